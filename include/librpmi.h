@@ -311,6 +311,21 @@ enum rpmi_clock_service_id {
 	RPMI_CLK_SRV_ID_MAX,
 };
 
+/**
+ * RPMI Clock Extension ServiceGroup Service IDs
+ *
+ * Implementation specific bulk clock services which are registered
+ * with an experimental or vendor service group ID.
+ */
+enum rpmi_clock_ext_service_id {
+	RPMI_CLK_EXT_SRV_ENABLE_NOTIFICATION = 0x01,
+	RPMI_CLK_EXT_SRV_GET_CONFIGS = 0x02,
+	RPMI_CLK_EXT_SRV_GET_RATES = 0x03,
+	RPMI_CLK_EXT_SRV_SET_CONFIGS = 0x04,
+	RPMI_CLK_EXT_SRV_SET_RATES = 0x05,
+	RPMI_CLK_EXT_SRV_ID_MAX,
+};
+
 /** RPMI CPPC (CPPC) ServiceGroup Service IDs */
 enum rpmi_cppc_service_id {
 	RPMI_CPPC_SRV_ENABLE_NOTIFICATION = 0x01,
@@ -342,9 +357,116 @@ enum rpmi_cppc_service_id {
 #define LIBRPMI_TRANSPORT_SHMEM_QUEUE_MIN_SIZE(__slot_size)	\
 	((__slot_size) * LIBRPMI_TRANSPORT_SHMEM_QUEUE_MIN_SLOTS)
 
+/** Maximum number of A2P requests processed by a RPMI context in one batch */
+#ifndef LIBRPMI_CONTEXT_BATCH_COUNT
+#define LIBRPMI_CONTEXT_BATCH_COUNT			4
+#endif
+
+/** Maximum number of deferred A2P requests pending in a RPMI context */
+#ifndef LIBRPMI_CONTEXT_MAX_DEFERRED
+#define LIBRPMI_CONTEXT_MAX_DEFERRED			4
+#endif
+
+/** Maximum number of RPMI transports served by a RPMI context */
+#ifndef LIBRPMI_CONTEXT_MAX_CHANNELS
+#define LIBRPMI_CONTEXT_MAX_CHANNELS			4
+#endif
+
+#if LIBRPMI_CONTEXT_MAX_CHANNELS > 32
+#error "LIBRPMI_CONTEXT_MAX_CHANNELS must not be more than 32"
+#endif
+
+/** P2A doorbell system MSI index of a RPMI transport without doorbell */
+#define LIBRPMI_CONTEXT_NO_P2A_MSI			(-1U)
+
+/** Maximum number of workers of a RPMI context in dispatcher mode */
+#ifndef LIBRPMI_CONTEXT_MAX_WORKERS
+#define LIBRPMI_CONTEXT_MAX_WORKERS			4
+#endif
+
+/** Number of A2P requests queued per worker of a RPMI context (power of 2) */
+#ifndef LIBRPMI_CONTEXT_WORKER_QUEUE_LEN
+#define LIBRPMI_CONTEXT_WORKER_QUEUE_LEN		8
+#endif
+
+#if LIBRPMI_CONTEXT_WORKER_QUEUE_LEN & (LIBRPMI_CONTEXT_WORKER_QUEUE_LEN - 1)
+#error "LIBRPMI_CONTEXT_WORKER_QUEUE_LEN must be a power of 2"
+#endif
+
+/**
+ * Inject one P2A doorbell per round of A2P request processing instead of
+ * one per acknowledgement requesting it (1 = coalesce, 0 = do not coalesce)
+ */
+#ifndef LIBRPMI_CONTEXT_COALESCE_DOORBELL
+#define LIBRPMI_CONTEXT_COALESCE_DOORBELL		0
+#endif
+
+/**
+ * Fixed slot size of all RPMI transports (0 = slot size chosen at runtime)
+ *
+ * A non-zero value must be a power-of-2 of at least RPMI_SLOT_SIZE_MIN and
+ * lets message size computations fold to constants.
+ */
+#ifndef LIBRPMI_FIXED_SLOT_SIZE
+#define LIBRPMI_FIXED_SLOT_SIZE				0
+#endif
+
+#if LIBRPMI_FIXED_SLOT_SIZE && \
+    ((LIBRPMI_FIXED_SLOT_SIZE & (LIBRPMI_FIXED_SLOT_SIZE - 1)) || \
+     LIBRPMI_FIXED_SLOT_SIZE < RPMI_SLOT_SIZE_MIN)
+#error "LIBRPMI_FIXED_SLOT_SIZE must be a power-of-2 >= RPMI_SLOT_SIZE_MIN"
+#endif
+
+/*
+ * Build-time selection of service groups (1 = built, 0 = not built)
+ *
+ * The create functions of a service group which is not built are stubs
+ * returning NULL and the other functions of it return RPMI_ERR_NOTSUPP.
+ */
+
+/** Build the hart state management (HSM) service group */
+#ifndef CONFIG_LIBRPMI_SRVGRP_HSM
+#define CONFIG_LIBRPMI_SRVGRP_HSM		1
+#endif
+
+/** Build the system MSI service group */
+#ifndef CONFIG_LIBRPMI_SRVGRP_SYSMSI
+#define CONFIG_LIBRPMI_SRVGRP_SYSMSI		1
+#endif
+
+/** Build the system reset service group */
+#ifndef CONFIG_LIBRPMI_SRVGRP_SYSRESET
+#define CONFIG_LIBRPMI_SRVGRP_SYSRESET		1
+#endif
+
+/** Build the system suspend service group */
+#ifndef CONFIG_LIBRPMI_SRVGRP_SYSSUSP
+#define CONFIG_LIBRPMI_SRVGRP_SYSSUSP		1
+#endif
+
+/** Build the clock (and clock extension) service group */
+#ifndef CONFIG_LIBRPMI_SRVGRP_CLOCK
+#define CONFIG_LIBRPMI_SRVGRP_CLOCK		1
+#endif
+
+/** Build the CPPC service group */
+#ifndef CONFIG_LIBRPMI_SRVGRP_CPPC
+#define CONFIG_LIBRPMI_SRVGRP_CPPC		1
+#endif
+
 /** RPMI shared memory structure to access a platform shared memory */
 struct rpmi_shmem;
 
+/** One range of a scatter-gather shared memory access */
+struct rpmi_shmem_iovec {
+	/** Offset of the range (relative to the base passed along) */
+	rpmi_uint32_t offset;
+	/** Length of the range in bytes */
+	rpmi_uint32_t len;
+	/** Local buffer (destination for read and source for write) */
+	void *buf;
+};
+
 /** Platform specific shared memory operations */
 struct rpmi_shmem_platform_ops {
 	/** Read from a physical address range (mandatory) */
@@ -358,6 +480,61 @@ struct rpmi_shmem_platform_ops {
 	/** Fill a physical address range (mandatory) */
 	enum rpmi_error (*fill)(void *priv, rpmi_uint64_t addr,
 				char ch, rpmi_uint32_t len);
+
+	/**
+	 * Get a pointer for direct load/store access to a physical address
+	 * range (optional)
+	 *
+	 * Note: This should be provided only if the physical address range
+	 * can be accessed in-place without any cache maintenance.
+	 */
+	void *(*direct_ptr)(void *priv, rpmi_uint64_t addr, rpmi_uint32_t len);
+
+	/**
+	 * Read an aligned 32-bit word with a single access (optional)
+	 *
+	 * Note: If not provided then read() is used.
+	 */
+	enum rpmi_error (*read32)(void *priv, rpmi_uint64_t addr,
+				  rpmi_uint32_t *val);
+
+	/**
+	 * Write an aligned 32-bit word with a single access (optional)
+	 *
+	 * Note: If not provided then write() is used.
+	 */
+	enum rpmi_error (*write32)(void *priv, rpmi_uint64_t addr,
+				   rpmi_uint32_t val);
+
+	/**
+	 * Read multiple ranges at offsets from a physical address (optional)
+	 *
+	 * Note: If not provided then read() is used for each range.
+	 */
+	enum rpmi_error (*readv)(void *priv, rpmi_uint64_t addr,
+				 const struct rpmi_shmem_iovec *iov,
+				 rpmi_uint32_t iov_count);
+
+	/**
+	 * Write multiple ranges at offsets from a physical address (optional)
+	 *
+	 * Note: If not provided then write() is used for each range.
+	 */
+	enum rpmi_error (*writev)(void *priv, rpmi_uint64_t addr,
+				  const struct rpmi_shmem_iovec *iov,
+				  rpmi_uint32_t iov_count);
+
+	/**
+	 * Invalidate a physical address range from the local caches so that
+	 * the following reads observe the other side writes (optional)
+	 */
+	void (*invalidate_range)(void *priv, rpmi_uint64_t addr, rpmi_uint32_t len);
+
+	/**
+	 * Clean (write back) a physical address range from the local caches so
+	 * that the other side observes the preceding writes (optional)
+	 */
+	void (*clean_range)(void *priv, rpmi_uint64_t addr, rpmi_uint32_t len);
 };
 
 /**
@@ -426,6 +603,90 @@ enum rpmi_error rpmi_shmem_write(struct rpmi_shmem *shmem, rpmi_uint32_t offset,
 enum rpmi_error rpmi_shmem_fill(struct rpmi_shmem *shmem, rpmi_uint32_t offset,
 				char ch, rpmi_uint32_t len);
 
+/**
+ * @brief Read an aligned 32-bit word from shared memory with a single access
+ *
+ * @param[in] shmem		pointer to shared memory instance
+ * @param[in] offset		source offset (32-bit aligned) within shared memory
+ * @param[out] val		pointer to the word read
+ * @return enum rpmi_error
+ */
+enum rpmi_error rpmi_shmem_read32(struct rpmi_shmem *shmem, rpmi_uint32_t offset,
+				  rpmi_uint32_t *val);
+
+/**
+ * @brief Write an aligned 32-bit word to shared memory with a single access
+ *
+ * @param[in] shmem		pointer to shared memory instance
+ * @param[in] offset		destination offset (32-bit aligned) within shared memory
+ * @param[in] val		word to write
+ * @return enum rpmi_error
+ */
+enum rpmi_error rpmi_shmem_write32(struct rpmi_shmem *shmem, rpmi_uint32_t offset,
+				   rpmi_uint32_t val);
+
+/**
+ * @brief Read multiple ranges from shared memory in one call
+ *
+ * @param[in] shmem		pointer to shared memory instance
+ * @param[in] iov		array of ranges (offsets within shared memory)
+ * @param[in] iov_count		number of ranges
+ * @return enum rpmi_error
+ */
+enum rpmi_error rpmi_shmem_readv(struct rpmi_shmem *shmem,
+				 const struct rpmi_shmem_iovec *iov,
+				 rpmi_uint32_t iov_count);
+
+/**
+ * @brief Write multiple ranges to shared memory in one call
+ *
+ * @param[in] shmem		pointer to shared memory instance
+ * @param[in] iov		array of ranges (offsets within shared memory)
+ * @param[in] iov_count		number of ranges
+ * @return enum rpmi_error
+ */
+enum rpmi_error rpmi_shmem_writev(struct rpmi_shmem *shmem,
+				  const struct rpmi_shmem_iovec *iov,
+				  rpmi_uint32_t iov_count);
+
+/**
+ * @brief Invalidate a part of shared memory from the local caches
+ *
+ * This is a nop for shared memory without invalidate_range() operation.
+ *
+ * @param[in] shmem		pointer to shared memory instance
+ * @param[in] offset		offset within shared memory
+ * @param[in] len		number of bytes to invalidate
+ * @return enum rpmi_error
+ */
+enum rpmi_error rpmi_shmem_invalidate(struct rpmi_shmem *shmem,
+				      rpmi_uint32_t offset, rpmi_uint32_t len);
+
+/**
+ * @brief Clean a part of shared memory from the local caches
+ *
+ * This is a nop for shared memory without clean_range() operation.
+ *
+ * @param[in] shmem		pointer to shared memory instance
+ * @param[in] offset		offset within shared memory
+ * @param[in] len		number of bytes to clean
+ * @return enum rpmi_error
+ */
+enum rpmi_error rpmi_shmem_clean(struct rpmi_shmem *shmem,
+				 rpmi_uint32_t offset, rpmi_uint32_t len);
+
+/**
+ * @brief Get a pointer for direct access to a part of shared memory
+ *
+ * @param[in] shmem		pointer to shared memory instance
+ * @param[in] offset		offset within shared memory
+ * @param[in] len		number of bytes to access
+ * @return pointer to the shared memory range upon success and NULL if
+ * the shared memory can't be accessed directly
+ */
+void *rpmi_shmem_direct_ptr(struct rpmi_shmem *shmem, rpmi_uint32_t offset,
+			    rpmi_uint32_t len);
+
 /**
  * @brief Create a shared memory instance
  *
@@ -450,6 +711,188 @@ struct rpmi_shmem *rpmi_shmem_create(const char *name,
  */
 void rpmi_shmem_destroy(struct rpmi_shmem *shmem);
 
+/** Alignment of each allocation carved out of a RPMI memory arena */
+#ifndef LIBRPMI_ARENA_ALIGN
+#define LIBRPMI_ARENA_ALIGN				16
+#endif
+
+/**
+ * RPMI memory arena
+ *
+ * While an arena is selected using rpmi_arena_select(), all memory
+ * allocated by the library (create functions of shared memory, transports,
+ * contexts, HSM, service groups, etc) is carved out of the arena instead
+ * of using rpmi_env_zalloc(). This allows the complete library state to be
+ * placed in one statically sized region.
+ *
+ * An arena without memory (base == NULL) is a measuring arena which falls
+ * back to rpmi_env_zalloc() and only accounts the allocations. Creating
+ * everything once with a measuring arena selected gives the region size
+ * required by rpmi_arena_used().
+ *
+ * The selected arena and the list of arenas are global to the library,
+ * not per thread and not locked so arenas are meant to be initialized and
+ * selected only during the single threaded platform initialization.
+ * Besides the create functions, the following calls may allocate and must
+ * be done within that window: rpmi_context_add_group() (statistics),
+ * rpmi_context_set_group_worker() (first use of a worker) and
+ * rpmi_service_group_cppc_set_domains(). Objects which reallocate after
+ * creation (rpmi_hsm_refresh() and
+ * rpmi_service_group_cppc_set_fastchan_stride()) remember the arena
+ * selected when they were created and use it regardless of the arena
+ * selected at the time of the call. When the library is compiled
+ * with LIBRPMI_ARENA_ONLY defined, allocations while no arena is selected
+ * fail instead of falling back to rpmi_env_zalloc() so allocations outside
+ * the window are caught.
+ *
+ * Note: Memory carved out of an arena is never given back individually so
+ * rpmi_free() of arena memory does nothing. Destroying objects living in an
+ * arena is allowed but the memory is only reclaimed by re-initializing the
+ * arena. Locks are always allocated using rpmi_env_alloc_lock().
+ */
+struct rpmi_arena {
+	/** Base address of the arena memory (NULL for a measuring arena) */
+	rpmi_uint8_t *base;
+	/** Size of the arena memory in bytes */
+	rpmi_size_t size;
+	/** Number of bytes allocated so far (including alignment padding) */
+	rpmi_size_t used;
+	/** Next arena known to the library (internal use only) */
+	struct rpmi_arena *next;
+};
+
+/**
+ * @brief Initialize a memory arena
+ *
+ * Re-initializing an already known arena discards all its allocations.
+ *
+ * @param[in] arena		pointer to arena
+ * @param[in] base		base of arena memory aligned to
+ *				LIBRPMI_ARENA_ALIGN (NULL for a measuring arena)
+ * @param[in] size		size of arena memory in bytes
+ * @return enum rpmi_error
+ */
+enum rpmi_error rpmi_arena_init(struct rpmi_arena *arena,
+				void *base, rpmi_size_t size);
+
+/**
+ * @brief Select the memory arena used for library allocations
+ *
+ * @param[in] arena		pointer to an initialized arena or NULL to
+ *				allocate using rpmi_env_zalloc()
+ * @return pointer to previously selected arena (NULL if none)
+ */
+struct rpmi_arena *rpmi_arena_select(struct rpmi_arena *arena);
+
+/**
+ * @brief Get the number of bytes allocated from a memory arena
+ *
+ * @param[in] arena		pointer to arena
+ * @return number of bytes allocated (including alignment padding)
+ */
+rpmi_size_t rpmi_arena_used(const struct rpmi_arena *arena);
+
+/** Magic value of a RPMI trace ring ("RPTR" as little-endian word) */
+#define RPMI_TRACE_RING_MAGIC				0x52545052
+
+/** Layout version of a RPMI trace ring */
+#define RPMI_TRACE_RING_VERSION				2
+
+/** RPMI trace event types */
+enum rpmi_trace_event_type {
+	RPMI_TRACE_EVENT_NONE = 0,
+	/** Messages dequeued (arg0 = queue type, arg1 = count) */
+	RPMI_TRACE_EVENT_DEQUEUE = 1,
+	/**
+	 * Request dispatch start (arg0 = service ID, arg1 = service group ID,
+	 * arg2[15:0] = token)
+	 */
+	RPMI_TRACE_EVENT_DISPATCH_START = 2,
+	/**
+	 * Request dispatch end (arg0 = service ID, arg1 = service group ID,
+	 * arg2[15:0] = token, arg2[31:16] = enum rpmi_error of the service)
+	 */
+	RPMI_TRACE_EVENT_DISPATCH_END = 3,
+	/** Acknowledgements enqueued (arg0 = queue type, arg1 = count) */
+	RPMI_TRACE_EVENT_ACK_ENQUEUE = 4,
+	/** Enqueue retry due to queue full (arg0 = queue type, arg1 = pending) */
+	RPMI_TRACE_EVENT_QUEUE_FULL = 5,
+	/** System MSI injected (arg2 = MSI index) */
+	RPMI_TRACE_EVENT_MSI_INJECT = 6,
+	/**
+	 * HSM hart state transition (arg0 = new state, arg1 = old state or
+	 * 0xffff if not known yet, arg2 = hart ID)
+	 */
+	RPMI_TRACE_EVENT_HSM_STATE = 7,
+	RPMI_TRACE_EVENT_MAX,
+};
+
+/** RPMI trace event (24 bytes in native endianness) */
+struct rpmi_trace_event {
+	/** Timestamp from rpmi_env_timer_value() */
+	rpmi_uint64_t timestamp;
+	/** Event type (enum rpmi_trace_event_type) */
+	rpmi_uint8_t type;
+	/** Event type specific arguments */
+	rpmi_uint8_t arg0;
+	rpmi_uint16_t arg1;
+	rpmi_uint32_t arg2;
+	/**
+	 * Free running index of the event plus one. It is cleared before and
+	 * written after all other fields so a mismatch with the expected index
+	 * marks a torn event.
+	 */
+	rpmi_uint32_t seq;
+	/** Reserved (zero) */
+	rpmi_uint32_t reserved;
+};
+
+/**
+ * RPMI trace ring
+ *
+ * The trace ring lives in caller-provided memory (such as a shared memory
+ * region visible to the AP or a debugger) so it can be exported as-is and
+ * decoded on a host. The ring is written in native endianness and the
+ * magic value tells the decoder about the byte order.
+ *
+ * Events are recorded lock-free by claiming a slot with an atomic increment
+ * of the head and storing the event fields. The most recent num_events
+ * events are kept. Events recorded concurrently with an export can be torn
+ * or not yet written so decoders must skip the events whose seq field does
+ * not match the index of the event plus one.
+ */
+struct rpmi_trace_ring {
+	/** Magic value (RPMI_TRACE_RING_MAGIC) */
+	rpmi_uint32_t magic;
+	/** Layout version (RPMI_TRACE_RING_VERSION) */
+	rpmi_uint16_t version;
+	/** Size of one event in bytes */
+	rpmi_uint16_t event_size;
+	/** Number of events in the ring (power of 2) */
+	rpmi_uint32_t num_events;
+	/** Free running count of events recorded so far */
+	rpmi_uint32_t head;
+	/** Array of events indexed by (head % num_events) */
+	struct rpmi_trace_event events[0];
+};
+
+/**
+ * @brief Initialize the RPMI trace ring and start recording events
+ *
+ * The number of events is the largest power of 2 which fits in the given
+ * memory after the ring header. There is one trace ring for the library
+ * and re-initializing discards all previously recorded events.
+ *
+ * Note: Events are only recorded when the library is compiled with
+ * LIBRPMI_TRACE defined.
+ *
+ * @param[in] base		base of trace ring memory aligned to 8 bytes
+ *				(NULL to stop recording events)
+ * @param[in] size		size of trace ring memory in bytes
+ * @return enum rpmi_error
+ */
+enum rpmi_error rpmi_trace_init(void *base, rpmi_size_t size);
+
 /** @} */
 
 /*****************************************************************************/
@@ -461,6 +904,24 @@ void rpmi_shmem_destroy(struct rpmi_shmem *shmem);
  * @{
  */
 
+/**
+ * RPMI transport statistics
+ *
+ * Note: The statistics are only maintained when the library is compiled
+ * with LIBRPMI_STATS defined.
+ */
+struct rpmi_transport_stats {
+	/** Number of messages transferred through each queue type */
+	rpmi_uint64_t messages[RPMI_QUEUE_MAX];
+
+	/**
+	 * Number of attempts failed because the queue type was full (for
+	 * enqueue) or empty (for dequeue). For the P2A acknowledgement queue
+	 * this counts the acknowledgement retries.
+	 */
+	rpmi_uint64_t queue_busy[RPMI_QUEUE_MAX];
+};
+
 /**
  * RPMI transport instance
  *
@@ -517,6 +978,93 @@ struct rpmi_transport {
 				   enum rpmi_queue_type qtype,
 				   struct rpmi_message *out_msg);
 
+	/**
+	 * Callback to enqueue a batch of RPMI messages to a specified RPMI
+	 * queue type (optional)
+	 *
+	 * The messages are laid out back-to-back in the msgs buffer and each
+	 * message occupies slot_size bytes. The callback enqueues as many
+	 * messages as there are free slots in the queue and returns the
+	 * number of enqueued messages in out_count.
+	 *
+	 * Note: This function must be called with transport lock held.
+	 */
+	enum rpmi_error (*enqueue_batch)(struct rpmi_transport *trans,
+					 enum rpmi_queue_type qtype,
+					 const struct rpmi_message *msgs,
+					 rpmi_uint32_t count,
+					 rpmi_uint32_t *out_count);
+
+	/**
+	 * Callback to dequeue a batch of RPMI messages from a specified RPMI
+	 * queue type (optional)
+	 *
+	 * The dequeued messages are laid out back-to-back in the out_msgs
+	 * buffer and each message occupies slot_size bytes. The callback
+	 * dequeues at most max_count messages and returns the number of
+	 * dequeued messages in out_count.
+	 *
+	 * Note: This function must be called with transport lock held.
+	 */
+	enum rpmi_error (*dequeue_batch)(struct rpmi_transport *trans,
+					 enum rpmi_queue_type qtype,
+					 struct rpmi_message *out_msgs,
+					 rpmi_uint32_t max_count,
+					 rpmi_uint32_t *out_count);
+
+	/**
+	 * Callback to get the RPMI message at the head of a specified RPMI
+	 * queue type for in-place access without dequeuing it (optional)
+	 *
+	 * The message header is in transport endianness. The slot remains
+	 * owned by the caller until commit_slot() is called but the other
+	 * side of the transport can still write it.
+	 *
+	 * Note: This function must be called with transport lock held and
+	 * must return RPMI_ERR_IO if the queue is empty.
+	 */
+	enum rpmi_error (*peek_slot)(struct rpmi_transport *trans,
+				     enum rpmi_queue_type qtype,
+				     struct rpmi_message **out_msg);
+
+	/**
+	 * Callback to release the slot returned by peek_slot() back to the
+	 * producer of a specified RPMI queue type (optional)
+	 *
+	 * Note: This function must be called with transport lock held.
+	 */
+	enum rpmi_error (*commit_slot)(struct rpmi_transport *trans,
+				       enum rpmi_queue_type qtype);
+
+	/**
+	 * Callback to get the free slot at the tail of a specified RPMI queue
+	 * type for in-place message construction without enqueuing it (optional)
+	 *
+	 * The message header must be written in transport endianness. The
+	 * message becomes visible to the consumer only after publish_slot().
+	 *
+	 * Note: This function must be called with transport lock held and
+	 * must return RPMI_ERR_IO if the queue is full.
+	 */
+	enum rpmi_error (*reserve_slot)(struct rpmi_transport *trans,
+					enum rpmi_queue_type qtype,
+					struct rpmi_message **out_msg);
+
+	/**
+	 * Callback to make the slot returned by reserve_slot() visible to the
+	 * consumer of a specified RPMI queue type (optional)
+	 *
+	 * Note: This function must be called with transport lock held.
+	 */
+	enum rpmi_error (*publish_slot)(struct rpmi_transport *trans,
+					enum rpmi_queue_type qtype);
+
+	/**
+	 * Statistics of the transport (updated with transport lock held and
+	 * only maintained when the library is compiled with LIBRPMI_STATS)
+	 */
+	struct rpmi_transport_stats stats;
+
 	/** Lock to synchronize transport access (optional) */
 	void *lock;
 
@@ -568,6 +1116,214 @@ enum rpmi_error rpmi_transport_dequeue(struct rpmi_transport *trans,
 				       enum rpmi_queue_type qtype,
 				       struct rpmi_message *out_msg);
 
+/**
+ * @brief Get the endianness of messages transferred through a RPMI transport
+ *
+ * @param[in] trans		pointer to RPMI transport instance
+ * @return true for big-endian and false for little-endian transport
+ */
+static inline rpmi_bool_t rpmi_transport_is_be(const struct rpmi_transport *trans)
+{
+#ifdef LIBRPMI_FIXED_ENDIAN_LE
+	return false;
+#else
+	return trans->is_be;
+#endif
+}
+
+/**
+ * @brief Get the slot (or max message) size of a RPMI transport
+ *
+ * @param[in] trans		pointer to RPMI transport instance
+ * @return slot size in bytes
+ */
+static inline rpmi_size_t rpmi_transport_slot_size(const struct rpmi_transport *trans)
+{
+#if LIBRPMI_FIXED_SLOT_SIZE
+	return LIBRPMI_FIXED_SLOT_SIZE;
+#else
+	return trans->slot_size;
+#endif
+}
+
+/**
+ * @brief Get a message from a batch of RPMI messages laid out back-to-back
+ *
+ * @param[in] trans		pointer to RPMI transport instance
+ * @param[in] msgs		pointer to the batch of RPMI messages
+ * @param[in] index		index of the message within the batch
+ * @return pointer to the RPMI message at given index
+ */
+static inline struct rpmi_message *rpmi_transport_batch_msg(struct rpmi_transport *trans,
+							    struct rpmi_message *msgs,
+							    rpmi_uint32_t index)
+{
+	return (struct rpmi_message *)((rpmi_uint8_t *)msgs +
+				       (index * rpmi_transport_slot_size(trans)));
+}
+
+/**
+ * @brief Convert a RPMI message header between native and transport endianness
+ *
+ * @param[in] trans		pointer to RPMI transport instance
+ * @param[out] dst		pointer to the converted message header
+ * @param[in] src		pointer to the message header to convert
+ */
+static inline void rpmi_transport_convert_header(struct rpmi_transport *trans,
+						 struct rpmi_message_header *dst,
+						 const struct rpmi_message_header *src)
+{
+	dst->servicegroup_id = rpmi_to_xe16(trans->is_be, src->servicegroup_id);
+	dst->service_id = src->service_id;
+	dst->flags = src->flags;
+	dst->datalen = rpmi_to_xe16(trans->is_be, src->datalen);
+	dst->token = rpmi_to_xe16(trans->is_be, src->token);
+}
+
+/**
+ * @brief Check if a RPMI transport supports in-place access to the slot at
+ * the head of a queue (consumer side)
+ *
+ * @param[in] trans		pointer to RPMI transport instance
+ * @return true if peek/commit slot operations are supported and false
+ * otherwise
+ */
+static inline rpmi_bool_t rpmi_transport_has_peek_slot(struct rpmi_transport *trans)
+{
+	return (trans->peek_slot && trans->commit_slot) ? true : false;
+}
+
+/**
+ * @brief Check if a RPMI transport supports in-place access to the slot at
+ * the tail of a queue (producer side)
+ *
+ * @param[in] trans		pointer to RPMI transport instance
+ * @return true if reserve/publish slot operations are supported and false
+ * otherwise
+ */
+static inline rpmi_bool_t rpmi_transport_has_reserve_slot(struct rpmi_transport *trans)
+{
+	return (trans->reserve_slot && trans->publish_slot) ? true : false;
+}
+
+/**
+ * @brief Get the RPMI message at the head of a specified RPMI queue type for
+ * in-place access without dequeuing it
+ *
+ * The returned message header is in transport endianness and the message
+ * must be released using rpmi_transport_commit_slot() after use.
+ *
+ * Note: At most one in-place consumer per queue is allowed and it must
+ * not be mixed with rpmi_transport_dequeue() between peek and commit. The
+ * other side of the transport can still write the slot so the message must
+ * only be accessed in-place if that side is trusted.
+ *
+ * @param[in] trans		pointer to RPMI transport instance
+ * @param[in] qtype		type of the RPMI queue
+ * @param[out] out_msg		pointer to the RPMI message within the slot
+ * @return enum rpmi_error (RPMI_ERR_IO if queue is empty)
+ */
+enum rpmi_error rpmi_transport_peek_slot(struct rpmi_transport *trans,
+					 enum rpmi_queue_type qtype,
+					 struct rpmi_message **out_msg);
+
+/**
+ * @brief Release the slot returned by rpmi_transport_peek_slot()
+ *
+ * @param[in] trans		pointer to RPMI transport instance
+ * @param[in] qtype		type of the RPMI queue
+ * @return enum rpmi_error
+ */
+enum rpmi_error rpmi_transport_commit_slot(struct rpmi_transport *trans,
+					   enum rpmi_queue_type qtype);
+
+/**
+ * @brief Get the free slot at the tail of a specified RPMI queue type for
+ * in-place message construction without enqueuing it
+ *
+ * The message header must be written in transport endianness and the
+ * message must be made visible using rpmi_transport_publish_slot().
+ *
+ * Note: At most one in-place producer per queue is allowed and it must
+ * not be mixed with rpmi_transport_enqueue() between reserve and publish.
+ *
+ * @param[in] trans		pointer to RPMI transport instance
+ * @param[in] qtype		type of the RPMI queue
+ * @param[out] out_msg		pointer to the RPMI message within the slot
+ * @return enum rpmi_error (RPMI_ERR_IO if queue is full)
+ */
+enum rpmi_error rpmi_transport_reserve_slot(struct rpmi_transport *trans,
+					    enum rpmi_queue_type qtype,
+					    struct rpmi_message **out_msg);
+
+/**
+ * @brief Make the slot returned by rpmi_transport_reserve_slot() visible
+ *
+ * @param[in] trans		pointer to RPMI transport instance
+ * @param[in] qtype		type of the RPMI queue
+ * @return enum rpmi_error
+ */
+enum rpmi_error rpmi_transport_publish_slot(struct rpmi_transport *trans,
+					    enum rpmi_queue_type qtype);
+
+/**
+ * @brief Get the statistics of a RPMI transport
+ *
+ * Note: The snapshot is taken with the transport lock held. Without a
+ * transport lock (SPSC mode) each counter is owned by the side which serves
+ * the queue through the transport instance so a snapshot taken concurrently
+ * with that side may be torn or mix counters of different moments.
+ *
+ * @param[in] trans		pointer to RPMI transport instance
+ * @param[out] out_stats	pointer to the statistics
+ * @return enum rpmi_error (RPMI_ERR_NOTSUPP if compiled without LIBRPMI_STATS)
+ */
+enum rpmi_error rpmi_transport_get_stats(struct rpmi_transport *trans,
+					 struct rpmi_transport_stats *out_stats);
+
+/**
+ * @brief Enqueue a batch of RPMI messages to a specified RPMI queue type of
+ * a RPMI transport
+ *
+ * The messages are laid out back-to-back in the msgs buffer where each
+ * message occupies slot_size bytes of the transport. The transport lock
+ * is taken only once for the whole batch.
+ *
+ * @param[in] trans		pointer to RPMI transport instance
+ * @param[in] qtype		type of the RPMI queue
+ * @param[in] msgs		pointer to the batch of RPMI messages
+ * @param[in] count		number of RPMI messages in the batch
+ * @param[out] out_count	number of RPMI messages actually enqueued
+ * @return enum rpmi_error (RPMI_ERR_IO if queue is full)
+ */
+enum rpmi_error rpmi_transport_enqueue_batch(struct rpmi_transport *trans,
+					     enum rpmi_queue_type qtype,
+					     struct rpmi_message *msgs,
+					     rpmi_uint32_t count,
+					     rpmi_uint32_t *out_count);
+
+/**
+ * @brief Dequeue a batch of RPMI messages from a specified RPMI queue type of
+ * a RPMI transport
+ *
+ * The dequeued messages are laid out back-to-back in the out_msgs buffer
+ * where each message occupies slot_size bytes of the transport hence the
+ * out_msgs buffer must be at least (max_count * slot_size) bytes. The
+ * transport lock is taken only once for the whole batch.
+ *
+ * @param[in] trans		pointer to RPMI transport instance
+ * @param[in] qtype		type of the RPMI queue
+ * @param[out] out_msgs		pointer to the buffer for dequeued RPMI messages
+ * @param[in] max_count		maximum number of RPMI messages to dequeue
+ * @param[out] out_count	number of RPMI messages actually dequeued
+ * @return enum rpmi_error (RPMI_ERR_IO if queue is empty)
+ */
+enum rpmi_error rpmi_transport_dequeue_batch(struct rpmi_transport *trans,
+					     enum rpmi_queue_type qtype,
+					     struct rpmi_message *out_msgs,
+					     rpmi_uint32_t max_count,
+					     rpmi_uint32_t *out_count);
+
 /**
  * @brief Create a shared memory transport instance
  *
@@ -584,37 +1340,264 @@ struct rpmi_transport *rpmi_transport_shmem_create(const char *name,
 						   rpmi_uint32_t p2a_req_queue_size,
 						   struct rpmi_shmem *shmem);
 
+/**
+ * Lock-free single-producer single-consumer (SPSC) mode of shared memory
+ * transport. In this mode, the transport lock is not allocated and the
+ * queues are synchronized only using acquire/release ordering of the
+ * head/tail indices.
+ *
+ * Note: The caller must ensure that each queue has at most one producer
+ * and one consumer on this side of the transport. The shared memory ops
+ * must access naturally aligned 32-bit words with a single access.
+ */
+#define LIBRPMI_TRANSPORT_SHMEM_FLAG_SPSC	(1U << 0)
+
+/**
+ * Application processors on the other side of the shared memory transport
+ * are trusted (trusted AP only). In this mode, the RPMI context processes
+ * A2P requests in-place within the shared memory slot instead of copying
+ * them to a private buffer first.
+ *
+ * Note: Service groups validate a request field before using it so an
+ * untrusted AP could change the field in between. Without this flag, only
+ * the P2A acknowledgements are written in-place.
+ */
+#define LIBRPMI_TRANSPORT_SHMEM_FLAG_TRUSTED_AP	(1U << 1)
+
+#define LIBRPMI_TRANSPORT_SHMEM_FLAGS_MASK	(LIBRPMI_TRANSPORT_SHMEM_FLAG_SPSC | \
+						 LIBRPMI_TRANSPORT_SHMEM_FLAG_TRUSTED_AP)
+
+/**
+ * @brief Create a shared memory transport instance with additional flags
+ *
+ * @param[in] name		name of the shared memory transport instance
+ * @param[in] slot_size		size of message slot for queues in shared memory
+ * @param[in] a2p_req_queue_size	size of A2P request and P2A acknowledgement queues
+ * @param[in] p2a_req_queue_size	size of P2A request and A2P acknowledgement queues
+ * @param[in] shmem		pointer to a RPMI shared memory instance
+ * @param[in] flags		LIBRPMI_TRANSPORT_SHMEM_FLAG_xyz flags
+ * @return pointer to RPMI transport upon success and NULL upon failure
+ */
+struct rpmi_transport *rpmi_transport_shmem_create_ext(const char *name,
+						       rpmi_uint32_t slot_size,
+						       rpmi_uint32_t a2p_req_queue_size,
+						       rpmi_uint32_t p2a_req_queue_size,
+						       struct rpmi_shmem *shmem,
+						       rpmi_uint32_t flags);
+
 /**
  * @brief Destroy (of free) a shared memory transport instance
  *
  * @param[in] trans		pointer to RPMI transport instance
  */
-void rpmi_transport_shmem_destroy(struct rpmi_transport *trans);
-
-/** @} */
-
-/*****************************************************************************/
+void rpmi_transport_shmem_destroy(struct rpmi_transport *trans);
+
+/** @} */
+
+/*****************************************************************************/
+
+/**
+ * \defgroup LIBRPMI_CONTEXT_INTERFACE RPMI Context Library Interface
+ * @brief Global functions and data structures implemented by the RPMI library
+ * for managing RPMI context.
+ * @{
+ */
+
+/**
+ * @brief Opaque RPMI execution context which groups together a RPMI transport
+ * instance and a set of RPMI service groups. The RPMI base service group is
+ * a built-in service group of the RPMI context and is always available.
+ */
+struct rpmi_context;
+
+/**
+ * @brief Opaque handle of the A2P request being processed which is passed
+ * to the process_a2p_request_deferrable callback of a service. The handle
+ * is only valid until the callback returns.
+ */
+struct rpmi_context_request;
+
+/**
+ * RPMI service statistics
+ *
+ * Latencies are measured in rpmi_env_timer_value() ticks around the service
+ * callback and are only meaningful if the platform provides a timer.
+ *
+ * Note: The statistics are only maintained when the library is compiled
+ * with LIBRPMI_STATS defined.
+ */
+struct rpmi_service_stats {
+	/** Number of A2P requests processed */
+	rpmi_uint64_t requests;
+
+	/**
+	 * Number of A2P requests failed by the library or with error status
+	 * other than RPMI_ERR_NOTSUPP
+	 */
+	rpmi_uint64_t errors;
+
+	/** Number of A2P requests answered with RPMI_ERR_NOTSUPP */
+	rpmi_uint64_t notsupp;
+
+	/** Minimum latency of processing an A2P request */
+	rpmi_uint64_t latency_min;
+
+	/** Maximum latency of processing an A2P request */
+	rpmi_uint64_t latency_max;
+
+	/** Cumulative latency of processing A2P requests */
+	rpmi_uint64_t latency_total;
+};
+
+/**
+ * @brief Process requests from application processors for a RPMI context
+ *
+ * @param[in] cntx		pointer to the RPMI context
+ */
+void rpmi_context_process_a2p_request(struct rpmi_context *cntx);
+
+/**
+ * @brief Process a bounded number of requests from application processors
+ * for a RPMI context
+ *
+ * Unlike rpmi_context_process_a2p_request(), this function does not wait
+ * for free space in the P2A acknowledgement queue. If the acknowledgement
+ * queue is full then pending acknowledgements are parked in the context
+ * and posted by the next call before processing any new request. As with
+ * rpmi_context_process_a2p_request(), requests are left in the A2P request
+ * queue while the work queue of a worker (see
+ * rpmi_context_set_group_worker()) is full.
+ *
+ * @param[in] cntx		pointer to the RPMI context
+ * @param[in] max_count		maximum number of requests to process
+ * (0 means no limit)
+ * @param[in] deadline		value of rpmi_env_timer_value() after which no
+ * new request is processed (0 means no deadline)
+ * @return number of requests processed
+ */
+rpmi_uint32_t rpmi_context_process_a2p_request_bounded(struct rpmi_context *cntx,
+						       rpmi_uint32_t max_count,
+						       rpmi_uint64_t deadline);
+
+/**
+ * @brief Get the RPMI context processing an A2P request
+ *
+ * @param[in] req		handle of the request passed to process_a2p_request_deferrable
+ * @return struct rpmi_context * pointer to the RPMI context
+ */
+struct rpmi_context *rpmi_context_request_context(struct rpmi_context_request *req);
+
+/**
+ * @brief Defer the completion of an A2P request
+ *
+ * This allows a service with slow platform operations to complete the
+ * request asynchronously so that the RPMI context can move on to the next
+ * request. The acknowledgement with the saved token is posted only after
+ * the platform calls rpmi_context_complete_request() with the RPMI context
+ * of the request (see rpmi_context_request_context()) and the returned
+ * handle. The response prepared by the process_a2p_request_deferrable
+ * callback is discarded. Deferred requests may be completed in any order.
+ *
+ * Note: This function must be called from the process_a2p_request_deferrable
+ * callback which got the request handle. The request data is not preserved so the
+ * callback must save whatever it needs for the completion. Requests
+ * processed by a worker (see rpmi_context_set_group_worker()) can't be
+ * deferred.
+ *
+ * @param[in] req		handle of the request passed to process_a2p_request_deferrable
+ * @param[out] out_handle	handle of the deferred request
+ * @return enum rpmi_error (RPMI_ERR_BUSY if too many requests are deferred and
+ * RPMI_ERR_INVALID_STATE if the request is processed by a worker or already
+ * deferred)
+ */
+enum rpmi_error rpmi_context_defer_request(struct rpmi_context_request *req,
+					   rpmi_uint32_t *out_handle);
+
+/**
+ * @brief Complete a deferred A2P request of a RPMI context
+ *
+ * The acknowledgement is posted to the P2A acknowledgement queue by the next
+ * rpmi_context_process_a2p_request() or rpmi_context_process_a2p_request_bounded()
+ * call hence this function can be called from any thread or interrupt context.
+ *
+ * @param[in] cntx		pointer to the RPMI context
+ * @param[in] handle		handle returned by rpmi_context_defer_request()
+ * @param[in] response_datalen	length of response data in bytes
+ * @param[in] response_data	response data in transport endianness
+ * @return enum rpmi_error
+ */
+enum rpmi_error rpmi_context_complete_request(struct rpmi_context *cntx,
+					      rpmi_uint32_t handle,
+					      rpmi_uint16_t response_datalen,
+					      const rpmi_uint8_t *response_data);
 
 /**
- * \defgroup LIBRPMI_CONTEXT_INTERFACE RPMI Context Library Interface
- * @brief Global functions and data structures implemented by the RPMI library
- * for managing RPMI context.
- * @{
+ * @brief Complete a deferred A2P request of a RPMI context with a status
+ * only response
+ *
+ * Same as rpmi_context_complete_request() but the response data is the
+ * status converted to the endianness of the transport of the request.
+ *
+ * @param[in] cntx		pointer to the RPMI context
+ * @param[in] handle		handle returned by rpmi_context_defer_request()
+ * @param[in] status		status of the request
+ * @return enum rpmi_error
  */
+enum rpmi_error rpmi_context_complete_request_status(struct rpmi_context *cntx,
+						     rpmi_uint32_t handle,
+						     enum rpmi_error status);
 
 /**
- * @brief Opaque RPMI execution context which groups together a RPMI transport
- * instance and a set of RPMI service groups. The RPMI base service group is
- * a built-in service group of the RPMI context and is always available.
+ * @brief Assign the A2P requests of a RPMI service group to a worker
+ *
+ * Assigning a service group to a worker turns the caller of
+ * rpmi_context_process_a2p_request() (or its bounded variant) into a
+ * dispatcher which queues the requests of the service group to the work
+ * queue of the worker instead of processing them. Each worker processes its
+ * queue using rpmi_context_process_worker() so slow platform operations of
+ * one service group don't block the requests of service groups assigned to
+ * other workers or to the dispatcher. The service group lock is held while
+ * a request is processed by the worker.
+ *
+ * Workers must run on a separate execution context (another core or thread)
+ * from the dispatcher. The dispatcher never waits for a worker: requests are
+ * left in the A2P request queue while the work queue of a worker is full and
+ * picked up by a later call once the worker made progress. The
+ * acknowledgements of a worker are posted by the dispatcher in the order in
+ * which the requests were queued.
+ *
+ * The worker of a service group can be changed at any time. To keep the
+ * order of the acknowledgements, the dispatcher keeps queuing the requests
+ * of the service group to the previous worker until all requests queued to
+ * it are acknowledged so the previous worker must keep processing its queue
+ * until then. If a service group is removed while requests of it are queued
+ * then the worker acknowledges them with RPMI_ERR_NOTSUPP.
+ *
+ * @param[in] cntx		pointer to the RPMI context
+ * @param[in] servicegroup_id	ID of a service group added to the context
+ * @param[in] worker		worker number from 1 to
+ * LIBRPMI_CONTEXT_MAX_WORKERS (0 means processed by the dispatcher)
+ * @return enum rpmi_error
  */
-struct rpmi_context;
+enum rpmi_error rpmi_context_set_group_worker(struct rpmi_context *cntx,
+					      rpmi_uint16_t servicegroup_id,
+					      rpmi_uint32_t worker);
 
 /**
- * @brief Process requests from application processors for a RPMI context
+ * @brief Process the A2P requests queued to a worker of a RPMI context
+ *
+ * The acknowledgements are posted by the next call to
+ * rpmi_context_process_a2p_request() or its bounded variant.
+ *
+ * Note: At most one caller per worker is allowed at a time and it must run
+ * on a separate execution context from the dispatcher.
  *
  * @param[in] cntx		pointer to the RPMI context
+ * @param[in] worker		worker number from 1 to LIBRPMI_CONTEXT_MAX_WORKERS
+ * @return number of requests processed
  */
-void rpmi_context_process_a2p_request(struct rpmi_context *cntx);
+rpmi_uint32_t rpmi_context_process_worker(struct rpmi_context *cntx,
+					  rpmi_uint32_t worker);
 
 /**
  * @brief Process events of RPMI service group in a RPMI context
@@ -628,13 +1611,49 @@ void rpmi_context_process_group_events(struct rpmi_context *cntx,
 /**
  * @brief Process events of all RPMI service groups in a RPMI context
  *
+ * Only service groups which poll for events and service groups which are
+ * signalled are visited so the cost of an idle call does not depend on
+ * the number of service groups waiting for a signal.
+ *
  * @param[in] cntx		pointer to the RPMI context
  */
 void rpmi_context_process_all_events(struct rpmi_context *cntx);
 
+/**
+ * @brief Signal pending events of a RPMI service group in a RPMI context
+ *
+ * The events are processed by the next rpmi_context_process_all_events()
+ * call. This function is lock-free and can be called from interrupt context.
+ *
+ * @param[in] cntx		pointer to the RPMI context
+ * @param[in] servicegroup_id	ID of the service group
+ * @return enum rpmi_error
+ */
+enum rpmi_error rpmi_context_signal_group(struct rpmi_context *cntx,
+					  rpmi_uint16_t servicegroup_id);
+
+/**
+ * @brief Get the statistics of a RPMI service in a RPMI context
+ *
+ * @param[in] cntx		pointer to the RPMI context
+ * @param[in] servicegroup_id	ID of the service group
+ * @param[in] service_id	ID of the service or 0 for the whole service group
+ * @param[out] out_stats	pointer to the statistics
+ * @return enum rpmi_error (RPMI_ERR_NOTSUPP if compiled without LIBRPMI_STATS)
+ */
+enum rpmi_error rpmi_context_get_stats(struct rpmi_context *cntx,
+				       rpmi_uint16_t servicegroup_id,
+				       rpmi_uint8_t service_id,
+				       struct rpmi_service_stats *out_stats);
+
 /**
  * @brief Find a RPMI service group in a RPMI context
  *
+ * Note: The lookup is lock-free and takes constant time on average. A lookup
+ * which races with adding or removing a group may not find that group. The
+ * returned group is only guaranteed to stay in the context while called
+ * from a service or event callback of the same context.
+ *
  * @param[in] cntx		pointer to the RPMI context
  * @param[in] servicegroup_id	ID of the service group
  * @return pointer to RPMI service group upon success and NULL upon failure
@@ -645,6 +1664,15 @@ struct rpmi_service_group *rpmi_context_find_group(struct rpmi_context *cntx,
 /**
  * @brief Add a RPMI service group to a RPMI context
  *
+ * Note: Request, event and worker processing look up service groups
+ * lock-free so this waits until none of them uses the previous dispatch
+ * table anymore. The request processing only holds on to the dispatch
+ * table while processing one request (or one batch of copied requests of
+ * a transport) so this doesn't wait for a whole
+ * rpmi_context_process_a2p_request() call. It must not be called from a
+ * service or event callback and not while holding a lock which such a
+ * callback may take.
+ *
  * @param[in] cntx		pointer to the RPMI context
  * @param[in] group		pointer to the RPMI service group
  * @return enum rpmi_error
@@ -655,15 +1683,73 @@ enum rpmi_error rpmi_context_add_group(struct rpmi_context *cntx,
 /**
  * @brief Remove a RPMI service group from a RPMI context
  *
+ * Note: This waits until no request, event or worker processing of the
+ * context uses the service group anymore so the group can be destroyed
+ * after it returns. The restrictions of rpmi_context_add_group() apply.
+ *
  * @param[in] cntx		pointer to the RPMI context
  * @param[in] group		pointer to the RPMI service group
  */
 void rpmi_context_remove_group(struct rpmi_context *cntx,
 			       struct rpmi_service_group *group);
 
+/**
+ * @brief Add a secondary RPMI transport to a RPMI context
+ *
+ * All transports of a RPMI context share the same set of service groups
+ * and each transport (channel) only sees the service groups accessible at
+ * its privilege level. The A2P requests of all transports are processed
+ * by rpmi_context_process_a2p_request() in a round-robin manner.
+ *
+ * The P2A doorbell requested by A2P requests of the transport is injected
+ * using the given system MSI of the system MSI service group of the context
+ * whereas the transport passed to rpmi_context_create() uses the P2A doorbell
+ * system MSI of that service group. The doorbell flag of A2P requests is
+ * ignored for a transport without doorbell system MSI.
+ *
+ * Note: The slot size of the secondary transport must not be bigger than
+ * the slot size of the transport passed to rpmi_context_create(). Big-endian
+ * transports are rejected when LIBRPMI_FIXED_ENDIAN_LE is defined.
+ *
+ * @param[in] cntx		pointer to the RPMI context
+ * @param[in] trans		pointer to RPMI transport instance
+ * @param[in] privilege_level	RISC-V privilege level of the transport
+ * @param[in] p2a_msi_index	system MSI index of the P2A doorbell of the
+ * transport (LIBRPMI_CONTEXT_NO_P2A_MSI if the transport has no doorbell)
+ * @return enum rpmi_error
+ */
+enum rpmi_error rpmi_context_add_transport(struct rpmi_context *cntx,
+					   struct rpmi_transport *trans,
+					   enum rpmi_privilege_level privilege_level,
+					   rpmi_uint32_t p2a_msi_index);
+
+/**
+ * @brief Remove a secondary RPMI transport from a RPMI context
+ *
+ * The request processing stops serving the transport before this function
+ * waits for the requests of the transport which may still be in flight,
+ * so the restrictions of rpmi_context_add_group() apply.
+ * Acknowledgements parked for the transport are dropped.
+ *
+ * Note: The transport passed to rpmi_context_create() can't be removed and
+ * a transport with deferred requests or requests queued to a worker which
+ * are not yet acknowledged is not removed (RPMI_ERR_BUSY) so the caller
+ * can retry once they are acknowledged.
+ *
+ * @param[in] cntx		pointer to the RPMI context
+ * @param[in] trans		pointer to RPMI transport instance
+ * @return enum rpmi_error
+ */
+enum rpmi_error rpmi_context_remove_transport(struct rpmi_context *cntx,
+					      struct rpmi_transport *trans);
+
 /**
  * @brief Create a RPMI context
  *
+ * Note: Big-endian transports are rejected when LIBRPMI_FIXED_ENDIAN_LE is
+ * defined because the endianness conversions ignore the transport
+ * endianness in such builds.
+ *
  * @param[in] name		name of the context instance
  * @param[in] trans		pointer to RPMI transport instance
  * @param[in] max_num_groups	maximum number of service groups
@@ -710,7 +1796,8 @@ struct rpmi_service {
 	/**
 	 * Callback to process a2p request
 	 *
-	 * Note: This function must be called with service group lock held.
+	 * Note: This function must be called with service group lock held
+	 * unless LIBRPMI_SERVICE_GROUP_FLAG_INTERNAL_LOCKING is set.
 	 */
 	enum rpmi_error (*process_a2p_request)(struct rpmi_service_group *group,
 					       struct rpmi_service *service,
@@ -719,8 +1806,40 @@ struct rpmi_service {
 					       const rpmi_uint8_t *request_data,
 					       rpmi_uint16_t *response_data_len,
 					       rpmi_uint8_t *response_data);
+
+	/**
+	 * Callback to process a2p request which may be deferred (optional)
+	 *
+	 * Same as process_a2p_request and used instead of it if set where
+	 * the req handle identifies the request for rpmi_context_defer_request().
+	 *
+	 * Note: This function must be called with service group lock held
+	 * unless LIBRPMI_SERVICE_GROUP_FLAG_INTERNAL_LOCKING is set.
+	 */
+	enum rpmi_error (*process_a2p_request_deferrable)(struct rpmi_service_group *group,
+							  struct rpmi_service *service,
+							  struct rpmi_transport *trans,
+							  struct rpmi_context_request *req,
+							  rpmi_uint16_t request_data_len,
+							  const rpmi_uint8_t *request_data,
+							  rpmi_uint16_t *response_data_len,
+							  rpmi_uint8_t *response_data);
 };
 
+/**
+ * Events of the service group are only processed after the service group
+ * is signalled using rpmi_context_signal_group(). A service group is also
+ * signalled implicitly whenever an A2P request of it is processed.
+ */
+#define LIBRPMI_SERVICE_GROUP_FLAG_EVENTS_ON_SIGNAL	(1U << 0)
+
+/**
+ * The service group synchronizes its state internally so the RPMI context
+ * does not hold the service group lock while calling the service group
+ * callbacks which allows concurrent processing of requests.
+ */
+#define LIBRPMI_SERVICE_GROUP_FLAG_INTERNAL_LOCKING	(1U << 1)
+
 /** RPMI service group instance */
 struct rpmi_service_group {
 	/** Name of the service group */
@@ -746,6 +1865,9 @@ struct rpmi_service_group {
 	/** Array of services indexed by service ID */
 	struct rpmi_service *services;
 
+	/** Service group flags (LIBRPMI_SERVICE_GROUP_FLAG_xyz) */
+	rpmi_uint32_t flags;
+
 	/**
 	 * Callback to process events for a service group. This events can be:
 	 *
@@ -753,13 +1875,23 @@ struct rpmi_service_group {
 	 * 2) Pending HW interrupts relevant to a service group
 	 * 3) HW state changes relevant to a service group
 	 *
-	 * Note: This function must be called with service group lock held.
+	 * The callback is called by rpmi_context_process_all_events() for
+	 * every service group unless LIBRPMI_SERVICE_GROUP_FLAG_EVENTS_ON_SIGNAL
+	 * is set in which case it is only called after the service group has
+	 * been signalled. A signalled service group remains pending until the
+	 * callback returns RPMI_SUCCESS.
+	 *
+	 * Note: This function must be called with service group lock held
+	 * unless LIBRPMI_SERVICE_GROUP_FLAG_INTERNAL_LOCKING is set.
 	 */
 	enum rpmi_error (*process_events)(struct rpmi_service_group *group);
 
 	/** Lock to synchronize service group access (optional) */
 	void *lock;
 
+	/** Number of RPMI contexts the group is added to (internal use only) */
+	rpmi_uint32_t num_contexts;
+
 	/** Private data of the service group implementation */
 	void *priv;
 };
@@ -782,6 +1914,13 @@ struct rpmi_service_group {
 /** Hart index considered invalid by RPMI library */
 #define LIBRPMI_HSM_INVALID_HART_INDEX	(-1U)
 
+/**
+ * Number of 32-bit words in a hart mask of a HSM instance where bit N of
+ * word W represents the hart with hart index (W * 32 + N)
+ */
+#define LIBRPMI_HSM_HART_MASK_WORDS(__hart_count)	\
+	(((__hart_count) + 31) / 32)
+
 /** RPMI HSM hart states (based on SBI specification) */
 enum rpmi_hsm_hart_state {
 	RPMI_HSM_HART_STATE_STARTED = 0x0,
@@ -854,6 +1993,29 @@ struct rpmi_hsm_platform_ops {
 				      rpmi_uint32_t hart_index,
 			const struct rpmi_hsm_suspend_type *suspend_type,
 				      rpmi_uint64_t resume_addr);
+
+	/**
+	 * Prepare a set of harts to start (optional)
+	 *
+	 * Bit N of hart_mask represents the hart with hart index
+	 * (base_index + N) where base_index is a multiple of 32.
+	 * Upon failure none of the harts must be prepared.
+	 */
+	enum rpmi_error (*hart_start_prepare_multi)(void *priv,
+						    rpmi_uint32_t base_index,
+						    rpmi_uint32_t hart_mask,
+						    rpmi_uint64_t start_addr);
+
+	/**
+	 * Prepare a set of harts to stop (optional)
+	 *
+	 * Bit N of hart_mask represents the hart with hart index
+	 * (base_index + N) where base_index is a multiple of 32.
+	 * Upon failure none of the harts must be prepared.
+	 */
+	enum rpmi_error (*hart_stop_prepare_multi)(void *priv,
+						   rpmi_uint32_t base_index,
+						   rpmi_uint32_t hart_mask);
 };
 
 /**
@@ -961,13 +2123,89 @@ enum rpmi_error rpmi_hsm_hart_suspend(struct rpmi_hsm *hsm,
  */
 int rpmi_hsm_get_hart_state(struct rpmi_hsm *hsm, rpmi_uint32_t hart_id);
 
+/**
+ * @brief Start a set of harts
+ *
+ * The harts are prepared using hart_start_prepare_multi() platform
+ * operation (if available) so that a group of up to 32 harts of a leaf
+ * HSM instance is prepared in one platform call.
+ *
+ * @param[in] hsm		pointer to HSM instance
+ * @param[in] hart_mask		mask of hart indexes to start
+ * @param[in] start_addr	start address of the harts
+ * @param[out] out_fail_mask	mask of hart indexes which failed (optional)
+ * @return enum rpmi_error (error of the last failure if any hart failed)
+ */
+enum rpmi_error rpmi_hsm_harts_start_mask(struct rpmi_hsm *hsm,
+					  const rpmi_uint32_t *hart_mask,
+					  rpmi_uint64_t start_addr,
+					  rpmi_uint32_t *out_fail_mask);
+
+/**
+ * @brief Stop a set of harts
+ *
+ * The harts are prepared using hart_stop_prepare_multi() platform
+ * operation (if available) so that a group of up to 32 harts of a leaf
+ * HSM instance is prepared in one platform call.
+ *
+ * @param[in] hsm		pointer to HSM instance
+ * @param[in] hart_mask		mask of hart indexes to stop
+ * @param[out] out_fail_mask	mask of hart indexes which failed (optional)
+ * @return enum rpmi_error (error of the last failure if any hart failed)
+ */
+enum rpmi_error rpmi_hsm_harts_stop_mask(struct rpmi_hsm *hsm,
+					 const rpmi_uint32_t *hart_mask,
+					 rpmi_uint32_t *out_fail_mask);
+
+/**
+ * @brief Get a snapshot of harts in a given HSM hart state
+ *
+ * @param[in] hsm		pointer to HSM instance
+ * @param[in] start_index	hart index of the first hart
+ * @param[in] count		number of harts (at most 32)
+ * @param[in] state		HSM hart state to check
+ * @param[out] out_mask		bit N is set if hart (start_index + N) is in the state
+ * @return enum rpmi_error
+ */
+enum rpmi_error rpmi_hsm_harts_state_snapshot(struct rpmi_hsm *hsm,
+					      rpmi_uint32_t start_index,
+					      rpmi_uint32_t count,
+					      enum rpmi_hsm_hart_state state,
+					      rpmi_uint32_t *out_mask);
+
 /**
  * @brief Synchronize state of each hart with HW state
  *
+ * Only harts in a transient state (start, stop or suspend pending and
+ * suspended) and harts notified using rpmi_hsm_notify_hw_state_change()
+ * are synchronized with the HW state.
+ *
  * @param[in] hsm		pointer to HSM instance
  */
 void rpmi_hsm_process_state_changes(struct rpmi_hsm *hsm);
 
+/**
+ * @brief Check if any hart needs to be synchronized with HW state
+ *
+ * @param[in] hsm		pointer to HSM instance
+ * @return true if rpmi_hsm_process_state_changes() has work and false otherwise
+ */
+rpmi_bool_t rpmi_hsm_state_changes_pending(struct rpmi_hsm *hsm);
+
+/**
+ * @brief Notify a HW state change of a hart
+ *
+ * The hart is synchronized with HW state by the next call to
+ * rpmi_hsm_process_state_changes(). This function is lock-free and
+ * can be called from interrupt context.
+ *
+ * @param[in] hsm		pointer to HSM instance
+ * @param[in] hart_index	index of the hart
+ * @return enum rpmi_error
+ */
+enum rpmi_error rpmi_hsm_notify_hw_state_change(struct rpmi_hsm *hsm,
+						rpmi_uint32_t hart_index);
+
 /**
  * @brief Create a leaf HSM instance to manage a set of harts
  *
@@ -1003,6 +2241,30 @@ struct rpmi_hsm *rpmi_hsm_nonleaf_create(rpmi_uint32_t child_count,
  */
 void rpmi_hsm_destroy(struct rpmi_hsm *hsm);
 
+/**
+ * @brief Rebuild the hart lookup tables of a HSM instance
+ *
+ * The hart index and hart ID lookup tables of a HSM instance are built at
+ * creation time. A non-leaf HSM instance flattens the tables of its child
+ * instances so this function must be called for the top-most HSM instance
+ * if the child_array passed to rpmi_hsm_nonleaf_create() is modified.
+ *
+ * Note: The previous tables are freed before this function returns and
+ * the HSM functions read them without any locking. All users of the HSM
+ * instance and of its child instances must be quiesced first, for example
+ * by removing the HSM, CPPC and system suspend service groups using it from
+ * their RPMI contexts and stopping any platform code calling HSM functions.
+ *
+ * Note: The tables of a HSM instance created while an arena with memory
+ * was selected (or in builds with LIBRPMI_ARENA_ONLY defined) are built
+ * once at creation time because arena memory is never given back so this
+ * function returns RPMI_ERR_NOTSUPP for such an instance.
+ *
+ * @param[in] hsm		pointer to HSM instance
+ * @return enum rpmi_error
+ */
+enum rpmi_error rpmi_hsm_refresh(struct rpmi_hsm *hsm);
+
 /** @} */
 
 /******************************************************************************/
@@ -1023,6 +2285,8 @@ struct rpmi_sysreset_platform_ops {
 	void (*do_system_reset)(void *priv, rpmi_uint32_t sysreset_type);
 };
 
+#if CONFIG_LIBRPMI_SRVGRP_SYSRESET
+
 /**
  * @brief Create a system reset service group instance
  *
@@ -1043,6 +2307,24 @@ rpmi_service_group_sysreset_create(rpmi_uint32_t sysreset_type_count,
  */
 void rpmi_service_group_sysreset_destroy(struct rpmi_service_group *group);
 
+#else
+
+static inline struct rpmi_service_group *
+rpmi_service_group_sysreset_create(rpmi_uint32_t sysreset_type_count,
+				   const rpmi_uint32_t *sysreset_types,
+				   const struct rpmi_sysreset_platform_ops *ops,
+				   void *ops_priv)
+{
+	return NULL;
+}
+
+static inline void rpmi_service_group_sysreset_destroy(struct rpmi_service_group *group)
+{
+}
+
+#endif
+
+
 /** @} */
 
 /******************************************************************************/
@@ -1091,6 +2373,8 @@ struct rpmi_syssusp_platform_ops {
 						 rpmi_uint64_t resume_addr);
 };
 
+#if CONFIG_LIBRPMI_SRVGRP_SYSSUSP
+
 /**
  * @brief Create a system suspend service group instance
  *
@@ -1115,6 +2399,27 @@ rpmi_service_group_syssusp_create(struct rpmi_hsm *hsm,
  */
 void rpmi_service_group_syssusp_destroy(struct rpmi_service_group *group);
 
+#else
+
+static inline struct rpmi_service_group *
+rpmi_service_group_syssusp_create(struct rpmi_hsm *hsm,
+				  rpmi_uint32_t syssusp_type_count,
+			const struct rpmi_system_suspend_type *syssusp_types,
+				  const struct rpmi_syssusp_platform_ops *ops,
+				  void *ops_priv)
+{
+	return NULL;
+}
+
+static inline void rpmi_service_group_syssusp_destroy(struct rpmi_service_group *group)
+{
+}
+
+#endif
+
+
+#if CONFIG_LIBRPMI_SRVGRP_HSM
+
 /**
  * @brief Create a hart state management (HSM) service group instance
  *
@@ -1130,6 +2435,20 @@ struct rpmi_service_group *rpmi_service_group_hsm_create(struct rpmi_hsm *hsm);
  */
 void rpmi_service_group_hsm_destroy(struct rpmi_service_group *group);
 
+#else
+
+static inline struct rpmi_service_group *rpmi_service_group_hsm_create(struct rpmi_hsm *hsm)
+{
+	return NULL;
+}
+
+static inline void rpmi_service_group_hsm_destroy(struct rpmi_service_group *group)
+{
+}
+
+#endif
+
+
 /** @} */
 
 /******************************************************************************/
@@ -1190,7 +2509,7 @@ struct rpmi_clock_data {
 	enum rpmi_clock_type clock_type;
 	/* Clock name */
 	const char *name;
-	/* Clock rate array */
+	/* Clock rate array (discrete rates need not be sorted) */
 	const rpmi_uint64_t *clock_rate_array;
 };
 
@@ -1208,7 +2527,16 @@ struct rpmi_clock_attrs {
 	const char *name;
 };
 
-/** Platform specific clock operations(synchronous) */
+/**
+ * Platform specific clock operations(synchronous)
+ *
+ * The clock service groups lock each clock domain (all clocks with the same
+ * root clock) separately instead of using the service group lock (see
+ * LIBRPMI_SERVICE_GROUP_FLAG_INTERNAL_LOCKING). The operations are called
+ * with the lock of the clock domain held so operations for clocks of
+ * different root clocks can run concurrently. The platform must lock the
+ * registers or other state shared between root clocks on its own.
+ */
 struct rpmi_clock_platform_ops {
 	/** Set the clock state enable/disable/others */
 	enum rpmi_error (*set_state)(void *priv,
@@ -1237,6 +2565,10 @@ struct rpmi_clock_platform_ops {
 	 * Also based on the rate match mode and PLL lock frequency
 	 * the actual frequency set may have +-margin with requested rate.
 	 * Return the set rate in new_rate buffer
+	 *
+	 * Note: For discrete clocks, the ROUND_DOWN and ROUND_UP rate
+	 * matches are resolved by the clock service group so the rate
+	 * passed is one of the rates in the clock rate array.
 	 * */
 	enum rpmi_error (*set_rate)(void *priv,
 				    rpmi_uint32_t clock_id,
@@ -1244,10 +2576,34 @@ struct rpmi_clock_platform_ops {
 				    rpmi_uint64_t rate,
 				    rpmi_uint64_t *new_rate);
 
+	/**
+	 * Start setting clock rate without waiting for the change (optional).
+	 * This is used instead of set_rate for the CLOCK_SET_RATE service
+	 * whenever the request can be deferred (see rpmi_context_defer_request())
+	 * and set_rate is used otherwise, e.g. for requests processed by a
+	 * worker or while too many requests are deferred. Upon RPMI_SUCCESS the
+	 * platform must call rpmi_service_group_clock_set_rate_complete() with
+	 * the passed cntx and handle once the rate change is done whereas any
+	 * other error fails the request immediately. Further CLOCK_SET_RATE
+	 * requests for the clock fail with RPMI_ERR_BUSY until then.
+	 *
+	 * Note: The completion must not be called from this callback since
+	 * the clock domain lock is held.
+	 */
+	enum rpmi_error (*set_rate_async)(void *priv,
+					  rpmi_uint32_t clock_id,
+					  enum rpmi_clock_rate_match match,
+					  rpmi_uint64_t rate,
+					  struct rpmi_context *cntx,
+					  rpmi_uint32_t handle);
+
 	/**
 	 * Recalculate and set rate.
 	 * Recalculate and set the clock rate based on the new input(parent)
 	 * clock and return the new rate in buffer.
+	 *
+	 * Note: This is called lazily when the rate of a clock is needed
+	 * (queried or clock enabled) after the rate of a parent clock changed.
 	 */
 	enum rpmi_error (*set_rate_recalc)(void *priv,
 					rpmi_uint32_t clock_id,
@@ -1255,6 +2611,8 @@ struct rpmi_clock_platform_ops {
 					rpmi_uint64_t *new_rate);
 };
 
+#if CONFIG_LIBRPMI_SRVGRP_CLOCK
+
 /**
  * @brief Create a clock service group instance
  *
@@ -1275,6 +2633,132 @@ rpmi_service_group_clock_create(rpmi_uint32_t clock_count,
  */
 void rpmi_service_group_clock_destroy(struct rpmi_service_group *group);
 
+/**
+ * @brief Notify a clock rate change done outside of the clock service group
+ *
+ * Clock rates are cached by the clock service group so the platform must
+ * call this function if the rate of a clock changes without a request. The
+ * rate of the clock and its child clocks is fetched again when needed.
+ *
+ * @param[in] group	pointer to RPMI service group instance
+ * @param[in] clock_id	ID of the clock
+ * @return enum rpmi_error
+ */
+enum rpmi_error rpmi_service_group_clock_rate_changed(struct rpmi_service_group *group,
+						      rpmi_uint32_t clock_id);
+
+/**
+ * @brief Complete a clock rate change started by the set_rate_async
+ * platform operation
+ *
+ * This updates the cached rate of the clock and completes the deferred
+ * CLOCK_SET_RATE request so it can be called from any thread or interrupt
+ * context which may take the clock domain lock.
+ *
+ * @param[in] group	pointer to RPMI service group instance
+ * @param[in] clock_id	ID of the clock
+ * @param[in] status	status of the rate change
+ * @param[in] new_rate	rate set by the platform (ignored upon failure)
+ * @param[in] cntx	RPMI context passed to set_rate_async
+ * @param[in] handle	handle passed to set_rate_async
+ * @return enum rpmi_error
+ */
+enum rpmi_error rpmi_service_group_clock_set_rate_complete(struct rpmi_service_group *group,
+							   rpmi_uint32_t clock_id,
+							   enum rpmi_error status,
+							   rpmi_uint64_t new_rate,
+							   struct rpmi_context *cntx,
+							   rpmi_uint32_t handle);
+
+/**
+ * @brief Create a clock extension service group instance
+ *
+ * The clock extension service group provides bulk variants of the
+ * clock services operating on the clocks of an existing clock service
+ * group. The services are:
+ *
+ * GET_CONFIGS: request { clock_id }, response { status, remaining,
+ * returned, config[returned] } for clocks starting at clock_id.
+ *
+ * GET_RATES: request { clock_id }, response { status, remaining,
+ * returned, { rate_lo, rate_hi }[returned] } for clocks starting at
+ * clock_id.
+ *
+ * SET_CONFIGS: request { count, { clock_id, config }[count] },
+ * response { status, count, status[count] }.
+ *
+ * SET_RATES: request { count, { clock_id, flags, rate_lo, rate_hi }[count] },
+ * response { status, count, status[count] }.
+ *
+ * The number of entries returned by GET_CONFIGS and GET_RATES is limited
+ * by the message data size and stops at the first clock which fails.
+ *
+ * @param[in] clock_group	pointer to clock service group instance
+ * @param[in] servicegroup_id	experimental or vendor service group ID
+ * @return pointer to RPMI service group instance upon success and NULL
+ * upon failure
+ */
+struct rpmi_service_group *
+rpmi_service_group_clock_ext_create(struct rpmi_service_group *clock_group,
+				    rpmi_uint16_t servicegroup_id);
+
+/**
+ * @brief Destroy (free) a clock extension service group instance
+ *
+ * The clock extension service group must be destroyed before the
+ * clock service group it was created from.
+ *
+ * @param[in] group	pointer to RPMI service group instance
+ */
+void rpmi_service_group_clock_ext_destroy(struct rpmi_service_group *group);
+
+#else
+
+static inline struct rpmi_service_group *
+rpmi_service_group_clock_create(rpmi_uint32_t clock_count,
+				const struct rpmi_clock_data *clock_tree_data,
+				const struct rpmi_clock_platform_ops *ops,
+				void *ops_priv)
+{
+	return NULL;
+}
+
+static inline void rpmi_service_group_clock_destroy(struct rpmi_service_group *group)
+{
+}
+
+static inline enum rpmi_error
+rpmi_service_group_clock_rate_changed(struct rpmi_service_group *group,
+				      rpmi_uint32_t clock_id)
+{
+	return RPMI_ERR_NOTSUPP;
+}
+
+static inline enum rpmi_error
+rpmi_service_group_clock_set_rate_complete(struct rpmi_service_group *group,
+					   rpmi_uint32_t clock_id,
+					   enum rpmi_error status,
+					   rpmi_uint64_t new_rate,
+					   struct rpmi_context *cntx,
+					   rpmi_uint32_t handle)
+{
+	return RPMI_ERR_NOTSUPP;
+}
+
+static inline struct rpmi_service_group *
+rpmi_service_group_clock_ext_create(struct rpmi_service_group *clock_group,
+				    rpmi_uint16_t servicegroup_id)
+{
+	return NULL;
+}
+
+static inline void rpmi_service_group_clock_ext_destroy(struct rpmi_service_group *group)
+{
+}
+
+#endif
+
+
 /** @} */
 
 /**
@@ -1385,6 +2869,25 @@ struct rpmi_cppc_regs {
 /* CPPC Fastchannel size of both types as per RPMI spec */
 #define RPMI_CPPC_FASTCHAN_SIZE		8
 
+/** Cache line size used to pad fastchannel entries (can be overridden) */
+#ifndef LIBRPMI_CACHE_LINE_SIZE
+#define LIBRPMI_CACHE_LINE_SIZE		64
+#endif
+
+/** CPPC fastchannel region flags */
+#define RPMI_CPPC_FAST_CHANNEL_FLAGS_DB_SUPPORTED	(1U << 0)
+#define RPMI_CPPC_FAST_CHANNEL_FLAGS_DB_WIDTH_POS	1
+#define RPMI_CPPC_FAST_CHANNEL_FLAGS_DB_WIDTH_MASK	(0x3U << 1)
+
+/** CPPC fastchannel doorbell register width */
+enum rpmi_cppc_doorbell_width {
+	RPMI_CPPC_DOORBELL_WIDTH_8BIT = 0,
+	RPMI_CPPC_DOORBELL_WIDTH_16BIT = 1,
+	RPMI_CPPC_DOORBELL_WIDTH_32BIT = 2,
+	RPMI_CPPC_DOORBELL_WIDTH_64BIT = 3,
+	RPMI_CPPC_DOORBELL_WIDTH_MAX_IDX,
+};
+
 /**
  * CPPC Performance Request Fastchannel
  *
@@ -1455,6 +2958,22 @@ struct rpmi_cppc_platform_ops {
 	enum rpmi_error (*cppc_get_current_freq)(void *priv,
 						 rpmi_uint32_t hart_index,
 						 rpmi_uint64_t *current_freq_hz);
+	/**
+	 * cppc update performance level for a frequency domain
+	 * (optional, only required with frequency domains)
+	 */
+	enum rpmi_error (*cppc_update_domain_perf)(void *priv,
+						   rpmi_uint32_t domain_id,
+						   rpmi_uint32_t desired_perf);
+};
+
+/** CPPC frequency domain performance aggregation policy */
+enum rpmi_cppc_domain_policy {
+	/** Highest desired performance of the domain harts */
+	RPMI_CPPC_DOMAIN_POLICY_MAX_PERF = 0,
+	/** Lowest desired performance of the domain harts */
+	RPMI_CPPC_DOMAIN_POLICY_MIN_PERF,
+	RPMI_CPPC_DOMAIN_POLICY_MAX_IDX,
 };
 
 /**
@@ -1471,6 +2990,8 @@ struct rpmi_cppc_platform_ops {
  * @return rpmi_service_group *	pointer to RPMI service group instance upon
  * success and NULL upon failure
  */
+#if CONFIG_LIBRPMI_SRVGRP_CPPC
+
 struct rpmi_service_group *
 rpmi_service_group_cppc_create(struct rpmi_hsm *hsm,
 			       const struct rpmi_cppc_regs *cppc_regs,
@@ -1488,6 +3009,137 @@ rpmi_service_group_cppc_create(struct rpmi_hsm *hsm,
  */
 void rpmi_service_group_cppc_destroy(struct rpmi_service_group *group);
 
+/**
+ * @brief Set the per-hart fastchannel entry stride of a cppc service group
+ *
+ * By default the per-hart fastchannel entries are packed with a stride
+ * of RPMI_CPPC_FASTCHAN_SIZE so the entries of multiple harts share a
+ * cache line. A stride of LIBRPMI_CACHE_LINE_SIZE gives each hart its
+ * own cache line and keeps the perf request and perf feedback subregions
+ * in separate cache lines which avoids false sharing between the
+ * application processors and the platform. The per-hart offsets reported
+ * to the application processor follow the stride.
+ *
+ * Note: This must be called before the application processor queries
+ * the fastchannel offsets and both subregion offsets must be aligned
+ * to the stride. The stride is changed with the service group lock held
+ * so it is safe against concurrent event processing.
+ *
+ * Note: A larger stride needs a larger scratch buffer which is allocated
+ * from the arena selected when the service group was created (see struct
+ * rpmi_arena). Arena memory is never given back so for such a service
+ * group the buffer can only be grown once and further calls which need a
+ * larger buffer fail with RPMI_ERR_ALREADY.
+ *
+ * @param[in] group	pointer to RPMI service group instance
+ * @param[in] stride	power-of-2 stride (>= RPMI_CPPC_FASTCHAN_SIZE)
+ * @return enum rpmi_error
+ */
+enum rpmi_error
+rpmi_service_group_cppc_set_fastchan_stride(struct rpmi_service_group *group,
+					    rpmi_uint32_t stride);
+
+/**
+ * @brief Setup frequency domains for a cppc service group instance
+ *
+ * Harts of a frequency domain share the performance level. Desired
+ * performance changes of the domain harts are aggregated as per the
+ * policy and a single cppc_update_domain_perf() platform operation is
+ * done per domain on each event processing. The resulting frequency is
+ * reported to the perf feedback fastchannels of all domain harts.
+ *
+ * Note: The domains can only be set once. They are published with the
+ * service group lock held so it is safe against concurrent event processing.
+ *
+ * @param[in] group		pointer to RPMI service group instance
+ * @param[in] domain_count	number of frequency domains
+ * @param[in] hart_domain	domain ID of each hart (indexed by hart index)
+ * @param[in] policy		domain performance aggregation policy
+ * @return enum rpmi_error
+ */
+enum rpmi_error
+rpmi_service_group_cppc_set_domains(struct rpmi_service_group *group,
+				    rpmi_uint32_t domain_count,
+				    const rpmi_uint32_t *hart_domain,
+				    enum rpmi_cppc_domain_policy policy);
+
+/**
+ * @brief Advertise a fastchannel doorbell for a cppc service group instance
+ *
+ * The doorbell is reported to the application processor which rings it
+ * after writing a new desired performance level in the fastchannels.
+ * Once a doorbell is set, the fastchannels are only scanned by the
+ * event processing after the platform signals the service group using
+ * rpmi_context_signal_group() from its doorbell handler.
+ *
+ * Note: This must be called before adding the service group to an RPMI
+ * context because the contexts decide at that time whether a service group
+ * is polled. Later calls fail with RPMI_ERR_INVALID_STATE. The doorbell only
+ * decides when the fastchannels are scanned and each scan still reads and
+ * compares the perf request fastchannels of all harts.
+ *
+ * @param[in] group		pointer to RPMI service group instance
+ * @param[in] width		doorbell register width
+ * @param[in] addr		doorbell register physical address
+ * @param[in] set_mask		doorbell register bits to set
+ * @param[in] preserve_mask	doorbell register bits to preserve
+ * @return enum rpmi_error
+ */
+enum rpmi_error
+rpmi_service_group_cppc_set_doorbell(struct rpmi_service_group *group,
+				     enum rpmi_cppc_doorbell_width width,
+				     rpmi_uint64_t addr,
+				     rpmi_uint64_t set_mask,
+				     rpmi_uint64_t preserve_mask);
+
+#else
+
+static inline struct rpmi_service_group *
+rpmi_service_group_cppc_create(struct rpmi_hsm *hsm,
+			       const struct rpmi_cppc_regs *cppc_regs,
+			       enum rpmi_cppc_mode mode,
+			       struct rpmi_shmem *shmem_fastchan,
+			       rpmi_uint64_t perf_request_shmem_offset,
+			       rpmi_uint64_t perf_feedback_shmem_offset,
+			       const struct rpmi_cppc_platform_ops *ops,
+			       void *ops_priv)
+{
+	return NULL;
+}
+
+static inline void rpmi_service_group_cppc_destroy(struct rpmi_service_group *group)
+{
+}
+
+static inline enum rpmi_error
+rpmi_service_group_cppc_set_fastchan_stride(struct rpmi_service_group *group,
+					    rpmi_uint32_t stride)
+{
+	return RPMI_ERR_NOTSUPP;
+}
+
+static inline enum rpmi_error
+rpmi_service_group_cppc_set_domains(struct rpmi_service_group *group,
+				    rpmi_uint32_t domain_count,
+				    const rpmi_uint32_t *hart_domain,
+				    enum rpmi_cppc_domain_policy policy)
+{
+	return RPMI_ERR_NOTSUPP;
+}
+
+static inline enum rpmi_error
+rpmi_service_group_cppc_set_doorbell(struct rpmi_service_group *group,
+				     enum rpmi_cppc_doorbell_width width,
+				     rpmi_uint64_t addr,
+				     rpmi_uint64_t set_mask,
+				     rpmi_uint64_t preserve_mask)
+{
+	return RPMI_ERR_NOTSUPP;
+}
+
+#endif
+
+
 /** @} */
 
 /**
@@ -1518,6 +3170,8 @@ struct rpmi_sysmsi_platform_ops {
 			 char *out_name, rpmi_uint32_t out_name_sz);
 };
 
+#if CONFIG_LIBRPMI_SRVGRP_SYSMSI
+
 /**
  * @brief Inject a MSI to the system MSI service group instance
  *
@@ -1559,6 +3213,37 @@ rpmi_service_group_sysmsi_create(rpmi_uint32_t num_msi,
 				 const struct rpmi_sysmsi_platform_ops *ops,
 				 void *ops_priv);
 
+#else
+
+static inline enum rpmi_error
+rpmi_service_group_sysmsi_inject(struct rpmi_service_group *group,
+				 rpmi_uint32_t msi_index)
+{
+	return RPMI_ERR_NOTSUPP;
+}
+
+static inline enum rpmi_error
+rpmi_service_group_sysmsi_inject_p2a(struct rpmi_service_group *group)
+{
+	return RPMI_ERR_NOTSUPP;
+}
+
+static inline void rpmi_service_group_sysmsi_destroy(struct rpmi_service_group *group)
+{
+}
+
+static inline struct rpmi_service_group *
+rpmi_service_group_sysmsi_create(rpmi_uint32_t num_msi,
+				 rpmi_uint32_t p2a_msi_index,
+				 const struct rpmi_sysmsi_platform_ops *ops,
+				 void *ops_priv)
+{
+	return NULL;
+}
+
+#endif
+
+
 /** @} */
 
 #endif  /* __LIBRPMI_H__ */
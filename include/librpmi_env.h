@@ -285,6 +285,108 @@ static inline void rpmi_env_unlock(void *lptr)
 
 /******************************************************************************/
 
+/**
+ * \defgroup BARRIER_ENV Memory Barrier Environment Functions
+ * @brief Memory ordering functions used by the library which must be provided
+ * by the platform firmware.
+ *
+ * Note: The default implementations only order accesses between harts. If the
+ * shared memory is accessed by a device or a microcontroller which is not part
+ * of the coherence domain then the platform must provide stronger fences.
+ * @{
+ */
+
+/**
+ * @brief Acquire fence
+ *
+ * Orders loads before the fence against loads and stores after the fence.
+ */
+static inline void rpmi_env_fence_acquire(void)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Release fence
+ *
+ * Orders loads and stores before the fence against stores after the fence.
+ */
+static inline void rpmi_env_fence_release(void)
+{
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Atomically OR a value into a 32-bit word
+ *
+ * Note: This function may be called from interrupt context.
+ *
+ * @param[in] ptr	Pointer to the 32-bit word
+ * @param[in] val	Value to OR
+ */
+static inline void rpmi_env_atomic_or32(volatile rpmi_uint32_t *ptr,
+					rpmi_uint32_t val)
+{
+	__atomic_fetch_or(ptr, val, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Atomically exchange a 32-bit word
+ *
+ * @param[in] ptr	Pointer to the 32-bit word
+ * @param[in] val	New value of the word
+ * @return rpmi_uint32_t	Old value of the word
+ */
+static inline rpmi_uint32_t rpmi_env_atomic_xchg32(volatile rpmi_uint32_t *ptr,
+						   rpmi_uint32_t val)
+{
+	return __atomic_exchange_n(ptr, val, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Atomically add a value to a 32-bit word
+ *
+ * Note: The addition must be fully ordered against the memory accesses
+ * before and after it (including loads after it).
+ *
+ * @param[in] ptr	Pointer to the 32-bit word
+ * @param[in] val	Value to add (use -1 to subtract)
+ * @return rpmi_uint32_t	New value of the word
+ */
+static inline rpmi_uint32_t rpmi_env_atomic_add32(volatile rpmi_uint32_t *ptr,
+						  rpmi_uint32_t val)
+{
+	return __atomic_add_fetch(ptr, val, __ATOMIC_SEQ_CST);
+}
+
+/** @} */
+
+/******************************************************************************/
+
+/**
+ * \defgroup TIMER_ENV Timer Environment Functions
+ * @brief Timer functions used by library which must be provided by the
+ * platform firmware.
+ * @{
+ */
+
+/**
+ * @brief Get current value of a monotonically increasing platform timer
+ *
+ * Note: The default implementation always returns 0 which means no timer
+ * is available so time based deadlines are never reached.
+ *
+ * @return rpmi_uint64_t Current timer value in platform specific ticks
+ */
+static inline rpmi_uint64_t rpmi_env_timer_value(void)
+{
+	return 0;
+}
+
+/** @} */
+
+/******************************************************************************/
+
 /**
  * \defgroup MATH_ENV Integer Math Environment Functions
  * @brief Basic math functions for 32/64 bit integers to be implemented by the
@@ -384,6 +486,13 @@ static inline rpmi_uint32_t rpmi_to_be32(rpmi_uint32_t val)
 #error "Unexpected __BYTE_ORDER__"
 #endif
 
+/*
+ * Define LIBRPMI_FIXED_ENDIAN_LE when all RPMI transports are little-endian
+ * so that the conversions below ignore the target endianness parameter and
+ * fold to no-ops on little-endian platforms. RPMI contexts reject
+ * big-endian transports in such builds.
+ */
+
 /**
  * @brief Convert endianness of 16-bit integer based on parameter
  *
@@ -393,7 +502,11 @@ static inline rpmi_uint32_t rpmi_to_be32(rpmi_uint32_t val)
  */
 static inline rpmi_uint16_t rpmi_to_xe16(rpmi_bool_t is_be, rpmi_uint16_t val)
 {
+#ifdef LIBRPMI_FIXED_ENDIAN_LE
+	return rpmi_to_le16(val);
+#else
 	return is_be ? rpmi_to_be16(val) : rpmi_to_le16(val);
+#endif
 }
 
 /**
@@ -405,7 +518,11 @@ static inline rpmi_uint16_t rpmi_to_xe16(rpmi_bool_t is_be, rpmi_uint16_t val)
  */
 static inline rpmi_uint32_t rpmi_to_xe32(rpmi_bool_t is_be, rpmi_uint32_t val)
 {
+#ifdef LIBRPMI_FIXED_ENDIAN_LE
+	return rpmi_to_le32(val);
+#else
 	return is_be ? rpmi_to_be32(val) : rpmi_to_le32(val);
+#endif
 }
 
 /** @} */
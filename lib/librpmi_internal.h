@@ -58,6 +58,100 @@
 
 #define RPMI_ROUNDDOWN(a, b) ((a) / (b) * (b))
 
+#define RPMI_BITS_PER_WORD32		32
+
+#define RPMI_BITMAP_WORDS32(nbits) \
+	(((nbits) + RPMI_BITS_PER_WORD32 - 1) / RPMI_BITS_PER_WORD32)
+
+/**
+ * Allocate zeroed memory from the selected arena or rpmi_env_zalloc()
+ * (fails without a selected arena when LIBRPMI_ARENA_ONLY is defined)
+ */
+void *rpmi_zalloc(rpmi_size_t size);
+
+/** Free memory allocated by rpmi_zalloc() */
+void rpmi_free(void *ptr);
+
+/** Arena selected for allocations (NULL means rpmi_env_zalloc()) */
+struct rpmi_arena *rpmi_arena_selected(void);
+
+/**
+ * Allocate zeroed memory from an explicit arena or rpmi_env_zalloc() if the
+ * arena is NULL. Objects which allocate after creation remember the arena
+ * selected at creation time and pass it here instead of using whatever
+ * arena happens to be selected at that time.
+ */
+void *rpmi_arena_zalloc(struct rpmi_arena *arena, rpmi_size_t size);
+
+/** Free memory allocated by rpmi_arena_zalloc() from the same arena */
+void rpmi_arena_free(struct rpmi_arena *arena, void *ptr);
+
+/**
+ * Check if memory allocated from an arena (NULL means rpmi_env_zalloc())
+ * is given back by rpmi_arena_free() so that it can be reallocated at
+ * runtime without leaking memory
+ */
+rpmi_bool_t rpmi_arena_reclaimable(const struct rpmi_arena *arena);
+
+/**
+ * Copy words from a table of little-endian words to a message in transport
+ * endianness. This is one memcpy for little-endian transports so tables of
+ * static data which are served in pages are prebuilt in little-endian.
+ */
+static inline void rpmi_copy_le32_table(struct rpmi_transport *trans,
+					rpmi_uint32_t *dst,
+					const rpmi_uint32_t *table_le,
+					rpmi_uint32_t count)
+{
+	rpmi_uint32_t i;
+
+	if (!rpmi_transport_is_be(trans)) {
+		rpmi_env_memcpy(dst, table_le, count * sizeof(*dst));
+		return;
+	}
+
+	for (i = 0; i < count; i++)
+		dst[i] = rpmi_to_be32(rpmi_to_le32(table_le[i]));
+}
+
+/** Get hart IDs of a HSM instance indexed by hart index as little-endian words */
+const rpmi_uint32_t *rpmi_hsm_hart_id_table_le(struct rpmi_hsm *hsm);
+
+/** Get suspend types of a HSM instance indexed by suspend type index as little-endian words */
+const rpmi_uint32_t *rpmi_hsm_suspend_type_table_le(struct rpmi_hsm *hsm);
+
+/** Trace ring used for recording events (NULL if not recording) */
+extern struct rpmi_trace_ring *rpmi_trace_current;
+
+/** Record an event in the trace ring (a few stores when enabled) */
+static inline void rpmi_trace(enum rpmi_trace_event_type type,
+			      rpmi_uint8_t arg0, rpmi_uint16_t arg1,
+			      rpmi_uint32_t arg2)
+{
+#ifdef LIBRPMI_TRACE
+	struct rpmi_trace_ring *ring = rpmi_trace_current;
+	struct rpmi_trace_event *ev;
+	rpmi_uint32_t idx;
+
+	if (!ring)
+		return;
+
+	idx = rpmi_env_atomic_add32(&ring->head, 1) - 1;
+	ev = &ring->events[idx & (ring->num_events - 1)];
+	/* Invalidate the slot so decoders never see old sequence with new fields */
+	*(volatile rpmi_uint32_t *)&ev->seq = 0;
+	rpmi_env_fence_release();
+	ev->timestamp = rpmi_env_timer_value();
+	ev->type = type;
+	ev->arg0 = arg0;
+	ev->arg1 = arg1;
+	ev->arg2 = arg2;
+	/* Event is only valid for decoders once the sequence matches */
+	rpmi_env_fence_release();
+	*(volatile rpmi_uint32_t *)&ev->seq = idx + 1;
+#endif
+}
+
 #endif
 
 
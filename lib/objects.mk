@@ -4,14 +4,16 @@
 # Copyright (c) 2024 Ventana Micro Systems Inc.
 #
 
+lib-objs-y += rpmi_arena.o
 lib-objs-y += rpmi_context.o
 lib-objs-y += rpmi_hsm.o
-lib-objs-y += rpmi_service_group_hsm.o
-lib-objs-y += rpmi_service_group_sysmsi.o
-lib-objs-y += rpmi_service_group_sysreset.o
-lib-objs-y += rpmi_service_group_syssusp.o
-lib-objs-y += rpmi_service_group_clock.o
-lib-objs-y += rpmi_service_group_cppc.o
+lib-objs-$(CONFIG_LIBRPMI_SRVGRP_HSM) += rpmi_service_group_hsm.o
+lib-objs-$(CONFIG_LIBRPMI_SRVGRP_SYSMSI) += rpmi_service_group_sysmsi.o
+lib-objs-$(CONFIG_LIBRPMI_SRVGRP_SYSRESET) += rpmi_service_group_sysreset.o
+lib-objs-$(CONFIG_LIBRPMI_SRVGRP_SYSSUSP) += rpmi_service_group_syssusp.o
+lib-objs-$(CONFIG_LIBRPMI_SRVGRP_CLOCK) += rpmi_service_group_clock.o
+lib-objs-$(CONFIG_LIBRPMI_SRVGRP_CPPC) += rpmi_service_group_cppc.o
 lib-objs-y += rpmi_shmem.o
+lib-objs-y += rpmi_trace.o
 lib-objs-y += rpmi_transport.o
 lib-objs-y += rpmi_transport_shmem.o
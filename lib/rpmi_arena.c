@@ -0,0 +1,160 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 Ventana Micro Systems Inc.
+ */
+
+#include <librpmi.h>
+#include "librpmi_internal.h"
+
+#undef DEBUG
+
+#ifdef DEBUG
+#define DPRINTF(msg...)		rpmi_env_printf(msg)
+#else
+#define DPRINTF(msg...)
+#endif
+
+/** List of arenas known to the library */
+static struct rpmi_arena *rpmi_arena_list;
+
+/** Arena used for allocations (NULL means rpmi_env_zalloc()) */
+static struct rpmi_arena *rpmi_arena_current;
+
+static struct rpmi_arena *rpmi_arena_find(const void *ptr)
+{
+	const rpmi_uint8_t *p = ptr;
+	struct rpmi_arena *arena;
+
+	for (arena = rpmi_arena_list; arena; arena = arena->next) {
+		if (arena->base && arena->base <= p &&
+		    p < arena->base + arena->size)
+			return arena;
+	}
+
+	return NULL;
+}
+
+enum rpmi_error rpmi_arena_init(struct rpmi_arena *arena,
+				void *base, rpmi_size_t size)
+{
+	struct rpmi_arena *a;
+
+	if (!arena || (base && !size)) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	if ((unsigned long)base & (LIBRPMI_ARENA_ALIGN - 1)) {
+		DPRINTF("%s: base %p not aligned to %d bytes\n",
+			__func__, base, LIBRPMI_ARENA_ALIGN);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	for (a = rpmi_arena_list; a; a = a->next) {
+		if (a == arena)
+			break;
+	}
+
+	arena->base = base;
+	arena->size = base ? size : 0;
+	arena->used = 0;
+	if (!a) {
+		arena->next = rpmi_arena_list;
+		rpmi_arena_list = arena;
+	}
+
+	return RPMI_SUCCESS;
+}
+
+struct rpmi_arena *rpmi_arena_select(struct rpmi_arena *arena)
+{
+	struct rpmi_arena *prev = rpmi_arena_current;
+
+	rpmi_arena_current = arena;
+	return prev;
+}
+
+rpmi_size_t rpmi_arena_used(const struct rpmi_arena *arena)
+{
+	return arena ? arena->used : 0;
+}
+
+struct rpmi_arena *rpmi_arena_selected(void)
+{
+	return rpmi_arena_current;
+}
+
+rpmi_bool_t rpmi_arena_reclaimable(const struct rpmi_arena *arena)
+{
+	/* Measuring arena allocates using rpmi_env_zalloc() */
+	if (arena)
+		return arena->base ? false : true;
+
+#ifdef LIBRPMI_ARENA_ONLY
+	return false;
+#else
+	return true;
+#endif
+}
+
+void *rpmi_arena_zalloc(struct rpmi_arena *arena, rpmi_size_t size)
+{
+	rpmi_size_t asize;
+	void *ptr;
+
+	if (!arena) {
+#ifdef LIBRPMI_ARENA_ONLY
+		/* Allocation outside the arena window of the platform */
+		DPRINTF("%s: no arena selected (request %lu)\n",
+			__func__, (unsigned long)size);
+		return NULL;
+#else
+		return rpmi_env_zalloc(size);
+#endif
+	}
+
+	asize = RPMI_ROUNDUP(size ? size : 1, LIBRPMI_ARENA_ALIGN);
+
+	/* Measuring arena only accounts the allocation */
+	if (!arena->base) {
+		ptr = rpmi_env_zalloc(size);
+		if (ptr)
+			arena->used += asize;
+		return ptr;
+	}
+
+	if (arena->size - arena->used < asize) {
+		DPRINTF("%s: arena exhausted (used %lu size %lu request %lu)\n",
+			__func__, (unsigned long)arena->used,
+			(unsigned long)arena->size, (unsigned long)size);
+		return NULL;
+	}
+
+	ptr = arena->base + arena->used;
+	arena->used += asize;
+	rpmi_env_memset(ptr, 0, asize);
+
+	return ptr;
+}
+
+void rpmi_arena_free(struct rpmi_arena *arena, void *ptr)
+{
+	if (!ptr || (arena && arena->base))
+		return;
+
+	rpmi_env_free(ptr);
+}
+
+void *rpmi_zalloc(rpmi_size_t size)
+{
+	return rpmi_arena_zalloc(rpmi_arena_current, size);
+}
+
+void rpmi_free(void *ptr)
+{
+	if (!ptr || rpmi_arena_find(ptr))
+		return;
+
+	rpmi_env_free(ptr);
+}
@@ -5,6 +5,7 @@
  */
 
 #include <librpmi.h>
+#include "librpmi_internal.h"
 
 #undef DEBUG
 
@@ -16,12 +17,182 @@
 
 struct rpmi_base_group;
 
+/** States of a deferred request slot */
+enum rpmi_deferred_state {
+	RPMI_DEFERRED_FREE = 0,
+	RPMI_DEFERRED_PENDING,
+	RPMI_DEFERRED_COMPLETED,
+};
+
+/** Deferred request awaiting completion by the platform */
+struct rpmi_deferred_request {
+	/** Current state of the deferred request */
+	enum rpmi_deferred_state state;
+
+	/** Acknowledgement is required (i.e. not a posted request) */
+	rpmi_bool_t do_acknowledge;
+
+	/** P2A doorbell is requested for the acknowledgement */
+	rpmi_bool_t do_doorbell;
+
+	/** Index of the channel on which the acknowledgement is posted */
+	rpmi_uint32_t channel;
+
+	/** Acknowledgement message (one slot) */
+	struct rpmi_message *ack_msg;
+};
+
+/** A2P request being processed by a service (see struct rpmi_context_request) */
+struct rpmi_context_request {
+	/** Context processing the request */
+	struct rpmi_context *cntx;
+
+	/** Channel of the request (NULL if processed by a worker) */
+	struct rpmi_context_channel *chan;
+
+	/** Request header in native endianness */
+	const struct rpmi_message_header *rhdr;
+
+	/** Deferred request handle (LIBRPMI_CONTEXT_MAX_DEFERRED if not deferred) */
+	rpmi_uint32_t deferred;
+};
+
+/** Transport channel served by a RPMI context */
+struct rpmi_context_channel {
+	/** Underlying transport instance of the channel (NULL if the slot is free) */
+	struct rpmi_transport *trans;
+
+	/** Requests of the channel are processed (cleared while being removed) */
+	rpmi_bool_t active;
+
+	/** RISC-V privilege level of the channel */
+	enum rpmi_privilege_level privilege_level;
+
+	/**
+	 * System MSI index of the P2A doorbell of a secondary channel
+	 * (LIBRPMI_CONTEXT_NO_P2A_MSI if the channel has no doorbell)
+	 */
+	rpmi_uint32_t p2a_msi_index;
+
+	/** Temporary acknowledgment messages (LIBRPMI_CONTEXT_BATCH_COUNT slots) */
+	struct rpmi_message *ack_msgs;
+
+	/** Index of first parked acknowledgment in ack_msgs */
+	rpmi_uint32_t ack_first;
+
+	/** Number of parked acknowledgments not yet posted to P2A queue */
+	rpmi_uint32_t ack_pending;
+
+	/** Number of P2A doorbells to inject once parked acknowledgments are posted */
+	rpmi_uint32_t doorbell_pending;
+};
+
+/** A2P request queued to a worker */
+struct rpmi_context_work {
+	/** Service group slot of the request */
+	struct rpmi_context_group *cgrp;
+
+	/** Transport on which the acknowledgement is posted */
+	struct rpmi_transport *trans;
+
+	/** Index of the channel of the transport */
+	rpmi_uint32_t channel;
+
+	/** Acknowledgement is required (cleared if the request failed) */
+	rpmi_bool_t do_acknowledge;
+
+	/** P2A doorbell is requested for the acknowledgement */
+	rpmi_bool_t do_doorbell;
+
+	/** Request message with header in native endianness (one slot) */
+	struct rpmi_message *req_msg;
+
+	/** Acknowledgement message with header in native endianness (one slot) */
+	struct rpmi_message *ack_msg;
+};
+
+/**
+ * Work queue of a worker where the dispatcher queues requests at head, the
+ * worker processes them up to done and the dispatcher posts acknowledgements
+ * up to tail. All indexes are free running.
+ */
+struct rpmi_context_worker {
+	/** Work queue (LIBRPMI_CONTEXT_WORKER_QUEUE_LEN entries or NULL if unused) */
+	struct rpmi_context_work *queue;
+
+	/** Request and acknowledgement messages of the work queue */
+	struct rpmi_message *msgs;
+
+	/** Number of requests queued (written by the dispatcher) */
+	rpmi_uint32_t head;
+
+	/** Number of requests processed (written by the worker) */
+	rpmi_uint32_t done;
+
+	/** Number of requests acknowledged (written by the dispatcher) */
+	rpmi_uint32_t tail;
+};
+
+/** Slot of a service group holding the state kept by a RPMI context */
+struct rpmi_context_group {
+	/** Service group added to the context (NULL if the slot is free) */
+	struct rpmi_service_group *group;
+
+	/**
+	 * Statistics indexed by service ID where requests with a service ID
+	 * beyond max_service_id are accounted to index 0 (LIBRPMI_STATS only)
+	 */
+	struct rpmi_service_stats *stats;
+
+	/**
+	 * Lock protecting the statistics. The service group lock does not
+	 * cover them since it is not taken for groups doing their own locking
+	 * which may then process requests on several channels concurrently.
+	 */
+	void *stats_lock;
+
+	/**
+	 * Worker assigned to the service group by rpmi_context_set_group_worker()
+	 * (0 means the dispatcher processes the requests)
+	 */
+	rpmi_uint32_t worker;
+
+	/**
+	 * Worker to which the dispatcher currently queues the requests. It
+	 * follows the assigned worker once no request is queued anymore so
+	 * that the acknowledgements keep the order of the requests.
+	 */
+	rpmi_uint32_t active_worker;
+
+	/**
+	 * Number of requests queued to the active worker which are not yet
+	 * acknowledged (written by the dispatcher). A slot with queued requests
+	 * is not reused by rpmi_context_add_group().
+	 */
+	rpmi_uint32_t queued;
+};
+
 struct rpmi_context {
 	/** Name of the context */
 	const char *name;
 
-	/** Underlying transport instance of the context */
-	struct rpmi_transport *trans;
+	/**
+	 * Transport channels of the context where the first channel is the
+	 * primary channel passed to rpmi_context_create() and it decides the
+	 * maximum slot size of all channels. A channel keeps its slot while
+	 * it is in the context so that deferred requests can refer to it by
+	 * index and the slot of a removed channel is reused by the next one.
+	 */
+	struct rpmi_context_channel channels[LIBRPMI_CONTEXT_MAX_CHANNELS];
+
+	/** Number of channel slots used so far (free slots have no transport) */
+	rpmi_uint32_t num_channels;
+
+	/** Channel from which the next round of request processing starts */
+	rpmi_uint32_t next_channel;
+
+	/** Bitmap of RISC-V privilege levels of all channels */
+	rpmi_uint32_t privilege_level_bitmap;
 
 	/** Maximum number of service groups handled by the context */
 	rpmi_uint32_t max_num_groups;
@@ -29,28 +200,208 @@ struct rpmi_context {
 	/** Current number of service groups in the context */
 	rpmi_uint32_t num_groups;
 
-	/** RISC-V privilege level of RPMI context */
-	enum rpmi_privilege_level privilege_level;
-
-	/** Current set of service groups in the context as an array */
-	struct rpmi_service_group **groups;
+	/**
+	 * Service group slots of the context (max_num_groups entries). A slot
+	 * keeps its position while the group is in the context so that the
+	 * per-context group state can be referenced by the dispatch tables.
+	 */
+	struct rpmi_context_group *groups;
 
 	/** Lock to synchronize num_groups and groups array access (optional) */
 	void *groups_lock;
 
-	/** Temporary request message */
-	struct rpmi_message *req_msg;
+	/**
+	 * Open-addressed hash tables of service group slots keyed by
+	 * servicegroup_id used for lock-free lookup. The tables are double
+	 * buffered so that add/remove rebuilds the spare table under
+	 * groups_lock and publishes it with release ordering while readers
+	 * keep using the old table.
+	 */
+	struct rpmi_context_group **dispatch_tables[2];
 
-	/** Temporary acknowledgment message */
-	struct rpmi_message *ack_msg;
+	/** Currently published dispatch table */
+	struct rpmi_context_group **dispatch;
+
+	/**
+	 * Generation of the dispatch table where the parity selects the counter
+	 * of readers entering from now on (incremented by add/remove)
+	 */
+	rpmi_uint32_t dispatch_epoch;
+
+	/**
+	 * Number of lock-free readers of the dispatch table and group slots per
+	 * generation parity. Add/remove waits for the readers of the previous
+	 * generation before reusing the old table or freeing slot state.
+	 */
+	rpmi_uint32_t dispatch_readers[2];
+
+	/** Dispatch table index mask (dispatch table size - 1) */
+	rpmi_uint32_t dispatch_mask;
+
+	/** Number of 32-bit words in each bitmap indexed by dispatch table slot */
+	rpmi_uint32_t dispatch_words;
+
+	/** Bitmaps of slots with groups which poll for events (per dispatch table) */
+	rpmi_uint32_t *dispatch_poll[2];
+
+	/** Bitmap of slots with groups which have been signalled */
+	volatile rpmi_uint32_t *events_pending;
+
+	/** Temporary request messages shared by all channels (LIBRPMI_CONTEXT_BATCH_COUNT slots) */
+	struct rpmi_message *req_msgs;
+
+	/** Deferred requests awaiting completion from the platform */
+	struct rpmi_deferred_request deferred[LIBRPMI_CONTEXT_MAX_DEFERRED];
+
+	/** Number of deferred requests completed but not yet acknowledged */
+	rpmi_uint32_t deferred_completed;
+
+	/** Lock to synchronize deferred requests (optional) */
+	void *deferred_lock;
 
 	/** Base serivce group */
 	struct rpmi_service_group *base_group;
 
 	/** System MSI serivce group */
 	struct rpmi_service_group *sysmsi_group;
+
+	/** Bitmap of channels with P2A doorbell coalesced until the end of request processing */
+	rpmi_uint32_t doorbell_coalesced;
+
+	/** Workers processing the requests of service groups assigned to them */
+	struct rpmi_context_worker workers[LIBRPMI_CONTEXT_MAX_WORKERS];
 };
 
+static struct rpmi_context_channel *rpmi_context_find_channel(struct rpmi_context *cntx,
+							      struct rpmi_transport *trans)
+{
+	rpmi_uint32_t i;
+
+	for (i = 0; i < cntx->num_channels; i++) {
+		if (cntx->channels[i].trans == trans)
+			return &cntx->channels[i];
+	}
+
+	return NULL;
+}
+
+/**
+ * Inject the P2A doorbell of a channel where the primary channel uses the
+ * P2A doorbell of the system MSI service group and a secondary channel its
+ * own system MSI (if any)
+ */
+static void rpmi_context_ring_doorbell(struct rpmi_context *cntx,
+				       rpmi_uint32_t channel)
+{
+	struct rpmi_context_channel *chan = &cntx->channels[channel];
+
+	if (!cntx->sysmsi_group)
+		return;
+
+	if (!channel)
+		rpmi_service_group_sysmsi_inject_p2a(cntx->sysmsi_group);
+	else if (chan->p2a_msi_index != LIBRPMI_CONTEXT_NO_P2A_MSI)
+		rpmi_service_group_sysmsi_inject(cntx->sysmsi_group,
+						 chan->p2a_msi_index);
+}
+
+/*
+ * Check if the endianness of a transport can be served. The endianness
+ * conversions ignore it when LIBRPMI_FIXED_ENDIAN_LE is defined.
+ */
+static inline rpmi_bool_t rpmi_context_endian_supported(struct rpmi_transport *trans)
+{
+#ifdef LIBRPMI_FIXED_ENDIAN_LE
+	return trans->is_be ? false : true;
+#else
+	return true;
+#endif
+}
+
+/* Check if a service group is accessible at the privilege level of a channel */
+static inline rpmi_bool_t rpmi_context_group_allowed(struct rpmi_context_channel *chan,
+						     struct rpmi_service_group *group)
+{
+	return (group->privilege_level_bitmap & (1U << chan->privilege_level)) ?
+								true : false;
+}
+
+static inline rpmi_uint32_t rpmi_context_dispatch_hash(struct rpmi_context *cntx,
+							rpmi_uint16_t servicegroup_id)
+{
+	return (servicegroup_id ^ (servicegroup_id >> 8)) & cntx->dispatch_mask;
+}
+
+/* Lock-free lookup of the slot of a service group in the dispatch table */
+static struct rpmi_context_group *rpmi_context_lookup_group(struct rpmi_context *cntx,
+							    rpmi_uint16_t servicegroup_id,
+							    rpmi_uint32_t *out_pos)
+{
+	struct rpmi_context_group **table, *cgrp;
+	rpmi_uint32_t i, pos;
+
+	table = *(struct rpmi_context_group ** volatile *)&cntx->dispatch;
+	rpmi_env_fence_acquire();
+
+	pos = rpmi_context_dispatch_hash(cntx, servicegroup_id);
+	for (i = 0; i <= cntx->dispatch_mask; i++) {
+		cgrp = table[pos];
+		if (!cgrp)
+			break;
+		if (cgrp->group->servicegroup_id == servicegroup_id) {
+			*out_pos = pos;
+			return cgrp;
+		}
+		pos = (pos + 1) & cntx->dispatch_mask;
+	}
+
+	return NULL;
+}
+
+/**
+ * Enter a lock-free read-side section of the dispatch table, group slots and
+ * channels. Returns the generation parity to be passed to
+ * rpmi_context_read_unlock(). The reader count update must be ordered
+ * before the generation is checked again (store-load ordering) so it
+ * remains a full atomic while the table itself is read with acquire
+ * ordering. Sections are kept short (one message or one channel visit)
+ * because add/remove busy-waits for them under groups_lock.
+ */
+static inline rpmi_uint32_t rpmi_context_read_lock(struct rpmi_context *cntx)
+{
+	rpmi_uint32_t e;
+
+	while (1) {
+		e = *(volatile rpmi_uint32_t *)&cntx->dispatch_epoch & 1;
+		rpmi_env_atomic_add32(&cntx->dispatch_readers[e], 1);
+		/* Generation not flipped in between so add/remove will wait */
+		if ((*(volatile rpmi_uint32_t *)&cntx->dispatch_epoch & 1) == e)
+			return e;
+		rpmi_env_atomic_add32(&cntx->dispatch_readers[e], -1);
+	}
+}
+
+static inline void rpmi_context_read_unlock(struct rpmi_context *cntx,
+					    rpmi_uint32_t e)
+{
+	rpmi_env_atomic_add32(&cntx->dispatch_readers[e], -1);
+}
+
+/**
+ * Wait until all readers which may still see the previously published
+ * dispatch table have left (called with groups_lock held)
+ */
+static void rpmi_context_synchronize(struct rpmi_context *cntx)
+{
+	rpmi_uint32_t e = cntx->dispatch_epoch & 1;
+
+	/* Readers entering from now on are accounted to the other parity */
+	rpmi_env_atomic_add32(&cntx->dispatch_epoch, 1);
+	while (*(volatile rpmi_uint32_t *)&cntx->dispatch_readers[e])
+		;
+	rpmi_env_fence_acquire();
+}
+
 struct rpmi_base_group {
 	struct rpmi_context *cntx;
 
@@ -149,6 +500,7 @@ static enum rpmi_error rpmi_base_probe_group(struct rpmi_service_group *group,
 {
 	rpmi_uint32_t *resp = (void *)response_data;
 	struct rpmi_base_group *base = group->priv;
+	struct rpmi_context_channel *chan;
 	struct rpmi_service_group *srvgrp;
 	rpmi_uint32_t probe_id, ver;
 
@@ -157,8 +509,11 @@ static enum rpmi_error rpmi_base_probe_group(struct rpmi_service_group *group,
 	*response_datalen = 2 * sizeof(*resp);
 	resp[0] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)RPMI_SUCCESS);
 	
+	/* Groups not accessible from this channel are reported as absent */
 	srvgrp = rpmi_context_find_group(base->cntx, probe_id);
-	ver = srvgrp ? srvgrp->servicegroup_version : 0;
+	chan = rpmi_context_find_channel(base->cntx, trans);
+	ver = (srvgrp && chan && rpmi_context_group_allowed(chan, srvgrp)) ?
+					srvgrp->servicegroup_version : 0;
 
 	resp[1] = rpmi_to_xe32(trans->is_be, ver);
 
@@ -175,10 +530,11 @@ static enum rpmi_error rpmi_base_get_attributes(struct rpmi_service_group *group
 {
 	rpmi_uint32_t *resp = (void *)response_data;
 	struct rpmi_context *cntx = ((struct rpmi_base_group *)group->priv)->cntx;
+	struct rpmi_context_channel *chan = rpmi_context_find_channel(cntx, trans);
 	rpmi_uint32_t flags = 0;
 
-	/* Set the context privilege level bit if context priv mode is M-mode */
-	flags |= (cntx->privilege_level == RPMI_PRIVILEGE_M_MODE) ?
+	/* Set the privilege level bit if channel priv mode is M-mode */
+	flags |= (chan && chan->privilege_level == RPMI_PRIVILEGE_M_MODE) ?
 					RPMI_BASE_FLAGS_F0_PRIVILEGE : 0;
 
 	*response_datalen = 5 * sizeof(*resp);
@@ -237,7 +593,7 @@ static struct rpmi_service_group *rpmi_base_group_create(struct rpmi_context *cn
 	struct rpmi_base_group *base;
 	rpmi_uint32_t max_plat_info_len;
 
-	base = rpmi_env_zalloc(sizeof(*base));
+	base = rpmi_zalloc(sizeof(*base));
 	if (!base)
 		return NULL;
 
@@ -248,7 +604,8 @@ static struct rpmi_service_group *rpmi_base_group_create(struct rpmi_context *cn
 	 * accomodated in the message data as per the
 	 * format of the base_get_platform_info service
 	 */
-	max_plat_info_len = RPMI_MSG_DATA_SIZE(cntx->trans->slot_size) -
+	max_plat_info_len =
+		RPMI_MSG_DATA_SIZE(rpmi_transport_slot_size(cntx->channels[0].trans)) -
 						(sizeof(rpmi_uint32_t) * 2);
 
 	if (plat_info_len > max_plat_info_len) {
@@ -257,7 +614,7 @@ static struct rpmi_service_group *rpmi_base_group_create(struct rpmi_context *cn
 
 	if (plat_info) {
 		base->plat_info_len = plat_info_len;
-		base->plat_info = rpmi_env_zalloc(plat_info_len);
+		base->plat_info = rpmi_zalloc(plat_info_len);
 		if (!base->plat_info)
 			goto fail_free_base;
 
@@ -280,7 +637,7 @@ static struct rpmi_service_group *rpmi_base_group_create(struct rpmi_context *cn
 	return group;
 
 fail_free_base:
-	rpmi_env_free(base);
+	rpmi_free(base);
 	return NULL;
 }
 
@@ -289,9 +646,9 @@ static void rpmi_base_group_destroy(struct rpmi_service_group *group)
 	struct rpmi_base_group *base = group->priv;
 
 	if (base->plat_info)
-		rpmi_env_free(base->plat_info);
+		rpmi_free(base->plat_info);
 	rpmi_env_free_lock(group->lock);
-	rpmi_env_free(group->priv);
+	rpmi_free(group->priv);
 }
 
 static enum rpmi_error rpmi_service_notsupp_a2p_request(struct rpmi_service_group *group,
@@ -309,203 +666,1238 @@ static enum rpmi_error rpmi_service_notsupp_a2p_request(struct rpmi_service_grou
 	return RPMI_SUCCESS;
 }
 
-void rpmi_context_process_a2p_request(struct rpmi_context *cntx)
+/* Take the service group lock unless the group does its own locking */
+static inline void rpmi_context_group_lock(struct rpmi_service_group *group)
 {
-	rpmi_bool_t do_process, do_acknowledge;
-	struct rpmi_message *rmsg, *amsg;
-	struct rpmi_service_group *group;
-	struct rpmi_service *service;
-	struct rpmi_transport *trans;
-	enum rpmi_error rc;
+	if (!(group->flags & LIBRPMI_SERVICE_GROUP_FLAG_INTERNAL_LOCKING))
+		rpmi_env_lock(group->lock);
+}
 
-	if (!cntx) {
-		DPRINTF("%s: invalid parameters\n", __func__);
+static inline void rpmi_context_group_unlock(struct rpmi_service_group *group)
+{
+	if (!(group->flags & LIBRPMI_SERVICE_GROUP_FLAG_INTERNAL_LOCKING))
+		rpmi_env_unlock(group->lock);
+}
+
+/* Timestamp for request latency statistics */
+static inline rpmi_uint64_t rpmi_context_stats_timestamp(void)
+{
+#ifdef LIBRPMI_STATS
+	return rpmi_env_timer_value();
+#else
+	return 0;
+#endif
+}
+
+/* Account a processed request under the statistics lock */
+static inline void rpmi_context_stats_request(struct rpmi_context_group *cgrp,
+					      struct rpmi_transport *trans,
+					      const struct rpmi_message_header *rhdr,
+					      const struct rpmi_message_header *ahdr,
+					      const rpmi_uint8_t *adata,
+					      enum rpmi_error rc,
+					      rpmi_uint64_t start,
+					      rpmi_bool_t deferred)
+{
+#ifdef LIBRPMI_STATS
+	struct rpmi_service_stats *st;
+	rpmi_uint64_t latency;
+	rpmi_int32_t status;
+
+	if (!cgrp->stats)
 		return;
+
+	latency = rpmi_context_stats_timestamp() - start;
+
+	/* Response of a deferred request is not available yet */
+	status = RPMI_SUCCESS;
+	if (!deferred && ahdr->datalen >= sizeof(rpmi_uint32_t))
+		status = (rpmi_int32_t)rpmi_to_xe32(trans->is_be,
+						    ((const rpmi_uint32_t *)adata)[0]);
+
+	rpmi_env_lock(cgrp->stats_lock);
+	st = &cgrp->stats[(rhdr->service_id < cgrp->group->max_service_id) ?
+							rhdr->service_id : 0];
+	if (!st->requests || latency < st->latency_min)
+		st->latency_min = latency;
+	if (latency > st->latency_max)
+		st->latency_max = latency;
+	st->latency_total += latency;
+	st->requests++;
+	if (!deferred) {
+		if (status == RPMI_ERR_NOTSUPP)
+			st->notsupp++;
+		else if (rc || status)
+			st->errors++;
 	}
+	rpmi_env_unlock(cgrp->stats_lock);
+#endif
+}
 
-	trans = cntx->trans;
-	rmsg = cntx->req_msg;
-	amsg = cntx->ack_msg;
-	while (!rpmi_transport_dequeue(trans, RPMI_QUEUE_A2P_REQ, rmsg)) {
-		group = rpmi_context_find_group(cntx, rmsg->header.servicegroup_id);
-		if (!group) {
-			DPRINTF("%s: %s: service group ID 0x%x not found\n",
-				__func__, cntx->name, rmsg->header.servicegroup_id);
-			continue;
-		}
+/**
+ * Call the service of an A2P request with the service group lock held unless
+ * the group does its own locking and prepare the acknowledgement data. The
+ * request handle tells whether the request was deferred by the service.
+ */
+static enum rpmi_error rpmi_context_call_service(struct rpmi_context_group *cgrp,
+						 struct rpmi_transport *trans,
+						 struct rpmi_context_request *req,
+						 const rpmi_uint8_t *rdata,
+						 struct rpmi_message_header *ahdr,
+						 rpmi_uint8_t *adata)
+{
+	const struct rpmi_message_header *rhdr = req->rhdr;
+	struct rpmi_service_group *group = cgrp->group;
+	struct rpmi_context *cntx = req->cntx;
+	struct rpmi_service *service;
+	rpmi_uint64_t start;
+	enum rpmi_error rc;
 
-		service = NULL;
-		if (rmsg->header.service_id < group->max_service_id)
-			service = &group->services[rmsg->header.service_id];
-
-		amsg->header.flags = RPMI_MSG_ACKNOWLDGEMENT;
-		amsg->header.service_id = rmsg->header.service_id;
-		amsg->header.servicegroup_id = rmsg->header.servicegroup_id;
-		amsg->header.datalen = 0;
-		amsg->header.token = rmsg->header.token;
-
-		do_process = false;
-		do_acknowledge = false;
-		switch (rmsg->header.flags & RPMI_MSG_FLAGS_TYPE) {
-		case RPMI_MSG_NORMAL_REQUEST:
-			do_process = true;
-			do_acknowledge = true;
-			break;
-		case RPMI_MSG_POSTED_REQUEST:
-			do_process = true;
-			break;
-		case RPMI_MSG_ACKNOWLDGEMENT:
-			DPRINTF("%s: %s: group %s ignoring acknowledgment from a2p queue\n",
-				__func__, cntx->name, group->name);
-			break;
-		case RPMI_MSG_NOTIFICATION:
-			DPRINTF("%s: %s: group %s can't handle notification from a2p queue\n",
-				__func__, cntx->name, group->name);
-			break;
-		default:
-			break;
-		}
+	service = NULL;
+	if (rhdr->service_id < group->max_service_id)
+		service = &group->services[rhdr->service_id];
+
+	rpmi_trace(RPMI_TRACE_EVENT_DISPATCH_START, rhdr->service_id,
+		   rhdr->servicegroup_id, rhdr->token);
+	rpmi_context_group_lock(group);
+	start = rpmi_context_stats_timestamp();
+	if (service && service->process_a2p_request_deferrable &&
+	    rhdr->datalen >= service->min_a2p_request_datalen)
+		rc = service->process_a2p_request_deferrable(group, service,
+						trans, req, rhdr->datalen, rdata,
+						&ahdr->datalen, adata);
+	else if (service && service->process_a2p_request &&
+		 rhdr->datalen >= service->min_a2p_request_datalen)
+		rc = service->process_a2p_request(group, service, trans,
+						rhdr->datalen, rdata,
+						&ahdr->datalen, adata);
+	else
+		rc = rpmi_service_notsupp_a2p_request(group, service, trans,
+						rhdr->datalen, rdata,
+						&ahdr->datalen, adata);
+	rpmi_context_stats_request(cgrp, trans, rhdr, ahdr, adata, rc, start,
+				   req->deferred < LIBRPMI_CONTEXT_MAX_DEFERRED);
+	rpmi_context_group_unlock(group);
+	rpmi_trace(RPMI_TRACE_EVENT_DISPATCH_END, rhdr->service_id,
+		   rhdr->servicegroup_id,
+		   ((rpmi_uint32_t)(rpmi_uint16_t)rc << 16) | rhdr->token);
+
+	/* Requests may generate events so let the group check for them */
+	if (group->flags & LIBRPMI_SERVICE_GROUP_FLAG_EVENTS_ON_SIGNAL)
+		rpmi_context_signal_group(cntx, group->servicegroup_id);
 
-		if (!do_process)
-			continue;
+	if (rc) {
+		DPRINTF("%s: %s: group %s a2p request failed (error %d)\n",
+			__func__, cntx->name, group->name, rc);
+		DPRINTF("%s: %s: flags 0x%x service_id 0x%x servicegroup_id 0x%x\n",
+			__func__, cntx->name,
+			rhdr->flags, rhdr->service_id,
+			rhdr->servicegroup_id);
+		DPRINTF("%s: %s: datalen 0x%x token 0x%x\n",
+			__func__, cntx->name,
+			rhdr->datalen, rhdr->token);
+	}
 
-		rpmi_env_lock(group->lock);
-		if (service && service->process_a2p_request &&
-		    rmsg->header.datalen >= service->min_a2p_request_datalen)
-			rc = service->process_a2p_request(group, service, trans,
-							rmsg->header.datalen, rmsg->data,
-							&amsg->header.datalen, amsg->data);
-		else
-			rc = rpmi_service_notsupp_a2p_request(group, service, trans,
-							rmsg->header.datalen, rmsg->data,
-							&amsg->header.datalen, amsg->data);
-		rpmi_env_unlock(group->lock);
+	return rc;
+}
 
-		if (rc) {
-			DPRINTF("%s: %s: group %s a2p request failed (error %d)\n",
-				__func__, cntx->name, group->name, rc);
-			DPRINTF("%s: %s: flags 0x%x service_id 0x%x servicegroup_id 0x%x\n",
-				__func__, cntx->name,
-				rmsg->header.flags, rmsg->header.service_id,
-				rmsg->header.servicegroup_id);
-			DPRINTF("%s: %s: datalen 0x%x token 0x%x\n",
-				__func__, cntx->name,
-				rmsg->header.datalen, rmsg->header.token);
-			continue;
-		}
+static rpmi_bool_t rpmi_context_post_work(struct rpmi_context *cntx,
+					  struct rpmi_context_worker *w,
+					  rpmi_bool_t wait);
 
-		if (!do_acknowledge)
-			continue;
+/**
+ * Queue an A2P request to the work queue of a worker. The request
+ * processing never gets here with a full work queue because requests are
+ * left in the A2P queue until the workers have space for them (see
+ * rpmi_context_worker_space()) so the dispatcher never waits for a worker.
+ */
+static void rpmi_context_queue_work(struct rpmi_context *cntx,
+				    struct rpmi_context_channel *chan,
+				    struct rpmi_context_group *cgrp,
+				    struct rpmi_context_worker *w,
+				    const struct rpmi_message_header *rhdr,
+				    const rpmi_uint8_t *rdata,
+				    rpmi_bool_t do_acknowledge)
+{
+	struct rpmi_message_header *ahdr;
+	struct rpmi_context_work *work;
+
+	work = &w->queue[w->head & (LIBRPMI_CONTEXT_WORKER_QUEUE_LEN - 1)];
+	work->cgrp = cgrp;
+	work->trans = chan->trans;
+	work->channel = chan - cntx->channels;
+	work->do_acknowledge = do_acknowledge;
+	work->do_doorbell = (rhdr->flags & RPMI_MSG_FLAGS_DOORBELL) ? true : false;
+
+	/* Work messages are sized using the primary transport */
+	work->req_msg->header = *rhdr;
+	work->req_msg->header.datalen = RPMI_MIN(rhdr->datalen,
+		RPMI_MSG_DATA_SIZE(rpmi_transport_slot_size(cntx->channels[0].trans)));
+	rpmi_env_memcpy(work->req_msg->data, rdata, work->req_msg->header.datalen);
+
+	ahdr = &work->ack_msg->header;
+	ahdr->flags = RPMI_MSG_ACKNOWLDGEMENT;
+	ahdr->service_id = rhdr->service_id;
+	ahdr->servicegroup_id = rhdr->servicegroup_id;
+	ahdr->datalen = 0;
+	ahdr->token = rhdr->token;
+
+	/* Work entry must be visible before the worker sees it */
+	cgrp->queued++;
+	rpmi_env_fence_release();
+	*(volatile rpmi_uint32_t *)&w->head = w->head + 1;
+}
 
-		/**
-		 * Try pushing the message in queue until successful
-		 * or any other error apart from input/output error
-		 * in case of queue full.
-		 */
-		do {
-			rc = rpmi_transport_enqueue(trans, RPMI_QUEUE_P2A_ACK, amsg);
-		} while (rc == RPMI_ERR_IO);
+/**
+ * Select the worker for the next request of a service group. A change of
+ * the assigned worker takes effect only after the requests queued to the
+ * previous worker are acknowledged so the dispatcher never waits for it.
+ * Returns 0 for the dispatcher.
+ */
+static rpmi_uint32_t rpmi_context_select_worker(struct rpmi_context_group *cgrp)
+{
+	rpmi_uint32_t worker = *(volatile rpmi_uint32_t *)&cgrp->worker;
 
-		if (rc) {
-			DPRINTF("%s: %s: group %s p2a acknowledgment failed (error %d)\n",
-				__func__, cntx->name, group->name, rc);
-		}
+	if (worker != cgrp->active_worker && !cgrp->queued)
+		cgrp->active_worker = worker;
 
-		if ((rmsg->header.flags & RPMI_MSG_FLAGS_DOORBELL) &&
-		    cntx->sysmsi_group)
-			rpmi_service_group_sysmsi_inject_p2a(cntx->sysmsi_group);
-	}
+	return cgrp->active_worker;
 }
 
-void rpmi_context_process_group_events(struct rpmi_context *cntx,
-				       rpmi_uint16_t servicegroup_id)
+/**
+ * Process one A2P request message and prepare the acknowledgement message.
+ * The message headers are in native endianness whereas the message data
+ * is in transport endianness. Returns true if the acknowledgement message
+ * must be sent to the AP.
+ */
+static rpmi_bool_t rpmi_context_process_msg(struct rpmi_context *cntx,
+					    struct rpmi_context_channel *chan,
+					    const struct rpmi_message_header *rhdr,
+					    const rpmi_uint8_t *rdata,
+					    struct rpmi_message_header *ahdr,
+					    rpmi_uint8_t *adata)
 {
-	struct rpmi_service_group *group;
+	rpmi_bool_t do_process, do_acknowledge;
+	struct rpmi_transport *trans = chan->trans;
+	struct rpmi_context_request req;
+	struct rpmi_context_group *cgrp;
+	rpmi_uint32_t pos, worker;
 	enum rpmi_error rc;
 
-	if (!cntx) {
-		DPRINTF("%s: invalid parameters\n", __func__);
-		return;
+	cgrp = rpmi_context_lookup_group(cntx, rhdr->servicegroup_id, &pos);
+	if (!cgrp || !rpmi_context_group_allowed(chan, cgrp->group)) {
+		DPRINTF("%s: %s: service group ID 0x%x not found for %s\n",
+			__func__, cntx->name, rhdr->servicegroup_id, trans->name);
+		return false;
 	}
 
-	group = rpmi_context_find_group(cntx, servicegroup_id);
-	if (!group) {
-		DPRINTF("%s: %s: group not found for servicegroup_id 0x%x\n",
-			__func__, cntx->name, servicegroup_id);
-		return;
-	}
-	if (!group->process_events) {
-		DPRINTF("%s: %s: group %s does not support events\n",
-			__func__, cntx->name, group->name);
-		return;
+	ahdr->flags = RPMI_MSG_ACKNOWLDGEMENT;
+	ahdr->service_id = rhdr->service_id;
+	ahdr->servicegroup_id = rhdr->servicegroup_id;
+	ahdr->datalen = 0;
+	ahdr->token = rhdr->token;
+
+	do_process = false;
+	do_acknowledge = false;
+	switch (rhdr->flags & RPMI_MSG_FLAGS_TYPE) {
+	case RPMI_MSG_NORMAL_REQUEST:
+		do_process = true;
+		do_acknowledge = true;
+		break;
+	case RPMI_MSG_POSTED_REQUEST:
+		do_process = true;
+		break;
+	case RPMI_MSG_ACKNOWLDGEMENT:
+		DPRINTF("%s: %s: group %s ignoring acknowledgment from a2p queue\n",
+			__func__, cntx->name, cgrp->group->name);
+		break;
+	case RPMI_MSG_NOTIFICATION:
+		DPRINTF("%s: %s: group %s can't handle notification from a2p queue\n",
+			__func__, cntx->name, cgrp->group->name);
+		break;
+	default:
+		break;
 	}
 
-	rpmi_env_lock(group->lock);
-	rc = group->process_events(group);
-	rpmi_env_unlock(group->lock);
-	if (rc && rc != RPMI_ERR_BUSY) {
-		DPRINTF("%s: %s: group %s failed with error %d\n",
-			__func__, cntx->name, group->name, rc);
+	if (!do_process)
+		return false;
+
+	/* Requests of a group assigned to a worker are acknowledged by it */
+	worker = rpmi_context_select_worker(cgrp);
+	if (worker) {
+		rpmi_context_queue_work(cntx, chan, cgrp, &cntx->workers[worker - 1],
+					rhdr, rdata, do_acknowledge);
+		return false;
 	}
+
+	req.cntx = cntx;
+	req.chan = chan;
+	req.rhdr = rhdr;
+	req.deferred = LIBRPMI_CONTEXT_MAX_DEFERRED;
+
+	rc = rpmi_context_call_service(cgrp, trans, &req, rdata, ahdr, adata);
+
+	/* Deferred requests are acknowledged upon completion */
+	if (req.deferred < LIBRPMI_CONTEXT_MAX_DEFERRED)
+		return false;
+
+	return rc ? false : do_acknowledge;
 }
 
-void rpmi_context_process_all_events(struct rpmi_context *cntx)
+/**
+ * Post the pending acknowledgements parked in the temporary buffer and
+ * inject the P2A doorbell for them. If the wait parameter is true then try
+ * until successful or any other error apart from input/output error in
+ * case of queue full. Returns true if nothing is pending anymore.
+ */
+static rpmi_bool_t rpmi_context_flush_acks(struct rpmi_context *cntx,
+					   struct rpmi_context_channel *chan,
+					   rpmi_bool_t wait)
 {
-	struct rpmi_service_group *group;
+	struct rpmi_transport *trans = chan->trans;
+	rpmi_uint32_t count;
 	enum rpmi_error rc;
-	rpmi_uint32_t i;
 
-	if (!cntx) {
-		DPRINTF("%s: invalid parameters\n", __func__);
-		return;
+	while (chan->ack_pending) {
+		rc = rpmi_transport_enqueue_batch(trans, RPMI_QUEUE_P2A_ACK,
+				rpmi_transport_batch_msg(trans, chan->ack_msgs,
+							 chan->ack_first),
+				chan->ack_pending, &count);
+		if (rc == RPMI_ERR_IO) {
+			rpmi_trace(RPMI_TRACE_EVENT_QUEUE_FULL, RPMI_QUEUE_P2A_ACK,
+				   chan->ack_pending, 0);
+			if (!wait)
+				return false;
+			continue;
+		}
+		if (rc) {
+			DPRINTF("%s: %s: p2a acknowledgment failed (error %d)\n",
+				__func__, cntx->name, rc);
+			chan->ack_pending = 0;
+			break;
+		}
+		rpmi_trace(RPMI_TRACE_EVENT_ACK_ENQUEUE, RPMI_QUEUE_P2A_ACK, count, 0);
+		chan->ack_first += count;
+		chan->ack_pending -= count;
 	}
+	chan->ack_first = 0;
 
-	rpmi_env_lock(cntx->groups_lock);
+#if LIBRPMI_CONTEXT_COALESCE_DOORBELL
+	if (chan->doorbell_pending)
+		cntx->doorbell_coalesced |= 1U << (chan - cntx->channels);
+#else
+	while (chan->doorbell_pending) {
+		rpmi_context_ring_doorbell(cntx, chan - cntx->channels);
+		chan->doorbell_pending--;
+	}
+#endif
+	chan->doorbell_pending = 0;
 
-	for (i = 0; i < cntx->num_groups; i++) {
-		group = cntx->groups[i];
-		if (!group->process_events)
-			continue;
+	return true;
+}
 
-		rpmi_env_unlock(cntx->groups_lock);
+/**
+ * Process one A2P request with header in native endianness. The
+ * acknowledgement is written directly into a P2A slot if the transport
+ * supports it and no earlier acknowledgement is parked otherwise it is
+ * parked in the temporary buffer.
+ */
+static void rpmi_context_process_request(struct rpmi_context *cntx,
+					 struct rpmi_context_channel *chan,
+					 const struct rpmi_message_header *rhdr,
+					 const rpmi_uint8_t *rdata)
+{
+	struct rpmi_transport *trans = chan->trans;
+	struct rpmi_message_header ahdr;
+	struct rpmi_message *aslot;
+	enum rpmi_error rc;
 
-		rpmi_env_lock(group->lock);
-		rc = group->process_events(group);
-		rpmi_env_unlock(group->lock);
-		if (rc && rc != RPMI_ERR_BUSY) {
-			DPRINTF("%s: %s: group %s failed with error %d\n",
-				__func__, cntx->name, group->name, rc);
+	aslot = NULL;
+	if (!chan->ack_pending && rpmi_transport_has_reserve_slot(trans) &&
+	    (rhdr->flags & RPMI_MSG_FLAGS_TYPE) == RPMI_MSG_NORMAL_REQUEST &&
+	    rpmi_transport_reserve_slot(trans, RPMI_QUEUE_P2A_ACK, &aslot))
+		aslot = NULL;
+
+	if (!aslot) {
+		aslot = rpmi_transport_batch_msg(trans, chan->ack_msgs,
+						 chan->ack_pending);
+		if (!rpmi_context_process_msg(cntx, chan, rhdr, rdata,
+					      &aslot->header, aslot->data))
+			return;
+		chan->ack_pending++;
+	} else {
+		if (!rpmi_context_process_msg(cntx, chan, rhdr, rdata,
+					      &ahdr, aslot->data))
+			return;
+		rpmi_transport_convert_header(trans, &aslot->header, &ahdr);
+		rc = rpmi_transport_publish_slot(trans, RPMI_QUEUE_P2A_ACK);
+		if (rc)
+			DPRINTF("%s: %s: p2a slot publish failed (error %d)\n",
+				__func__, cntx->name, rc);
+		else
+			rpmi_trace(RPMI_TRACE_EVENT_ACK_ENQUEUE,
+				   RPMI_QUEUE_P2A_ACK, 1, 0);
+	}
+
+	if (rhdr->flags & RPMI_MSG_FLAGS_DOORBELL)
+		chan->doorbell_pending++;
+}
+
+/**
+ * Process one A2P request in-place within the transport slot. This is only
+ * used for transports of trusted application processors (see
+ * rpmi_transport_peek_slot()). Returns true if a request was processed.
+ */
+static rpmi_bool_t rpmi_context_process_inplace(struct rpmi_context *cntx,
+						struct rpmi_context_channel *chan)
+{
+	struct rpmi_transport *trans = chan->trans;
+	struct rpmi_message_header rhdr;
+	struct rpmi_message *rslot;
+	enum rpmi_error rc;
+
+	if (rpmi_transport_peek_slot(trans, RPMI_QUEUE_A2P_REQ, &rslot))
+		return false;
+	rpmi_trace(RPMI_TRACE_EVENT_DEQUEUE, RPMI_QUEUE_A2P_REQ, 1, 0);
+
+	rpmi_transport_convert_header(trans, &rhdr, &rslot->header);
+	rpmi_context_process_request(cntx, chan, &rhdr, rslot->data);
+
+	rc = rpmi_transport_commit_slot(trans, RPMI_QUEUE_A2P_REQ);
+	if (rc)
+		DPRINTF("%s: %s: a2p slot commit failed (error %d)\n",
+			__func__, cntx->name, rc);
+
+	return true;
+}
+
+/**
+ * Dequeue and process a batch of A2P requests copied into the temporary
+ * buffer so that the application processors can't change a request while
+ * it is processed. Returns number of requests processed.
+ */
+static rpmi_uint32_t rpmi_context_process_batch(struct rpmi_context *cntx,
+						struct rpmi_context_channel *chan,
+						rpmi_uint32_t max_count)
+{
+	struct rpmi_transport *trans = chan->trans;
+	struct rpmi_message *rmsg;
+	rpmi_uint32_t i, req_count;
+
+	if (rpmi_transport_dequeue_batch(trans, RPMI_QUEUE_A2P_REQ, cntx->req_msgs,
+					 max_count, &req_count))
+		return 0;
+	rpmi_trace(RPMI_TRACE_EVENT_DEQUEUE, RPMI_QUEUE_A2P_REQ, req_count, 0);
+
+	for (i = 0; i < req_count; i++) {
+		rmsg = rpmi_transport_batch_msg(trans, cntx->req_msgs, i);
+		rpmi_context_process_request(cntx, chan, &rmsg->header, rmsg->data);
+	}
+
+	return req_count;
+}
+
+/**
+ * Post the acknowledgements of completed deferred requests. If the wait
+ * parameter is true then try until successful or any other error apart
+ * from input/output error in case of queue full otherwise leave them
+ * for the next call.
+ */
+static void rpmi_context_post_deferred(struct rpmi_context *cntx,
+				       rpmi_bool_t wait)
+{
+	struct rpmi_deferred_request *dreq;
+	enum rpmi_error rc;
+	rpmi_uint32_t i;
+
+	if (!*(volatile rpmi_uint32_t *)&cntx->deferred_completed)
+		return;
+
+	for (i = 0; i < LIBRPMI_CONTEXT_MAX_DEFERRED; i++) {
+		dreq = &cntx->deferred[i];
+
+		rpmi_env_lock(cntx->deferred_lock);
+		if (dreq->state != RPMI_DEFERRED_COMPLETED) {
+			rpmi_env_unlock(cntx->deferred_lock);
+			continue;
+		}
+		rpmi_env_unlock(cntx->deferred_lock);
+
+		/* Completed slots are only touched by the request processing */
+		do {
+			rc = rpmi_transport_enqueue(cntx->channels[dreq->channel].trans,
+						    RPMI_QUEUE_P2A_ACK, dreq->ack_msg);
+		} while (wait && rc == RPMI_ERR_IO);
+		if (rc == RPMI_ERR_IO) {
+			rpmi_trace(RPMI_TRACE_EVENT_QUEUE_FULL, RPMI_QUEUE_P2A_ACK,
+				   1, 0);
+			continue;
+		}
+		if (rc)
+			DPRINTF("%s: %s: deferred p2a acknowledgment failed (error %d)\n",
+				__func__, cntx->name, rc);
+		else
+			rpmi_trace(RPMI_TRACE_EVENT_ACK_ENQUEUE,
+				   RPMI_QUEUE_P2A_ACK, 1, 0);
+
+#if LIBRPMI_CONTEXT_COALESCE_DOORBELL
+		if (dreq->do_doorbell)
+			cntx->doorbell_coalesced |= 1U << dreq->channel;
+#else
+		if (dreq->do_doorbell)
+			rpmi_context_ring_doorbell(cntx, dreq->channel);
+#endif
+
+		rpmi_env_lock(cntx->deferred_lock);
+		dreq->state = RPMI_DEFERRED_FREE;
+		cntx->deferred_completed--;
+		rpmi_env_unlock(cntx->deferred_lock);
+	}
+}
+
+/**
+ * Post the acknowledgements of requests processed by a worker in the order
+ * in which the requests were queued. If the wait parameter is true then try
+ * until successful or any other error apart from input/output error in case
+ * of queue full otherwise leave them for the next call. Returns true if all
+ * processed requests have been acknowledged.
+ */
+static rpmi_bool_t rpmi_context_post_work(struct rpmi_context *cntx,
+					  struct rpmi_context_worker *w,
+					  rpmi_bool_t wait)
+{
+	struct rpmi_context_work *work;
+	rpmi_uint32_t done;
+	enum rpmi_error rc;
+
+	done = *(volatile rpmi_uint32_t *)&w->done;
+	rpmi_env_fence_acquire();
+
+	for (; w->tail != done; w->tail++) {
+		work = &w->queue[w->tail & (LIBRPMI_CONTEXT_WORKER_QUEUE_LEN - 1)];
+		if (!work->do_acknowledge) {
+			work->cgrp->queued--;
+			continue;
+		}
+
+		do {
+			rc = rpmi_transport_enqueue(work->trans, RPMI_QUEUE_P2A_ACK,
+						    work->ack_msg);
+		} while (wait && rc == RPMI_ERR_IO);
+		if (rc == RPMI_ERR_IO) {
+			rpmi_trace(RPMI_TRACE_EVENT_QUEUE_FULL, RPMI_QUEUE_P2A_ACK,
+				   done - w->tail, 0);
+			return false;
+		}
+		work->cgrp->queued--;
+		if (rc)
+			DPRINTF("%s: %s: worker p2a acknowledgment failed (error %d)\n",
+				__func__, cntx->name, rc);
+		else
+			rpmi_trace(RPMI_TRACE_EVENT_ACK_ENQUEUE,
+				   RPMI_QUEUE_P2A_ACK, 1, 0);
+
+#if LIBRPMI_CONTEXT_COALESCE_DOORBELL
+		if (work->do_doorbell)
+			cntx->doorbell_coalesced |= 1U << work->channel;
+#else
+		if (work->do_doorbell)
+			rpmi_context_ring_doorbell(cntx, work->channel);
+#endif
+	}
+
+	return true;
+}
+
+static void rpmi_context_post_workers(struct rpmi_context *cntx,
+				      rpmi_bool_t wait)
+{
+	rpmi_uint32_t i;
+
+	for (i = 0; i < LIBRPMI_CONTEXT_MAX_WORKERS; i++) {
+		if (cntx->workers[i].queue)
+			rpmi_context_post_work(cntx, &cntx->workers[i], wait);
+	}
+}
+
+/**
+ * Number of requests (up to max_count) which can be dequeued without
+ * waiting for a worker. Each request takes at most one entry of one work
+ * queue so the free entries of the fullest work queue bound the requests
+ * when the P2A queue or a worker falls behind.
+ */
+static rpmi_uint32_t rpmi_context_worker_space(struct rpmi_context *cntx,
+					       rpmi_uint32_t max_count,
+					       rpmi_bool_t wait)
+{
+	struct rpmi_context_worker *w;
+	rpmi_uint32_t i, space = max_count;
+
+	for (i = 0; i < LIBRPMI_CONTEXT_MAX_WORKERS; i++) {
+		w = &cntx->workers[i];
+		if (!w->queue)
+			continue;
+		if (LIBRPMI_CONTEXT_WORKER_QUEUE_LEN - (w->head - w->tail) < space)
+			rpmi_context_post_work(cntx, w, wait);
+		space = RPMI_MIN(space,
+				 LIBRPMI_CONTEXT_WORKER_QUEUE_LEN - (w->head - w->tail));
+	}
+
+	return space;
+}
+
+struct rpmi_context *rpmi_context_request_context(struct rpmi_context_request *req)
+{
+	return req ? req->cntx : NULL;
+}
+
+enum rpmi_error rpmi_context_defer_request(struct rpmi_context_request *req,
+					   rpmi_uint32_t *out_handle)
+{
+	const struct rpmi_message_header *rhdr;
+	struct rpmi_deferred_request *dreq;
+	struct rpmi_message_header *ahdr;
+	struct rpmi_context *cntx;
+	rpmi_uint32_t i;
+
+	if (!req || !out_handle) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	/* Acknowledgements of a worker are posted in queue order */
+	cntx = req->cntx;
+	if (!req->chan || req->deferred < LIBRPMI_CONTEXT_MAX_DEFERRED) {
+		DPRINTF("%s: %s: request can't be deferred\n", __func__, cntx->name);
+		return RPMI_ERR_INVALID_STATE;
+	}
+	rhdr = req->rhdr;
+
+	rpmi_env_lock(cntx->deferred_lock);
+	for (i = 0; i < LIBRPMI_CONTEXT_MAX_DEFERRED; i++) {
+		if (cntx->deferred[i].state == RPMI_DEFERRED_FREE)
+			break;
+	}
+	if (i == LIBRPMI_CONTEXT_MAX_DEFERRED) {
+		rpmi_env_unlock(cntx->deferred_lock);
+		DPRINTF("%s: %s: no free deferred request slot\n", __func__, cntx->name);
+		return RPMI_ERR_BUSY;
+	}
+
+	dreq = &cntx->deferred[i];
+	dreq->state = RPMI_DEFERRED_PENDING;
+	dreq->channel = req->chan - cntx->channels;
+	dreq->do_acknowledge =
+		((rhdr->flags & RPMI_MSG_FLAGS_TYPE) == RPMI_MSG_NORMAL_REQUEST) ?
+								true : false;
+	dreq->do_doorbell = (rhdr->flags & RPMI_MSG_FLAGS_DOORBELL) ? true : false;
+
+	ahdr = &dreq->ack_msg->header;
+	ahdr->flags = RPMI_MSG_ACKNOWLDGEMENT;
+	ahdr->service_id = rhdr->service_id;
+	ahdr->servicegroup_id = rhdr->servicegroup_id;
+	ahdr->datalen = 0;
+	ahdr->token = rhdr->token;
+	rpmi_env_unlock(cntx->deferred_lock);
+
+	req->deferred = i;
+	*out_handle = i;
+
+	return RPMI_SUCCESS;
+}
+
+enum rpmi_error rpmi_context_complete_request(struct rpmi_context *cntx,
+					      rpmi_uint32_t handle,
+					      rpmi_uint16_t response_datalen,
+					      const rpmi_uint8_t *response_data)
+{
+	struct rpmi_deferred_request *dreq;
+	struct rpmi_transport *trans;
+
+	if (!cntx || handle >= LIBRPMI_CONTEXT_MAX_DEFERRED ||
+	    (response_datalen && !response_data)) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	dreq = &cntx->deferred[handle];
+
+	rpmi_env_lock(cntx->deferred_lock);
+	if (dreq->state != RPMI_DEFERRED_PENDING) {
+		rpmi_env_unlock(cntx->deferred_lock);
+		DPRINTF("%s: %s: deferred request %d not pending\n",
+			__func__, cntx->name, handle);
+		return RPMI_ERR_INVALID_STATE;
+	}
+
+	/* Channel of a pending deferred request can't be removed */
+	trans = cntx->channels[dreq->channel].trans;
+	if (response_datalen > RPMI_MSG_DATA_SIZE(rpmi_transport_slot_size(trans))) {
+		rpmi_env_unlock(cntx->deferred_lock);
+		DPRINTF("%s: %s: response too big (%d bytes)\n",
+			__func__, cntx->name, response_datalen);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	if (dreq->do_acknowledge) {
+		rpmi_env_memcpy(dreq->ack_msg->data, response_data, response_datalen);
+		dreq->ack_msg->header.datalen = response_datalen;
+		dreq->state = RPMI_DEFERRED_COMPLETED;
+		cntx->deferred_completed++;
+	} else {
+		dreq->state = RPMI_DEFERRED_FREE;
+	}
+	rpmi_env_unlock(cntx->deferred_lock);
+
+	return RPMI_SUCCESS;
+}
+
+enum rpmi_error rpmi_context_complete_request_status(struct rpmi_context *cntx,
+						     rpmi_uint32_t handle,
+						     enum rpmi_error status)
+{
+	struct rpmi_deferred_request *dreq;
+	rpmi_uint32_t resp;
+	rpmi_bool_t is_be;
+
+	if (!cntx || handle >= LIBRPMI_CONTEXT_MAX_DEFERRED) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	/* Channel of a pending deferred request can't be removed */
+	dreq = &cntx->deferred[handle];
+	rpmi_env_lock(cntx->deferred_lock);
+	if (dreq->state != RPMI_DEFERRED_PENDING) {
+		rpmi_env_unlock(cntx->deferred_lock);
+		DPRINTF("%s: %s: deferred request %d not pending\n",
+			__func__, cntx->name, handle);
+		return RPMI_ERR_INVALID_STATE;
+	}
+	is_be = rpmi_transport_is_be(cntx->channels[dreq->channel].trans);
+	rpmi_env_unlock(cntx->deferred_lock);
+
+	resp = rpmi_to_xe32(is_be, (rpmi_uint32_t)status);
+
+	return rpmi_context_complete_request(cntx, handle, sizeof(resp),
+					     (const rpmi_uint8_t *)&resp);
+}
+
+enum rpmi_error rpmi_context_set_group_worker(struct rpmi_context *cntx,
+					      rpmi_uint16_t servicegroup_id,
+					      rpmi_uint32_t worker)
+{
+	struct rpmi_context_group *cgrp;
+	struct rpmi_transport *trans;
+	struct rpmi_context_worker *w;
+	enum rpmi_error rc = RPMI_SUCCESS;
+	rpmi_uint32_t i, pos;
+
+	if (!cntx || worker > LIBRPMI_CONTEXT_MAX_WORKERS) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	/* Dispatch tables only change with groups_lock held */
+	rpmi_env_lock(cntx->groups_lock);
+
+	cgrp = rpmi_context_lookup_group(cntx, servicegroup_id, &pos);
+	if (!cgrp) {
+		DPRINTF("%s: %s: group not found for servicegroup_id 0x%x\n",
+			__func__, cntx->name, servicegroup_id);
+		rc = RPMI_ERR_INVALID_PARAM;
+		goto done;
+	}
+
+	/* Work queue of a worker is allocated upon first use */
+	w = worker ? &cntx->workers[worker - 1] : NULL;
+	if (w && !w->queue) {
+		trans = cntx->channels[0].trans;
+		w->queue = rpmi_zalloc(LIBRPMI_CONTEXT_WORKER_QUEUE_LEN *
+				       sizeof(*w->queue));
+		w->msgs = rpmi_zalloc(2 * LIBRPMI_CONTEXT_WORKER_QUEUE_LEN *
+				      rpmi_transport_slot_size(trans));
+		if (!w->queue || !w->msgs) {
+			DPRINTF("%s: %s: worker %d queue allocation failed\n",
+				__func__, cntx->name, worker);
+			if (w->queue)
+				rpmi_free(w->queue);
+			if (w->msgs)
+				rpmi_free(w->msgs);
+			w->queue = NULL;
+			w->msgs = NULL;
+			rc = RPMI_ERR_FAILED;
+			goto done;
 		}
 
-		rpmi_env_lock(cntx->groups_lock);
+		for (i = 0; i < LIBRPMI_CONTEXT_WORKER_QUEUE_LEN; i++) {
+			w->queue[i].req_msg =
+				rpmi_transport_batch_msg(trans, w->msgs, 2 * i);
+			w->queue[i].ack_msg =
+				rpmi_transport_batch_msg(trans, w->msgs, 2 * i + 1);
+		}
 	}
 
+	/* Work queue must be visible before the dispatcher uses it */
+	rpmi_env_fence_release();
+	*(volatile rpmi_uint32_t *)&cgrp->worker = worker;
+
+done:
 	rpmi_env_unlock(cntx->groups_lock);
+	return rc;
+}
+
+rpmi_uint32_t rpmi_context_process_worker(struct rpmi_context *cntx,
+					  rpmi_uint32_t worker)
+{
+	struct rpmi_message_header *rhdr, *ahdr;
+	struct rpmi_context_request req;
+	struct rpmi_context_worker *w;
+	struct rpmi_context_work *work;
+	rpmi_uint32_t start, head, done, e;
+	enum rpmi_error rc;
+
+	if (!cntx || !worker || worker > LIBRPMI_CONTEXT_MAX_WORKERS) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return 0;
+	}
+
+	w = &cntx->workers[worker - 1];
+	if (!w->queue)
+		return 0;
+
+	head = *(volatile rpmi_uint32_t *)&w->head;
+	rpmi_env_fence_acquire();
+
+	start = w->done;
+	for (done = start; done != head; done++) {
+		work = &w->queue[done & (LIBRPMI_CONTEXT_WORKER_QUEUE_LEN - 1)];
+		rhdr = &work->req_msg->header;
+		ahdr = &work->ack_msg->header;
+
+		/*
+		 * Group may have been removed after the request was queued
+		 * in which case the slot is not reused until the request is
+		 * acknowledged.
+		 */
+		e = rpmi_context_read_lock(cntx);
+		if (*(struct rpmi_service_group * volatile *)&work->cgrp->group) {
+			req.cntx = cntx;
+			req.chan = NULL;
+			req.rhdr = rhdr;
+			req.deferred = LIBRPMI_CONTEXT_MAX_DEFERRED;
+			rc = rpmi_context_call_service(work->cgrp, work->trans, &req,
+						       work->req_msg->data,
+						       ahdr, work->ack_msg->data);
+			if (rc)
+				work->do_acknowledge = false;
+		} else {
+			DPRINTF("%s: %s: service group ID 0x%x removed\n",
+				__func__, cntx->name, rhdr->servicegroup_id);
+			ahdr->datalen = sizeof(rpmi_uint32_t);
+			((rpmi_uint32_t *)work->ack_msg->data)[0] =
+				rpmi_to_xe32(work->trans->is_be,
+					     (rpmi_uint32_t)RPMI_ERR_NOTSUPP);
+		}
+		rpmi_context_read_unlock(cntx, e);
+
+		/* Acknowledgement must be visible before the dispatcher sees it */
+		rpmi_env_fence_release();
+		*(volatile rpmi_uint32_t *)&w->done = done + 1;
+	}
+
+	return done - start;
+}
+
+/**
+ * Visit one channel and process one request (in-place) or one batch of
+ * requests (copy) of it (called within a read-side section). Returns number
+ * of requests processed.
+ */
+static rpmi_uint32_t rpmi_context_process_channel(struct rpmi_context *cntx,
+						  struct rpmi_context_channel *chan,
+						  rpmi_uint32_t max_count,
+						  rpmi_bool_t wait)
+{
+	rpmi_uint32_t count;
+
+	/* Channel state must be visible before the channel is used */
+	if (!*(volatile rpmi_bool_t *)&chan->active)
+		return 0;
+	rpmi_env_fence_acquire();
+
+	/* Parked acknowledgements must be posted before new requests */
+	if (!rpmi_context_flush_acks(cntx, chan, wait))
+		return 0;
+
+	count = LIBRPMI_CONTEXT_BATCH_COUNT;
+	if (max_count)
+		count = RPMI_MIN(count, max_count);
+
+	/* Requests stay in the A2P queue while a work queue is full */
+	count = rpmi_context_worker_space(cntx, count, wait);
+	if (!count)
+		return 0;
+
+	/* Avoid copying requests only for trusted application processors */
+	if (rpmi_transport_has_peek_slot(chan->trans))
+		count = rpmi_context_process_inplace(cntx, chan) ? 1 : 0;
+	else
+		count = rpmi_context_process_batch(cntx, chan, count);
+	if (count)
+		rpmi_context_flush_acks(cntx, chan, wait);
+
+	return count;
+}
+
+static rpmi_uint32_t rpmi_context_process_channels(struct rpmi_context *cntx,
+						   rpmi_uint32_t max_count,
+						   rpmi_uint64_t deadline,
+						   rpmi_bool_t wait)
+{
+	rpmi_uint32_t i, e, count, num_channels, processed = 0;
+	struct rpmi_context_channel *chan;
+	rpmi_bool_t progress;
+
+	e = rpmi_context_read_lock(cntx);
+	rpmi_context_post_deferred(cntx, wait);
+	rpmi_context_post_workers(cntx, wait);
+	rpmi_context_read_unlock(cntx, e);
+
+	/*
+	 * Visit the channels in round-robin order where each visit processes
+	 * one request (in-place) or one batch of requests (copy) so that a
+	 * busy channel can't starve other channels. Each visit is a separate
+	 * read-side section so that add/remove only waits for the requests
+	 * in flight and not for the whole call.
+	 */
+	num_channels = *(volatile rpmi_uint32_t *)&cntx->num_channels;
+	do {
+		progress = false;
+		for (i = 0; i < num_channels; i++) {
+			if (max_count && processed >= max_count)
+				return processed;
+			if (deadline && rpmi_env_timer_value() >= deadline)
+				return processed;
+
+			if (cntx->next_channel >= num_channels)
+				cntx->next_channel = 0;
+			chan = &cntx->channels[cntx->next_channel++];
+
+			e = rpmi_context_read_lock(cntx);
+			count = rpmi_context_process_channel(cntx, chan,
+							     max_count ?
+							     max_count - processed : 0,
+							     wait);
+			rpmi_context_read_unlock(cntx, e);
+			if (!count)
+				continue;
+
+			processed += count;
+			progress = true;
+		}
+	} while (progress);
+
+	/* Requests may have been completed while they were deferred */
+	e = rpmi_context_read_lock(cntx);
+	rpmi_context_post_deferred(cntx, wait);
+	rpmi_context_read_unlock(cntx, e);
+
+	return processed;
+}
+
+static rpmi_uint32_t __rpmi_context_process_a2p_request(struct rpmi_context *cntx,
+							rpmi_uint32_t max_count,
+							rpmi_uint64_t deadline,
+							rpmi_bool_t wait)
+{
+	rpmi_uint32_t processed, bits, e;
+
+	processed = rpmi_context_process_channels(cntx, max_count,
+						  deadline, wait);
+
+	/* One P2A doorbell per channel for all acknowledgements posted by this call */
+	e = rpmi_context_read_lock(cntx);
+	bits = cntx->doorbell_coalesced;
+	cntx->doorbell_coalesced = 0;
+	while (bits) {
+		rpmi_context_ring_doorbell(cntx, __builtin_ctz(bits));
+		bits &= bits - 1;
+	}
+	rpmi_context_read_unlock(cntx, e);
+
+	return processed;
+}
+
+void rpmi_context_process_a2p_request(struct rpmi_context *cntx)
+{
+	if (!cntx) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return;
+	}
+
+	__rpmi_context_process_a2p_request(cntx, 0, 0, true);
+}
+
+rpmi_uint32_t rpmi_context_process_a2p_request_bounded(struct rpmi_context *cntx,
+						       rpmi_uint32_t max_count,
+						       rpmi_uint64_t deadline)
+{
+	if (!cntx) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return 0;
+	}
+
+	return __rpmi_context_process_a2p_request(cntx, max_count, deadline, false);
+}
+
+void rpmi_context_process_group_events(struct rpmi_context *cntx,
+				       rpmi_uint16_t servicegroup_id)
+{
+	struct rpmi_service_group *group;
+	struct rpmi_context_group *cgrp;
+	rpmi_uint32_t pos, e;
+	enum rpmi_error rc;
+
+	if (!cntx) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return;
+	}
+
+	e = rpmi_context_read_lock(cntx);
+
+	cgrp = rpmi_context_lookup_group(cntx, servicegroup_id, &pos);
+	if (!cgrp) {
+		DPRINTF("%s: %s: group not found for servicegroup_id 0x%x\n",
+			__func__, cntx->name, servicegroup_id);
+		goto done;
+	}
+	group = cgrp->group;
+	if (!group->process_events) {
+		DPRINTF("%s: %s: group %s does not support events\n",
+			__func__, cntx->name, group->name);
+		goto done;
+	}
+
+	rpmi_context_group_lock(group);
+	rc = group->process_events(group);
+	rpmi_context_group_unlock(group);
+	if (rc && rc != RPMI_ERR_BUSY) {
+		DPRINTF("%s: %s: group %s failed with error %d\n",
+			__func__, cntx->name, group->name, rc);
+	}
+
+done:
+	rpmi_context_read_unlock(cntx, e);
+}
+
+void rpmi_context_process_all_events(struct rpmi_context *cntx)
+{
+	struct rpmi_context_group **table;
+	struct rpmi_service_group *group;
+	rpmi_uint32_t i, bit, bits, *poll, e;
+	enum rpmi_error rc;
+
+	if (!cntx) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return;
+	}
+
+	e = rpmi_context_read_lock(cntx);
+	table = *(struct rpmi_context_group ** volatile *)&cntx->dispatch;
+	rpmi_env_fence_acquire();
+	poll = cntx->dispatch_poll[(table == cntx->dispatch_tables[0]) ? 0 : 1];
+
+	for (i = 0; i < cntx->dispatch_words; i++) {
+		bits = poll[i];
+		if (cntx->events_pending[i])
+			bits |= rpmi_env_atomic_xchg32(&cntx->events_pending[i], 0);
+
+		while (bits) {
+			bit = __builtin_ctz(bits);
+			bits &= bits - 1;
+
+			if (!table[i * RPMI_BITS_PER_WORD32 + bit])
+				continue;
+			group = table[i * RPMI_BITS_PER_WORD32 + bit]->group;
+			if (!group->process_events)
+				continue;
+
+			rpmi_context_group_lock(group);
+			rc = group->process_events(group);
+			rpmi_context_group_unlock(group);
+			if (rc == RPMI_SUCCESS)
+				continue;
+
+			/* Signalled group remains pending until events are processed */
+			if (group->flags & LIBRPMI_SERVICE_GROUP_FLAG_EVENTS_ON_SIGNAL)
+				rpmi_env_atomic_or32(&cntx->events_pending[i], 1U << bit);
+			if (rc != RPMI_ERR_BUSY) {
+				DPRINTF("%s: %s: group %s failed with error %d\n",
+					__func__, cntx->name, group->name, rc);
+			}
+		}
+	}
+	rpmi_context_read_unlock(cntx, e);
+}
+
+/*
+ * Rebuild the spare dispatch table without the slot being removed (if any),
+ * publish it and wait for the readers of the old table (called with
+ * groups_lock held)
+ */
+static void rpmi_context_rebuild_dispatch(struct rpmi_context *cntx,
+					  struct rpmi_context_group *removed)
+{
+	struct rpmi_context_group **table;
+	struct rpmi_service_group *group;
+	rpmi_uint32_t i, pos, *poll, *signalled;
+	int t;
+
+	t = (cntx->dispatch == cntx->dispatch_tables[0]) ? 1 : 0;
+	table = cntx->dispatch_tables[t];
+	poll = cntx->dispatch_poll[t];
+	signalled = poll + cntx->dispatch_words;
+	rpmi_env_memset(table, 0, (cntx->dispatch_mask + 1) * sizeof(*table));
+	rpmi_env_memset(poll, 0, 2 * cntx->dispatch_words * sizeof(*poll));
+
+	for (i = 0; i < cntx->max_num_groups; i++) {
+		group = cntx->groups[i].group;
+		if (!group || &cntx->groups[i] == removed)
+			continue;
+		pos = rpmi_context_dispatch_hash(cntx, group->servicegroup_id);
+		while (table[pos])
+			pos = (pos + 1) & cntx->dispatch_mask;
+		table[pos] = &cntx->groups[i];
+
+		if (!group->process_events)
+			continue;
+		if (group->flags & LIBRPMI_SERVICE_GROUP_FLAG_EVENTS_ON_SIGNAL)
+			signalled[pos / RPMI_BITS_PER_WORD32] |=
+					1U << (pos % RPMI_BITS_PER_WORD32);
+		else
+			poll[pos / RPMI_BITS_PER_WORD32] |=
+					1U << (pos % RPMI_BITS_PER_WORD32);
+	}
+
+	/* Table contents must be visible before the table itself */
+	rpmi_env_fence_release();
+	*(struct rpmi_context_group ** volatile *)&cntx->dispatch = table;
+
+	/*
+	 * Pending bits are indexed by the slots of the old table so signal
+	 * all groups of the new table once instead of translating them.
+	 */
+	for (i = 0; i < cntx->dispatch_words; i++) {
+		if (signalled[i])
+			rpmi_env_atomic_or32(&cntx->events_pending[i], signalled[i]);
+	}
+
+	/* Old table becomes the spare table once its readers are gone */
+	rpmi_context_synchronize(cntx);
+}
+
+enum rpmi_error rpmi_context_get_stats(struct rpmi_context *cntx,
+				       rpmi_uint16_t servicegroup_id,
+				       rpmi_uint8_t service_id,
+				       struct rpmi_service_stats *out_stats)
+{
+#ifdef LIBRPMI_STATS
+	struct rpmi_context_group *cgrp;
+	struct rpmi_service_stats *st;
+	enum rpmi_error rc = RPMI_SUCCESS;
+	rpmi_uint32_t i, pos, e;
+#endif
+
+	if (!cntx || !out_stats) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+#ifdef LIBRPMI_STATS
+	e = rpmi_context_read_lock(cntx);
+
+	cgrp = rpmi_context_lookup_group(cntx, servicegroup_id, &pos);
+	if (!cgrp || !cgrp->stats ||
+	    service_id >= RPMI_MAX(cgrp->group->max_service_id, 1)) {
+		rc = RPMI_ERR_INVALID_PARAM;
+		goto done;
+	}
+
+	rpmi_env_lock(cgrp->stats_lock);
+	if (service_id) {
+		rpmi_env_memcpy(out_stats, &cgrp->stats[service_id], sizeof(*out_stats));
+	} else {
+		/* Accumulate statistics of all services of the group */
+		rpmi_env_memset(out_stats, 0, sizeof(*out_stats));
+		for (i = 0; i < RPMI_MAX(cgrp->group->max_service_id, 1); i++) {
+			st = &cgrp->stats[i];
+			if (!st->requests)
+				continue;
+			if (!out_stats->requests || st->latency_min < out_stats->latency_min)
+				out_stats->latency_min = st->latency_min;
+			if (st->latency_max > out_stats->latency_max)
+				out_stats->latency_max = st->latency_max;
+			out_stats->latency_total += st->latency_total;
+			out_stats->requests += st->requests;
+			out_stats->errors += st->errors;
+			out_stats->notsupp += st->notsupp;
+		}
+	}
+	rpmi_env_unlock(cgrp->stats_lock);
+
+done:
+	rpmi_context_read_unlock(cntx, e);
+	return rc;
+#else
+	return RPMI_ERR_NOTSUPP;
+#endif
 }
 
 struct rpmi_service_group *rpmi_context_find_group(struct rpmi_context *cntx,
 						   rpmi_uint16_t servicegroup_id)
 {
-	struct rpmi_service_group *ret = NULL;
-	rpmi_uint32_t i;
+	struct rpmi_service_group *group;
+	struct rpmi_context_group *cgrp;
+	rpmi_uint32_t pos, e;
 
 	if (!cntx) {
 		DPRINTF("%s: invalid parameters\n", __func__);
 		return NULL;
 	}
 
-	rpmi_env_lock(cntx->groups_lock);
+	e = rpmi_context_read_lock(cntx);
+	cgrp = rpmi_context_lookup_group(cntx, servicegroup_id, &pos);
+	group = cgrp ? cgrp->group : NULL;
+	rpmi_context_read_unlock(cntx, e);
 
-	for (i = 0; i < cntx->num_groups; i++) {
-		if (cntx->groups[i]->servicegroup_id == servicegroup_id) {
-			ret = cntx->groups[i];
-			break;
-		}
+	return group;
+}
+
+enum rpmi_error rpmi_context_signal_group(struct rpmi_context *cntx,
+					  rpmi_uint16_t servicegroup_id)
+{
+	struct rpmi_context_group *cgrp;
+	enum rpmi_error rc = RPMI_SUCCESS;
+	rpmi_uint32_t pos, e;
+
+	if (!cntx) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
 	}
 
-	rpmi_env_unlock(cntx->groups_lock);
+	e = rpmi_context_read_lock(cntx);
+	cgrp = rpmi_context_lookup_group(cntx, servicegroup_id, &pos);
+	if (!cgrp)
+		rc = RPMI_ERR_INVALID_PARAM;
+	else if (!cgrp->group->process_events)
+		rc = RPMI_ERR_NOTSUPP;
+	else
+		rpmi_env_atomic_or32(&cntx->events_pending[pos / RPMI_BITS_PER_WORD32],
+				     1U << (pos % RPMI_BITS_PER_WORD32));
+	rpmi_context_read_unlock(cntx, e);
 
-	return ret;
+	return rc;
 }
 
 static enum rpmi_error rpmi_context_verify_privilege_level(struct rpmi_context *cntx,
@@ -514,7 +1906,8 @@ static enum rpmi_error rpmi_context_verify_privilege_level(struct rpmi_context *
 	if (!group->privilege_level_bitmap)
 		return RPMI_ERR_INVALID_PARAM;
 
-	if (group->privilege_level_bitmap & (1U << cntx->privilege_level))
+	/* Group must be accessible from at least one channel */
+	if (group->privilege_level_bitmap & cntx->privilege_level_bitmap)
 		return RPMI_SUCCESS;
 
 	return RPMI_ERR_DENIED;
@@ -523,6 +1916,7 @@ static enum rpmi_error rpmi_context_verify_privilege_level(struct rpmi_context *
 enum rpmi_error rpmi_context_add_group(struct rpmi_context *cntx,
 				       struct rpmi_service_group *group)
 {
+	struct rpmi_context_group *cgrp = NULL;
 	enum rpmi_error rc = RPMI_SUCCESS;
 	rpmi_uint32_t i;
 
@@ -533,15 +1927,16 @@ enum rpmi_error rpmi_context_add_group(struct rpmi_context *cntx,
 
 	rpmi_env_lock(cntx->groups_lock);
 
-	if (cntx->max_num_groups <= cntx->num_groups) {
-		DPRINTF("%s: %s: no space to add group %s\n",
-			__func__, cntx->name, group->name);
-		rc = RPMI_ERR_IO;
-		goto fail_unlock;
-	}
-
-	for (i = 0; i < cntx->num_groups; i++) {
-		if (cntx->groups[i] == group) {
+	for (i = 0; i < cntx->max_num_groups; i++) {
+		if (!cntx->groups[i].group) {
+			/* Requests of a removed group may still be queued */
+			if (!cgrp &&
+			    !*(volatile rpmi_uint32_t *)&cntx->groups[i].queued)
+				cgrp = &cntx->groups[i];
+			continue;
+		}
+		if (cntx->groups[i].group == group ||
+		    cntx->groups[i].group->servicegroup_id == group->servicegroup_id) {
 			DPRINTF("%s: %s: group %s alread added\n",
 				__func__, cntx->name, group->name);
 			rc = RPMI_ERR_ALREADY;
@@ -549,12 +1944,34 @@ enum rpmi_error rpmi_context_add_group(struct rpmi_context *cntx,
 		}
 	}
 
+	if (!cgrp) {
+		DPRINTF("%s: %s: no space to add group %s\n",
+			__func__, cntx->name, group->name);
+		rc = RPMI_ERR_IO;
+		goto fail_unlock;
+	}
+
 	rc = rpmi_context_verify_privilege_level(cntx, group);
 	if (rc)
 		goto fail_unlock;
 
-	cntx->groups[cntx->num_groups] = group;
+#ifdef LIBRPMI_STATS
+	cgrp->stats = rpmi_zalloc(RPMI_MAX(group->max_service_id, 1) *
+				  sizeof(*cgrp->stats));
+	if (!cgrp->stats) {
+		DPRINTF("%s: %s: group %s stats allocation failed\n",
+			__func__, cntx->name, group->name);
+		rc = RPMI_ERR_FAILED;
+		goto fail_unlock;
+	}
+	cgrp->stats_lock = rpmi_env_alloc_lock();
+#endif
+
+	cgrp->worker = 0;
+	cgrp->group = group;
 	cntx->num_groups++;
+	rpmi_env_atomic_add32(&group->num_contexts, 1);
+	rpmi_context_rebuild_dispatch(cntx, NULL);
 
 	if (group->servicegroup_id == RPMI_SRVGRP_SYSTEM_MSI)
 		cntx->sysmsi_group = group;
@@ -568,7 +1985,8 @@ fail_unlock:
 void rpmi_context_remove_group(struct rpmi_context *cntx,
 			       struct rpmi_service_group *group)
 {
-	rpmi_uint32_t i, j;
+	struct rpmi_context_group *cgrp;
+	rpmi_uint32_t i;
 
 	if (!cntx || !group) {
 		DPRINTF("%s: invalid parameters\n", __func__);
@@ -577,17 +1995,28 @@ void rpmi_context_remove_group(struct rpmi_context *cntx,
 
 	rpmi_env_lock(cntx->groups_lock);
 
-	for (i = 0; i < cntx->num_groups; i++) {
-		if (cntx->groups[i] != group)
+	for (i = 0; i < cntx->max_num_groups; i++) {
+		cgrp = &cntx->groups[i];
+		if (cgrp->group != group)
 			continue;
 
-		for (j = i; j < (cntx->num_groups - 1); j++)
-			cntx->groups[j] = cntx->groups[j + 1];
-
-		cntx->num_groups--;
-		cntx->groups[cntx->num_groups] = NULL;
 		if (group->servicegroup_id == RPMI_SRVGRP_SYSTEM_MSI)
 			cntx->sysmsi_group = NULL;
+		cntx->num_groups--;
+
+		/* Slot state is released once no reader can see the slot */
+		rpmi_context_rebuild_dispatch(cntx, cgrp);
+		cgrp->group = NULL;
+		if (cgrp->stats) {
+			rpmi_free(cgrp->stats);
+			cgrp->stats = NULL;
+		}
+		if (cgrp->stats_lock) {
+			rpmi_env_free_lock(cgrp->stats_lock);
+			cgrp->stats_lock = NULL;
+		}
+		cgrp->worker = 0;
+		rpmi_env_atomic_add32(&group->num_contexts, -1);
 
 		break;
 	}
@@ -595,6 +2024,201 @@ void rpmi_context_remove_group(struct rpmi_context *cntx,
 	rpmi_env_unlock(cntx->groups_lock);
 }
 
+/* Update the union of channel privilege levels (called with groups_lock held) */
+static void rpmi_context_update_privilege_levels(struct rpmi_context *cntx)
+{
+	rpmi_uint32_t i;
+
+	cntx->privilege_level_bitmap = 0;
+	for (i = 0; i < cntx->num_channels; i++) {
+		if (cntx->channels[i].trans)
+			cntx->privilege_level_bitmap |=
+				1U << cntx->channels[i].privilege_level;
+	}
+}
+
+enum rpmi_error rpmi_context_add_transport(struct rpmi_context *cntx,
+					   struct rpmi_transport *trans,
+					   enum rpmi_privilege_level privilege_level,
+					   rpmi_uint32_t p2a_msi_index)
+{
+	struct rpmi_base_group *base;
+	struct rpmi_context_channel *chan;
+	struct rpmi_message *ack_msgs;
+	rpmi_uint32_t i;
+
+	if (!cntx || !trans || privilege_level >= RPMI_PRIVILEGE_LEVEL_MAX_IDX) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	if (!rpmi_context_endian_supported(trans)) {
+		DPRINTF("%s: %s: big-endian transport %s not supported\n",
+			__func__, cntx->name, trans->name);
+		return RPMI_ERR_NOTSUPP;
+	}
+
+	/*
+	 * Request and deferred acknowledgement buffers are sized using the
+	 * primary transport so secondary slots can't be bigger. The platform
+	 * info must also fit in a message of the secondary transport.
+	 */
+	base = cntx->base_group->priv;
+	if (rpmi_transport_slot_size(trans) >
+			rpmi_transport_slot_size(cntx->channels[0].trans) ||
+	    base->plat_info_len > (RPMI_MSG_DATA_SIZE(rpmi_transport_slot_size(trans)) -
+					(2 * sizeof(rpmi_uint32_t)))) {
+		DPRINTF("%s: %s: transport %s slot size %lu not supported\n",
+			__func__, cntx->name, trans->name,
+			rpmi_transport_slot_size(trans));
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	ack_msgs = rpmi_zalloc(LIBRPMI_CONTEXT_BATCH_COUNT * rpmi_transport_slot_size(trans));
+	if (!ack_msgs) {
+		DPRINTF("%s: %s: acknowledgment message allocation failed\n",
+			__func__, cntx->name);
+		return RPMI_ERR_FAILED;
+	}
+
+	rpmi_env_lock(cntx->groups_lock);
+
+	if (rpmi_context_find_channel(cntx, trans)) {
+		rpmi_env_unlock(cntx->groups_lock);
+		rpmi_free(ack_msgs);
+		return RPMI_ERR_ALREADY;
+	}
+
+	/* Slots of removed channels are reused before new slots */
+	for (i = 0; i < cntx->num_channels; i++) {
+		if (!cntx->channels[i].trans)
+			break;
+	}
+	if (i >= LIBRPMI_CONTEXT_MAX_CHANNELS) {
+		rpmi_env_unlock(cntx->groups_lock);
+		rpmi_free(ack_msgs);
+		DPRINTF("%s: %s: too many transports\n", __func__, cntx->name);
+		return RPMI_ERR_FAILED;
+	}
+
+	chan = &cntx->channels[i];
+	rpmi_env_memset(chan, 0, sizeof(*chan));
+	chan->trans = trans;
+	chan->privilege_level = privilege_level;
+	chan->p2a_msi_index = p2a_msi_index;
+	chan->ack_msgs = ack_msgs;
+
+	/* Channel state must be visible before the request processing uses it */
+	rpmi_env_fence_release();
+	*(volatile rpmi_bool_t *)&chan->active = true;
+	if (i == cntx->num_channels)
+		*(volatile rpmi_uint32_t *)&cntx->num_channels = i + 1;
+
+	/* New slot is only covered once num_channels includes it */
+	rpmi_context_update_privilege_levels(cntx);
+
+	rpmi_env_unlock(cntx->groups_lock);
+
+	return RPMI_SUCCESS;
+}
+
+/*
+ * Check if deferred or worker requests of a channel are not yet acknowledged
+ * (called with groups_lock held once the request processing can't see the
+ * channel anymore)
+ */
+static rpmi_bool_t rpmi_context_channel_busy(struct rpmi_context *cntx,
+					     struct rpmi_context_channel *chan)
+{
+	rpmi_uint32_t i, pos, head, channel = chan - cntx->channels;
+	struct rpmi_context_worker *w;
+	rpmi_bool_t busy = false;
+
+	rpmi_env_lock(cntx->deferred_lock);
+	for (i = 0; i < LIBRPMI_CONTEXT_MAX_DEFERRED; i++) {
+		if (cntx->deferred[i].state != RPMI_DEFERRED_FREE &&
+		    cntx->deferred[i].channel == channel) {
+			busy = true;
+			break;
+		}
+	}
+	rpmi_env_unlock(cntx->deferred_lock);
+	if (busy) {
+		DPRINTF("%s: %s: transport %s has deferred requests\n",
+			__func__, cntx->name, chan->trans->name);
+		return true;
+	}
+
+	/* No new work of the channel is queued so only the tail moves */
+	for (i = 0; i < LIBRPMI_CONTEXT_MAX_WORKERS; i++) {
+		w = &cntx->workers[i];
+		if (!w->queue)
+			continue;
+		head = *(volatile rpmi_uint32_t *)&w->head;
+		for (pos = *(volatile rpmi_uint32_t *)&w->tail; pos != head; pos++) {
+			if (w->queue[pos & (LIBRPMI_CONTEXT_WORKER_QUEUE_LEN - 1)].trans ==
+								chan->trans) {
+				DPRINTF("%s: %s: transport %s has queued worker requests\n",
+					__func__, cntx->name, chan->trans->name);
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+enum rpmi_error rpmi_context_remove_transport(struct rpmi_context *cntx,
+					      struct rpmi_transport *trans)
+{
+	struct rpmi_context_channel *chan;
+	enum rpmi_error rc = RPMI_SUCCESS;
+
+	if (!cntx || !trans) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	rpmi_env_lock(cntx->groups_lock);
+
+	chan = rpmi_context_find_channel(cntx, trans);
+	if (!chan) {
+		DPRINTF("%s: %s: transport %s not found\n",
+			__func__, cntx->name, trans->name);
+		rc = RPMI_ERR_INVALID_PARAM;
+		goto done;
+	}
+	if (chan == &cntx->channels[0]) {
+		DPRINTF("%s: %s: can't remove primary transport %s\n",
+			__func__, cntx->name, trans->name);
+		rc = RPMI_ERR_DENIED;
+		goto done;
+	}
+
+	/*
+	 * Stop processing the channel and wait for the readers which may
+	 * still use it so that no request of the channel is in flight.
+	 */
+	*(volatile rpmi_bool_t *)&chan->active = false;
+	rpmi_context_synchronize(cntx);
+
+	if (rpmi_context_channel_busy(cntx, chan)) {
+		*(volatile rpmi_bool_t *)&chan->active = true;
+		rc = RPMI_ERR_BUSY;
+		goto done;
+	}
+
+	/* Parked acknowledgements are dropped along with the channel */
+	rpmi_free(chan->ack_msgs);
+	chan->ack_msgs = NULL;
+	chan->trans = NULL;
+	rpmi_context_update_privilege_levels(cntx);
+
+done:
+	rpmi_env_unlock(cntx->groups_lock);
+	return rc;
+}
+
 struct rpmi_context *rpmi_context_create(const char *name,
 					 struct rpmi_transport *trans,
 					 rpmi_uint32_t max_num_groups,
@@ -604,6 +2228,7 @@ struct rpmi_context *rpmi_context_create(const char *name,
 {
 	struct rpmi_context *cntx;
 	enum rpmi_error rc;
+	rpmi_uint32_t i;
 
 	if (!name || !trans || !max_num_groups ||
 			privilege_level >= RPMI_PRIVILEGE_LEVEL_MAX_IDX) {
@@ -616,45 +2241,99 @@ struct rpmi_context *rpmi_context_create(const char *name,
 		return NULL;
 	}
 
-	cntx = rpmi_env_zalloc(sizeof(*cntx));
+	if (!rpmi_context_endian_supported(trans)) {
+		DPRINTF("%s: %s: big-endian transport %s not supported\n",
+			__func__, name, trans->name);
+		return NULL;
+	}
+
+	cntx = rpmi_zalloc(sizeof(*cntx));
 	if (!cntx) {
 		DPRINTF("%s: %s: context allocation failed\n", __func__, name);
 		return NULL;
 	}
 
 	cntx->name = name;
-	cntx->trans = trans;
 	cntx->max_num_groups = max_num_groups;
-	cntx->privilege_level = privilege_level;
+	cntx->channels[0].trans = trans;
+	cntx->channels[0].active = true;
+	cntx->channels[0].privilege_level = privilege_level;
+	cntx->channels[0].p2a_msi_index = LIBRPMI_CONTEXT_NO_P2A_MSI;
+	cntx->num_channels = 1;
+	cntx->privilege_level_bitmap = 1U << privilege_level;
 
 	/**
-	 * Allocate for the array of pointers to the service
+	 * Allocate for the array of slots of the service
 	 * groups instances which are assigned to the context
 	 */
-	cntx->groups = rpmi_env_zalloc(cntx->max_num_groups * sizeof(*cntx->groups));
+	cntx->groups = rpmi_zalloc(cntx->max_num_groups * sizeof(*cntx->groups));
 	if (!cntx->groups) {
 		DPRINTF("%s: %s: groups array allocation failed\n", __func__, name);
 		goto fail_free_cntx;
 	}
 
+	/**
+	 * Dispatch table size is a power of 2 which is at least twice the
+	 * maximum number of groups to keep the probe sequences short
+	 */
+	cntx->dispatch_mask = 1;
+	while (cntx->dispatch_mask < (2 * max_num_groups))
+		cntx->dispatch_mask <<= 1;
+	cntx->dispatch_tables[0] = rpmi_zalloc(2 * cntx->dispatch_mask *
+						   sizeof(*cntx->dispatch));
+	if (!cntx->dispatch_tables[0]) {
+		DPRINTF("%s: %s: dispatch table allocation failed\n", __func__, name);
+		goto fail_free_groups_array;
+	}
+	cntx->dispatch_tables[1] = cntx->dispatch_tables[0] + cntx->dispatch_mask;
+	cntx->dispatch = cntx->dispatch_tables[0];
+
+	/**
+	 * Per table poll bitmaps (each followed by scratch space used by
+	 * the rebuild) and the pending events bitmap
+	 */
+	cntx->dispatch_words = RPMI_BITMAP_WORDS32(cntx->dispatch_mask);
+	cntx->dispatch_poll[0] = rpmi_zalloc(5 * cntx->dispatch_words *
+						 sizeof(rpmi_uint32_t));
+	if (!cntx->dispatch_poll[0]) {
+		DPRINTF("%s: %s: events bitmap allocation failed\n", __func__, name);
+		goto fail_free_dispatch;
+	}
+	cntx->dispatch_poll[1] = cntx->dispatch_poll[0] + 2 * cntx->dispatch_words;
+	cntx->events_pending = cntx->dispatch_poll[1] + 2 * cntx->dispatch_words;
+	cntx->dispatch_mask--;
+
 	cntx->groups_lock = rpmi_env_alloc_lock();
 
-	cntx->req_msg = rpmi_env_zalloc(trans->slot_size);
-	if (!cntx->req_msg) {
+	cntx->req_msgs = rpmi_zalloc(LIBRPMI_CONTEXT_BATCH_COUNT * rpmi_transport_slot_size(trans));
+	if (!cntx->req_msgs) {
 		DPRINTF("%s: %s: request message allocation failed\n", __func__, name);
 		goto fail_free_groups;
 	}
 
-	cntx->ack_msg = rpmi_env_zalloc(trans->slot_size);
-	if (!cntx->ack_msg) {
+	cntx->channels[0].ack_msgs =
+		rpmi_zalloc(LIBRPMI_CONTEXT_BATCH_COUNT * rpmi_transport_slot_size(trans));
+	if (!cntx->channels[0].ack_msgs) {
 		DPRINTF("%s: %s: acknowledgment message allocation failed\n", __func__, name);
 		goto fail_free_req_msg;
 	}
 
+	cntx->deferred[0].ack_msg = rpmi_zalloc(LIBRPMI_CONTEXT_MAX_DEFERRED *
+						    rpmi_transport_slot_size(trans));
+	if (!cntx->deferred[0].ack_msg) {
+		DPRINTF("%s: %s: deferred message allocation failed\n", __func__, name);
+		goto fail_free_ack_msg;
+	}
+	for (i = 1; i < LIBRPMI_CONTEXT_MAX_DEFERRED; i++)
+		cntx->deferred[i].ack_msg =
+			rpmi_transport_batch_msg(trans, cntx->deferred[0].ack_msg, i);
+
+	cntx->deferred_lock = rpmi_env_alloc_lock();
+
 	cntx->base_group = rpmi_base_group_create(cntx, plat_info_len, plat_info);
 	if (!cntx->base_group) {
 		DPRINTF("%s: %s: base group creation failed\n", __func__, name);
-		goto fail_free_ack_msg;
+		goto fail_free_deferred;
 	}
 
 	rc = rpmi_context_add_group(cntx, cntx->base_group);
@@ -667,20 +2346,29 @@ struct rpmi_context *rpmi_context_create(const char *name,
 
 fail_destroy_base:
 	rpmi_base_group_destroy(cntx->base_group);
+fail_free_deferred:
+	rpmi_env_free_lock(cntx->deferred_lock);
+	rpmi_free(cntx->deferred[0].ack_msg);
 fail_free_ack_msg:
-	rpmi_env_free(cntx->ack_msg);
+	rpmi_free(cntx->channels[0].ack_msgs);
 fail_free_req_msg:
-	rpmi_env_free(cntx->req_msg);
+	rpmi_free(cntx->req_msgs);
 fail_free_groups:
 	rpmi_env_free_lock(cntx->groups_lock);
-	rpmi_env_free(cntx->groups);
+	rpmi_free(cntx->dispatch_poll[0]);
+fail_free_dispatch:
+	rpmi_free(cntx->dispatch_tables[0]);
+fail_free_groups_array:
+	rpmi_free(cntx->groups);
 fail_free_cntx:
-	rpmi_env_free(cntx);
+	rpmi_free(cntx);
 	return NULL;
 }
 
 void rpmi_context_destroy(struct rpmi_context *cntx)
 {
+	rpmi_uint32_t i;
+
 	if (cntx->num_groups > 1) {
 		DPRINTF("%s: %s: failed to destroy\n", __func__, cntx->name);
 		return;
@@ -689,9 +2377,23 @@ void rpmi_context_destroy(struct rpmi_context *cntx)
 	rpmi_context_remove_group(cntx, cntx->base_group);
 	rpmi_base_group_destroy(cntx->base_group);
 
-	rpmi_env_free(cntx->ack_msg);
-	rpmi_env_free(cntx->req_msg);
+	for (i = 0; i < LIBRPMI_CONTEXT_MAX_WORKERS; i++) {
+		if (!cntx->workers[i].queue)
+			continue;
+		rpmi_free(cntx->workers[i].msgs);
+		rpmi_free(cntx->workers[i].queue);
+	}
+
+	rpmi_env_free_lock(cntx->deferred_lock);
+	rpmi_free(cntx->deferred[0].ack_msg);
+	for (i = 0; i < cntx->num_channels; i++) {
+		if (cntx->channels[i].trans)
+			rpmi_free(cntx->channels[i].ack_msgs);
+	}
+	rpmi_free(cntx->req_msgs);
 	rpmi_env_free_lock(cntx->groups_lock);
-	rpmi_env_free(cntx->groups);
-	rpmi_env_free(cntx);
+	rpmi_free(cntx->dispatch_poll[0]);
+	rpmi_free(cntx->dispatch_tables[0]);
+	rpmi_free(cntx->groups);
+	rpmi_free(cntx);
 }
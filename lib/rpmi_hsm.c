@@ -5,6 +5,7 @@
  */
 
 #include <librpmi.h>
+#include "librpmi_internal.h"
 
 #undef DEBUG
 
@@ -29,10 +30,40 @@ struct rpmi_hsm_hart {
 	rpmi_uint64_t resume_addr;
 };
 
+/** Flattened hart table entry of a HSM instance */
+struct rpmi_hsm_hart_map {
+	/** Leaf HSM instance managing the hart */
+	struct rpmi_hsm *leaf;
+
+	/** Hart index relative to the leaf HSM instance */
+	rpmi_uint32_t leaf_index;
+
+	/** Hart ID */
+	rpmi_uint32_t hart_id;
+};
+
 struct rpmi_hsm {
 	/** Whether HSM instance is non-leaf (or hierarchical) instance */
 	rpmi_bool_t is_non_leaf;
 
+	/** Total number of harts managed by this instance */
+	rpmi_uint32_t hart_count;
+
+	/** Arena selected when the instance was created (for the tables) */
+	struct rpmi_arena *arena;
+
+	/** Flattened hart table indexed by hart index */
+	struct rpmi_hsm_hart_map *hart_map;
+
+	/** Hart indexes sorted by hart ID (for binary search) */
+	rpmi_uint32_t *sorted_index;
+
+	/**
+	 * Hart IDs indexed by hart index followed by suspend types indexed
+	 * by suspend type index as little-endian words (for list services)
+	 */
+	rpmi_uint32_t *table_le;
+
 	union {
 		/** Details required by leaf instance */
 		struct {
@@ -45,6 +76,12 @@ struct rpmi_hsm {
 			/** Array of harts */
 			struct rpmi_hsm_hart *harts;
 
+			/**
+			 * Bitmap of harts whose HW state must be checked by
+			 * rpmi_hsm_process_state_changes() (updated atomically)
+			 */
+			volatile rpmi_uint32_t *pending;
+
 			/** Number of suspend types */
 			rpmi_uint32_t suspend_type_count;
 
@@ -75,86 +112,73 @@ struct rpmi_hsm {
 
 rpmi_uint32_t rpmi_hsm_hart_count(struct rpmi_hsm *hsm)
 {
-	struct rpmi_hsm *child_hsm;
-	rpmi_uint32_t i, ret;
-
 	if (!hsm)
 		return 0;
 
-	if (!hsm->is_non_leaf)
-		return hsm->leaf.hart_count;
-
-	ret = 0;
-	for (i = 0; i < hsm->nonleaf.child_count; i++) {
-		child_hsm = hsm->nonleaf.child_array[i];
-		ret += rpmi_hsm_hart_count(child_hsm);
-	}
-
-	return ret;
-}
-
-static struct rpmi_hsm *rpmi_hsm_hart_index2child(struct rpmi_hsm *hsm,
-						  rpmi_uint32_t hart_index,
-						  rpmi_uint32_t *child_rel_index_ptr)
-{
-	rpmi_uint32_t i, count, child_rel_index;
-	struct rpmi_hsm *child_hsm;
-
-	if (!hsm->is_non_leaf)
-		return NULL;
-
-	child_rel_index = 0;
-	for (i = 0; i < hsm->nonleaf.child_count; i++) {
-		child_hsm = hsm->nonleaf.child_array[i];
-
-		count = rpmi_hsm_hart_count(child_hsm);
-		if (child_rel_index <= hart_index &&
-		    hart_index < (child_rel_index + count)) {
-			if (child_rel_index_ptr)
-				*child_rel_index_ptr = child_rel_index;
-			return child_hsm;
-		}
-
-		child_rel_index += count;
-	}
-
-	return NULL;
+	return hsm->hart_count;
 }
 
 rpmi_uint32_t rpmi_hsm_hart_index2id(struct rpmi_hsm *hsm, rpmi_uint32_t hart_index)
 {
-	rpmi_uint32_t child_rel_index;
-	struct rpmi_hsm *child_hsm;
-
-	if (!hsm || rpmi_hsm_hart_count(hsm) <= hart_index)
+	if (!hsm || hsm->hart_count <= hart_index)
 		return LIBRPMI_HSM_INVALID_HART_ID;
 
-	if (!hsm->is_non_leaf)
-		return hsm->leaf.hart_ids[hart_index];
+	return hsm->hart_map[hart_index].hart_id;
+}
 
-	child_hsm = rpmi_hsm_hart_index2child(hsm, hart_index, &child_rel_index);
-	if (child_hsm)
-		return rpmi_hsm_hart_index2id(child_hsm, hart_index - child_rel_index);
+const rpmi_uint32_t *rpmi_hsm_hart_id_table_le(struct rpmi_hsm *hsm)
+{
+	return hsm->table_le;
+}
 
-	return LIBRPMI_HSM_INVALID_HART_ID;
+const rpmi_uint32_t *rpmi_hsm_suspend_type_table_le(struct rpmi_hsm *hsm)
+{
+	return hsm->table_le + hsm->hart_count;
 }
 
 rpmi_uint32_t rpmi_hsm_hart_id2index(struct rpmi_hsm *hsm, rpmi_uint32_t hart_id)
 {
-	rpmi_uint32_t i, hart_count;
+	rpmi_uint32_t lo, hi, mid;
 
 	if (!hsm)
 		return LIBRPMI_HSM_INVALID_HART_INDEX;
 
-	hart_count = rpmi_hsm_hart_count(hsm);
-	for (i = 0; i < hart_count; i++) {
-		if (rpmi_hsm_hart_index2id(hsm, i) == hart_id)
-			return i;
+	/* Find the first entry with hart ID not less than the given hart ID */
+	lo = 0;
+	hi = hsm->hart_count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (hsm->hart_map[hsm->sorted_index[mid]].hart_id < hart_id)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
 
+	if (lo < hsm->hart_count &&
+	    hsm->hart_map[hsm->sorted_index[lo]].hart_id == hart_id)
+		return hsm->sorted_index[lo];
+
 	return LIBRPMI_HSM_INVALID_HART_INDEX;
 }
 
+/**
+ * Find the leaf HSM instance and the leaf relative hart index of a hart ID
+ * using the flattened tables so hierarchical instances are not traversed.
+ */
+static struct rpmi_hsm *rpmi_hsm_hart_id2leaf(struct rpmi_hsm *hsm,
+					      rpmi_uint32_t hart_id,
+					      rpmi_uint32_t *leaf_index_ptr)
+{
+	rpmi_uint32_t hart_index;
+
+	hart_index = rpmi_hsm_hart_id2index(hsm, hart_id);
+	if (hart_index == LIBRPMI_HSM_INVALID_HART_INDEX)
+		return NULL;
+
+	*leaf_index_ptr = hsm->hart_map[hart_index].leaf_index;
+	return hsm->hart_map[hart_index].leaf;
+}
+
 rpmi_uint32_t rpmi_hsm_get_suspend_type_count(struct rpmi_hsm *hsm)
 {
 	if (!hsm)
@@ -199,10 +223,31 @@ const struct rpmi_hsm_suspend_type *rpmi_hsm_find_suspend_type(struct rpmi_hsm *
 	return NULL;
 }
 
+/* Mark a hart of a leaf instance for HW state check */
+static inline void rpmi_hsm_hart_set_pending(struct rpmi_hsm *hsm,
+					     rpmi_uint32_t hart_index)
+{
+	rpmi_env_atomic_or32(&hsm->leaf.pending[hart_index / RPMI_BITS_PER_WORD32],
+			     1U << (hart_index % RPMI_BITS_PER_WORD32));
+}
+
+/* Check if a hart state waits for a HW state change */
+static inline rpmi_bool_t rpmi_hsm_hart_state_is_transient(enum rpmi_hsm_hart_state state)
+{
+	switch (state) {
+	case RPMI_HSM_HART_STATE_STARTED:
+	case RPMI_HSM_HART_STATE_STOPPED:
+		return false;
+	default:
+		return true;
+	}
+}
+
 static void __rpmi_hsm_process_hart_state_changes(struct rpmi_hsm *hsm,
 						  struct rpmi_hsm_hart *hart,
 						  rpmi_uint32_t hart_index)
 {
+	enum rpmi_hsm_hart_state old_state = hart->state;
 	enum rpmi_hart_hw_state hw_state;
 
 	if (hsm->is_non_leaf)
@@ -257,13 +302,22 @@ static void __rpmi_hsm_process_hart_state_changes(struct rpmi_hsm *hsm,
 			break;
 		}
 	}
+
+	/* Unknown initial state is traced as old state 0xffff */
+	if (hart->state != old_state)
+		rpmi_trace(RPMI_TRACE_EVENT_HSM_STATE, hart->state,
+			   (rpmi_uint16_t)old_state,
+			   hsm->leaf.hart_ids[hart_index]);
+
+	/* Pending and suspended harts are checked again later */
+	if (rpmi_hsm_hart_state_is_transient(hart->state))
+		rpmi_hsm_hart_set_pending(hsm, hart_index);
 }
 
 enum rpmi_error rpmi_hsm_hart_start(struct rpmi_hsm *hsm, rpmi_uint32_t hart_id,
 				    rpmi_uint64_t start_addr)
 {
 	struct rpmi_hsm_hart *hart;
-	struct rpmi_hsm *child_hsm;
 	rpmi_uint32_t hart_index;
 	enum rpmi_error ret;
 
@@ -272,17 +326,12 @@ enum rpmi_error rpmi_hsm_hart_start(struct rpmi_hsm *hsm, rpmi_uint32_t hart_id,
 		return RPMI_ERR_INVALID_PARAM;
 	}
 
-	hart_index = rpmi_hsm_hart_id2index(hsm, hart_id);
-	if (hart_index == LIBRPMI_HSM_INVALID_HART_INDEX) {
+	hsm = rpmi_hsm_hart_id2leaf(hsm, hart_id, &hart_index);
+	if (!hsm) {
 		DPRINTF("%s: invalid hart_id 0x%x\n", __func__, hart_id);
 		return RPMI_ERR_INVALID_PARAM;
 	}
 
-	if (hsm->is_non_leaf) {
-		child_hsm = rpmi_hsm_hart_index2child(hsm, hart_index, NULL);
-		return rpmi_hsm_hart_start(child_hsm, hart_id, start_addr);
-	}
-
 	if (!hsm->leaf.ops->hart_start_prepare || !hsm->leaf.ops->hart_start_finalize) {
 		DPRINTF("%s: not supported\n", __func__);
 		return RPMI_ERR_NOTSUPP;
@@ -327,7 +376,6 @@ enum rpmi_error rpmi_hsm_hart_start(struct rpmi_hsm *hsm, rpmi_uint32_t hart_id,
 enum rpmi_error rpmi_hsm_hart_stop(struct rpmi_hsm *hsm, rpmi_uint32_t hart_id)
 {
 	struct rpmi_hsm_hart *hart;
-	struct rpmi_hsm *child_hsm;
 	rpmi_uint32_t hart_index;
 	enum rpmi_error ret;
 
@@ -336,17 +384,12 @@ enum rpmi_error rpmi_hsm_hart_stop(struct rpmi_hsm *hsm, rpmi_uint32_t hart_id)
 		return RPMI_ERR_INVALID_PARAM;
 	}
 
-	hart_index = rpmi_hsm_hart_id2index(hsm, hart_id);
-	if (hart_index == LIBRPMI_HSM_INVALID_HART_INDEX) {
+	hsm = rpmi_hsm_hart_id2leaf(hsm, hart_id, &hart_index);
+	if (!hsm) {
 		DPRINTF("%s: invalid hart_id 0x%x\n", __func__, hart_id);
 		return RPMI_ERR_INVALID_PARAM;
 	}
 
-	if (hsm->is_non_leaf) {
-		child_hsm = rpmi_hsm_hart_index2child(hsm, hart_index, NULL);
-		return rpmi_hsm_hart_stop(child_hsm, hart_id);
-	}
-
 	if (!hsm->leaf.ops->hart_stop_prepare || !hsm->leaf.ops->hart_stop_finalize) {
 		DPRINTF("%s: not supported\n", __func__);
 		return RPMI_ERR_NOTSUPP;
@@ -392,7 +435,6 @@ enum rpmi_error rpmi_hsm_hart_suspend(struct rpmi_hsm *hsm, rpmi_uint32_t hart_i
 				rpmi_uint64_t resume_addr)
 {
 	struct rpmi_hsm_hart *hart;
-	struct rpmi_hsm *child_hsm;
 	rpmi_uint32_t hart_index;
 	enum rpmi_error ret;
 
@@ -401,18 +443,12 @@ enum rpmi_error rpmi_hsm_hart_suspend(struct rpmi_hsm *hsm, rpmi_uint32_t hart_i
 		return RPMI_ERR_INVALID_PARAM;
 	}
 
-	hart_index = rpmi_hsm_hart_id2index(hsm, hart_id);
-	if (hart_index == LIBRPMI_HSM_INVALID_HART_INDEX) {
+	hsm = rpmi_hsm_hart_id2leaf(hsm, hart_id, &hart_index);
+	if (!hsm) {
 		DPRINTF("%s: invalid hart_id 0x%x\n", __func__, hart_id);
 		return RPMI_ERR_INVALID_PARAM;
 	}
 
-	if (hsm->is_non_leaf) {
-		child_hsm = rpmi_hsm_hart_index2child(hsm, hart_index, NULL);
-		return rpmi_hsm_hart_suspend(child_hsm, hart_id, suspend_type,
-					     resume_addr);
-	}
-
 	if (!hsm->leaf.ops->hart_suspend_prepare || !hsm->leaf.ops->hart_suspend_finalize) {
 		DPRINTF("%s: not supported\n", __func__);
 		return RPMI_ERR_NOTSUPP;
@@ -459,7 +495,6 @@ enum rpmi_error rpmi_hsm_hart_suspend(struct rpmi_hsm *hsm, rpmi_uint32_t hart_i
 int rpmi_hsm_get_hart_state(struct rpmi_hsm *hsm, rpmi_uint32_t hart_id)
 {
 	enum rpmi_hsm_hart_state state;
-	struct rpmi_hsm *child_hsm;
 	struct rpmi_hsm_hart *hart;
 	rpmi_uint32_t hart_index;
 
@@ -468,17 +503,12 @@ int rpmi_hsm_get_hart_state(struct rpmi_hsm *hsm, rpmi_uint32_t hart_id)
 		return RPMI_ERR_INVALID_PARAM;
 	}
 
-	hart_index = rpmi_hsm_hart_id2index(hsm, hart_id);
-	if (hart_index == LIBRPMI_HSM_INVALID_HART_INDEX) {
+	hsm = rpmi_hsm_hart_id2leaf(hsm, hart_id, &hart_index);
+	if (!hsm) {
 		DPRINTF("%s: invalid hart_id 0x%x\n", __func__, hart_id);
 		return RPMI_ERR_INVALID_PARAM;
 	}
 
-	if (hsm->is_non_leaf) {
-		child_hsm = rpmi_hsm_hart_index2child(hsm, hart_index, NULL);
-		return rpmi_hsm_get_hart_state(child_hsm, hart_id);
-	}
-
 	hart = &hsm->leaf.harts[hart_index];
 	rpmi_env_lock(hart->lock);
 	state = hart->state;
@@ -487,11 +517,224 @@ int rpmi_hsm_get_hart_state(struct rpmi_hsm *hsm, rpmi_uint32_t hart_id)
 	return state;
 }
 
-void rpmi_hsm_process_state_changes(struct rpmi_hsm *hsm)
+/**
+ * Start or stop a set of harts of a leaf HSM instance where bit N of the
+ * mask represents the leaf relative hart index (base_index + N). Returns
+ * the mask of harts which failed.
+ */
+static rpmi_uint32_t rpmi_hsm_leaf_mask_op(struct rpmi_hsm *hsm,
+					   rpmi_uint32_t base_index,
+					   rpmi_uint32_t mask,
+					   rpmi_bool_t start,
+					   rpmi_uint64_t start_addr,
+					   enum rpmi_error *ret_ptr)
+{
+	const struct rpmi_hsm_platform_ops *ops = hsm->leaf.ops;
+	rpmi_uint32_t i, bit, bits, fail_mask = 0;
+	enum rpmi_hsm_hart_state from_state, to_state, pending_state;
+	struct rpmi_hsm_hart *hart;
+	enum rpmi_error ret;
+
+	if ((start && (!ops->hart_start_prepare || !ops->hart_start_finalize)) ||
+	    (!start && (!ops->hart_stop_prepare || !ops->hart_stop_finalize))) {
+		*ret_ptr = RPMI_ERR_NOTSUPP;
+		return mask;
+	}
+
+	/* Locks are taken in ascending hart index order */
+	from_state = start ? RPMI_HSM_HART_STATE_STOPPED : RPMI_HSM_HART_STATE_STARTED;
+	to_state = start ? RPMI_HSM_HART_STATE_STARTED : RPMI_HSM_HART_STATE_STOPPED;
+	pending_state = start ? RPMI_HSM_HART_STATE_START_PENDING :
+				RPMI_HSM_HART_STATE_STOP_PENDING;
+	for (bits = mask; bits; bits &= bits - 1) {
+		bit = __builtin_ctz(bits);
+		hart = &hsm->leaf.harts[base_index + bit];
+		rpmi_env_lock(hart->lock);
+		if (hart->state != from_state) {
+			*ret_ptr = (hart->state == to_state || hart->state == pending_state) ?
+						RPMI_ERR_ALREADY : RPMI_ERR_DENIED;
+			rpmi_env_unlock(hart->lock);
+			fail_mask |= 1U << bit;
+		}
+	}
+	mask &= ~fail_mask;
+	if (!mask)
+		return fail_mask;
+
+	/* Prepare all harts with one platform call if possible */
+	ret = RPMI_ERR_NOTSUPP;
+	if (start && ops->hart_start_prepare_multi)
+		ret = ops->hart_start_prepare_multi(hsm->leaf.ops_priv, base_index,
+						    mask, start_addr);
+	else if (!start && ops->hart_stop_prepare_multi)
+		ret = ops->hart_stop_prepare_multi(hsm->leaf.ops_priv, base_index, mask);
+	if (ret == RPMI_ERR_NOTSUPP) {
+		ret = RPMI_SUCCESS;
+		for (bits = mask; bits; bits &= bits - 1) {
+			bit = __builtin_ctz(bits);
+			i = base_index + bit;
+			ret = start ? ops->hart_start_prepare(hsm->leaf.ops_priv, i,
+							      start_addr) :
+				      ops->hart_stop_prepare(hsm->leaf.ops_priv, i);
+			if (ret) {
+				*ret_ptr = ret;
+				fail_mask |= 1U << bit;
+			}
+		}
+	} else if (ret) {
+		*ret_ptr = ret;
+		fail_mask |= mask;
+	}
+
+	for (bits = mask; bits; bits &= bits - 1) {
+		bit = __builtin_ctz(bits);
+		i = base_index + bit;
+		hart = &hsm->leaf.harts[i];
+		if (!(fail_mask & (1U << bit))) {
+			if (start) {
+				hart->start_addr = start_addr;
+				hart->state = RPMI_HSM_HART_STATE_START_PENDING;
+			} else {
+				hart->state = RPMI_HSM_HART_STATE_STOP_PENDING;
+			}
+			__rpmi_hsm_process_hart_state_changes(hsm, hart, i);
+		}
+		rpmi_env_unlock(hart->lock);
+	}
+
+	return fail_mask;
+}
+
+static void rpmi_hsm_harts_mask_flush(struct rpmi_hsm *leaf,
+				      rpmi_uint32_t base_index,
+				      rpmi_uint32_t leaf_mask,
+				      rpmi_uint32_t first_index,
+				      rpmi_bool_t start,
+				      rpmi_uint64_t start_addr,
+				      rpmi_uint32_t *out_fail_mask,
+				      enum rpmi_error *ret_ptr)
+{
+	rpmi_uint32_t fail, index;
+
+	fail = rpmi_hsm_leaf_mask_op(leaf, base_index, leaf_mask,
+				     start, start_addr, ret_ptr);
+
+	/* Leaf relative bits map to consecutive hart indexes */
+	while (out_fail_mask && fail) {
+		index = first_index + __builtin_ctz(fail);
+		out_fail_mask[index / RPMI_BITS_PER_WORD32] |=
+					1U << (index % RPMI_BITS_PER_WORD32);
+		fail &= fail - 1;
+	}
+}
+
+static enum rpmi_error rpmi_hsm_harts_mask_op(struct rpmi_hsm *hsm,
+					      const rpmi_uint32_t *hart_mask,
+					      rpmi_bool_t start,
+					      rpmi_uint64_t start_addr,
+					      rpmi_uint32_t *out_fail_mask)
+{
+	rpmi_uint32_t index, leaf_index, base_index = 0, first_index = 0;
+	rpmi_uint32_t leaf_mask = 0;
+	struct rpmi_hsm *leaf, *cur_leaf = NULL;
+	enum rpmi_error ret = RPMI_SUCCESS;
+
+	if (!hsm || !hart_mask) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	if (out_fail_mask)
+		rpmi_env_memset(out_fail_mask, 0,
+			LIBRPMI_HSM_HART_MASK_WORDS(hsm->hart_count) * sizeof(*out_fail_mask));
+
+	/*
+	 * Harts of a leaf instance are contiguous in the flattened table so
+	 * collect runs of harts which belong to the same 32 harts of a leaf
+	 * and handle each run with one leaf operation.
+	 */
+	for (index = 0; index < hsm->hart_count; index++) {
+		if (!(hart_mask[index / RPMI_BITS_PER_WORD32] &
+		      (1U << (index % RPMI_BITS_PER_WORD32))))
+			continue;
+
+		leaf = hsm->hart_map[index].leaf;
+		leaf_index = hsm->hart_map[index].leaf_index;
+		if (leaf_mask && (leaf != cur_leaf ||
+				  RPMI_ROUNDDOWN(leaf_index, RPMI_BITS_PER_WORD32) != base_index)) {
+			rpmi_hsm_harts_mask_flush(cur_leaf, base_index, leaf_mask,
+						  first_index, start, start_addr,
+						  out_fail_mask, &ret);
+			leaf_mask = 0;
+		}
+
+		if (!leaf_mask) {
+			cur_leaf = leaf;
+			base_index = RPMI_ROUNDDOWN(leaf_index, RPMI_BITS_PER_WORD32);
+			first_index = index - (leaf_index - base_index);
+		}
+		leaf_mask |= 1U << (leaf_index - base_index);
+	}
+
+	if (leaf_mask)
+		rpmi_hsm_harts_mask_flush(cur_leaf, base_index, leaf_mask,
+					  first_index, start, start_addr,
+					  out_fail_mask, &ret);
+
+	return ret;
+}
+
+enum rpmi_error rpmi_hsm_harts_start_mask(struct rpmi_hsm *hsm,
+					  const rpmi_uint32_t *hart_mask,
+					  rpmi_uint64_t start_addr,
+					  rpmi_uint32_t *out_fail_mask)
+{
+	return rpmi_hsm_harts_mask_op(hsm, hart_mask, true, start_addr,
+				      out_fail_mask);
+}
+
+enum rpmi_error rpmi_hsm_harts_stop_mask(struct rpmi_hsm *hsm,
+					 const rpmi_uint32_t *hart_mask,
+					 rpmi_uint32_t *out_fail_mask)
+{
+	return rpmi_hsm_harts_mask_op(hsm, hart_mask, false, 0, out_fail_mask);
+}
+
+enum rpmi_error rpmi_hsm_harts_state_snapshot(struct rpmi_hsm *hsm,
+					      rpmi_uint32_t start_index,
+					      rpmi_uint32_t count,
+					      enum rpmi_hsm_hart_state state,
+					      rpmi_uint32_t *out_mask)
 {
+	struct rpmi_hsm_hart_map *map;
 	struct rpmi_hsm_hart *hart;
 	rpmi_uint32_t i;
 
+	if (!hsm || !out_mask || count > RPMI_BITS_PER_WORD32 ||
+	    start_index > hsm->hart_count ||
+	    count > (hsm->hart_count - start_index)) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	*out_mask = 0;
+	for (i = 0; i < count; i++) {
+		map = &hsm->hart_map[start_index + i];
+		hart = &map->leaf->leaf.harts[map->leaf_index];
+		rpmi_env_lock(hart->lock);
+		if (hart->state == state)
+			*out_mask |= 1U << i;
+		rpmi_env_unlock(hart->lock);
+	}
+
+	return RPMI_SUCCESS;
+}
+
+void rpmi_hsm_process_state_changes(struct rpmi_hsm *hsm)
+{
+	rpmi_uint32_t i, w, bits;
+	struct rpmi_hsm_hart *hart;
+
 	if (!hsm) {
 		DPRINTF("%s: invalid parameters\n", __func__);
 		return;
@@ -500,8 +743,19 @@ void rpmi_hsm_process_state_changes(struct rpmi_hsm *hsm)
 	if (hsm->is_non_leaf) {
 		for (i = 0; i < hsm->nonleaf.child_count; i++)
 			rpmi_hsm_process_state_changes(hsm->nonleaf.child_array[i]);
-	} else {
-		for (i = 0; i < hsm->leaf.hart_count; i++) {
+		return;
+	}
+
+	/* Only check harts which are marked pending */
+	for (w = 0; w < RPMI_BITMAP_WORDS32(hsm->leaf.hart_count); w++) {
+		if (!hsm->leaf.pending[w])
+			continue;
+
+		bits = rpmi_env_atomic_xchg32(&hsm->leaf.pending[w], 0);
+		while (bits) {
+			i = w * RPMI_BITS_PER_WORD32 + __builtin_ctz(bits);
+			bits &= bits - 1;
+
 			hart = &hsm->leaf.harts[i];
 			rpmi_env_lock(hart->lock);
 			__rpmi_hsm_process_hart_state_changes(hsm, hart, i);
@@ -510,6 +764,150 @@ void rpmi_hsm_process_state_changes(struct rpmi_hsm *hsm)
 	}
 }
 
+rpmi_bool_t rpmi_hsm_state_changes_pending(struct rpmi_hsm *hsm)
+{
+	rpmi_uint32_t i;
+
+	if (!hsm)
+		return false;
+
+	if (hsm->is_non_leaf) {
+		for (i = 0; i < hsm->nonleaf.child_count; i++) {
+			if (rpmi_hsm_state_changes_pending(hsm->nonleaf.child_array[i]))
+				return true;
+		}
+		return false;
+	}
+
+	for (i = 0; i < RPMI_BITMAP_WORDS32(hsm->leaf.hart_count); i++) {
+		if (hsm->leaf.pending[i])
+			return true;
+	}
+
+	return false;
+}
+
+enum rpmi_error rpmi_hsm_notify_hw_state_change(struct rpmi_hsm *hsm,
+						rpmi_uint32_t hart_index)
+{
+	if (!hsm || hsm->hart_count <= hart_index) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	rpmi_hsm_hart_set_pending(hsm->hart_map[hart_index].leaf,
+				  hsm->hart_map[hart_index].leaf_index);
+
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error rpmi_hsm_build_tables(struct rpmi_hsm *hsm)
+{
+	rpmi_uint32_t i, j, k, hart_count, type_count, *sorted_index, *table_le;
+	struct rpmi_hsm_hart_map *hart_map;
+	struct rpmi_hsm *child_hsm;
+
+	if (!hsm->is_non_leaf) {
+		hart_count = hsm->leaf.hart_count;
+	} else {
+		hart_count = 0;
+		for (i = 0; i < hsm->nonleaf.child_count; i++)
+			hart_count += hsm->nonleaf.child_array[i]->hart_count;
+	}
+
+	hart_map = rpmi_arena_zalloc(hsm->arena, hart_count * sizeof(*hart_map));
+	if (!hart_map)
+		return RPMI_ERR_FAILED;
+
+	sorted_index = rpmi_arena_zalloc(hsm->arena,
+					 hart_count * sizeof(*sorted_index));
+	if (!sorted_index) {
+		rpmi_arena_free(hsm->arena, hart_map);
+		return RPMI_ERR_FAILED;
+	}
+
+	type_count = rpmi_hsm_get_suspend_type_count(hsm);
+	table_le = rpmi_arena_zalloc(hsm->arena,
+				     (hart_count + type_count) * sizeof(*table_le));
+	if (!table_le) {
+		rpmi_arena_free(hsm->arena, sorted_index);
+		rpmi_arena_free(hsm->arena, hart_map);
+		return RPMI_ERR_FAILED;
+	}
+
+	/* Children are flattened already so only copy their tables */
+	if (!hsm->is_non_leaf) {
+		for (i = 0; i < hart_count; i++) {
+			hart_map[i].leaf = hsm;
+			hart_map[i].leaf_index = i;
+			hart_map[i].hart_id = hsm->leaf.hart_ids[i];
+		}
+	} else {
+		k = 0;
+		for (i = 0; i < hsm->nonleaf.child_count; i++) {
+			child_hsm = hsm->nonleaf.child_array[i];
+			for (j = 0; j < child_hsm->hart_count; j++)
+				hart_map[k++] = child_hsm->hart_map[j];
+		}
+	}
+
+	/*
+	 * Stable insertion sort by hart ID so that duplicate hart IDs
+	 * resolve to the lowest hart index as with a linear search.
+	 */
+	for (i = 0; i < hart_count; i++) {
+		for (j = i; j && hart_map[sorted_index[j - 1]].hart_id >
+						hart_map[i].hart_id; j--)
+			sorted_index[j] = sorted_index[j - 1];
+		sorted_index[j] = i;
+	}
+
+	for (i = 0; i < hart_count; i++)
+		table_le[i] = rpmi_to_le32(hart_map[i].hart_id);
+	for (i = 0; i < type_count; i++)
+		table_le[hart_count + i] =
+			rpmi_to_le32(rpmi_hsm_get_suspend_type(hsm, i)->type);
+
+	/* Callers of rpmi_hsm_refresh() quiesce all users of the old tables */
+	rpmi_arena_free(hsm->arena, hsm->hart_map);
+	rpmi_arena_free(hsm->arena, hsm->sorted_index);
+	rpmi_arena_free(hsm->arena, hsm->table_le);
+	hsm->hart_count = hart_count;
+	hsm->hart_map = hart_map;
+	hsm->sorted_index = sorted_index;
+	hsm->table_le = table_le;
+
+	return RPMI_SUCCESS;
+}
+
+enum rpmi_error rpmi_hsm_refresh(struct rpmi_hsm *hsm)
+{
+	enum rpmi_error ret;
+	rpmi_uint32_t i;
+
+	if (!hsm) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	/* Tables carved out of an arena are never given back */
+	if (!rpmi_arena_reclaimable(hsm->arena)) {
+		DPRINTF("%s: tables of HSM instance in arena can't be rebuilt\n",
+			__func__);
+		return RPMI_ERR_NOTSUPP;
+	}
+
+	if (hsm->is_non_leaf) {
+		for (i = 0; i < hsm->nonleaf.child_count; i++) {
+			ret = rpmi_hsm_refresh(hsm->nonleaf.child_array[i]);
+			if (ret)
+				return ret;
+		}
+	}
+
+	return rpmi_hsm_build_tables(hsm);
+}
+
 struct rpmi_hsm *rpmi_hsm_create(rpmi_uint32_t hart_count,
 				 const rpmi_uint32_t *hart_ids,
 				 rpmi_uint32_t suspend_type_count,
@@ -534,25 +932,37 @@ struct rpmi_hsm *rpmi_hsm_create(rpmi_uint32_t hart_count,
 	}
 
 	/* Allocate HSM */
-	hsm = rpmi_env_zalloc(sizeof(*hsm));
+	hsm = rpmi_zalloc(sizeof(*hsm));
 	if (!hsm) {
 		DPRINTF("%s: failed to allocate HSM instance\n", __func__);
 		return NULL;
 	}
+	hsm->arena = rpmi_arena_selected();
 
 	hsm->leaf.hart_count = hart_count;
 	hsm->leaf.hart_ids = hart_ids;
 
-	hsm->leaf.harts = rpmi_env_zalloc(hsm->leaf.hart_count * sizeof(*hsm->leaf.harts));
+	hsm->leaf.harts = rpmi_zalloc(hsm->leaf.hart_count * sizeof(*hsm->leaf.harts));
 	if (!hsm->leaf.harts) {
 		DPRINTF("%s: failed to allocate hart array\n", __func__);
-		rpmi_env_free(hsm);
+		rpmi_free(hsm);
 		return NULL;
 	}
 
+	hsm->leaf.pending = rpmi_zalloc(RPMI_BITMAP_WORDS32(hart_count) *
+					    sizeof(*hsm->leaf.pending));
+	if (!hsm->leaf.pending) {
+		DPRINTF("%s: failed to allocate pending bitmap\n", __func__);
+		rpmi_free(hsm->leaf.harts);
+		rpmi_free(hsm);
+		return NULL;
+	}
+
+	/* Initial state of all harts is derived from the HW state */
 	for (i = 0; i < hsm->leaf.hart_count; i++) {
 		hsm->leaf.harts[i].lock = rpmi_env_alloc_lock();
 		hsm->leaf.harts[i].state = -1;
+		rpmi_hsm_hart_set_pending(hsm, i);
 	}
 
 	hsm->leaf.suspend_type_count = suspend_type_count;
@@ -560,6 +970,16 @@ struct rpmi_hsm *rpmi_hsm_create(rpmi_uint32_t hart_count,
 	hsm->leaf.ops = ops;
 	hsm->leaf.ops_priv = ops_priv;
 
+	if (rpmi_hsm_build_tables(hsm)) {
+		DPRINTF("%s: failed to allocate hart tables\n", __func__);
+		for (i = 0; i < hsm->leaf.hart_count; i++)
+			rpmi_env_free_lock(hsm->leaf.harts[i].lock);
+		rpmi_free((void *)hsm->leaf.pending);
+		rpmi_free(hsm->leaf.harts);
+		rpmi_free(hsm);
+		return NULL;
+	}
+
 	rpmi_hsm_process_state_changes(hsm);
 
 	return hsm;
@@ -649,16 +1069,23 @@ struct rpmi_hsm *rpmi_hsm_nonleaf_create(rpmi_uint32_t child_count,
 	}
 
 	/* Allocate HSM */
-	hsm = rpmi_env_zalloc(sizeof(*hsm));
+	hsm = rpmi_zalloc(sizeof(*hsm));
 	if (!hsm) {
 		DPRINTF("%s: failed to allocate HSM instance\n", __func__);
 		return NULL;
 	}
+	hsm->arena = rpmi_arena_selected();
 
 	hsm->is_non_leaf = true;
 	hsm->nonleaf.child_count = child_count;
 	hsm->nonleaf.child_array = child_array;
 
+	if (rpmi_hsm_build_tables(hsm)) {
+		DPRINTF("%s: failed to allocate hart tables\n", __func__);
+		rpmi_free(hsm);
+		return NULL;
+	}
+
 	return hsm;
 }
 
@@ -674,8 +1101,12 @@ void rpmi_hsm_destroy(struct rpmi_hsm *hsm)
 	if (!hsm->is_non_leaf) {
 		for (i = 0; i < hsm->leaf.hart_count; i++)
 			rpmi_env_free_lock(hsm->leaf.harts[i].lock);
-		rpmi_env_free(hsm->leaf.harts);
+		rpmi_free((void *)hsm->leaf.pending);
+		rpmi_free(hsm->leaf.harts);
 	}
 
-	rpmi_env_free(hsm);
+	rpmi_free(hsm->table_le);
+	rpmi_free(hsm->sorted_index);
+	rpmi_free(hsm->hart_map);
+	rpmi_free(hsm);
 }
@@ -35,8 +35,11 @@
 struct rpmi_clock {
 	/* Clock node */
 	struct rpmi_dlist node;
-	/* Lock to invoke the platform operations to
-	 * protect this structure */
+	/* Lock of the clock domain (shared by all clocks with the same
+	 * root clock) to invoke the platform operations and to protect
+	 * the clock domain. Since a clock operation only walks its own
+	 * clock tree one lock serializes the parent and child updates
+	 * while operations on different domains run concurrently. */
 	void *lock;
 	/* Clock ID */
 	rpmi_uint32_t id;
@@ -44,12 +47,26 @@ struct rpmi_clock {
 	rpmi_uint32_t enable_count;
 	/* Current clock state */
 	enum rpmi_clock_state current_state;
+	/* Cached clock rate (valid only if rate_dirty is false) */
+	rpmi_uint64_t rate;
+	/* Parent rate changed so the cached rate must be recalculated */
+	rpmi_bool_t rate_dirty;
+	/* Rate change started by set_rate_async is not completed yet */
+	rpmi_bool_t rate_pending;
 	/* Parent clock instance pointer */
 	struct rpmi_clock *parent;
 	/* Child clock count */
 	rpmi_uint32_t child_count;
 	/* Clock static attributes/data */
 	const struct rpmi_clock_data *cdata;
+	/* Discrete rates in ascending order (NULL for linear clocks) */
+	const rpmi_uint64_t *sorted_rates;
+	/* Sorted rates are a private copy of the clock rate array */
+	rpmi_bool_t sorted_rates_copy;
+	/* Supported rates serialized as little-endian struct rpmi_clock_rate */
+	rpmi_uint32_t *rate_table_le;
+	/* Number of rates in the serialized table */
+	rpmi_uint32_t rate_table_count;
 	/* Child clock list */
 	struct rpmi_dlist child_clock;
 };
@@ -60,7 +77,10 @@ struct rpmi_clock_group {
 	rpmi_uint32_t clock_count;
 	/* Pointer to clock tree */
 	struct rpmi_clock *clock_tree;
-	/* Common clock platform operations (called with holding the lock)*/
+	/*
+	 * Common clock platform operations (called with holding the domain
+	 * lock so operations of different domains may run concurrently)
+	 */
 	const struct rpmi_clock_platform_ops *ops;
 	/* Private data of platform clock operations */
 	void *ops_priv;
@@ -102,41 +122,149 @@ static enum rpmi_error rpmi_clock_get_attrs(struct rpmi_clock_group *clkgrp,
 }
 
 /**
- * Take the parent node of a clock subtree and update the
- * rates of all available child clocks based on the
- * new parent clock rate.
+ * Mark the cached rates of all child clocks in a clock subtree as dirty.
+ * A dirty clock has a dirty subtree so marking stops at dirty clocks.
  */
-static enum rpmi_error
-__rpmi_clock_update_rate_tree(struct rpmi_clock_group *clkgrp,
-			      struct rpmi_clock *parent,
-			      enum rpmi_clock_rate_match match,
-			      rpmi_uint64_t parent_rate)
+static void __rpmi_clock_mark_rate_tree_dirty(struct rpmi_clock *parent)
 {
-	enum rpmi_error ret;
 	struct rpmi_dlist *pos;
+
+	rpmi_list_for_each(pos, &parent->child_clock) {
+		struct rpmi_clock *cc = to_rpmi_clock(pos);
+		if (cc->rate_dirty)
+			continue;
+
+		cc->rate_dirty = true;
+		if (cc->child_count)
+			__rpmi_clock_mark_rate_tree_dirty(cc);
+	}
+}
+
+/**
+ * Recalculate the rate of a clock with dirty cached rate based on the
+ * rate of its parent clock which is recalculated first if required.
+ */
+static enum rpmi_error __rpmi_clock_refresh_rate(struct rpmi_clock_group *clkgrp,
+						 struct rpmi_clock *clk)
+{
+	enum rpmi_error ret;
 	rpmi_uint64_t new_rate;
 
-	if (!parent->child_count)
+	if (!clk->rate_dirty)
 		return RPMI_SUCCESS;
 
-	/* iterate over all child clocks recursively */
-	rpmi_list_for_each(pos, &parent->child_clock) {
-		struct rpmi_clock *cc = to_rpmi_clock(pos);
-		ret = clkgrp->ops->set_rate_recalc(clkgrp->ops_priv, cc->id,
-						parent_rate, &new_rate);
-		if (ret) {
-			DPRINTF("%s: failed to recalc rate for clock-%u\n",
-					__func__, cc->id);
+	if (clk->parent) {
+		ret = __rpmi_clock_refresh_rate(clkgrp, clk->parent);
+		if (ret)
 			return ret;
-		}
 
-		ret = __rpmi_clock_update_rate_tree(clkgrp, cc,
-						    match, new_rate);
-		if (ret) {
-			DPRINTF("%s: failed to update rate for clk-%u tree\n",
-					__func__, cc->id);
-			return ret;
-		}
+		ret = clkgrp->ops->set_rate_recalc(clkgrp->ops_priv, clk->id,
+						   clk->parent->rate, &new_rate);
+	} else {
+		ret = clkgrp->ops->get_state_and_rate(clkgrp->ops_priv, clk->id,
+						      NULL, &new_rate);
+	}
+	if (ret) {
+		DPRINTF("%s: failed to recalc rate for clock-%u\n",
+			__func__, clk->id);
+		return ret;
+	}
+
+	clk->rate = new_rate;
+	clk->rate_dirty = false;
+
+	return RPMI_SUCCESS;
+}
+
+/**
+ * Resolve a ROUND_DOWN/ROUND_UP rate match of a discrete clock to one of
+ * the supported rates using binary search on the sorted rates.
+ */
+static enum rpmi_error __rpmi_clock_match_rate(struct rpmi_clock *clk,
+					       enum rpmi_clock_rate_match match,
+					       rpmi_uint64_t *rate)
+{
+	const rpmi_uint64_t *rates = clk->sorted_rates;
+	rpmi_uint32_t lo = 0, hi, mid;
+
+	if (!rates || match == RPMI_CLK_RATE_MATCH_PLATFORM)
+		return RPMI_SUCCESS;
+
+	/* Find the first rate which is not lower than the requested rate */
+	hi = clk->cdata->rate_count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (rates[mid] < *rate)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo < clk->cdata->rate_count && rates[lo] == *rate)
+		return RPMI_SUCCESS;
+
+	if (match == RPMI_CLK_RATE_MATCH_ROUND_UP) {
+		if (lo == clk->cdata->rate_count)
+			return RPMI_ERR_INVALID_PARAM;
+		*rate = rates[lo];
+	} else {
+		if (lo == 0)
+			return RPMI_ERR_INVALID_PARAM;
+		*rate = rates[lo - 1];
+	}
+
+	return RPMI_SUCCESS;
+}
+
+/**
+ * Update the cached rate of a clock after its rate was changed. The parent
+ * clocks are refreshed first because a clean clock below a dirty parent
+ * would not be marked again by a later rate change of an ancestor. If that
+ * fails then the rate stays dirty and is recalculated once needed.
+ */
+static void __rpmi_clock_update_rate(struct rpmi_clock_group *clkgrp,
+				     struct rpmi_clock *clk,
+				     rpmi_uint64_t new_rate)
+{
+	clk->rate = new_rate;
+	clk->rate_dirty = (clk->parent &&
+			   __rpmi_clock_refresh_rate(clkgrp, clk->parent)) ?
+								true : false;
+
+	/* Child clocks are recalculated lazily when their rate is needed */
+	if (clk->child_count)
+		__rpmi_clock_mark_rate_tree_dirty(clk);
+}
+
+/**
+ * Start an asynchronous rate change if the platform supports it and the
+ * request can be deferred. Returns RPMI_ERR_NOTSUPP if the rate must be
+ * changed synchronously.
+ */
+static enum rpmi_error __rpmi_clock_set_rate_async(struct rpmi_clock_group *clkgrp,
+						   struct rpmi_clock *clk,
+						   struct rpmi_context_request *req,
+						   enum rpmi_clock_rate_match match,
+						   rpmi_uint64_t rate)
+{
+	struct rpmi_context *cntx;
+	rpmi_uint32_t handle;
+	enum rpmi_error ret;
+
+	if (!req || !clkgrp->ops->set_rate_async)
+		return RPMI_ERR_NOTSUPP;
+
+	if (rpmi_context_defer_request(req, &handle))
+		return RPMI_ERR_NOTSUPP;
+
+	cntx = rpmi_context_request_context(req);
+	clk->rate_pending = true;
+	ret = clkgrp->ops->set_rate_async(clkgrp->ops_priv, clk->id, match,
+					  rate, cntx, handle);
+	if (ret) {
+		/* Request is already deferred so fail it with the error */
+		clk->rate_pending = false;
+		rpmi_context_complete_request_status(cntx, handle, ret);
 	}
 
 	return RPMI_SUCCESS;
@@ -144,6 +272,7 @@ __rpmi_clock_update_rate_tree(struct rpmi_clock_group *clkgrp,
 
 static enum rpmi_error __rpmi_clock_set_rate(struct rpmi_clock_group *clkgrp,
 				    struct rpmi_clock *clk,
+				    struct rpmi_context_request *req,
 				    enum rpmi_clock_rate_match match,
 				    rpmi_uint64_t rate)
 {
@@ -154,27 +283,38 @@ static enum rpmi_error __rpmi_clock_set_rate(struct rpmi_clock_group *clkgrp,
 	if (clk->current_state == RPMI_CLK_STATE_DISABLED)
 		return RPMI_ERR_DENIED;
 
+	if (clk->rate_pending)
+		return RPMI_ERR_BUSY;
+
+	ret = __rpmi_clock_match_rate(clk, match, &rate);
+	if (ret)
+		return ret;
+
 	rate_change_req = clkgrp->ops->rate_change_match(clkgrp->ops_priv,
 							clk->id, rate);
 	if (!rate_change_req)
 		return RPMI_ERR_ALREADY;
 
+	ret = __rpmi_clock_set_rate_async(clkgrp, clk, req, match, rate);
+	if (ret != RPMI_ERR_NOTSUPP)
+		return ret;
+
 	ret = clkgrp->ops->set_rate(clkgrp->ops_priv, clk->id, match,
 					rate, &curr_rate);
 	if (ret)
 		return ret;
 
-	if (clk->child_count) {
-		ret = __rpmi_clock_update_rate_tree(clkgrp, clk,
-						    match, curr_rate);
-		if (ret)
-			return ret;
-	}
+	__rpmi_clock_update_rate(clkgrp, clk, curr_rate);
 
 	return RPMI_SUCCESS;
 }
 
+/**
+ * Set the rate of a clock where the request handle is NULL unless the
+ * request may be deferred for an asynchronous rate change.
+ */
 static enum rpmi_error rpmi_clock_set_rate(struct rpmi_clock_group *clkgrp,
+				    struct rpmi_context_request *req,
 				    rpmi_uint32_t clkid,
 				    enum rpmi_clock_rate_match match,
 				    rpmi_uint64_t rate)
@@ -189,7 +329,7 @@ static enum rpmi_error rpmi_clock_set_rate(struct rpmi_clock_group *clkgrp,
 	}
 
 	rpmi_env_lock(clk->lock);
-	ret = __rpmi_clock_set_rate(clkgrp, clk, match, rate);
+	ret = __rpmi_clock_set_rate(clkgrp, clk, req, match, rate);
 	rpmi_env_unlock(clk->lock);
 
 	return ret;
@@ -276,6 +416,11 @@ static enum rpmi_error __rpmi_clock_set_state(struct rpmi_clock_group *clkgrp,
 
 		clk->current_state = state;
 		clk->enable_count += 1;
+
+		/* Running clock must follow the current parent rate */
+		ret = __rpmi_clock_refresh_rate(clkgrp, clk);
+		if (ret)
+			return ret;
 	}
 
 done:
@@ -308,8 +453,10 @@ static enum rpmi_error rpmi_clock_get_state(struct rpmi_clock_group *clkgrp,
 	if (!clk || !state)
 		return RPMI_ERR_INVALID_PARAM;
 
+	rpmi_env_lock(clk->lock);
 	ret = clkgrp->ops->get_state_and_rate(clkgrp->ops_priv, clk->id, state,
 					      NULL);
+	rpmi_env_unlock(clk->lock);
 	return ret;
 }
 
@@ -322,11 +469,105 @@ static enum rpmi_error rpmi_clock_get_rate(struct rpmi_clock_group *clkgrp,
 	if (!clk || !rate)
 		return RPMI_ERR_INVALID_PARAM;
 
-	ret = clkgrp->ops->get_state_and_rate(clkgrp->ops_priv, clk->id, NULL,
-					      rate);
+	/* Clean cached rate is served without calling the platform */
+	rpmi_env_lock(clk->lock);
+	ret = __rpmi_clock_refresh_rate(clkgrp, clk);
+	if (!ret)
+		*rate = clk->rate;
+	rpmi_env_unlock(clk->lock);
 	return ret;
 }
 
+/**
+ * Setup the sorted rates of a discrete clock. The clock rate array
+ * is used as-is when already sorted otherwise a sorted copy is made.
+ */
+static enum rpmi_error rpmi_clock_init_sorted_rates(struct rpmi_clock *clock)
+{
+	const rpmi_uint64_t *rates = clock->cdata->clock_rate_array;
+	rpmi_uint32_t i, j, count = clock->cdata->rate_count;
+	rpmi_uint64_t *sorted, tmp;
+
+	if (clock->cdata->clock_type != RPMI_CLK_TYPE_DISCRETE ||
+	    !rates || !count)
+		return RPMI_SUCCESS;
+
+	for (i = 1; i < count; i++) {
+		if (rates[i - 1] > rates[i])
+			break;
+	}
+	if (i == count) {
+		clock->sorted_rates = rates;
+		return RPMI_SUCCESS;
+	}
+
+	sorted = rpmi_zalloc(sizeof(*sorted) * count);
+	if (!sorted)
+		return RPMI_ERR_FAILED;
+
+	for (i = 0; i < count; i++) {
+		tmp = rates[i];
+		for (j = i; j && sorted[j - 1] > tmp; j--)
+			sorted[j] = sorted[j - 1];
+		sorted[j] = tmp;
+	}
+
+	clock->sorted_rates = sorted;
+	clock->sorted_rates_copy = true;
+	return RPMI_SUCCESS;
+}
+
+/**
+ * Setup the supported rates serialized as little-endian so that pages of
+ * the get supported rates service are copied out as-is. Linear clocks have
+ * the max, min and step rates.
+ */
+static enum rpmi_error rpmi_clock_init_rate_table(struct rpmi_clock *clock)
+{
+	const rpmi_uint64_t *rates = clock->cdata->clock_rate_array;
+	rpmi_uint32_t i, count = clock->cdata->rate_count;
+
+	if (!rates || !count)
+		return RPMI_SUCCESS;
+
+	if (clock->cdata->clock_type == RPMI_CLK_TYPE_LINEAR)
+		count = 3;
+	else if (clock->cdata->clock_type != RPMI_CLK_TYPE_DISCRETE)
+		return RPMI_SUCCESS;
+
+	clock->rate_table_le = rpmi_zalloc(2 * sizeof(rpmi_uint32_t) * count);
+	if (!clock->rate_table_le)
+		return RPMI_ERR_FAILED;
+
+	for (i = 0; i < count; i++) {
+		clock->rate_table_le[2 * i] = rpmi_to_le32(RATE_U64TOLO(rates[i]));
+		clock->rate_table_le[2 * i + 1] = rpmi_to_le32(RATE_U64TOHI(rates[i]));
+	}
+	clock->rate_table_count = count;
+
+	return RPMI_SUCCESS;
+}
+
+/** Free the clock tree along with clock domain locks and rate tables */
+static void rpmi_clock_tree_free(struct rpmi_clock *clock_tree,
+				 rpmi_uint32_t clock_count)
+{
+	rpmi_uint32_t clkid;
+	struct rpmi_clock *clock;
+
+	for (clkid = 0; clkid < clock_count; clkid++) {
+		clock = &clock_tree[clkid];
+		if (clock->cdata->parent_id == -1 && clock->lock)
+			rpmi_env_free_lock(clock->lock);
+		if (clock->sorted_rates_copy)
+			rpmi_free((void *)clock->sorted_rates);
+		if (clock->rate_table_le)
+			rpmi_free(clock->rate_table_le);
+	}
+
+	rpmi_free(clock_tree);
+}
+
 /**
  * Initialize the clock tree from provided
  * static platform clock data.
@@ -344,10 +585,13 @@ rpmi_clock_tree_init(rpmi_uint32_t clock_count,
 	rpmi_uint32_t clkid;
 	rpmi_uint64_t rate;
 	enum rpmi_clock_state state;
-	struct rpmi_clock *clock;
+	struct rpmi_clock *clock, *root;
+	rpmi_uint32_t num_roots = 0, num_locks = 0;
 
 	struct rpmi_clock *clock_tree =
-		rpmi_env_zalloc(sizeof(struct rpmi_clock) * clock_count);
+		rpmi_zalloc(sizeof(struct rpmi_clock) * clock_count);
+	if (!clock_tree)
+		return NULL;
 
 	/* initialize all clocks instances */
 	for (clkid = 0; clkid < clock_count; clkid++) {
@@ -368,17 +612,27 @@ rpmi_clock_tree_init(rpmi_uint32_t clock_count,
 		if(ret) {
 			DPRINTF("%s: failed to get clk-%u state and rate\n",
 							__func__, clkid);
-			rpmi_env_free(clock_tree);
+			rpmi_clock_tree_free(clock_tree, clkid);
 			return NULL;
 		}
 
 		clock->current_state = state;
+		clock->rate = rate;
+		clock->rate_dirty = false;
 
 		if (state == RPMI_CLK_STATE_ENABLED) {
 			clock->enable_count += 1;
 		}
 
-		clock->lock = rpmi_env_alloc_lock();
+		ret = rpmi_clock_init_sorted_rates(clock);
+		if (!ret)
+			ret = rpmi_clock_init_rate_table(clock);
+		if (ret) {
+			DPRINTF("%s: failed to sort clk-%u rates\n",
+							__func__, clkid);
+			rpmi_clock_tree_free(clock_tree, clkid + 1);
+			return NULL;
+		}
 	}
 
 	/* Once all clocks instances initialized, link the clocks based
@@ -397,6 +651,35 @@ rpmi_clock_tree_init(rpmi_uint32_t clock_count,
 		}
 	}
 
+	/*
+	 * Only root clocks own a clock domain lock. The group does its own
+	 * locking so either every clock domain gets a lock or the environment
+	 * does not support locking and none of them gets one.
+	 */
+	for (clkid = 0; clkid < clock_count; clkid++) {
+		clock = &clock_tree[clkid];
+		if (clock->parent)
+			continue;
+		clock->lock = rpmi_env_alloc_lock();
+		num_roots++;
+		if (clock->lock)
+			num_locks++;
+	}
+	if (num_locks && num_locks != num_roots) {
+		DPRINTF("%s: failed to allocate %u of %u clock domain locks\n",
+			__func__, num_roots - num_locks, num_roots);
+		rpmi_clock_tree_free(clock_tree, clock_count);
+		return NULL;
+	}
+
+	/* Share the lock of the root clock within each clock domain */
+	for (clkid = 0; clkid < clock_count; clkid++) {
+		clock = &clock_tree[clkid];
+		for (root = clock; root->parent; root = root->parent)
+			;
+		clock->lock = root->lock;
+	}
+
 	return clock_tree;
 }
 
@@ -486,13 +769,13 @@ rpmi_clock_sg_get_supp_rates(struct rpmi_service_group *group,
 			     rpmi_uint8_t *response_data)
 {
 	enum rpmi_error ret;
-	rpmi_int32_t i = 0, j = 0;
 	rpmi_uint32_t rate_count;
 	rpmi_uint32_t resp_dlen = 0, clk_rate_idx = 0;
 	rpmi_uint32_t max_rates, remaining = 0, returned = 0;
 	const rpmi_uint64_t *rate_array;
 	struct rpmi_clock_attrs clk_attrs;
 	struct rpmi_clock_group *clkgrp = group->priv;
+	struct rpmi_clock *clk;
 	rpmi_uint32_t *resp = (void *)response_data;
 
 	rpmi_uint32_t clkid = rpmi_to_xe32(trans->is_be,
@@ -524,14 +807,10 @@ rpmi_clock_sg_get_supp_rates(struct rpmi_service_group *group,
 	clk_rate_idx = rpmi_to_xe32(trans->is_be,
 				    ((const rpmi_uint32_t *)request_data)[1]);
 
+	clk = rpmi_get_clock(clkgrp, clkid);
 	if (clk_attrs.type == RPMI_CLK_TYPE_LINEAR) {
 		/* max, min and step */
-		for (i = 0; i < 3; i++) {
-			resp[4 + 2*i] = rpmi_to_xe32(trans->is_be,
-				(rpmi_uint32_t)RATE_U64TOLO(rate_array[i]));
-			resp[5 + 2*i] = rpmi_to_xe32(trans->is_be,
-				(rpmi_uint32_t)RATE_U64TOHI(rate_array[i]));
-		}
+		rpmi_copy_le32_table(trans, &resp[4], clk->rate_table_le, 2 * 3);
 		remaining = 0;
 		returned = 3;
 	}
@@ -545,7 +824,7 @@ rpmi_clock_sg_get_supp_rates(struct rpmi_service_group *group,
 
 		/* max rates a rpmi message can accommodate */
 		max_rates =
-		(RPMI_MSG_DATA_SIZE(trans->slot_size) - (4 * sizeof(*resp))) /
+		(RPMI_MSG_DATA_SIZE(rpmi_transport_slot_size(trans)) - (4 * sizeof(*resp))) /
 					sizeof(struct rpmi_clock_rate);
 		remaining = rate_count - clk_rate_idx;
 		if (remaining > max_rates)
@@ -553,12 +832,9 @@ rpmi_clock_sg_get_supp_rates(struct rpmi_service_group *group,
 		else
 			returned = remaining;
 
-		for (i = clk_rate_idx, j = 0; i <= (clk_rate_idx + returned - 1); i++, j++) {
-			resp[4 + 2*j] = rpmi_to_xe32(trans->is_be,
-				(rpmi_uint32_t)RATE_U64TOLO(rate_array[i]));
-			resp[5 + 2*j] = rpmi_to_xe32(trans->is_be,
-				(rpmi_uint32_t)RATE_U64TOHI(rate_array[i]));
-		}
+		rpmi_copy_le32_table(trans, &resp[4],
+				     &clk->rate_table_le[2 * clk_rate_idx],
+				     2 * returned);
 
 		remaining = rate_count - (clk_rate_idx + returned);
 	}
@@ -676,6 +952,7 @@ static enum rpmi_error
 rpmi_clock_sg_set_rate(struct rpmi_service_group *group,
 		       struct rpmi_service *service,
 		       struct rpmi_transport *trans,
+		       struct rpmi_context_request *req,
 		       rpmi_uint16_t request_datalen,
 		       const rpmi_uint8_t *request_data,
 		       rpmi_uint16_t *response_datalen,
@@ -721,7 +998,7 @@ rpmi_clock_sg_set_rate(struct rpmi_service_group *group,
 		goto done;
 	}
 
-	status = rpmi_clock_set_rate(clkgrp, clkid, rate_match, rate_u64);
+	status = rpmi_clock_set_rate(clkgrp, req, clkid, rate_match, rate_u64);
 	resp[0] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)status);
 
 done:
@@ -808,7 +1085,7 @@ static struct rpmi_service rpmi_clock_services[RPMI_CLK_SRV_ID_MAX] = {
 	[RPMI_CLK_SRV_SET_RATE] = {
 		.service_id = RPMI_CLK_SRV_SET_RATE,
 		.min_a2p_request_datalen = 16,
-		.process_a2p_request = rpmi_clock_sg_set_rate,
+		.process_a2p_request_deferrable = rpmi_clock_sg_set_rate,
 	},
 	[RPMI_CLK_SRV_GET_RATE] = {
 		.service_id = RPMI_CLK_SRV_GET_RATE,
@@ -833,7 +1110,7 @@ rpmi_service_group_clock_create(rpmi_uint32_t clock_count,
 	}
 
 	/* Allocate clock service group */
-	clkgrp = rpmi_env_zalloc(sizeof(*clkgrp));
+	clkgrp = rpmi_zalloc(sizeof(*clkgrp));
 	if (!clkgrp) {
 		DPRINTF("%s: failed to allocate clock service group instance\n",
 			__func__);
@@ -846,7 +1123,7 @@ rpmi_service_group_clock_create(rpmi_uint32_t clock_count,
 						 ops_priv);
 	if (!clkgrp->clock_tree) {
 		DPRINTF("%s: failed to initialize clock tree\n", __func__);
-		rpmi_env_free(clkgrp);
+		rpmi_free(clkgrp);
 		return NULL;
 	}
 
@@ -863,15 +1140,75 @@ rpmi_service_group_clock_create(rpmi_uint32_t clock_count,
 	group->privilege_level_bitmap = RPMI_PRIVILEGE_M_MODE_MASK | RPMI_PRIVILEGE_S_MODE_MASK;
 	group->max_service_id = RPMI_CLK_SRV_ID_MAX;
 	group->services = rpmi_clock_services;
-	group->lock = rpmi_env_alloc_lock();
+	/* Clock domains are locked internally so no group lock is needed */
+	group->flags = LIBRPMI_SERVICE_GROUP_FLAG_INTERNAL_LOCKING;
+	group->lock = NULL;
 	group->priv = clkgrp;
 
 	return group;
 }
 
+enum rpmi_error rpmi_service_group_clock_rate_changed(struct rpmi_service_group *group,
+						      rpmi_uint32_t clock_id)
+{
+	struct rpmi_clock_group *clkgrp;
+	struct rpmi_clock *clk;
+
+	if (!group) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	clkgrp = group->priv;
+	if (clock_id >= clkgrp->clock_count)
+		return RPMI_ERR_INVALID_PARAM;
+
+	clk = rpmi_get_clock(clkgrp, clock_id);
+	rpmi_env_lock(clk->lock);
+	clk->rate_dirty = true;
+	__rpmi_clock_mark_rate_tree_dirty(clk);
+	rpmi_env_unlock(clk->lock);
+
+	return RPMI_SUCCESS;
+}
+
+enum rpmi_error rpmi_service_group_clock_set_rate_complete(struct rpmi_service_group *group,
+							   rpmi_uint32_t clock_id,
+							   enum rpmi_error status,
+							   rpmi_uint64_t new_rate,
+							   struct rpmi_context *cntx,
+							   rpmi_uint32_t handle)
+{
+	struct rpmi_clock_group *clkgrp;
+	struct rpmi_clock *clk;
+
+	if (!group || !cntx) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	clkgrp = group->priv;
+	if (clock_id >= clkgrp->clock_count)
+		return RPMI_ERR_INVALID_PARAM;
+
+	clk = rpmi_get_clock(clkgrp, clock_id);
+	rpmi_env_lock(clk->lock);
+	if (!clk->rate_pending) {
+		rpmi_env_unlock(clk->lock);
+		DPRINTF("%s: no rate change pending for clock-%u\n",
+			__func__, clock_id);
+		return RPMI_ERR_INVALID_STATE;
+	}
+	clk->rate_pending = false;
+	if (!status)
+		__rpmi_clock_update_rate(clkgrp, clk, new_rate);
+	rpmi_env_unlock(clk->lock);
+
+	return rpmi_context_complete_request_status(cntx, handle, status);
+}
+
 void rpmi_service_group_clock_destroy(struct rpmi_service_group *group)
 {
-	rpmi_uint32_t clkid;
 	struct rpmi_clock_group *clkgrp;
 
 	if (!group) {
@@ -881,11 +1218,287 @@ void rpmi_service_group_clock_destroy(struct rpmi_service_group *group)
 
 	clkgrp = group->priv;
 
-	for (clkid = 0; clkid < clkgrp->clock_count; clkid++) {
-		rpmi_env_free_lock(clkgrp->clock_tree[clkid].lock);
+	rpmi_clock_tree_free(clkgrp->clock_tree, clkgrp->clock_count);
+	rpmi_free(group->priv);
+}
+
+/*****************************************************************************
+ * RPMI Clock Extension (bulk) Service Group Functions
+ ****************************************************************************/
+static enum rpmi_error
+rpmi_clock_ext_sg_get_configs(struct rpmi_service_group *group,
+			      struct rpmi_service *service,
+			      struct rpmi_transport *trans,
+			      rpmi_uint16_t request_datalen,
+			      const rpmi_uint8_t *request_data,
+			      rpmi_uint16_t *response_datalen,
+			      rpmi_uint8_t *response_data)
+{
+	enum rpmi_error status = RPMI_SUCCESS;
+	enum rpmi_clock_state state;
+	rpmi_uint32_t i, max_clocks, remaining, returned = 0;
+	struct rpmi_clock_group *clkgrp = group->priv;
+	rpmi_uint32_t *resp = (void *)response_data;
+
+	rpmi_uint32_t clkid = rpmi_to_xe32(trans->is_be,
+				     ((const rpmi_uint32_t *)request_data)[0]);
+
+	if (clkid >= clkgrp->clock_count) {
+		resp[0] = rpmi_to_xe32(trans->is_be,
+				       (rpmi_uint32_t)RPMI_ERR_INVALID_PARAM);
+		*response_datalen = sizeof(*resp);
+		return RPMI_SUCCESS;
+	}
+
+	/* max configs a rpmi message can accommodate */
+	max_clocks = (RPMI_MSG_DATA_SIZE(rpmi_transport_slot_size(trans)) -
+		      (3 * sizeof(*resp))) / sizeof(*resp);
+	remaining = clkgrp->clock_count - clkid;
+
+	/* Stop at the first clock which fails so it can be retried alone */
+	for (i = 0; i < RPMI_MIN(remaining, max_clocks); i++) {
+		status = rpmi_clock_get_state(clkgrp, clkid + i, &state);
+		if (status)
+			break;
+
+		resp[3 + i] = rpmi_to_xe32(trans->is_be,
+				(state == RPMI_CLK_STATE_ENABLED) ? 1 : 0);
+		returned++;
+	}
+
+	if (!returned) {
+		resp[0] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)status);
+		*response_datalen = sizeof(*resp);
+		return RPMI_SUCCESS;
+	}
+
+	resp[2] = rpmi_to_xe32(trans->is_be, returned);
+	resp[1] = rpmi_to_xe32(trans->is_be, remaining - returned);
+	resp[0] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)RPMI_SUCCESS);
+	*response_datalen = (3 + returned) * sizeof(*resp);
+
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error
+rpmi_clock_ext_sg_get_rates(struct rpmi_service_group *group,
+			    struct rpmi_service *service,
+			    struct rpmi_transport *trans,
+			    rpmi_uint16_t request_datalen,
+			    const rpmi_uint8_t *request_data,
+			    rpmi_uint16_t *response_datalen,
+			    rpmi_uint8_t *response_data)
+{
+	enum rpmi_error status = RPMI_SUCCESS;
+	rpmi_uint64_t rate_u64;
+	rpmi_uint32_t i, max_clocks, remaining, returned = 0;
+	struct rpmi_clock_group *clkgrp = group->priv;
+	rpmi_uint32_t *resp = (void *)response_data;
+
+	rpmi_uint32_t clkid = rpmi_to_xe32(trans->is_be,
+				     ((const rpmi_uint32_t *)request_data)[0]);
+
+	if (clkid >= clkgrp->clock_count) {
+		resp[0] = rpmi_to_xe32(trans->is_be,
+				       (rpmi_uint32_t)RPMI_ERR_INVALID_PARAM);
+		*response_datalen = sizeof(*resp);
+		return RPMI_SUCCESS;
+	}
+
+	/* max rates a rpmi message can accommodate */
+	max_clocks = (RPMI_MSG_DATA_SIZE(rpmi_transport_slot_size(trans)) -
+		      (3 * sizeof(*resp))) / sizeof(struct rpmi_clock_rate);
+	remaining = clkgrp->clock_count - clkid;
+
+	/* Stop at the first clock which fails so it can be retried alone */
+	for (i = 0; i < RPMI_MIN(remaining, max_clocks); i++) {
+		status = rpmi_clock_get_rate(clkgrp, clkid + i, &rate_u64);
+		if (status)
+			break;
+
+		resp[3 + 2*i] = rpmi_to_xe32(trans->is_be,
+				(rpmi_uint32_t)RATE_U64TOLO(rate_u64));
+		resp[4 + 2*i] = rpmi_to_xe32(trans->is_be,
+				(rpmi_uint32_t)RATE_U64TOHI(rate_u64));
+		returned++;
+	}
+
+	if (!returned) {
+		resp[0] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)status);
+		*response_datalen = sizeof(*resp);
+		return RPMI_SUCCESS;
+	}
+
+	resp[2] = rpmi_to_xe32(trans->is_be, returned);
+	resp[1] = rpmi_to_xe32(trans->is_be, remaining - returned);
+	resp[0] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)RPMI_SUCCESS);
+	*response_datalen = (3 * sizeof(*resp)) +
+			    (returned * sizeof(struct rpmi_clock_rate));
+
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error
+rpmi_clock_ext_sg_set_configs(struct rpmi_service_group *group,
+			      struct rpmi_service *service,
+			      struct rpmi_transport *trans,
+			      rpmi_uint16_t request_datalen,
+			      const rpmi_uint8_t *request_data,
+			      rpmi_uint16_t *response_datalen,
+			      rpmi_uint8_t *response_data)
+{
+	enum rpmi_error status;
+	rpmi_uint32_t i, clkid, cfg, count;
+	struct rpmi_clock_group *clkgrp = group->priv;
+	const rpmi_uint32_t *args = (const void *)request_data;
+	rpmi_uint32_t *resp = (void *)response_data;
+
+	/* Each entry is a (clock_id, config) pair */
+	count = rpmi_to_xe32(trans->is_be, args[0]);
+	if (!count || count > (request_datalen - sizeof(*args)) / (2 * sizeof(*args))) {
+		resp[0] = rpmi_to_xe32(trans->is_be,
+				       (rpmi_uint32_t)RPMI_ERR_INVALID_PARAM);
+		*response_datalen = sizeof(*resp);
+		return RPMI_SUCCESS;
+	}
+
+	for (i = 0; i < count; i++) {
+		clkid = rpmi_to_xe32(trans->is_be, args[1 + 2*i]);
+		cfg = rpmi_to_xe32(trans->is_be, args[2 + 2*i]);
+
+		if (clkid >= clkgrp->clock_count)
+			status = RPMI_ERR_INVALID_PARAM;
+		else
+			status = rpmi_clock_set_state(clkgrp, clkid,
+					(cfg & 0b1) ? RPMI_CLK_STATE_ENABLED :
+						      RPMI_CLK_STATE_DISABLED);
+		resp[2 + i] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)status);
+	}
+
+	resp[1] = rpmi_to_xe32(trans->is_be, count);
+	resp[0] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)RPMI_SUCCESS);
+	*response_datalen = (2 + count) * sizeof(*resp);
+
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error
+rpmi_clock_ext_sg_set_rates(struct rpmi_service_group *group,
+			    struct rpmi_service *service,
+			    struct rpmi_transport *trans,
+			    rpmi_uint16_t request_datalen,
+			    const rpmi_uint8_t *request_data,
+			    rpmi_uint16_t *response_datalen,
+			    rpmi_uint8_t *response_data)
+{
+	enum rpmi_error status;
+	enum rpmi_clock_rate_match rate_match;
+	rpmi_uint32_t i, clkid, count;
+	rpmi_uint64_t rate_u64;
+	struct rpmi_clock_group *clkgrp = group->priv;
+	const rpmi_uint32_t *args = (const void *)request_data;
+	rpmi_uint32_t *resp = (void *)response_data;
+
+	/* Each entry is a (clock_id, flags, rate_lo, rate_hi) tuple */
+	count = rpmi_to_xe32(trans->is_be, args[0]);
+	if (!count || count > (request_datalen - sizeof(*args)) / (4 * sizeof(*args))) {
+		resp[0] = rpmi_to_xe32(trans->is_be,
+				       (rpmi_uint32_t)RPMI_ERR_INVALID_PARAM);
+		*response_datalen = sizeof(*resp);
+		return RPMI_SUCCESS;
+	}
+
+	for (i = 0; i < count; i++) {
+		clkid = rpmi_to_xe32(trans->is_be, args[1 + 4*i]);
+		rate_match = rpmi_to_xe32(trans->is_be, args[2 + 4*i]) & 0b11;
+		rate_u64 = RATE_U64(rpmi_to_xe32(trans->is_be, args[3 + 4*i]),
+				    rpmi_to_xe32(trans->is_be, args[4 + 4*i]));
+
+		if (clkid >= clkgrp->clock_count ||
+		    rate_match >= RPMI_CLK_RATE_MATCH_MAX_IDX ||
+		    rate_u64 == RPMI_CLOCK_RATE_INVALID || rate_u64 == 0)
+			status = RPMI_ERR_INVALID_PARAM;
+		else
+			status = rpmi_clock_set_rate(clkgrp, NULL, clkid,
+						     rate_match, rate_u64);
+		resp[2 + i] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)status);
+	}
+
+	resp[1] = rpmi_to_xe32(trans->is_be, count);
+	resp[0] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)RPMI_SUCCESS);
+	*response_datalen = (2 + count) * sizeof(*resp);
+
+	return RPMI_SUCCESS;
+}
+
+static struct rpmi_service rpmi_clock_ext_services[RPMI_CLK_EXT_SRV_ID_MAX] = {
+	[RPMI_CLK_EXT_SRV_ENABLE_NOTIFICATION] = {
+		.service_id = RPMI_CLK_EXT_SRV_ENABLE_NOTIFICATION,
+		.min_a2p_request_datalen = 4,
+		.process_a2p_request = NULL,
+	},
+	[RPMI_CLK_EXT_SRV_GET_CONFIGS] = {
+		.service_id = RPMI_CLK_EXT_SRV_GET_CONFIGS,
+		.min_a2p_request_datalen = 4,
+		.process_a2p_request = rpmi_clock_ext_sg_get_configs,
+	},
+	[RPMI_CLK_EXT_SRV_GET_RATES] = {
+		.service_id = RPMI_CLK_EXT_SRV_GET_RATES,
+		.min_a2p_request_datalen = 4,
+		.process_a2p_request = rpmi_clock_ext_sg_get_rates,
+	},
+	[RPMI_CLK_EXT_SRV_SET_CONFIGS] = {
+		.service_id = RPMI_CLK_EXT_SRV_SET_CONFIGS,
+		.min_a2p_request_datalen = 12,
+		.process_a2p_request = rpmi_clock_ext_sg_set_configs,
+	},
+	[RPMI_CLK_EXT_SRV_SET_RATES] = {
+		.service_id = RPMI_CLK_EXT_SRV_SET_RATES,
+		.min_a2p_request_datalen = 20,
+		.process_a2p_request = rpmi_clock_ext_sg_set_rates,
+	},
+};
+
+struct rpmi_service_group *
+rpmi_service_group_clock_ext_create(struct rpmi_service_group *clock_group,
+				    rpmi_uint16_t servicegroup_id)
+{
+	struct rpmi_service_group *group;
+
+	if (!clock_group || clock_group->servicegroup_id != RPMI_SRVGRP_CLOCK ||
+	    servicegroup_id < RPMI_SRVGRP_EXPERIMENTAL_START) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return NULL;
+	}
+
+	group = rpmi_zalloc(sizeof(*group));
+	if (!group) {
+		DPRINTF("%s: failed to allocate clock extension service group instance\n",
+			__func__);
+		return NULL;
+	}
+
+	group->name = "clk-ext";
+	group->servicegroup_id = servicegroup_id;
+	group->servicegroup_version =
+		RPMI_BASE_VERSION(RPMI_SPEC_VERSION_MAJOR, RPMI_SPEC_VERSION_MINOR);
+	group->privilege_level_bitmap = clock_group->privilege_level_bitmap;
+	group->max_service_id = RPMI_CLK_EXT_SRV_ID_MAX;
+	group->services = rpmi_clock_ext_services;
+	/* Clock state is shared with the clock group and locked per domain */
+	group->flags = LIBRPMI_SERVICE_GROUP_FLAG_INTERNAL_LOCKING;
+	group->lock = NULL;
+	group->priv = clock_group->priv;
+
+	return group;
+}
+
+void rpmi_service_group_clock_ext_destroy(struct rpmi_service_group *group)
+{
+	if (!group) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return;
 	}
 
-	rpmi_env_free(clkgrp->clock_tree);
-	rpmi_env_free_lock(group->lock);
-	rpmi_env_free(group->priv);
+	rpmi_free(group);
 }
@@ -6,6 +6,7 @@
  */
 
 #include <librpmi.h>
+#include "librpmi_internal.h"
 
 #undef DEBUG
 
@@ -46,11 +47,32 @@ struct rpmi_cppc_fastchan {
 
 	rpmi_uint64_t perf_request_shmem_offset;
 	rpmi_uint64_t perf_feedback_shmem_offset;
+	/** Distance between per-hart fastchannel entries */
+	rpmi_uint32_t stride;
 	/**
 	 * Array to shadow the Performance Request
 	 * fastchannels for all harts.
 	 */
 	union rpmi_cppc_perf_request_fastchan *hart_perf_request;
+	/**
+	 * Scratch buffer to read the Performance Request
+	 * fastchannels for all harts in one shmem read.
+	 */
+	rpmi_uint8_t *hart_perf_request_scratch;
+	/** Size of the scratch buffer in bytes */
+	rpmi_size_t scratch_size;
+	/**
+	 * Arena selected when the fastchannels were created. The scratch
+	 * buffer can only be grown once if the arena never gives memory back.
+	 */
+	struct rpmi_arena *arena;
+	rpmi_bool_t scratch_grown;
+
+	/** Doorbell details (doorbell_width < 0 if no doorbell) */
+	rpmi_int32_t doorbell_width;
+	rpmi_uint64_t doorbell_addr;
+	rpmi_uint64_t doorbell_set_mask;
+	rpmi_uint64_t doorbell_preserve_mask;
 };
 
 struct rpmi_cppc_group {
@@ -72,6 +94,18 @@ struct rpmi_cppc_group {
 	/** CPPC fast channel */
 	struct rpmi_cppc_fastchan *fastchan_ctx;
 
+	/** Frequency domains (domain_count is 0 if not configured) */
+	rpmi_uint32_t domain_count;
+	enum rpmi_cppc_domain_policy domain_policy;
+	/** Hart indexes grouped by domain */
+	rpmi_uint32_t *domain_harts;
+	/** Domain start offsets in domain_harts (domain_count + 1 entries) */
+	rpmi_uint32_t *domain_start;
+	/** Domain of each hart */
+	rpmi_uint32_t *hart_domain;
+	/** Bitmap of domains with a changed desired_perf */
+	rpmi_uint32_t *domain_pending;
+
 	/** Private data of platform cppc operations */
 	const struct rpmi_cppc_platform_ops *ops;
 	void *ops_priv;
@@ -99,7 +133,7 @@ __cppc_hart_fc_perf_request_offset(struct rpmi_cppc_fastchan *fastchan_ctx,
 			      rpmi_uint32_t hart_index)
 {
 	rpmi_uint64_t offset = fastchan_ctx->perf_request_shmem_offset +
-			(hart_index * sizeof(union rpmi_cppc_perf_request_fastchan));
+			(hart_index * fastchan_ctx->stride);
 	return offset;
 }
 
@@ -111,7 +145,7 @@ __cppc_hart_fc_perf_feedback_offset(struct rpmi_cppc_fastchan *fastchan_ctx,
 			       rpmi_uint32_t hart_index)
 {
 	rpmi_uint64_t offset = fastchan_ctx->perf_feedback_shmem_offset +
-			(hart_index * sizeof(struct rpmi_cppc_perf_feedback_fastchan));
+			(hart_index * fastchan_ctx->stride);
 	return offset;
 }
 
@@ -514,8 +548,14 @@ rpmi_cppc_sg_get_fast_channel_region(struct rpmi_service_group *group,
 	fastchan_region_base = rpmi_shmem_base(cppcgrp->fastchan_ctx->shmem);
 	fastchan_region_size = rpmi_shmem_size(cppcgrp->fastchan_ctx->shmem);
 
-	/* No doorbell, and mode is passive */
+	/* Mode is passive */
 	flags = 0;
+	if (cppcgrp->fastchan_ctx->doorbell_width >= 0) {
+		flags |= RPMI_CPPC_FAST_CHANNEL_FLAGS_DB_SUPPORTED;
+		flags |= ((rpmi_uint32_t)cppcgrp->fastchan_ctx->doorbell_width <<
+			  RPMI_CPPC_FAST_CHANNEL_FLAGS_DB_WIDTH_POS) &
+			 RPMI_CPPC_FAST_CHANNEL_FLAGS_DB_WIDTH_MASK;
+	}
 
 	status = RPMI_SUCCESS;
 	resp[1] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)flags);
@@ -528,17 +568,23 @@ rpmi_cppc_sg_get_fast_channel_region(struct rpmi_service_group *group,
 	/* fast channel region size high */
 	resp[5] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)(fastchan_region_size >> 32));
 	/* doorbell addr low */
-	resp[6] = 0;
+	resp[6] = rpmi_to_xe32(trans->is_be,
+			(rpmi_uint32_t)cppcgrp->fastchan_ctx->doorbell_addr);
 	/* doorbell addr high */
-	resp[7] = 0;
+	resp[7] = rpmi_to_xe32(trans->is_be,
+			(rpmi_uint32_t)(cppcgrp->fastchan_ctx->doorbell_addr >> 32));
 	/* doorbell set mask low */
-	resp[8] = 0;
+	resp[8] = rpmi_to_xe32(trans->is_be,
+			(rpmi_uint32_t)cppcgrp->fastchan_ctx->doorbell_set_mask);
 	/* doorbell set mask high */
-	resp[9] = 0;
+	resp[9] = rpmi_to_xe32(trans->is_be,
+			(rpmi_uint32_t)(cppcgrp->fastchan_ctx->doorbell_set_mask >> 32));
 	/* doorbell preserve mask low */
-	resp[10] = 0;
+	resp[10] = rpmi_to_xe32(trans->is_be,
+			(rpmi_uint32_t)cppcgrp->fastchan_ctx->doorbell_preserve_mask);
 	/* doorbell preserve mask high */
-	resp[11] = 0;
+	resp[11] = rpmi_to_xe32(trans->is_be,
+			(rpmi_uint32_t)(cppcgrp->fastchan_ctx->doorbell_preserve_mask >> 32));
 
 	resp_dlen = 12 * sizeof(*resp);
 
@@ -607,13 +653,13 @@ rpmi_cppc_sg_get_hart_list(struct rpmi_service_group *group,
 			   rpmi_uint8_t *response_data)
 {
 	enum rpmi_error status;
-	rpmi_uint32_t start_index, max_entries, hart_count, hart_id;
+	rpmi_uint32_t start_index, max_entries, hart_count;
 	struct rpmi_cppc_group *cppcgrp = group->priv;
 	rpmi_uint32_t *resp = (void *)response_data;
-	rpmi_uint32_t returned, remaining, i;
+	rpmi_uint32_t returned, remaining;
 
 	hart_count = rpmi_hsm_hart_count(cppcgrp->hsm);
-	max_entries = RPMI_MSG_DATA_SIZE(trans->slot_size) - (3 * sizeof(*resp));
+	max_entries = RPMI_MSG_DATA_SIZE(rpmi_transport_slot_size(trans)) - (3 * sizeof(*resp));
 	max_entries = rpmi_env_div32(max_entries, sizeof(*resp));
 
 	start_index = rpmi_to_xe32(trans->is_be, ((const rpmi_uint32_t *)request_data)[0]);
@@ -621,10 +667,9 @@ rpmi_cppc_sg_get_hart_list(struct rpmi_service_group *group,
 	if (start_index <= hart_count) {
 		returned = max_entries < (hart_count - start_index) ?
 			max_entries : (hart_count - start_index);
-		for (i = 0; i < returned; i++) {
-			hart_id = rpmi_hsm_hart_index2id(cppcgrp->hsm, start_index + i);
-			resp[3 + i] = rpmi_to_xe32(trans->is_be, hart_id);
-		}
+		rpmi_copy_le32_table(trans, &resp[3],
+				     rpmi_hsm_hart_id_table_le(cppcgrp->hsm) + start_index,
+				     returned);
 		remaining = hart_count - (start_index + returned);
 		status = RPMI_SUCCESS;
 	} else {
@@ -680,21 +725,121 @@ static struct rpmi_service rpmi_cppc_services[RPMI_CPPC_SRV_ID_MAX] = {
 	},
 };
 
+/**
+ * Aggregate the desired_perf of all harts in a frequency domain
+ * as per the domain policy. Harts without a request are ignored.
+ */
+static rpmi_uint32_t __cppc_domain_desired_perf(struct rpmi_cppc_group *cppcgrp,
+					       rpmi_uint32_t domain)
+{
+	rpmi_uint32_t i, perf, domain_perf = 0;
+	union rpmi_cppc_perf_request_fastchan *hart_perf_request =
+				cppcgrp->fastchan_ctx->hart_perf_request;
+
+	for (i = cppcgrp->domain_start[domain];
+	     i < cppcgrp->domain_start[domain + 1]; i++) {
+		perf = hart_perf_request[cppcgrp->domain_harts[i]].passive.desired_perf;
+		if (!perf)
+			continue;
+
+		if (!domain_perf)
+			domain_perf = perf;
+		else if (cppcgrp->domain_policy == RPMI_CPPC_DOMAIN_POLICY_MIN_PERF)
+			domain_perf = RPMI_MIN(domain_perf, perf);
+		else
+			domain_perf = RPMI_MAX(domain_perf, perf);
+	}
+
+	return domain_perf;
+}
+
+/**
+ * Update the performance level of a frequency domain and report
+ * the resulting frequency to every hart of the domain.
+ */
+static enum rpmi_error __cppc_update_domain(struct rpmi_cppc_group *cppcgrp,
+					    rpmi_uint32_t domain)
+{
+	enum rpmi_error status = RPMI_SUCCESS, update_status;
+	struct rpmi_shmem_iovec iov[8];
+	rpmi_uint32_t i, n, desired_perf;
+	rpmi_uint64_t current_freq;
+
+	desired_perf = __cppc_domain_desired_perf(cppcgrp, domain);
+	if (!desired_perf)
+		return RPMI_SUCCESS;
+
+	/**
+	 * Like the per-hart update, a failed update is reflected
+	 * in the performance feedback of the domain harts but the
+	 * platform error is still returned to the caller.
+	 */
+	update_status = cppcgrp->ops->cppc_update_domain_perf(cppcgrp->ops_priv,
+							      domain,
+							      desired_perf);
+	if (update_status)
+		DPRINTF("%s: domain %u perf update failed (error %d)\n",
+			__func__, domain, update_status);
+	cppcgrp->ops->cppc_get_current_freq(cppcgrp->ops_priv,
+				cppcgrp->domain_harts[cppcgrp->domain_start[domain]],
+				&current_freq);
+
+	/* Feedback of the domain harts is written in bursts of ranges */
+	for (i = cppcgrp->domain_start[domain], n = 0;
+	     i < cppcgrp->domain_start[domain + 1]; i++) {
+		iov[n].offset = __cppc_hart_fc_perf_feedback_offset(cppcgrp->fastchan_ctx,
+							cppcgrp->domain_harts[i]);
+		iov[n].len = sizeof(current_freq);
+		iov[n].buf = &current_freq;
+		if (++n < array_size(iov) &&
+		    i + 1 < cppcgrp->domain_start[domain + 1])
+			continue;
+
+		status = rpmi_shmem_writev(cppcgrp->fastchan_ctx->shmem, iov, n);
+		if (status)
+			break;
+		n = 0;
+	}
+
+	return update_status ? update_status : status;
+}
+
 static enum rpmi_error rpmi_cppc_process_events(struct rpmi_service_group *group)
 {
 
-	enum rpmi_error status = RPMI_SUCCESS;
-	rpmi_uint32_t hart_idx, desired_perf;
+	enum rpmi_error status = RPMI_SUCCESS, domain_status;
+	rpmi_uint32_t hart_idx, desired_perf, domain, i, bits;
 	rpmi_uint64_t current_freq;
 	union rpmi_cppc_perf_request_fastchan *hart_perf_request;
 	struct rpmi_cppc_group *cppcgrp = group->priv;
+	struct rpmi_cppc_fastchan *fc = cppcgrp->fastchan_ctx;
+
+	/**
+	 * Read the perf request fastchannels of all harts in one go
+	 * instead of one shmem access (and cache maintenance) per hart.
+	 */
+	status = rpmi_shmem_read(fc->shmem, fc->perf_request_shmem_offset,
+				 fc->hart_perf_request_scratch,
+				 cppcgrp->hart_count * fc->stride);
+	if (status)
+		return status;
 
 	for (hart_idx = 0; hart_idx < cppcgrp->hart_count; hart_idx++) {
-		hart_perf_request = &cppcgrp->fastchan_ctx->hart_perf_request[hart_idx];
-		desired_perf = __cppc_get_fc_desired_perf(cppcgrp, hart_idx);
+		hart_perf_request = &fc->hart_perf_request[hart_idx];
+		desired_perf = ((union rpmi_cppc_perf_request_fastchan *)
+			&fc->hart_perf_request_scratch[hart_idx * fc->stride])->passive.desired_perf;
 
 		if (hart_perf_request->passive.desired_perf != desired_perf) {
 			hart_perf_request->passive.desired_perf = desired_perf;
+
+			/* Domain harts are updated together below */
+			if (cppcgrp->domain_count) {
+				domain = cppcgrp->hart_domain[hart_idx];
+				cppcgrp->domain_pending[domain / RPMI_BITS_PER_WORD32] |=
+					1U << (domain % RPMI_BITS_PER_WORD32);
+				continue;
+			}
+
 			status = cppcgrp->ops->cppc_update_perf(cppcgrp->ops_priv,
 					   hart_idx,
 					   desired_perf);
@@ -713,19 +858,32 @@ static enum rpmi_error rpmi_cppc_process_events(struct rpmi_service_group *group
 		}
 	}
 
+	for (i = 0; i < RPMI_BITMAP_WORDS32(cppcgrp->domain_count); i++) {
+		bits = cppcgrp->domain_pending[i];
+		cppcgrp->domain_pending[i] = 0;
+		while (bits) {
+			domain = i * RPMI_BITS_PER_WORD32 + __builtin_ctz(bits);
+			bits &= bits - 1;
+			domain_status = __cppc_update_domain(cppcgrp, domain);
+			if (domain_status)
+				status = domain_status;
+		}
+	}
+
 	return status;
 }
 
-static struct rpmi_cppc_fastchan *
-rpmi_cppc_fastchan_create(rpmi_uint32_t hart_count,
-			  struct rpmi_shmem *shmem_fastchan,
-			  rpmi_uint64_t perf_request_shmem_offset,
-			  rpmi_uint64_t perf_feedback_shmem_offset)
+/**
+ * Check the fastchannel layout for a given per-hart entry stride
+ */
+static enum rpmi_error
+rpmi_cppc_fastchan_check_layout(rpmi_uint32_t hart_count,
+				struct rpmi_shmem *shmem_fastchan,
+				rpmi_uint64_t perf_request_shmem_offset,
+				rpmi_uint64_t perf_feedback_shmem_offset,
+				rpmi_uint32_t stride)
 {
-	struct rpmi_cppc_fastchan *cppc_fastchan_ctx;
-	rpmi_size_t fc_perf_request_region_size, fc_perf_feedback_region_size;
-	union rpmi_cppc_perf_request_fastchan *fc_hart_perf_request_array;
-
+	rpmi_size_t fc_region_size;
 	rpmi_uint32_t shmem_size = rpmi_shmem_size(shmem_fastchan);
 	rpmi_uint64_t shmem_base = rpmi_shmem_base(shmem_fastchan);
 
@@ -733,7 +891,7 @@ rpmi_cppc_fastchan_create(rpmi_uint32_t hart_count,
 	if (!shmem_size || (shmem_size & (shmem_size - 1))) {
 		DPRINTF("%s: CPPC fastchan shmem size not power-of-2\n",
 		__func__);
-		return NULL;
+		return RPMI_ERR_INVALID_PARAM;
 	}
 
 	/**
@@ -743,9 +901,9 @@ rpmi_cppc_fastchan_create(rpmi_uint32_t hart_count,
 		perf_feedback_shmem_offset > shmem_size ) {
 		DPRINTF("%s: CPPC fastchan offsets are outside shmem region\n",
 		__func__);
-		return NULL;
+		return RPMI_ERR_INVALID_PARAM;
 	}
-	
+
 	/**
 	 * RPMI requires shmem_base to be aligned to fastchannel size. But
 	 * RPMI does not mandate positions of Perf Request fastchannel and
@@ -755,100 +913,107 @@ rpmi_cppc_fastchan_create(rpmi_uint32_t hart_count,
 	 * for all the fastchannels for all harts.
 	 *
 	 * Due to that, check the alignment of perf_request and perf_feedback
-	 * addresses in that shared memory region.
+	 * addresses in that shared memory region. Both are aligned to the
+	 * entry stride so padded entries never share a cache line.
 	 */
 	if ((shmem_base & (RPMI_CPPC_FASTCHAN_SIZE - 1)) ||
-		(perf_request_shmem_offset & (RPMI_CPPC_FASTCHAN_SIZE - 1)) ||
-		(perf_feedback_shmem_offset & (RPMI_CPPC_FASTCHAN_SIZE - 1))) {
+		(perf_request_shmem_offset & (stride - 1)) ||
+		(perf_feedback_shmem_offset & (stride - 1))) {
 		DPRINTF("%s: CPPC fastchan shmem base not aligned to fastchan size\n",
 		__func__);
-		return NULL;
+		return RPMI_ERR_INVALID_PARAM;
 	}
 
-
-	fc_perf_request_region_size =
-		hart_count * sizeof(union rpmi_cppc_perf_request_fastchan);
-	fc_perf_feedback_region_size =
-		hart_count * sizeof(struct rpmi_cppc_perf_feedback_fastchan);
-
 	/**
-	 * Check if the perf request and perf feedback regions overlaps
-	 * with each other
+	 * Both subregions must fit in the shared memory region which
+	 * must accommodate fast channel entries for all harts.
 	 */
-
-	if (perf_request_shmem_offset == perf_feedback_shmem_offset) {
-		DPRINTF("%s: Perf request region overlaps with Perf Feedback region\n",
-		__func__);
-		return NULL;
-	}
-
-	if (perf_request_shmem_offset < perf_feedback_shmem_offset &&
-		perf_feedback_shmem_offset < fc_perf_request_region_size) {
-		DPRINTF("%s: Perf request region overlaps with Perf Feedback region\n",
+	fc_region_size = (rpmi_size_t)hart_count * stride;
+	if (perf_request_shmem_offset + fc_region_size > shmem_size ||
+		perf_feedback_shmem_offset + fc_region_size > shmem_size) {
+		DPRINTF("%s: CPPC fastchan shmem size less than required\n",
 		__func__);
-		return NULL;
+		return RPMI_ERR_INVALID_PARAM;
 	}
 
-	if (perf_feedback_shmem_offset < perf_request_shmem_offset &&
-		perf_request_shmem_offset < fc_perf_feedback_region_size) {
+	/**
+	 * Check if the perf request and perf feedback regions overlaps
+	 * with each other
+	 */
+	if (perf_request_shmem_offset < perf_feedback_shmem_offset + fc_region_size &&
+		perf_feedback_shmem_offset < perf_request_shmem_offset + fc_region_size) {
 		DPRINTF("%s: Perf request region overlaps with Perf Feedback region\n",
 		__func__);
-		return NULL;
+		return RPMI_ERR_INVALID_PARAM;
 	}
 
 	/**
-	 * LATER: Currently its assumed that the Perf Request fastchannels subregion
-	 * will be consequtive to Perf Feedback fastchannels subregion. This means
-	 * that the Hart(0) Perf Feedback fastchannel will be right next to the
-	 * Hart(N-1) Perf Request fastchannel, may possibily sharing the same cache
-	 * line and subject to performance penealty due to false sharing.
-	 *
-	 * This can be avoided if a memory gaurd is added inbetween the two
-	 * subregions of atleast 64-bytes.
-	 * This arrangement may incur a performance penalty.
+	 * With the default stride, the Hart(0) Perf Feedback fastchannel may be
+	 * right next to the Hart(N-1) Perf Request fastchannel, possibly sharing
+	 * the same cache line and subject to performance penalty due to false
+	 * sharing. Platforms can avoid this with a LIBRPMI_CACHE_LINE_SIZE stride
+	 * using rpmi_service_group_cppc_set_fastchan_stride().
 	 */
 
-	/**
-	 * total shared memory size must accommodate fast channel
-	 * entries for all harts
-	 */
-	if (shmem_size < (fc_perf_request_region_size + fc_perf_feedback_region_size)) {
-		DPRINTF("%s: CPPC fastchan shmem size less than required\n",
-		__func__);
-		return NULL;
-	}
+	return RPMI_SUCCESS;
+}
 
-	/**
-	 * check if shared memory base address is aligned to the
-	 * maximum of the fast channel sizes in both types
-	 */
-	if (shmem_base & (RPMI_CPPC_FASTCHAN_SIZE - 1))
+static struct rpmi_cppc_fastchan *
+rpmi_cppc_fastchan_create(rpmi_uint32_t hart_count,
+			  struct rpmi_shmem *shmem_fastchan,
+			  rpmi_uint64_t perf_request_shmem_offset,
+			  rpmi_uint64_t perf_feedback_shmem_offset)
+{
+	struct rpmi_cppc_fastchan *cppc_fastchan_ctx;
+	rpmi_size_t fc_perf_request_region_size;
+	union rpmi_cppc_perf_request_fastchan *fc_hart_perf_request_array;
+
+	if (rpmi_cppc_fastchan_check_layout(hart_count, shmem_fastchan,
+					    perf_request_shmem_offset,
+					    perf_feedback_shmem_offset,
+					    RPMI_CPPC_FASTCHAN_SIZE))
 		return NULL;
 
-	if (rpmi_shmem_fill(shmem_fastchan, 0, 0, shmem_size))
+	if (rpmi_shmem_fill(shmem_fastchan, 0, 0, rpmi_shmem_size(shmem_fastchan)))
 		return NULL;
 
 	/** CPPC service group fastchannel context instance allocation */
-	cppc_fastchan_ctx = rpmi_env_zalloc(sizeof(*cppc_fastchan_ctx));
+	cppc_fastchan_ctx = rpmi_zalloc(sizeof(*cppc_fastchan_ctx));
 	if (!cppc_fastchan_ctx) {
 		DPRINTF("%s: failed to allocate cppc fastchannel instance\n",
 		__func__);
 		return NULL;
 	}
 
+	fc_perf_request_region_size =
+		hart_count * sizeof(union rpmi_cppc_perf_request_fastchan);
 	fc_hart_perf_request_array =
-		rpmi_env_zalloc(fc_perf_request_region_size);
+		rpmi_zalloc(fc_perf_request_region_size);
 	if (!fc_hart_perf_request_array) {
 		DPRINTF("%s: failed to allocate perf_request fastchannel array\n",
 		__func__);
-		rpmi_env_free(cppc_fastchan_ctx);
+		rpmi_free(cppc_fastchan_ctx);
 		return NULL;
 	}
 
+	cppc_fastchan_ctx->hart_perf_request_scratch =
+		rpmi_zalloc(hart_count * RPMI_CPPC_FASTCHAN_SIZE);
+	if (!cppc_fastchan_ctx->hart_perf_request_scratch) {
+		DPRINTF("%s: failed to allocate perf_request scratch buffer\n",
+		__func__);
+		rpmi_free(fc_hart_perf_request_array);
+		rpmi_free(cppc_fastchan_ctx);
+		return NULL;
+	}
+	cppc_fastchan_ctx->scratch_size = hart_count * RPMI_CPPC_FASTCHAN_SIZE;
+	cppc_fastchan_ctx->arena = rpmi_arena_selected();
+
 	cppc_fastchan_ctx->hart_perf_request = fc_hart_perf_request_array;
+	cppc_fastchan_ctx->doorbell_width = -1;
 	cppc_fastchan_ctx->shmem = shmem_fastchan;
 	cppc_fastchan_ctx->perf_request_shmem_offset = perf_request_shmem_offset;
 	cppc_fastchan_ctx->perf_feedback_shmem_offset = perf_feedback_shmem_offset;
+	cppc_fastchan_ctx->stride = RPMI_CPPC_FASTCHAN_SIZE;
 
 	return cppc_fastchan_ctx;
 }
@@ -879,7 +1044,7 @@ rpmi_service_group_cppc_create(struct rpmi_hsm *hsm,
 	}
 
 	/** allocate cppc group instance memory */
-	cppcgrp = rpmi_env_zalloc(sizeof(*cppcgrp));
+	cppcgrp = rpmi_zalloc(sizeof(*cppcgrp));
 	if (!cppcgrp) {
 		DPRINTF("%s: failed to allocate cppc service group instance\n",
 		__func__);
@@ -890,7 +1055,7 @@ rpmi_service_group_cppc_create(struct rpmi_hsm *hsm,
 	if (!hart_count) {
 		DPRINTF("%s: hart count is 0, failed to create cppc group\n",
 		__func__);
-		rpmi_env_free(cppcgrp);
+		rpmi_free(cppcgrp);
 		return NULL;
 	}
 
@@ -900,7 +1065,7 @@ rpmi_service_group_cppc_create(struct rpmi_hsm *hsm,
 						      perf_feedback_shmem_offset);
 	if (!cppc_fastchan_ctx) {
 		DPRINTF("%s: failed to create cppc fastchannel\n", __func__);
-		rpmi_env_free(cppcgrp);
+		rpmi_free(cppcgrp);
 		return NULL;
 	}
 
@@ -943,6 +1108,168 @@ rpmi_service_group_cppc_create(struct rpmi_hsm *hsm,
 	return group;
 }
 
+enum rpmi_error
+rpmi_service_group_cppc_set_doorbell(struct rpmi_service_group *group,
+				     enum rpmi_cppc_doorbell_width width,
+				     rpmi_uint64_t addr,
+				     rpmi_uint64_t set_mask,
+				     rpmi_uint64_t preserve_mask)
+{
+	struct rpmi_cppc_fastchan *fc;
+
+	if (!group || width >= RPMI_CPPC_DOORBELL_WIDTH_MAX_IDX) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	/* RPMI contexts decide whether to poll a group when it is added */
+	if (group->num_contexts) {
+		DPRINTF("%s: %s: group already added to a context\n",
+			__func__, group->name);
+		return RPMI_ERR_INVALID_STATE;
+	}
+
+	fc = ((struct rpmi_cppc_group *)group->priv)->fastchan_ctx;
+	fc->doorbell_width = width;
+	fc->doorbell_addr = addr;
+	fc->doorbell_set_mask = set_mask;
+	fc->doorbell_preserve_mask = preserve_mask;
+
+	/* Fastchannels are only scanned after the doorbell is rung */
+	group->flags |= LIBRPMI_SERVICE_GROUP_FLAG_EVENTS_ON_SIGNAL;
+
+	return RPMI_SUCCESS;
+}
+
+enum rpmi_error
+rpmi_service_group_cppc_set_fastchan_stride(struct rpmi_service_group *group,
+					    rpmi_uint32_t stride)
+{
+	struct rpmi_cppc_group *cppcgrp;
+	struct rpmi_cppc_fastchan *fc;
+	rpmi_uint8_t *scratch, *old;
+	rpmi_size_t size;
+
+	if (!group || stride < RPMI_CPPC_FASTCHAN_SIZE || (stride & (stride - 1))) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	cppcgrp = group->priv;
+	fc = cppcgrp->fastchan_ctx;
+	if (rpmi_cppc_fastchan_check_layout(cppcgrp->hart_count, fc->shmem,
+					    fc->perf_request_shmem_offset,
+					    fc->perf_feedback_shmem_offset,
+					    stride))
+		return RPMI_ERR_INVALID_PARAM;
+
+	/* Event processing reads the fastchannels with the group lock held */
+	size = cppcgrp->hart_count * stride;
+	if (size <= fc->scratch_size) {
+		rpmi_env_lock(group->lock);
+		fc->stride = stride;
+		rpmi_env_unlock(group->lock);
+		return RPMI_SUCCESS;
+	}
+
+	/* Scratch buffers carved out of an arena are never given back */
+	if (fc->scratch_grown && !rpmi_arena_reclaimable(fc->arena)) {
+		DPRINTF("%s: scratch buffer in arena already grown\n", __func__);
+		return RPMI_ERR_ALREADY;
+	}
+
+	scratch = rpmi_arena_zalloc(fc->arena, size);
+	if (!scratch) {
+		DPRINTF("%s: failed to allocate perf_request scratch buffer\n",
+			__func__);
+		return RPMI_ERR_FAILED;
+	}
+
+	rpmi_env_lock(group->lock);
+	old = fc->hart_perf_request_scratch;
+	fc->hart_perf_request_scratch = scratch;
+	fc->scratch_size = size;
+	fc->scratch_grown = true;
+	fc->stride = stride;
+	rpmi_env_unlock(group->lock);
+	rpmi_arena_free(fc->arena, old);
+
+	return RPMI_SUCCESS;
+}
+
+enum rpmi_error
+rpmi_service_group_cppc_set_domains(struct rpmi_service_group *group,
+				    rpmi_uint32_t domain_count,
+				    const rpmi_uint32_t *hart_domain,
+				    enum rpmi_cppc_domain_policy policy)
+{
+	rpmi_uint32_t i, domain, pos, words, *buf, *domain_harts, *domain_start;
+	struct rpmi_cppc_group *cppcgrp;
+
+	if (!group || !domain_count || !hart_domain ||
+	    policy >= RPMI_CPPC_DOMAIN_POLICY_MAX_IDX) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	cppcgrp = group->priv;
+	if (!cppcgrp->ops->cppc_update_domain_perf) {
+		DPRINTF("%s: domains not supported\n", __func__);
+		return RPMI_ERR_INVALID_STATE;
+	}
+
+	for (i = 0; i < cppcgrp->hart_count; i++) {
+		if (hart_domain[i] >= domain_count) {
+			DPRINTF("%s: invalid domain for hart index %u\n",
+				__func__, i);
+			return RPMI_ERR_INVALID_PARAM;
+		}
+	}
+
+	/* All domain tables share a single allocation */
+	words = RPMI_BITMAP_WORDS32(domain_count);
+	buf = rpmi_zalloc(sizeof(*buf) *
+			      (2 * cppcgrp->hart_count + domain_count + 1 + words));
+	if (!buf) {
+		DPRINTF("%s: failed to allocate domain tables\n", __func__);
+		return RPMI_ERR_FAILED;
+	}
+	domain_harts = &buf[cppcgrp->hart_count];
+	domain_start = &buf[2 * cppcgrp->hart_count];
+
+	/* Group hart indexes by domain (done once so kept simple) */
+	for (domain = 0, pos = 0; domain < domain_count; domain++) {
+		domain_start[domain] = pos;
+		for (i = 0; i < cppcgrp->hart_count; i++) {
+			buf[i] = hart_domain[i];
+			if (hart_domain[i] == domain)
+				domain_harts[pos++] = i;
+		}
+	}
+	domain_start[domain_count] = pos;
+
+	/*
+	 * Event processing reads the domain tables with the group lock held
+	 * so publish them under the lock with domain_count written last.
+	 */
+	rpmi_env_lock(group->lock);
+	if (cppcgrp->domain_count) {
+		rpmi_env_unlock(group->lock);
+		rpmi_free(buf);
+		DPRINTF("%s: domains already set\n", __func__);
+		return RPMI_ERR_INVALID_STATE;
+	}
+	cppcgrp->hart_domain = buf;
+	cppcgrp->domain_harts = domain_harts;
+	cppcgrp->domain_start = domain_start;
+	cppcgrp->domain_pending = &buf[2 * cppcgrp->hart_count + domain_count + 1];
+	cppcgrp->domain_policy = policy;
+	cppcgrp->domain_count = domain_count;
+	rpmi_env_unlock(group->lock);
+
+	return RPMI_SUCCESS;
+}
+
 void rpmi_service_group_cppc_destroy(struct rpmi_service_group *group)
 {
 	struct rpmi_cppc_group *cppcgrp;
@@ -953,8 +1280,10 @@ void rpmi_service_group_cppc_destroy(struct rpmi_service_group *group)
 	}
 
 	cppcgrp = group->priv;
-	rpmi_env_free(cppcgrp->fastchan_ctx->hart_perf_request);
-	rpmi_env_free(cppcgrp->fastchan_ctx);
+	rpmi_free(cppcgrp->hart_domain);
+	rpmi_free(cppcgrp->fastchan_ctx->hart_perf_request_scratch);
+	rpmi_free(cppcgrp->fastchan_ctx->hart_perf_request);
+	rpmi_free(cppcgrp->fastchan_ctx);
 	rpmi_env_free_lock(group->lock);
-	rpmi_env_free(group->priv);
+	rpmi_free(group->priv);
 }
@@ -5,6 +5,7 @@
  */
 
 #include <librpmi.h>
+#include "librpmi_internal.h"
 
 #undef DEBUG
 
@@ -141,14 +142,14 @@ static enum rpmi_error rpmi_hsm_sg_get_hart_list(struct rpmi_service_group *grou
 						 rpmi_uint16_t *response_datalen,
 						 rpmi_uint8_t *response_data)
 {
-	rpmi_uint32_t start_index, max_entries, hart_count, hart_id;
+	rpmi_uint32_t start_index, max_entries, hart_count;
 	struct rpmi_hsm_group *sghsm = group->priv;
 	rpmi_uint32_t *resp = (void *)response_data;
-	rpmi_uint32_t returned, remaining, i;
+	rpmi_uint32_t returned, remaining;
 	enum rpmi_error status;
 
 	hart_count = rpmi_hsm_hart_count(sghsm->hsm);
-	max_entries = RPMI_MSG_DATA_SIZE(trans->slot_size) - (3 * sizeof(*resp));
+	max_entries = RPMI_MSG_DATA_SIZE(rpmi_transport_slot_size(trans)) - (3 * sizeof(*resp));
 	max_entries = rpmi_env_div32(max_entries, sizeof(*resp));
 
 	start_index = rpmi_to_xe32(trans->is_be, ((const rpmi_uint32_t *)request_data)[0]);
@@ -156,10 +157,9 @@ static enum rpmi_error rpmi_hsm_sg_get_hart_list(struct rpmi_service_group *grou
 	if (start_index <= hart_count) {
 		returned = max_entries < (hart_count - start_index) ?
 			   max_entries : (hart_count - start_index);
-		for (i = 0; i < returned; i++) {
-			hart_id = rpmi_hsm_hart_index2id(sghsm->hsm, start_index + i);
-			resp[3 + i] = rpmi_to_xe32(trans->is_be, hart_id);
-		}
+		rpmi_copy_le32_table(trans, &resp[3],
+				     rpmi_hsm_hart_id_table_le(sghsm->hsm) + start_index,
+				     returned);
 		remaining = hart_count - (start_index + returned);
 		status = RPMI_SUCCESS;
 	} else {
@@ -185,14 +185,13 @@ static enum rpmi_error rpmi_hsm_sg_get_suspend_types(struct rpmi_service_group *
 						     rpmi_uint8_t *response_data)
 {
 	rpmi_uint32_t start_index, max_entries, type_count;
-	const struct rpmi_hsm_suspend_type *suspend_type;
 	struct rpmi_hsm_group *sghsm = group->priv;
 	rpmi_uint32_t *resp = (void *)response_data;
-	rpmi_uint32_t returned, remaining, i;
+	rpmi_uint32_t returned, remaining;
 	enum rpmi_error status;
 
 	type_count = rpmi_hsm_get_suspend_type_count(sghsm->hsm);
-	max_entries = RPMI_MSG_DATA_SIZE(trans->slot_size) - (3 * sizeof(*resp));
+	max_entries = RPMI_MSG_DATA_SIZE(rpmi_transport_slot_size(trans)) - (3 * sizeof(*resp));
 	max_entries = rpmi_env_div32(max_entries, sizeof(*resp));
 
 	start_index = rpmi_to_xe32(trans->is_be, ((const rpmi_uint32_t *)request_data)[0]);
@@ -200,10 +199,9 @@ static enum rpmi_error rpmi_hsm_sg_get_suspend_types(struct rpmi_service_group *
 	if (start_index <= type_count) {
 		returned = max_entries < (type_count - start_index) ?
 			   max_entries : (type_count - start_index);
-		for (i = 0; i < returned; i++) {
-			suspend_type = rpmi_hsm_get_suspend_type(sghsm->hsm, start_index + i);
-			resp[3 + i] = rpmi_to_xe32(trans->is_be, suspend_type->type);
-		}
+		rpmi_copy_le32_table(trans, &resp[3],
+				     rpmi_hsm_suspend_type_table_le(sghsm->hsm) + start_index,
+				     returned);
 		remaining = type_count - (start_index + returned);
 		status = RPMI_SUCCESS;
 	} else {
@@ -320,7 +318,7 @@ struct rpmi_service_group *rpmi_service_group_hsm_create(struct rpmi_hsm *hsm)
 	}
 
 	/* Allocate HSM group */
-	sghsm = rpmi_env_zalloc(sizeof(*sghsm));
+	sghsm = rpmi_zalloc(sizeof(*sghsm));
 	if (!sghsm) {
 		DPRINTF("%s: failed to allocate HSM service group instance\n",
 			__func__);
@@ -352,5 +350,5 @@ void rpmi_service_group_hsm_destroy(struct rpmi_service_group *group)
 		return;
 	}
 
-	rpmi_env_free(group->priv);
+	rpmi_free(group->priv);
 }
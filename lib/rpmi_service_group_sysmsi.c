@@ -5,6 +5,7 @@
  */
 
 #include <librpmi.h>
+#include "librpmi_internal.h"
 
 #undef DEBUG
 
@@ -14,12 +15,8 @@
 #define DPRINTF(msg...)
 #endif
 
-struct rpmi_sysmsi_irq {
-	/** MSI state */
-	rpmi_bool_t msi_enable;
-	rpmi_bool_t msi_pending;
-	/** MSI target */
-	rpmi_bool_t msi_valid;
+/** System MSI target (only touched when the MSI is delivered or queried) */
+struct rpmi_sysmsi_target {
 	rpmi_uint64_t msi_addr;
 	rpmi_uint32_t msi_data;
 };
@@ -29,8 +26,16 @@ struct rpmi_sysmsi_group {
 	rpmi_uint32_t num_msi;
 	rpmi_uint32_t p2a_msi_index;
 
-	/** Array of system MSIs */
-	struct rpmi_sysmsi_irq *msis;
+	/** Array of system MSI targets */
+	struct rpmi_sysmsi_target *targets;
+
+	/**
+	 * Bitmaps of system MSI state which share a single allocation
+	 * so that the deliverable MSIs are obtained by ANDing words.
+	 */
+	rpmi_uint32_t *msi_enable;
+	rpmi_uint32_t *msi_pending;
+	rpmi_uint32_t *msi_valid;
 
 	/** Private data of platform cppc operations */
 	const struct rpmi_sysmsi_platform_ops *ops;
@@ -39,6 +44,27 @@ struct rpmi_sysmsi_group {
 	struct rpmi_service_group group;
 };
 
+static inline rpmi_bool_t rpmi_sysmsi_test_bit(const rpmi_uint32_t *bitmap,
+					       rpmi_uint32_t msi_index)
+{
+	return (bitmap[msi_index / RPMI_BITS_PER_WORD32] &
+		(1U << (msi_index % RPMI_BITS_PER_WORD32))) ? true : false;
+}
+
+static inline void rpmi_sysmsi_set_bit(rpmi_uint32_t *bitmap,
+				       rpmi_uint32_t msi_index)
+{
+	bitmap[msi_index / RPMI_BITS_PER_WORD32] |=
+				1U << (msi_index % RPMI_BITS_PER_WORD32);
+}
+
+static inline void rpmi_sysmsi_clear_bit(rpmi_uint32_t *bitmap,
+					 rpmi_uint32_t msi_index)
+{
+	bitmap[msi_index / RPMI_BITS_PER_WORD32] &=
+				~(1U << (msi_index % RPMI_BITS_PER_WORD32));
+}
+
 static enum rpmi_error rpmi_sysmsi_get_attrs(struct rpmi_service_group *group,
 					     struct rpmi_service *service,
 					     struct rpmi_transport *trans,
@@ -114,7 +140,6 @@ static enum rpmi_error rpmi_sysmsi_set_state(struct rpmi_service_group *group,
 	struct rpmi_sysmsi_group *sgmsi = group->priv;
 	rpmi_uint32_t *resp = (void *)response_data;
 	rpmi_uint32_t state, msi_index;
-	struct rpmi_sysmsi_irq *smsi;
 
 	msi_index = rpmi_to_xe32(trans->is_be,
 				 ((const rpmi_uint32_t *)request_data)[0]);
@@ -126,8 +151,10 @@ static enum rpmi_error rpmi_sysmsi_set_state(struct rpmi_service_group *group,
 
 	state = rpmi_to_xe32(trans->is_be,
 			      ((const rpmi_uint32_t *)request_data)[1]);
-	smsi = &sgmsi->msis[msi_index];
-	smsi->msi_enable = (state & RPMI_SYSMSI_MSI_STATE_ENABLE) ? true : false;
+	if (state & RPMI_SYSMSI_MSI_STATE_ENABLE)
+		rpmi_sysmsi_set_bit(sgmsi->msi_enable, msi_index);
+	else
+		rpmi_sysmsi_clear_bit(sgmsi->msi_enable, msi_index);
 	resp[0] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)RPMI_SUCCESS);
 
 done:
@@ -146,7 +173,6 @@ static enum rpmi_error rpmi_sysmsi_get_state(struct rpmi_service_group *group,
 	struct rpmi_sysmsi_group *sgmsi = group->priv;
 	rpmi_uint32_t *resp = (void *)response_data;
 	rpmi_uint32_t state, msi_index;
-	struct rpmi_sysmsi_irq *smsi;
 	rpmi_uint16_t resp_dlen = 0;
 
 	msi_index = rpmi_to_xe32(trans->is_be,
@@ -158,9 +184,10 @@ static enum rpmi_error rpmi_sysmsi_get_state(struct rpmi_service_group *group,
 		goto done;
 	}
 
-	smsi = &sgmsi->msis[msi_index];
-	state = smsi->msi_enable ? RPMI_SYSMSI_MSI_STATE_ENABLE : 0;
-	state |= smsi->msi_pending ? RPMI_SYSMSI_MSI_STATE_PENDING : 0;
+	state = rpmi_sysmsi_test_bit(sgmsi->msi_enable, msi_index) ?
+		RPMI_SYSMSI_MSI_STATE_ENABLE : 0;
+	state |= rpmi_sysmsi_test_bit(sgmsi->msi_pending, msi_index) ?
+		 RPMI_SYSMSI_MSI_STATE_PENDING : 0;
 	resp[0] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)RPMI_SUCCESS);
 	resp[1] = rpmi_to_xe32(trans->is_be, state);
 	resp_dlen = 2 * sizeof(*resp);
@@ -180,7 +207,7 @@ static enum rpmi_error rpmi_sysmsi_set_target(struct rpmi_service_group *group,
 {
 	struct rpmi_sysmsi_group *sgmsi = group->priv;
 	rpmi_uint32_t *resp = (void *)response_data;
-	struct rpmi_sysmsi_irq *smsi;
+	struct rpmi_sysmsi_target *target;
 	rpmi_uint32_t msi_index;
 	rpmi_uint64_t maddr;
 
@@ -202,11 +229,11 @@ static enum rpmi_error rpmi_sysmsi_set_target(struct rpmi_service_group *group,
 		goto done;
 	}
 
-	smsi = &sgmsi->msis[msi_index];
-	smsi->msi_addr = maddr;
-	smsi->msi_data = rpmi_to_xe32(trans->is_be,
-				      ((const rpmi_uint32_t *)request_data)[3]);
-	smsi->msi_valid = true;
+	target = &sgmsi->targets[msi_index];
+	target->msi_addr = maddr;
+	target->msi_data = rpmi_to_xe32(trans->is_be,
+					((const rpmi_uint32_t *)request_data)[3]);
+	rpmi_sysmsi_set_bit(sgmsi->msi_valid, msi_index);
 	resp[0] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)RPMI_SUCCESS);
 
 done:
@@ -224,7 +251,7 @@ static enum rpmi_error rpmi_sysmsi_get_target(struct rpmi_service_group *group,
 {
 	struct rpmi_sysmsi_group *sgmsi = group->priv;
 	rpmi_uint32_t *resp = (void *)response_data;
-	struct rpmi_sysmsi_irq *smsi;
+	struct rpmi_sysmsi_target *target;
 	rpmi_uint16_t resp_dlen = 0;
 	rpmi_uint32_t msi_index;
 
@@ -237,11 +264,11 @@ static enum rpmi_error rpmi_sysmsi_get_target(struct rpmi_service_group *group,
 		goto done;
 	}
 
-	smsi = &sgmsi->msis[msi_index];
+	target = &sgmsi->targets[msi_index];
 	resp[0] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)RPMI_SUCCESS);
-	resp[1] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)smsi->msi_addr);
-	resp[2] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)(smsi->msi_addr >> 32));
-	resp[3] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)smsi->msi_data);
+	resp[1] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)target->msi_addr);
+	resp[2] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)(target->msi_addr >> 32));
+	resp[3] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)target->msi_data);
 	resp_dlen = 4 * sizeof(*resp);
 
 done:
@@ -287,17 +314,30 @@ static struct rpmi_service rpmi_sysmsi_services[RPMI_SYSMSI_SRV_ID_MAX] = {
 	},
 };
 
+/** Deliver a system MSI which is pending, enabled and has valid target */
+static void rpmi_sysmsi_deliver(struct rpmi_sysmsi_group *sgmsi,
+				rpmi_uint32_t msi_index)
+{
+	struct rpmi_sysmsi_target *target = &sgmsi->targets[msi_index];
+
+	rpmi_trace(RPMI_TRACE_EVENT_MSI_INJECT, 0, 0, msi_index);
+	rpmi_env_writel(target->msi_addr, target->msi_data);
+	rpmi_sysmsi_clear_bit(sgmsi->msi_pending, msi_index);
+}
+
 static enum rpmi_error rpmi_sysmsi_process_events(struct rpmi_service_group *group)
 {
 	struct rpmi_sysmsi_group *sgmsi = group->priv;
-	struct rpmi_sysmsi_irq *smsi;
-	rpmi_uint32_t msi_index;
-
-	for (msi_index = 0; msi_index < sgmsi->num_msi; msi_index++) {
-		smsi = &sgmsi->msis[msi_index];
-		if (smsi->msi_enable && smsi->msi_pending && smsi->msi_valid) {
-			rpmi_env_writel(smsi->msi_addr, smsi->msi_data);
-			smsi->msi_pending = false;
+	rpmi_uint32_t i, bits;
+
+	/* Only visit deliverable MSIs */
+	for (i = 0; i < RPMI_BITMAP_WORDS32(sgmsi->num_msi); i++) {
+		bits = sgmsi->msi_pending[i] & sgmsi->msi_enable[i] &
+		       sgmsi->msi_valid[i];
+		while (bits) {
+			rpmi_sysmsi_deliver(sgmsi, i * RPMI_BITS_PER_WORD32 +
+					    __builtin_ctz(bits));
+			bits &= bits - 1;
 		}
 	}
 
@@ -308,8 +348,6 @@ enum rpmi_error rpmi_service_group_sysmsi_inject(struct rpmi_service_group *grou
 						 rpmi_uint32_t msi_index)
 {
 	struct rpmi_sysmsi_group *sgmsi;
-	struct rpmi_sysmsi_irq *smsi;
-	enum rpmi_error ret;
 
 	if (!group)
 		return RPMI_ERR_INVALID_PARAM;
@@ -317,14 +355,19 @@ enum rpmi_error rpmi_service_group_sysmsi_inject(struct rpmi_service_group *grou
 	sgmsi = group->priv;
 	if (sgmsi->num_msi <= msi_index)
 		return RPMI_ERR_INVALID_PARAM;
-	smsi = &sgmsi->msis[msi_index];
 
+	/*
+	 * Other pending MSIs only become deliverable via requests
+	 * so only the injected MSI needs to be delivered here.
+	 */
 	rpmi_env_lock(group->lock);
-	smsi->msi_pending = true;
-	ret = rpmi_sysmsi_process_events(group);
+	rpmi_sysmsi_set_bit(sgmsi->msi_pending, msi_index);
+	if (rpmi_sysmsi_test_bit(sgmsi->msi_enable, msi_index) &&
+	    rpmi_sysmsi_test_bit(sgmsi->msi_valid, msi_index))
+		rpmi_sysmsi_deliver(sgmsi, msi_index);
 	rpmi_env_unlock(group->lock);
 
-	return ret;
+	return RPMI_SUCCESS;
 }
 
 enum rpmi_error rpmi_service_group_sysmsi_inject_p2a(struct rpmi_service_group *group)
@@ -349,6 +392,7 @@ rpmi_service_group_sysmsi_create(rpmi_uint32_t num_msi,
 {
 	struct rpmi_service_group *group;
 	struct rpmi_sysmsi_group *sgmsi;
+	rpmi_uint32_t words;
 
 	/* All critical parameters should be non-NULL */
 	if (!num_msi || !ops || !ops->validate_msi_addr) {
@@ -357,7 +401,7 @@ rpmi_service_group_sysmsi_create(rpmi_uint32_t num_msi,
 	}
 
 	/* Allocate system MSI group */
-	sgmsi = rpmi_env_zalloc(sizeof(*sgmsi));
+	sgmsi = rpmi_zalloc(sizeof(*sgmsi));
 	if (!sgmsi) {
 		DPRINTF("%s: failed to allocate system MSI service group instance\n",
 			__func__);
@@ -366,13 +410,24 @@ rpmi_service_group_sysmsi_create(rpmi_uint32_t num_msi,
 
 	sgmsi->num_msi = num_msi;
 	sgmsi->p2a_msi_index = p2a_msi_index < num_msi ? p2a_msi_index : -1U;
-	sgmsi->msis = rpmi_env_zalloc(sizeof(*sgmsi->msis) * sgmsi->num_msi);
-	if (!sgmsi) {
-		DPRINTF("%s: failed to allocate system MSI array\n",
+	sgmsi->targets = rpmi_zalloc(sizeof(*sgmsi->targets) * sgmsi->num_msi);
+	if (!sgmsi->targets) {
+		DPRINTF("%s: failed to allocate system MSI target array\n",
+			__func__);
+		rpmi_free(sgmsi);
+		return NULL;
+	}
+	words = RPMI_BITMAP_WORDS32(sgmsi->num_msi);
+	sgmsi->msi_enable = rpmi_zalloc(sizeof(*sgmsi->msi_enable) * 3 * words);
+	if (!sgmsi->msi_enable) {
+		DPRINTF("%s: failed to allocate system MSI state bitmaps\n",
 			__func__);
-		rpmi_env_free(sgmsi);
+		rpmi_free(sgmsi->targets);
+		rpmi_free(sgmsi);
 		return NULL;
 	}
+	sgmsi->msi_pending = &sgmsi->msi_enable[words];
+	sgmsi->msi_valid = &sgmsi->msi_enable[2 * words];
 	sgmsi->ops = ops;
 	sgmsi->ops_priv = ops_priv;
 
@@ -385,6 +440,8 @@ rpmi_service_group_sysmsi_create(rpmi_uint32_t num_msi,
 					RPMI_PRIVILEGE_S_MODE_MASK;
 	group->max_service_id = RPMI_SYSMSI_SRV_ID_MAX;
 	group->services = rpmi_sysmsi_services;
+	/* MSIs are injected immediately or become deliverable via requests */
+	group->flags = LIBRPMI_SERVICE_GROUP_FLAG_EVENTS_ON_SIGNAL;
 	group->process_events = rpmi_sysmsi_process_events;
 	group->lock = rpmi_env_alloc_lock();
 	group->priv = sgmsi;
@@ -403,6 +460,7 @@ void rpmi_service_group_sysmsi_destroy(struct rpmi_service_group *group)
 	sgmsi = group->priv;
 
 	rpmi_env_free_lock(group->lock);
-	rpmi_env_free(sgmsi->msis);
-	rpmi_env_free(sgmsi);
+	rpmi_free(sgmsi->msi_enable);
+	rpmi_free(sgmsi->targets);
+	rpmi_free(sgmsi);
 }
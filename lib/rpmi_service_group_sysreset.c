@@ -5,6 +5,7 @@
  */
 
 #include <librpmi.h>
+#include "librpmi_internal.h"
 
 #undef DEBUG
 
@@ -125,7 +126,7 @@ rpmi_service_group_sysreset_create(rpmi_uint32_t sysreset_type_count,
 	}
 
 	/* Allocate system reset group */
-	sgrst = rpmi_env_zalloc(sizeof(*sgrst));
+	sgrst = rpmi_zalloc(sizeof(*sgrst));
 	if (!sgrst) {
 		DPRINTF("%s: failed to allocate system suspend service group instance\n",
 			__func__);
@@ -160,5 +161,5 @@ void rpmi_service_group_sysreset_destroy(struct rpmi_service_group *group)
 	}
 
 	rpmi_env_free_lock(group->lock);
-	rpmi_env_free(group->priv);
+	rpmi_free(group->priv);
 }
@@ -5,6 +5,7 @@
  */
 
 #include <librpmi.h>
+#include "librpmi_internal.h"
 
 #undef DEBUG
 
@@ -91,6 +92,7 @@ static enum rpmi_error rpmi_syssusp_do_suspend(struct rpmi_service_group *group,
 	struct rpmi_syssusp_group *sgsusp = group->priv;
 	rpmi_uint32_t *resp = (void *)response_data;
 	rpmi_uint32_t i, hart_id, hart_index, type;
+	rpmi_uint32_t hart_count, count, stopped_mask;
 	rpmi_uint64_t resume_addr;
 	int status;
 
@@ -117,14 +119,19 @@ static enum rpmi_error rpmi_syssusp_do_suspend(struct rpmi_service_group *group,
 		goto done;
 	}
 
-	for (i = 0; i < rpmi_hsm_hart_count(sgsusp->hsm); i++) {
-		if (i == hart_index)
-			continue;
-		status = rpmi_hsm_get_hart_state(sgsusp->hsm,
-						 rpmi_hsm_hart_index2id(sgsusp->hsm, i));
-		if (status < 0)
+	/* All harts other than the calling hart must be stopped */
+	hart_count = rpmi_hsm_hart_count(sgsusp->hsm);
+	for (i = 0; i < hart_count; i += RPMI_BITS_PER_WORD32) {
+		count = RPMI_MIN(hart_count - i, RPMI_BITS_PER_WORD32);
+		status = rpmi_hsm_harts_state_snapshot(sgsusp->hsm, i, count,
+						RPMI_HSM_HART_STATE_STOPPED,
+						&stopped_mask);
+		if (status)
 			goto done;
-		if (status != RPMI_HSM_HART_STATE_STOPPED) {
+		if (hart_index >= i && hart_index < (i + count))
+			stopped_mask |= 1U << (hart_index - i);
+		if (stopped_mask != ((count < RPMI_BITS_PER_WORD32) ?
+				     ((1U << count) - 1) : -1U)) {
 			status = RPMI_ERR_DENIED;
 			goto done;
 		}
@@ -198,7 +205,9 @@ static enum rpmi_error rpmi_syssusp_process_events(struct rpmi_service_group *gr
 		break;
 	}
 
-	return RPMI_SUCCESS;
+	/* Keep the group pending until the system is running again */
+	return (sgsusp->current_state == RPMI_SYSSUSP_STATE_RUNNING) ?
+						RPMI_SUCCESS : RPMI_ERR_BUSY;
 }
 
 struct rpmi_service_group *
@@ -225,7 +234,7 @@ rpmi_service_group_syssusp_create(struct rpmi_hsm *hsm,
 	}
 
 	/* Allocate system suspend group */
-	sgsusp = rpmi_env_zalloc(sizeof(*sgsusp));
+	sgsusp = rpmi_zalloc(sizeof(*sgsusp));
 	if (!sgsusp) {
 		DPRINTF("%s: failed to allocate system suspend service group instance\n",
 			__func__);
@@ -250,6 +259,8 @@ rpmi_service_group_syssusp_create(struct rpmi_hsm *hsm,
 	group->privilege_level_bitmap = RPMI_PRIVILEGE_M_MODE_MASK;
 	group->max_service_id = RPMI_SYSSUSP_SRV_ID_MAX;
 	group->services = rpmi_syssusp_services;
+	/* Suspend can only be started by a request */
+	group->flags = LIBRPMI_SERVICE_GROUP_FLAG_EVENTS_ON_SIGNAL;
 	group->process_events = rpmi_syssusp_process_events;
 	group->lock = rpmi_env_alloc_lock();
 	group->priv = sgsusp;
@@ -265,5 +276,5 @@ void rpmi_service_group_syssusp_destroy(struct rpmi_service_group *group)
 	}
 
 	rpmi_env_free_lock(group->lock);
-	rpmi_env_free(group->priv);
+	rpmi_free(group->priv);
 }
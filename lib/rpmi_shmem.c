@@ -5,6 +5,7 @@
  */
 
 #include <librpmi.h>
+#include "librpmi_internal.h"
 
 #undef DEBUG
 
@@ -32,17 +33,31 @@ struct rpmi_shmem {
 	void *ops_priv;
 };
 
+/**
+ * Copy between local memory and shared memory. An aligned 32-bit word is
+ * copied with a single access so that queue head/tail indices are never
+ * observed partially updated by the other side.
+ */
+static inline void shmem_env_copy(void *dst, const void *src, rpmi_uint32_t len)
+{
+	if (len == sizeof(rpmi_uint32_t) &&
+	    !(((rpmi_uintptr_t)dst | (rpmi_uintptr_t)src) & (sizeof(rpmi_uint32_t) - 1)))
+		*(volatile rpmi_uint32_t *)dst = *(const volatile rpmi_uint32_t *)src;
+	else
+		rpmi_env_memcpy(dst, src, len);
+}
+
 static enum rpmi_error shmem_env_memcpy_read(void *priv, rpmi_uint64_t addr,
 					     void *in, rpmi_uint32_t len)
 {
-	rpmi_env_memcpy(in, (const void *)(unsigned long)addr, len);
+	shmem_env_copy(in, (const void *)(unsigned long)addr, len);
 	return RPMI_SUCCESS;
 }
 
 static enum rpmi_error shmem_env_memcpy_write(void *priv, rpmi_uint64_t addr,
 					      const void *out, rpmi_uint32_t len)
 {
-	rpmi_env_memcpy((void *)(unsigned long)addr, out, len);
+	shmem_env_copy((void *)(unsigned long)addr, out, len);
 	return RPMI_SUCCESS;
 }
 
@@ -53,24 +68,74 @@ static enum rpmi_error shmem_env_memset_fill(void *priv, rpmi_uint64_t addr,
 	return RPMI_SUCCESS;
 }
 
+static void *shmem_env_direct_ptr(void *priv, rpmi_uint64_t addr,
+				  rpmi_uint32_t len)
+{
+	return (void *)(unsigned long)addr;
+}
+
+static enum rpmi_error shmem_env_read32(void *priv, rpmi_uint64_t addr,
+					rpmi_uint32_t *val)
+{
+	*val = *(const volatile rpmi_uint32_t *)(unsigned long)addr;
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error shmem_env_write32(void *priv, rpmi_uint64_t addr,
+					 rpmi_uint32_t val)
+{
+	*(volatile rpmi_uint32_t *)(unsigned long)addr = val;
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error shmem_env_memcpy_readv(void *priv, rpmi_uint64_t addr,
+					      const struct rpmi_shmem_iovec *iov,
+					      rpmi_uint32_t iov_count)
+{
+	rpmi_uint32_t i;
+
+	for (i = 0; i < iov_count; i++)
+		shmem_env_copy(iov[i].buf,
+			       (const void *)(unsigned long)(addr + iov[i].offset),
+			       iov[i].len);
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error shmem_env_memcpy_writev(void *priv, rpmi_uint64_t addr,
+					       const struct rpmi_shmem_iovec *iov,
+					       rpmi_uint32_t iov_count)
+{
+	rpmi_uint32_t i;
+
+	for (i = 0; i < iov_count; i++)
+		shmem_env_copy((void *)(unsigned long)(addr + iov[i].offset),
+			       iov[i].buf, iov[i].len);
+	return RPMI_SUCCESS;
+}
+
 struct rpmi_shmem_platform_ops rpmi_shmem_simple_ops = {
 	.read = shmem_env_memcpy_read,
 	.write = shmem_env_memcpy_write,
 	.fill = shmem_env_memset_fill,
+	.direct_ptr = shmem_env_direct_ptr,
+	.read32 = shmem_env_read32,
+	.write32 = shmem_env_write32,
+	.readv = shmem_env_memcpy_readv,
+	.writev = shmem_env_memcpy_writev,
 };
 
 static enum rpmi_error shmem_env_memcpy_invalidate_read(void *priv, rpmi_uint64_t addr,
 						        void *in, rpmi_uint32_t len)
 {
-	rpmi_env_cache_clean((void *)(unsigned long)addr, len);
-	rpmi_env_memcpy(in, (const void *)(unsigned long)addr, len);
+	rpmi_env_cache_invalidate((void *)(unsigned long)addr, len);
+	shmem_env_copy(in, (const void *)(unsigned long)addr, len);
 	return RPMI_SUCCESS;
 }
 
 static enum rpmi_error shmem_env_memcpy_write_clean(void *priv, rpmi_uint64_t addr,
 						    const void *out, rpmi_uint32_t len)
 {
-	rpmi_env_memcpy((void *)(unsigned long)addr, out, len);
+	shmem_env_copy((void *)(unsigned long)addr, out, len);
 	rpmi_env_cache_clean((void *)(unsigned long)addr, len);
 	return RPMI_SUCCESS;
 }
@@ -83,10 +148,71 @@ static enum rpmi_error shmem_env_memset_fill_clean(void *priv, rpmi_uint64_t add
 	return RPMI_SUCCESS;
 }
 
+static enum rpmi_error shmem_env_invalidate_read32(void *priv, rpmi_uint64_t addr,
+						   rpmi_uint32_t *val)
+{
+	rpmi_env_cache_invalidate((void *)(unsigned long)addr, sizeof(*val));
+	*val = *(const volatile rpmi_uint32_t *)(unsigned long)addr;
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error shmem_env_write32_clean(void *priv, rpmi_uint64_t addr,
+					       rpmi_uint32_t val)
+{
+	*(volatile rpmi_uint32_t *)(unsigned long)addr = val;
+	rpmi_env_cache_clean((void *)(unsigned long)addr, sizeof(val));
+	return RPMI_SUCCESS;
+}
+
+/* Cache maintenance of all ranges is done before copying any of them */
+static enum rpmi_error shmem_env_memcpy_invalidate_readv(void *priv, rpmi_uint64_t addr,
+							 const struct rpmi_shmem_iovec *iov,
+							 rpmi_uint32_t iov_count)
+{
+	rpmi_uint32_t i;
+
+	for (i = 0; i < iov_count; i++)
+		rpmi_env_cache_invalidate((void *)(unsigned long)(addr + iov[i].offset),
+					  iov[i].len);
+	return shmem_env_memcpy_readv(priv, addr, iov, iov_count);
+}
+
+/* Cache maintenance of all ranges is done after copying all of them */
+static enum rpmi_error shmem_env_memcpy_writev_clean(void *priv, rpmi_uint64_t addr,
+						     const struct rpmi_shmem_iovec *iov,
+						     rpmi_uint32_t iov_count)
+{
+	rpmi_uint32_t i;
+
+	shmem_env_memcpy_writev(priv, addr, iov, iov_count);
+	for (i = 0; i < iov_count; i++)
+		rpmi_env_cache_clean((void *)(unsigned long)(addr + iov[i].offset),
+				     iov[i].len);
+	return RPMI_SUCCESS;
+}
+
+static void shmem_env_invalidate_range(void *priv, rpmi_uint64_t addr,
+				       rpmi_uint32_t len)
+{
+	rpmi_env_cache_invalidate((void *)(unsigned long)addr, len);
+}
+
+static void shmem_env_clean_range(void *priv, rpmi_uint64_t addr,
+				  rpmi_uint32_t len)
+{
+	rpmi_env_cache_clean((void *)(unsigned long)addr, len);
+}
+
 struct rpmi_shmem_platform_ops rpmi_shmem_simple_noncoherent_ops = {
 	.read = shmem_env_memcpy_invalidate_read,
 	.write = shmem_env_memcpy_write_clean,
 	.fill = shmem_env_memset_fill_clean,
+	.read32 = shmem_env_invalidate_read32,
+	.write32 = shmem_env_write32_clean,
+	.readv = shmem_env_memcpy_invalidate_readv,
+	.writev = shmem_env_memcpy_writev_clean,
+	.invalidate_range = shmem_env_invalidate_range,
+	.clean_range = shmem_env_clean_range,
 };
 
 rpmi_uint64_t rpmi_shmem_base(struct rpmi_shmem *shmem)
@@ -144,6 +270,168 @@ enum rpmi_error rpmi_shmem_fill(struct rpmi_shmem *shmem, rpmi_uint32_t offset,
 	return shmem->ops->fill(shmem->ops_priv, shmem->base + offset, ch, len);
 }
 
+enum rpmi_error rpmi_shmem_read32(struct rpmi_shmem *shmem, rpmi_uint32_t offset,
+				  rpmi_uint32_t *val)
+{
+	if (!shmem || !val) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+	if ((offset & (sizeof(*val) - 1)) || (offset + sizeof(*val)) > shmem->size) {
+		DPRINTF("%s: %s: invalid offset 0x%x\n",
+			__func__, shmem->name, offset);
+		return RPMI_ERR_BAD_RANGE;
+	}
+	if (!shmem->ops->read32)
+		return shmem->ops->read(shmem->ops_priv, shmem->base + offset,
+					val, sizeof(*val));
+	return shmem->ops->read32(shmem->ops_priv, shmem->base + offset, val);
+}
+
+enum rpmi_error rpmi_shmem_write32(struct rpmi_shmem *shmem, rpmi_uint32_t offset,
+				   rpmi_uint32_t val)
+{
+	if (!shmem) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+	if ((offset & (sizeof(val) - 1)) || (offset + sizeof(val)) > shmem->size) {
+		DPRINTF("%s: %s: invalid offset 0x%x\n",
+			__func__, shmem->name, offset);
+		return RPMI_ERR_BAD_RANGE;
+	}
+	if (!shmem->ops->write32)
+		return shmem->ops->write(shmem->ops_priv, shmem->base + offset,
+					 &val, sizeof(val));
+	return shmem->ops->write32(shmem->ops_priv, shmem->base + offset, val);
+}
+
+static enum rpmi_error rpmi_shmem_check_iov(struct rpmi_shmem *shmem,
+					    const struct rpmi_shmem_iovec *iov,
+					    rpmi_uint32_t iov_count)
+{
+	rpmi_uint32_t i;
+
+	if (!shmem || (iov_count && !iov)) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+	for (i = 0; i < iov_count; i++) {
+		if (!iov[i].buf) {
+			DPRINTF("%s: invalid parameters\n", __func__);
+			return RPMI_ERR_INVALID_PARAM;
+		}
+		if ((iov[i].offset + iov[i].len) > shmem->size) {
+			DPRINTF("%s: %s: invalid offset 0x%x or len 0x%x\n",
+				__func__, shmem->name, iov[i].offset, iov[i].len);
+			return RPMI_ERR_BAD_RANGE;
+		}
+	}
+
+	return RPMI_SUCCESS;
+}
+
+enum rpmi_error rpmi_shmem_readv(struct rpmi_shmem *shmem,
+				 const struct rpmi_shmem_iovec *iov,
+				 rpmi_uint32_t iov_count)
+{
+	enum rpmi_error rc;
+	rpmi_uint32_t i;
+
+	rc = rpmi_shmem_check_iov(shmem, iov, iov_count);
+	if (rc)
+		return rc;
+	if (shmem->ops->readv)
+		return shmem->ops->readv(shmem->ops_priv, shmem->base,
+					 iov, iov_count);
+
+	for (i = 0; i < iov_count; i++) {
+		rc = shmem->ops->read(shmem->ops_priv, shmem->base + iov[i].offset,
+				      iov[i].buf, iov[i].len);
+		if (rc)
+			return rc;
+	}
+
+	return RPMI_SUCCESS;
+}
+
+enum rpmi_error rpmi_shmem_writev(struct rpmi_shmem *shmem,
+				  const struct rpmi_shmem_iovec *iov,
+				  rpmi_uint32_t iov_count)
+{
+	enum rpmi_error rc;
+	rpmi_uint32_t i;
+
+	rc = rpmi_shmem_check_iov(shmem, iov, iov_count);
+	if (rc)
+		return rc;
+	if (shmem->ops->writev)
+		return shmem->ops->writev(shmem->ops_priv, shmem->base,
+					  iov, iov_count);
+
+	for (i = 0; i < iov_count; i++) {
+		rc = shmem->ops->write(shmem->ops_priv, shmem->base + iov[i].offset,
+				       iov[i].buf, iov[i].len);
+		if (rc)
+			return rc;
+	}
+
+	return RPMI_SUCCESS;
+}
+
+enum rpmi_error rpmi_shmem_invalidate(struct rpmi_shmem *shmem,
+				      rpmi_uint32_t offset, rpmi_uint32_t len)
+{
+	if (!shmem) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+	if ((offset + len) > shmem->size) {
+		DPRINTF("%s: %s: invalid offset 0x%x or len 0x%x\n",
+			__func__, shmem->name, offset, len);
+		return RPMI_ERR_BAD_RANGE;
+	}
+	if (shmem->ops->invalidate_range)
+		shmem->ops->invalidate_range(shmem->ops_priv,
+					     shmem->base + offset, len);
+	return RPMI_SUCCESS;
+}
+
+enum rpmi_error rpmi_shmem_clean(struct rpmi_shmem *shmem,
+				 rpmi_uint32_t offset, rpmi_uint32_t len)
+{
+	if (!shmem) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+	if ((offset + len) > shmem->size) {
+		DPRINTF("%s: %s: invalid offset 0x%x or len 0x%x\n",
+			__func__, shmem->name, offset, len);
+		return RPMI_ERR_BAD_RANGE;
+	}
+	if (shmem->ops->clean_range)
+		shmem->ops->clean_range(shmem->ops_priv,
+					shmem->base + offset, len);
+	return RPMI_SUCCESS;
+}
+
+void *rpmi_shmem_direct_ptr(struct rpmi_shmem *shmem, rpmi_uint32_t offset,
+			    rpmi_uint32_t len)
+{
+	if (!shmem) {
+		DPRINTF("%s: invalid parameters\n", __func__);
+		return NULL;
+	}
+	if ((offset + len) > shmem->size) {
+		DPRINTF("%s: %s: invalid offset 0x%x or len 0x%x\n",
+			__func__, shmem->name, offset, len);
+		return NULL;
+	}
+	if (!shmem->ops->direct_ptr)
+		return NULL;
+	return shmem->ops->direct_ptr(shmem->ops_priv, shmem->base + offset, len);
+}
+
 struct rpmi_shmem *rpmi_shmem_create(const char *name,
 				     rpmi_uint64_t base,
 				     rpmi_uint32_t size,
@@ -159,7 +447,7 @@ struct rpmi_shmem *rpmi_shmem_create(const char *name,
 	}
 
 	/* Allocate shared memory */
-	shmem = rpmi_env_zalloc(sizeof(*shmem));
+	shmem = rpmi_zalloc(sizeof(*shmem));
 	if (!shmem) {
 		DPRINTF("%s: failed to allocate shared memory instance\n", __func__);
 		return NULL;
@@ -181,5 +469,5 @@ void rpmi_shmem_destroy(struct rpmi_shmem *shmem)
 		return;
 	}
 
-	rpmi_env_free(shmem);
+	rpmi_free(shmem);
 }
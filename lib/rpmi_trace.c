@@ -0,0 +1,69 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 Ventana Micro Systems Inc.
+ */
+
+#include <librpmi.h>
+#include "librpmi_internal.h"
+
+#undef DEBUG
+
+#ifdef DEBUG
+#define DPRINTF(msg...)		rpmi_env_printf(msg)
+#else
+#define DPRINTF(msg...)
+#endif
+
+struct rpmi_trace_ring *rpmi_trace_current;
+
+enum rpmi_error rpmi_trace_init(void *base, rpmi_size_t size)
+{
+#ifdef LIBRPMI_TRACE
+	struct rpmi_trace_ring *ring = base;
+	rpmi_size_t num_events;
+
+	if (!base) {
+		rpmi_trace_current = NULL;
+		return RPMI_SUCCESS;
+	}
+
+	if ((unsigned long)base & (sizeof(rpmi_uint64_t) - 1)) {
+		DPRINTF("%s: base %p not aligned to %d bytes\n",
+			__func__, base, (int)sizeof(rpmi_uint64_t));
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	if (size < sizeof(*ring) + sizeof(ring->events[0])) {
+		DPRINTF("%s: size 0x%lx too small\n",
+			__func__, (unsigned long)size);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	/* Largest power of 2 number of events which fits */
+	num_events = (size - sizeof(*ring)) / sizeof(ring->events[0]);
+	if (num_events > 0x80000000UL)
+		num_events = 0x80000000UL;
+	while (num_events & (num_events - 1))
+		num_events &= num_events - 1;
+
+	/* Stop recording while the ring is being set up */
+	rpmi_trace_current = NULL;
+	rpmi_env_fence_release();
+
+	rpmi_env_memset(ring, 0, sizeof(*ring) +
+			num_events * sizeof(ring->events[0]));
+	ring->version = RPMI_TRACE_RING_VERSION;
+	ring->event_size = sizeof(ring->events[0]);
+	ring->num_events = num_events;
+	ring->head = 0;
+	rpmi_env_fence_release();
+	ring->magic = RPMI_TRACE_RING_MAGIC;
+
+	rpmi_trace_current = ring;
+	return RPMI_SUCCESS;
+#else
+	DPRINTF("%s: library compiled without LIBRPMI_TRACE\n", __func__);
+	return RPMI_ERR_NOTSUPP;
+#endif
+}
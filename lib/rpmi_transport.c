@@ -5,6 +5,7 @@
  */
 
 #include <librpmi.h>
+#include "librpmi_internal.h"
 
 #undef DEBUG
 
@@ -14,6 +15,38 @@
 #define DPRINTF(msg...)
 #endif
 
+static inline void __rpmi_transport_swap_header(struct rpmi_transport *trans,
+						struct rpmi_message *msg)
+{
+	/* Nothing to do when transport endianness matches native endianness */
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	if (rpmi_transport_is_be(trans))
+		return;
+#else
+	if (!rpmi_transport_is_be(trans))
+		return;
+#endif
+
+	rpmi_transport_convert_header(trans, &msg->header, &msg->header);
+}
+
+/*
+ * Account transferred messages and busy queue attempts. This is called with
+ * the transport lock held except in SPSC mode where the counters of a queue
+ * type are only updated by the side of the queue served through this
+ * transport instance, so each counter has a single writer.
+ */
+static inline void __rpmi_transport_stats(struct rpmi_transport *trans,
+					  enum rpmi_queue_type qtype,
+					  rpmi_uint32_t count, rpmi_bool_t busy)
+{
+#ifdef LIBRPMI_STATS
+	trans->stats.messages[qtype] += count;
+	if (busy)
+		trans->stats.queue_busy[qtype]++;
+#endif
+}
+
 static inline rpmi_bool_t __rpmi_transport_is_empty(struct rpmi_transport *trans,
 						    enum rpmi_queue_type qtype)
 {
@@ -74,7 +107,7 @@ enum rpmi_error rpmi_transport_enqueue(struct rpmi_transport *trans,
 				      enum rpmi_queue_type qtype,
 				      struct rpmi_message *msg)
 {
-	struct rpmi_message_header *mhdr;
+	rpmi_uint32_t count;
 	enum rpmi_error rc;
 
 	if (!trans || !msg) {
@@ -100,25 +133,30 @@ enum rpmi_error rpmi_transport_enqueue(struct rpmi_transport *trans,
 	}
 
 	/* Convert header fields to match transport endianness */
-	mhdr = &msg->header;
-	mhdr->servicegroup_id = rpmi_to_xe32(trans->is_be, mhdr->servicegroup_id);
-	mhdr->datalen = rpmi_to_xe32(trans->is_be, mhdr->datalen);
-	mhdr->token = rpmi_to_xe16(trans->is_be, mhdr->token);
+	__rpmi_transport_swap_header(trans, msg);
 
-	/* Enqueue the message */
+	/*
+	 * Enqueue the message. A transport with batch support checks for
+	 * free slots itself so prefer it over a separate is_full check.
+	 */
 	rpmi_env_lock(trans->lock);
-	if (__rpmi_transport_is_full(trans, qtype)) {
-		DPRINTF("%s: %s: qtype %d is full\n", __func__, trans->name, qtype);
-		rpmi_env_unlock(trans->lock);
-		return RPMI_ERR_IO;
+	if (trans->enqueue_batch) {
+		rc = trans->enqueue_batch(trans, qtype, msg, 1, &count);
+		if (!rc && !count)
+			rc = RPMI_ERR_IO;
+	} else if (__rpmi_transport_is_full(trans, qtype)) {
+		rc = RPMI_ERR_IO;
+	} else {
+		rc = trans->enqueue(trans, qtype, msg);
 	}
-	rc = trans->enqueue(trans, qtype, msg);
+	__rpmi_transport_stats(trans, qtype, rc ? 0 : 1, rc == RPMI_ERR_IO);
 	rpmi_env_unlock(trans->lock);
 
+	if (rc == RPMI_ERR_IO)
+		DPRINTF("%s: %s: qtype %d is full\n", __func__, trans->name, qtype);
+
 	/* Reverse the endian conversion of header fields */
-	mhdr->servicegroup_id = rpmi_to_xe32(trans->is_be, mhdr->servicegroup_id);
-	mhdr->datalen = rpmi_to_xe16(trans->is_be, mhdr->datalen);
-	mhdr->token = rpmi_to_xe16(trans->is_be, mhdr->token);
+	__rpmi_transport_swap_header(trans, msg);
 
 	return rc;
 }
@@ -127,7 +165,7 @@ enum rpmi_error rpmi_transport_dequeue(struct rpmi_transport *trans,
 				       enum rpmi_queue_type qtype,
 				       struct rpmi_message *out_msg)
 {
-	struct rpmi_message_header *mhdr;
+	rpmi_uint32_t count;
 	enum rpmi_error rc;
 
 	if (!trans || !out_msg) {
@@ -152,24 +190,286 @@ enum rpmi_error rpmi_transport_dequeue(struct rpmi_transport *trans,
 		return RPMI_ERR_NOTSUPP;
 	}
 
+	/*
+	 * Dequeue the message. A transport with batch support checks for
+	 * filled slots itself so prefer it over a separate is_empty check.
+	 */
 	rpmi_env_lock(trans->lock);
+	if (trans->dequeue_batch) {
+		rc = trans->dequeue_batch(trans, qtype, out_msg, 1, &count);
+		if (!rc && !count)
+			rc = RPMI_ERR_IO;
+	} else if (__rpmi_transport_is_empty(trans, qtype)) {
+		rc = RPMI_ERR_IO;
+	} else {
+		rc = trans->dequeue(trans, qtype, out_msg);
+	}
+	__rpmi_transport_stats(trans, qtype, rc ? 0 : 1, rc == RPMI_ERR_IO);
+	rpmi_env_unlock(trans->lock);
 
-	/* Dequeue the message */
-	if (__rpmi_transport_is_empty(trans, qtype)) {
+	if (rc == RPMI_ERR_IO)
 		DPRINTF("%s: %s: qtype %d is empty\n", __func__, trans->name, qtype);
-		rpmi_env_unlock(trans->lock);
+
+	/* Convert header fields to native endianness */
+	if (!rc)
+		__rpmi_transport_swap_header(trans, out_msg);
+
+	return rc;
+}
+
+static enum rpmi_error __rpmi_transport_check_batch(struct rpmi_transport *trans,
+						   enum rpmi_queue_type qtype,
+						   struct rpmi_message *msgs,
+						   rpmi_uint32_t *out_count,
+						   const char *func)
+{
+	if (!trans || !msgs || !out_count) {
+		DPRINTF("%s: NULL transport, message or count pointer\n", func);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	if (qtype >= RPMI_QUEUE_MAX) {
+		DPRINTF("%s: %s: invalid qtype %d\n", func, trans->name, qtype);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	if (!trans->is_p2a_channel && qtype >= RPMI_QUEUE_P2A_REQ) {
+		DPRINTF("%s: %s: p2a channel not available, invalid qtype %d\n",
+			func, trans->name, qtype);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	return RPMI_SUCCESS;
+}
+
+enum rpmi_error rpmi_transport_enqueue_batch(struct rpmi_transport *trans,
+					     enum rpmi_queue_type qtype,
+					     struct rpmi_message *msgs,
+					     rpmi_uint32_t count,
+					     rpmi_uint32_t *out_count)
+{
+	enum rpmi_error rc;
+	rpmi_uint32_t i;
+
+	rc = __rpmi_transport_check_batch(trans, qtype, msgs, out_count, __func__);
+	if (rc)
+		return rc;
+
+	*out_count = 0;
+	if (!count)
+		return RPMI_SUCCESS;
+
+	if (!trans->enqueue_batch && !trans->enqueue) {
+		DPRINTF("%s: %s: enqueue operation not supported for qtype %d\n",
+			__func__, trans->name, qtype);
+		return RPMI_ERR_NOTSUPP;
+	}
+
+	/* Convert header fields to match transport endianness */
+	for (i = 0; i < count; i++)
+		__rpmi_transport_swap_header(trans, rpmi_transport_batch_msg(trans, msgs, i));
+
+	/* Enqueue the messages */
+	rpmi_env_lock(trans->lock);
+	if (trans->enqueue_batch) {
+		rc = trans->enqueue_batch(trans, qtype, msgs, count, out_count);
+	} else {
+		while (*out_count < count && !__rpmi_transport_is_full(trans, qtype)) {
+			rc = trans->enqueue(trans, qtype,
+					rpmi_transport_batch_msg(trans, msgs, *out_count));
+			if (rc)
+				break;
+			(*out_count)++;
+		}
+	}
+	__rpmi_transport_stats(trans, qtype, *out_count,
+			       !*out_count && (!rc || rc == RPMI_ERR_IO));
+	rpmi_env_unlock(trans->lock);
+
+	/* Reverse the endian conversion of header fields */
+	for (i = 0; i < count; i++)
+		__rpmi_transport_swap_header(trans, rpmi_transport_batch_msg(trans, msgs, i));
+
+	if (!rc && !*out_count) {
+		DPRINTF("%s: %s: qtype %d is full\n", __func__, trans->name, qtype);
 		return RPMI_ERR_IO;
 	}
-	rc = trans->dequeue(trans, qtype, out_msg);
+
+	return (*out_count) ? RPMI_SUCCESS : rc;
+}
+
+enum rpmi_error rpmi_transport_dequeue_batch(struct rpmi_transport *trans,
+					     enum rpmi_queue_type qtype,
+					     struct rpmi_message *out_msgs,
+					     rpmi_uint32_t max_count,
+					     rpmi_uint32_t *out_count)
+{
+	enum rpmi_error rc;
+	rpmi_uint32_t i;
+
+	rc = __rpmi_transport_check_batch(trans, qtype, out_msgs, out_count, __func__);
+	if (rc)
+		return rc;
+
+	*out_count = 0;
+	if (!max_count)
+		return RPMI_SUCCESS;
+
+	if (!trans->dequeue_batch && !trans->dequeue) {
+		DPRINTF("%s: %s: dequeue operation not supported for qtype %d\n",
+			__func__, trans->name, qtype);
+		return RPMI_ERR_NOTSUPP;
+	}
+
+	/* Dequeue the messages */
+	rpmi_env_lock(trans->lock);
+	if (trans->dequeue_batch) {
+		rc = trans->dequeue_batch(trans, qtype, out_msgs, max_count, out_count);
+	} else {
+		while (*out_count < max_count && !__rpmi_transport_is_empty(trans, qtype)) {
+			rc = trans->dequeue(trans, qtype,
+				rpmi_transport_batch_msg(trans, out_msgs, *out_count));
+			if (rc)
+				break;
+			(*out_count)++;
+		}
+	}
+	__rpmi_transport_stats(trans, qtype, *out_count,
+			       !*out_count && (!rc || rc == RPMI_ERR_IO));
 	rpmi_env_unlock(trans->lock);
 
 	/* Convert header fields to native endianness */
-	if (!rc) {
-		mhdr = &out_msg->header;
-		mhdr->servicegroup_id = rpmi_to_xe32(trans->is_be, mhdr->servicegroup_id);
-		mhdr->datalen = rpmi_to_xe16(trans->is_be, mhdr->datalen);
-		mhdr->token = rpmi_to_xe16(trans->is_be, mhdr->token);
+	for (i = 0; i < *out_count; i++)
+		__rpmi_transport_swap_header(trans, rpmi_transport_batch_msg(trans, out_msgs, i));
+
+	if (!rc && !*out_count) {
+		DPRINTF("%s: %s: qtype %d is empty\n", __func__, trans->name, qtype);
+		return RPMI_ERR_IO;
+	}
+
+	return (*out_count) ? RPMI_SUCCESS : rc;
+}
+
+static enum rpmi_error __rpmi_transport_check_slot(struct rpmi_transport *trans,
+						  enum rpmi_queue_type qtype,
+						  rpmi_bool_t is_reserve,
+						  const char *func)
+{
+	if (!trans) {
+		DPRINTF("%s: NULL transport pointer\n", func);
+		return RPMI_ERR_INVALID_PARAM;
 	}
 
+	if (qtype >= RPMI_QUEUE_MAX) {
+		DPRINTF("%s: %s: invalid qtype %d\n", func, trans->name, qtype);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	if (!trans->is_p2a_channel && qtype >= RPMI_QUEUE_P2A_REQ) {
+		DPRINTF("%s: %s: p2a channel not available, invalid qtype %d\n",
+			func, trans->name, qtype);
+		return RPMI_ERR_INVALID_PARAM;
+	}
+
+	if (is_reserve ? !rpmi_transport_has_reserve_slot(trans) :
+			 !rpmi_transport_has_peek_slot(trans)) {
+		DPRINTF("%s: %s: slot access not supported for qtype %d\n",
+			func, trans->name, qtype);
+		return RPMI_ERR_NOTSUPP;
+	}
+
+	return RPMI_SUCCESS;
+}
+
+enum rpmi_error rpmi_transport_peek_slot(struct rpmi_transport *trans,
+					 enum rpmi_queue_type qtype,
+					 struct rpmi_message **out_msg)
+{
+	enum rpmi_error rc;
+
+	if (!out_msg)
+		return RPMI_ERR_INVALID_PARAM;
+
+	rc = __rpmi_transport_check_slot(trans, qtype, false, __func__);
+	if (rc)
+		return rc;
+
+	rpmi_env_lock(trans->lock);
+	rc = trans->peek_slot(trans, qtype, out_msg);
+	__rpmi_transport_stats(trans, qtype, 0, rc == RPMI_ERR_IO);
+	rpmi_env_unlock(trans->lock);
+
+	return rc;
+}
+
+enum rpmi_error rpmi_transport_commit_slot(struct rpmi_transport *trans,
+					   enum rpmi_queue_type qtype)
+{
+	enum rpmi_error rc;
+
+	rc = __rpmi_transport_check_slot(trans, qtype, false, __func__);
+	if (rc)
+		return rc;
+
+	rpmi_env_lock(trans->lock);
+	rc = trans->commit_slot(trans, qtype);
+	__rpmi_transport_stats(trans, qtype, rc ? 0 : 1, false);
+	rpmi_env_unlock(trans->lock);
+
 	return rc;
 }
+
+enum rpmi_error rpmi_transport_reserve_slot(struct rpmi_transport *trans,
+					    enum rpmi_queue_type qtype,
+					    struct rpmi_message **out_msg)
+{
+	enum rpmi_error rc;
+
+	if (!out_msg)
+		return RPMI_ERR_INVALID_PARAM;
+
+	rc = __rpmi_transport_check_slot(trans, qtype, true, __func__);
+	if (rc)
+		return rc;
+
+	rpmi_env_lock(trans->lock);
+	rc = trans->reserve_slot(trans, qtype, out_msg);
+	__rpmi_transport_stats(trans, qtype, 0, rc == RPMI_ERR_IO);
+	rpmi_env_unlock(trans->lock);
+
+	return rc;
+}
+
+enum rpmi_error rpmi_transport_publish_slot(struct rpmi_transport *trans,
+					    enum rpmi_queue_type qtype)
+{
+	enum rpmi_error rc;
+
+	rc = __rpmi_transport_check_slot(trans, qtype, true, __func__);
+	if (rc)
+		return rc;
+
+	rpmi_env_lock(trans->lock);
+	rc = trans->publish_slot(trans, qtype);
+	__rpmi_transport_stats(trans, qtype, rc ? 0 : 1, false);
+	rpmi_env_unlock(trans->lock);
+
+	return rc;
+}
+
+enum rpmi_error rpmi_transport_get_stats(struct rpmi_transport *trans,
+					 struct rpmi_transport_stats *out_stats)
+{
+	if (!trans || !out_stats)
+		return RPMI_ERR_INVALID_PARAM;
+
+#ifdef LIBRPMI_STATS
+	rpmi_env_lock(trans->lock);
+	rpmi_env_memcpy(out_stats, &trans->stats, sizeof(*out_stats));
+	rpmi_env_unlock(trans->lock);
+
+	return RPMI_SUCCESS;
+#else
+	return RPMI_ERR_NOTSUPP;
+#endif
+}
@@ -5,6 +5,7 @@
  */
 
 #include <librpmi.h>
+#include "librpmi_internal.h"
 
 #undef DEBUG
 
@@ -19,40 +20,152 @@ struct rpmi_transport_shmem_queue {
 	rpmi_uint32_t queue_size;
 	rpmi_uint32_t queue_base;
 	rpmi_uint32_t data_slots;
+
+	/*
+	 * Shadow indices of the queue. The producer owns the tail index and
+	 * the consumer owns the head index so each side trusts its own shadow
+	 * and re-fetches the remote index from shared memory only when the
+	 * cached view says the queue is full (producer) or empty (consumer).
+	 * Producer and consumer shadows are kept separate so that both can
+	 * operate concurrently in lock-free SPSC mode.
+	 */
+	rpmi_uint32_t prod_tail;
+	rpmi_uint32_t prod_head_cache;
+	rpmi_uint32_t cons_head;
+	rpmi_uint32_t cons_tail_cache;
 };
 
 struct rpmi_transport_shmem {
 	struct rpmi_shmem *shmem;
+	/* Base pointer for direct slot access (NULL if not supported) */
+	rpmi_uint8_t *shmem_ptr;
 	rpmi_uint32_t queue_count;
 	struct rpmi_transport_shmem_queue *queues;
 	struct rpmi_transport trans;
 };
 
-static rpmi_bool_t shmem_is_empty(struct rpmi_transport *trans,
-				  enum rpmi_queue_type qtype)
+static enum rpmi_error shmem_read_index(struct rpmi_transport *trans,
+					enum rpmi_queue_type qtype,
+					rpmi_bool_t is_tail,
+					rpmi_uint32_t *out_idx)
 {
 	struct rpmi_transport_shmem *shtrans = trans->priv;
-	struct rpmi_shmem *shmem = shtrans->shmem;
-	rpmi_uint32_t queue_base = shtrans->queues[qtype].queue_base;
-	rpmi_uint32_t headidx, tailidx;
+	rpmi_uint32_t offset = shtrans->queues[qtype].queue_base;
+	rpmi_uint32_t idx;
 	int rc;
 
-	rc = rpmi_shmem_read(shmem, queue_base, &headidx, sizeof(headidx));
+	if (is_tail)
+		offset += rpmi_transport_slot_size(trans);
+
+	rc = rpmi_shmem_read32(shtrans->shmem, offset, &idx);
 	if (rc) {
-		DPRINTF("%s: %s: failed to read head index of qtype %d\n",
-			__func__, trans->name, qtype);
-		return false;
+		DPRINTF("%s: %s: failed to read %s index of qtype %d\n",
+			__func__, trans->name, is_tail ? "tail" : "head", qtype);
+		return RPMI_ERR_FAILED;
 	}
-	headidx = rpmi_to_le32(headidx);
+	*out_idx = rpmi_to_le32(idx);
 
-	rc = rpmi_shmem_read(shmem, queue_base + trans->slot_size,
-			     &tailidx, sizeof(tailidx));
+	/*
+	 * Index read has acquire semantics so that slot accesses are not
+	 * performed before the index published by other side is observed.
+	 */
+	rpmi_env_fence_acquire();
+
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error shmem_write_index(struct rpmi_transport *trans,
+					 enum rpmi_queue_type qtype,
+					 rpmi_bool_t is_tail,
+					 rpmi_uint32_t idx)
+{
+	struct rpmi_transport_shmem *shtrans = trans->priv;
+	rpmi_uint32_t offset = shtrans->queues[qtype].queue_base;
+	int rc;
+
+	if (is_tail)
+		offset += rpmi_transport_slot_size(trans);
+
+	/*
+	 * Index write has release semantics so that slot accesses are
+	 * complete before the other side observes the new index.
+	 */
+	rpmi_env_fence_release();
+
+	idx = rpmi_to_le32(idx);
+	rc = rpmi_shmem_write32(shtrans->shmem, offset, idx);
 	if (rc) {
-		DPRINTF("%s: %s: failed to read tail index of qtype %d\n",
-			__func__, trans->name, qtype);
-		return false;
+		DPRINTF("%s: %s: failed to write %s index of qtype %d\n",
+			__func__, trans->name, is_tail ? "tail" : "head", qtype);
+		return RPMI_ERR_FAILED;
 	}
-	tailidx = rpmi_to_le32(tailidx);
+
+	return RPMI_SUCCESS;
+}
+
+/*
+ * Number of filled slots as seen by the consumer. The tail index is
+ * re-fetched from shared memory only when less than wanted slots are
+ * available in the cached view.
+ */
+static rpmi_uint32_t shmem_cons_avail(struct rpmi_transport *trans,
+				      enum rpmi_queue_type qtype,
+				      rpmi_uint32_t wanted)
+{
+	struct rpmi_transport_shmem *shtrans = trans->priv;
+	struct rpmi_transport_shmem_queue *shq = &shtrans->queues[qtype];
+	rpmi_uint32_t avail;
+
+	avail = rpmi_env_mod32(shq->cons_tail_cache + shq->data_slots -
+			       shq->cons_head, shq->data_slots);
+	if (avail >= wanted)
+		return avail;
+
+	if (shmem_read_index(trans, qtype, true, &shq->cons_tail_cache))
+		return avail;
+
+	return rpmi_env_mod32(shq->cons_tail_cache + shq->data_slots -
+			      shq->cons_head, shq->data_slots);
+}
+
+/*
+ * Number of free slots as seen by the producer. The head index is
+ * re-fetched from shared memory only when less than wanted slots are
+ * free in the cached view. One slot is always kept free to distinguish
+ * a full queue from an empty queue.
+ */
+static rpmi_uint32_t shmem_prod_free(struct rpmi_transport *trans,
+				     enum rpmi_queue_type qtype,
+				     rpmi_uint32_t wanted)
+{
+	struct rpmi_transport_shmem *shtrans = trans->priv;
+	struct rpmi_transport_shmem_queue *shq = &shtrans->queues[qtype];
+	rpmi_uint32_t used;
+
+	used = rpmi_env_mod32(shq->prod_tail + shq->data_slots -
+			      shq->prod_head_cache, shq->data_slots);
+	if ((shq->data_slots - 1 - used) >= wanted)
+		return shq->data_slots - 1 - used;
+
+	if (!shmem_read_index(trans, qtype, false, &shq->prod_head_cache))
+		used = rpmi_env_mod32(shq->prod_tail + shq->data_slots -
+				      shq->prod_head_cache, shq->data_slots);
+
+	return shq->data_slots - 1 - used;
+}
+
+/*
+ * Queries always read both indices from shared memory because they can be
+ * used by either side of the queue and must not disturb the shadow indices.
+ */
+static rpmi_bool_t shmem_is_empty(struct rpmi_transport *trans,
+				  enum rpmi_queue_type qtype)
+{
+	rpmi_uint32_t headidx, tailidx;
+
+	if (shmem_read_index(trans, qtype, false, &headidx) ||
+	    shmem_read_index(trans, qtype, true, &tailidx))
+		return false;
 
 	return (headidx == tailidx) ? true : false;
 }
@@ -61,116 +174,215 @@ static rpmi_bool_t shmem_is_full(struct rpmi_transport *trans,
 				 enum rpmi_queue_type qtype)
 {
 	struct rpmi_transport_shmem *shtrans = trans->priv;
-	rpmi_uint32_t queue_base = shtrans->queues[qtype].queue_base;
 	rpmi_uint32_t data_slots = shtrans->queues[qtype].data_slots;
-	struct rpmi_shmem *shmem = shtrans->shmem;
 	rpmi_uint32_t headidx, tailidx;
-	int rc;
 
-	rc = rpmi_shmem_read(shmem, queue_base, &headidx, sizeof(headidx));
-	if (rc) {
-		DPRINTF("%s: %s: failed to read head index of qtype %d\n",
-			__func__, trans->name, qtype);
+	if (shmem_read_index(trans, qtype, false, &headidx) ||
+	    shmem_read_index(trans, qtype, true, &tailidx))
 		return false;
-	}
-	headidx = rpmi_to_le32(headidx);
-
-	rc = rpmi_shmem_read(shmem, queue_base + trans->slot_size,
-			     &tailidx, sizeof(tailidx));
-	if (rc) {
-		DPRINTF("%s: %s: failed to read tail index of qtype %d\n",
-			__func__, trans->name, qtype);
-		return false;
-	}
-	tailidx = rpmi_to_le32(tailidx);
 
 	return (rpmi_env_mod32(tailidx + 1, data_slots) == headidx) ? true : false;
 }
 
-static enum rpmi_error shmem_enqueue(struct rpmi_transport *trans,
-				     enum rpmi_queue_type qtype,
-				     const struct rpmi_message *msg)
+static enum rpmi_error shmem_enqueue_batch(struct rpmi_transport *trans,
+					   enum rpmi_queue_type qtype,
+					   const struct rpmi_message *msgs,
+					   rpmi_uint32_t count,
+					   rpmi_uint32_t *out_count)
 {
 	struct rpmi_transport_shmem *shtrans = trans->priv;
-	rpmi_uint32_t queue_base = shtrans->queues[qtype].queue_base;
-	rpmi_uint32_t data_slots = shtrans->queues[qtype].data_slots;
-	struct rpmi_shmem *shmem = shtrans->shmem;
-	rpmi_uint32_t tailidx;
-	int rc;
-
-	rc = rpmi_shmem_read(shmem, queue_base + trans->slot_size,
-			     &tailidx, sizeof(tailidx));
+	struct rpmi_transport_shmem_queue *shq = &shtrans->queues[qtype];
+	const rpmi_uint8_t *buf = (const rpmi_uint8_t *)msgs;
+	rpmi_size_t slot_size = rpmi_transport_slot_size(trans);
+	rpmi_uint32_t tailidx = shq->prod_tail, first, free;
+	struct rpmi_shmem_iovec iov[2];
+	enum rpmi_error rc;
+
+	*out_count = 0;
+
+	/* Free slots are fetched once because the consumer can free more */
+	free = shmem_prod_free(trans, qtype, count);
+	count = RPMI_MIN(count, free);
+	if (!count)
+		return RPMI_SUCCESS;
+
+	/* Copy slots in at most two contiguous chunks (before and after wrap) */
+	first = RPMI_MIN(count, shq->data_slots - tailidx);
+	iov[0].offset = shq->queue_base + ((tailidx + 2) * slot_size);
+	iov[0].len = first * slot_size;
+	iov[0].buf = (void *)buf;
+	iov[1].offset = shq->queue_base + (2 * slot_size);
+	iov[1].len = (count - first) * slot_size;
+	iov[1].buf = (void *)(buf + (first * slot_size));
+	rc = rpmi_shmem_writev(shtrans->shmem, iov, (first < count) ? 2 : 1);
 	if (rc) {
-		DPRINTF("%s: %s: failed to read tail index of qtype %d\n",
-			__func__, trans->name, qtype);
+		DPRINTF("%s: %s: failed to write %d messages at tailidx %d for qtype %d\n",
+			__func__, trans->name, count, tailidx, qtype);
 		return RPMI_ERR_FAILED;
 	}
-	tailidx = rpmi_to_le32(tailidx);
 
-	rc = rpmi_shmem_write(shmem, queue_base + ((tailidx + 2) * trans->slot_size),
-			      msg, trans->slot_size);
-	if (rc) {
-		DPRINTF("%s: %s: failed to write message at tailidx %d for qtype %d\n",
-			__func__, trans->name, tailidx, qtype);
-		return RPMI_ERR_FAILED;
-	}
+	tailidx = rpmi_env_mod32(tailidx + count, shq->data_slots);
+	rc = shmem_write_index(trans, qtype, true, tailidx);
+	if (rc)
+		return rc;
+
+	shq->prod_tail = tailidx;
+	*out_count = count;
+	return RPMI_SUCCESS;
+}
 
-	tailidx = rpmi_to_le32(rpmi_env_mod32(tailidx + 1, data_slots));
-	rc = rpmi_shmem_write(shmem, queue_base + trans->slot_size,
-			      &tailidx, sizeof(tailidx));
+static enum rpmi_error shmem_dequeue_batch(struct rpmi_transport *trans,
+					   enum rpmi_queue_type qtype,
+					   struct rpmi_message *out_msgs,
+					   rpmi_uint32_t max_count,
+					   rpmi_uint32_t *out_count)
+{
+	struct rpmi_transport_shmem *shtrans = trans->priv;
+	struct rpmi_transport_shmem_queue *shq = &shtrans->queues[qtype];
+	rpmi_uint8_t *buf = (rpmi_uint8_t *)out_msgs;
+	rpmi_size_t slot_size = rpmi_transport_slot_size(trans);
+	rpmi_uint32_t headidx = shq->cons_head, count, first, avail;
+	struct rpmi_shmem_iovec iov[2];
+	enum rpmi_error rc;
+
+	*out_count = 0;
+
+	/* Filled slots are fetched once because the producer can fill more */
+	avail = shmem_cons_avail(trans, qtype, max_count);
+	count = RPMI_MIN(max_count, avail);
+	if (!count)
+		return RPMI_SUCCESS;
+
+	/* Copy slots in at most two contiguous chunks (before and after wrap) */
+	first = RPMI_MIN(count, shq->data_slots - headidx);
+	iov[0].offset = shq->queue_base + ((headidx + 2) * slot_size);
+	iov[0].len = first * slot_size;
+	iov[0].buf = buf;
+	iov[1].offset = shq->queue_base + (2 * slot_size);
+	iov[1].len = (count - first) * slot_size;
+	iov[1].buf = buf + (first * slot_size);
+	rc = rpmi_shmem_readv(shtrans->shmem, iov, (first < count) ? 2 : 1);
 	if (rc) {
-		DPRINTF("%s: %s: failed to write tail index for qtype %d\n",
-			__func__, trans->name, qtype);
+		DPRINTF("%s: %s: failed to read %d messages at headidx %d for qtype %d\n",
+			__func__, trans->name, count, headidx, qtype);
 		return RPMI_ERR_FAILED;
 	}
 
-	return 0;
+	headidx = rpmi_env_mod32(headidx + count, shq->data_slots);
+	rc = shmem_write_index(trans, qtype, false, headidx);
+	if (rc)
+		return rc;
+
+	shq->cons_head = headidx;
+	*out_count = count;
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error shmem_enqueue(struct rpmi_transport *trans,
+				     enum rpmi_queue_type qtype,
+				     const struct rpmi_message *msg)
+{
+	rpmi_uint32_t count;
+	enum rpmi_error rc;
+
+	rc = shmem_enqueue_batch(trans, qtype, msg, 1, &count);
+	if (rc)
+		return rc;
+
+	return (count) ? RPMI_SUCCESS : RPMI_ERR_IO;
 }
 
 static enum rpmi_error shmem_dequeue(struct rpmi_transport *trans,
 				     enum rpmi_queue_type qtype,
 				     struct rpmi_message *out_msg)
+{
+	rpmi_uint32_t count;
+	enum rpmi_error rc;
+
+	rc = shmem_dequeue_batch(trans, qtype, out_msg, 1, &count);
+	if (rc)
+		return rc;
+
+	return (count) ? RPMI_SUCCESS : RPMI_ERR_IO;
+}
+
+static inline struct rpmi_message *shmem_slot_ptr(struct rpmi_transport *trans,
+						   enum rpmi_queue_type qtype,
+						   rpmi_uint32_t idx)
 {
 	struct rpmi_transport_shmem *shtrans = trans->priv;
-	rpmi_uint32_t queue_base = shtrans->queues[qtype].queue_base;
-	rpmi_uint32_t data_slots = shtrans->queues[qtype].data_slots;
-	struct rpmi_shmem *shmem = shtrans->shmem;
+
+	return (struct rpmi_message *)(shtrans->shmem_ptr +
+			shtrans->queues[qtype].queue_base +
+			((idx + 2) * rpmi_transport_slot_size(trans)));
+}
+
+static enum rpmi_error shmem_peek_slot(struct rpmi_transport *trans,
+				       enum rpmi_queue_type qtype,
+				       struct rpmi_message **out_msg)
+{
+	struct rpmi_transport_shmem *shtrans = trans->priv;
+
+	if (!shmem_cons_avail(trans, qtype, 1))
+		return RPMI_ERR_IO;
+
+	*out_msg = shmem_slot_ptr(trans, qtype, shtrans->queues[qtype].cons_head);
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error shmem_commit_slot(struct rpmi_transport *trans,
+					 enum rpmi_queue_type qtype)
+{
+	struct rpmi_transport_shmem *shtrans = trans->priv;
+	struct rpmi_transport_shmem_queue *shq = &shtrans->queues[qtype];
 	rpmi_uint32_t headidx;
-	int rc;
+	enum rpmi_error rc;
 
-	rc = rpmi_shmem_read(shmem, queue_base, &headidx, sizeof(headidx));
-	if (rc) {
-		DPRINTF("%s: %s: failed to read head index of qtype %d\n",
-			__func__, trans->name, qtype);
-		return false;
-	}
-	headidx = rpmi_to_le32(headidx);
+	headidx = rpmi_env_mod32(shq->cons_head + 1, shq->data_slots);
+	rc = shmem_write_index(trans, qtype, false, headidx);
+	if (rc)
+		return rc;
 
-	rc = rpmi_shmem_read(shmem, queue_base + ((headidx + 2) * trans->slot_size),
-			     out_msg, trans->slot_size);
-	if (rc) {
-		DPRINTF("%s: %s: failed to read message at headidx %d for qtype %d\n",
-			__func__, trans->name, headidx, qtype);
-		return RPMI_ERR_FAILED;
-	}
+	shq->cons_head = headidx;
+	return RPMI_SUCCESS;
+}
 
-	headidx = rpmi_to_le32(rpmi_env_mod32(headidx + 1, data_slots));
-	rc = rpmi_shmem_write(shmem, queue_base,
-			      &headidx, sizeof(headidx));
-	if (rc) {
-		DPRINTF("%s: %s: failed to write head index for qtype %d\n",
-			__func__, trans->name, qtype);
-		return RPMI_ERR_FAILED;
-	}
+static enum rpmi_error shmem_reserve_slot(struct rpmi_transport *trans,
+					  enum rpmi_queue_type qtype,
+					  struct rpmi_message **out_msg)
+{
+	struct rpmi_transport_shmem *shtrans = trans->priv;
 
-	return 0;
+	if (!shmem_prod_free(trans, qtype, 1))
+		return RPMI_ERR_IO;
+
+	*out_msg = shmem_slot_ptr(trans, qtype, shtrans->queues[qtype].prod_tail);
+	return RPMI_SUCCESS;
 }
 
-struct rpmi_transport *rpmi_transport_shmem_create(const char *name,
-						   rpmi_uint32_t slot_size,
-						   rpmi_uint32_t a2p_req_queue_size,
-						   rpmi_uint32_t p2a_req_queue_size,
-						   struct rpmi_shmem *shmem)
+static enum rpmi_error shmem_publish_slot(struct rpmi_transport *trans,
+					  enum rpmi_queue_type qtype)
+{
+	struct rpmi_transport_shmem *shtrans = trans->priv;
+	struct rpmi_transport_shmem_queue *shq = &shtrans->queues[qtype];
+	rpmi_uint32_t tailidx;
+	enum rpmi_error rc;
+
+	tailidx = rpmi_env_mod32(shq->prod_tail + 1, shq->data_slots);
+	rc = shmem_write_index(trans, qtype, true, tailidx);
+	if (rc)
+		return rc;
+
+	shq->prod_tail = tailidx;
+	return RPMI_SUCCESS;
+}
+
+struct rpmi_transport *rpmi_transport_shmem_create_ext(const char *name,
+						       rpmi_uint32_t slot_size,
+						       rpmi_uint32_t a2p_req_queue_size,
+						       rpmi_uint32_t p2a_req_queue_size,
+						       struct rpmi_shmem *shmem,
+						       rpmi_uint32_t flags)
 {
 	struct rpmi_transport_shmem_queue *shqueue;
 	struct rpmi_transport_shmem *shtrans;
@@ -181,10 +393,17 @@ struct rpmi_transport *rpmi_transport_shmem_create(const char *name,
 	if (!name || !slot_size || !shmem)
 		return NULL;
 
+	if (flags & ~LIBRPMI_TRANSPORT_SHMEM_FLAGS_MASK)
+		return NULL;
+
 	/* Slot size should be power of 2 and at least RPMI_SLOT_SIZE_MIN */
 	if ((slot_size & (slot_size - 1)) || slot_size < RPMI_SLOT_SIZE_MIN)
 		return NULL;
 
+	/* Slot size should match the build-time fixed slot size (if any) */
+	if (LIBRPMI_FIXED_SLOT_SIZE && slot_size != LIBRPMI_FIXED_SLOT_SIZE)
+		return NULL;
+
 	/* all four queue are present */
 	if (p2a_req_queue_size) {
 		/* Make sure queue sizes are multiples of slot size
@@ -222,14 +441,14 @@ struct rpmi_transport *rpmi_transport_shmem_create(const char *name,
 		return NULL;
 
 	/* Allocate shared memory transport */
-	shtrans = rpmi_env_zalloc(sizeof(*shtrans));
+	shtrans = rpmi_zalloc(sizeof(*shtrans));
 	if (!shtrans)
 		return NULL;
 
 	shtrans->shmem = shmem;
 	shtrans->queue_count = p2a_req_queue_size? RPMI_QUEUE_MAX : 2;
 
-	shtrans->queues = rpmi_env_zalloc(sizeof(*shtrans->queues) * shtrans->queue_count);
+	shtrans->queues = rpmi_zalloc(sizeof(*shtrans->queues) * shtrans->queue_count);
 	if (!shtrans->queues)
 		return NULL;
 
@@ -250,6 +469,7 @@ struct rpmi_transport *rpmi_transport_shmem_create(const char *name,
 
 	trans = &shtrans->trans;
 	trans->name = name;
+	/* Shared memory transports are always little-endian */
 	trans->is_be = false;
 	trans->slot_size = slot_size;
 	trans->is_p2a_channel = p2a_req_queue_size ? true : false;
@@ -257,12 +477,45 @@ struct rpmi_transport *rpmi_transport_shmem_create(const char *name,
 	trans->is_full = shmem_is_full;
 	trans->enqueue = shmem_enqueue;
 	trans->dequeue = shmem_dequeue;
-	trans->lock = rpmi_env_alloc_lock();
+	trans->enqueue_batch = shmem_enqueue_batch;
+	trans->dequeue_batch = shmem_dequeue_batch;
+
+	/*
+	 * In-place slot access only if shared memory is directly accessible
+	 * and messages from the other side are read in-place only if it is
+	 * trusted because it can still write the slot while being read.
+	 */
+	shtrans->shmem_ptr = rpmi_shmem_direct_ptr(shmem, 0, rpmi_shmem_size(shmem));
+	if (shtrans->shmem_ptr) {
+		if (flags & LIBRPMI_TRANSPORT_SHMEM_FLAG_TRUSTED_AP) {
+			trans->peek_slot = shmem_peek_slot;
+			trans->commit_slot = shmem_commit_slot;
+		}
+		trans->reserve_slot = shmem_reserve_slot;
+		trans->publish_slot = shmem_publish_slot;
+	}
+	/*
+	 * In single-producer single-consumer mode each queue is accessed
+	 * by exactly one producer and one consumer so the head/tail index
+	 * ordering is sufficient and no transport lock is needed.
+	 */
+	if (!(flags & LIBRPMI_TRANSPORT_SHMEM_FLAG_SPSC))
+		trans->lock = rpmi_env_alloc_lock();
 	trans->priv = shtrans;
 
 	return trans;
 }
 
+struct rpmi_transport *rpmi_transport_shmem_create(const char *name,
+						   rpmi_uint32_t slot_size,
+						   rpmi_uint32_t a2p_req_queue_size,
+						   rpmi_uint32_t p2a_req_queue_size,
+						   struct rpmi_shmem *shmem)
+{
+	return rpmi_transport_shmem_create_ext(name, slot_size, a2p_req_queue_size,
+					       p2a_req_queue_size, shmem, 0);
+}
+
 void rpmi_transport_shmem_destroy(struct rpmi_transport *trans)
 {
 	struct rpmi_transport_shmem *shtrans;
@@ -273,6 +526,6 @@ void rpmi_transport_shmem_destroy(struct rpmi_transport *trans)
 	shtrans = trans->priv;
 
 	rpmi_env_free_lock(trans->lock);
-	rpmi_env_free(shtrans->queues);
-	rpmi_env_free(trans->priv);
+	rpmi_free(shtrans->queues);
+	rpmi_free(trans->priv);
 }
@@ -0,0 +1,801 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 Ventana Micro Systems Inc.
+ */
+
+#include <librpmi.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../test_common.h"
+
+#define BENCH_HART_COUNT	4
+#define BENCH_CLOCK_COUNT	2
+#define BENCH_FASTCHAN_SZ	4096
+#define BENCH_MAX_CONFIGS	8
+#define BENCH_TOKEN_COUNT	(1U << 16)
+#define BENCH_TRACE_SZ		(1U << 20)
+#define BENCH_WORKER_COUNT	2
+
+#define PLAT_INFO		"librpmi bench"
+#define PLAT_INFO_LEN		(sizeof(PLAT_INFO))
+
+/* Counters of shared memory operations done by the platform side */
+struct bench_shmem_counts {
+	unsigned long ops;
+	unsigned long bytes;
+};
+
+struct bench_priv {
+	/* Application processor side view of the shared memory */
+	struct rpmi_shmem *ap_shmem;
+	struct rpmi_transport *ap_xport;
+
+	struct rpmi_hsm *hsm;
+	struct rpmi_service_group *hsm_group;
+	struct rpmi_service_group *clock_group;
+	struct rpmi_service_group *cppc_group;
+	void *fastchan;
+	struct rpmi_shmem *fastchan_shmem;
+
+	struct bench_shmem_counts counts;
+	int copy_mode;
+	int use_workers;
+
+	/* Enqueue timestamps indexed by message token */
+	rpmi_uint64_t *start_ns;
+	rpmi_uint64_t *lat_ns;
+
+	volatile int stop;
+};
+
+static struct bench_priv bench;
+
+/* ==================== Counting shared memory operations ==================== */
+
+static enum rpmi_error bench_shmem_read(void *priv, rpmi_uint64_t addr,
+					void *in, rpmi_uint32_t len)
+{
+	struct bench_shmem_counts *counts = priv;
+
+	counts->ops++;
+	counts->bytes += len;
+	return rpmi_shmem_simple_ops.read(NULL, addr, in, len);
+}
+
+static enum rpmi_error bench_shmem_write(void *priv, rpmi_uint64_t addr,
+					 const void *out, rpmi_uint32_t len)
+{
+	struct bench_shmem_counts *counts = priv;
+
+	counts->ops++;
+	counts->bytes += len;
+	return rpmi_shmem_simple_ops.write(NULL, addr, out, len);
+}
+
+static enum rpmi_error bench_shmem_fill(void *priv, rpmi_uint64_t addr,
+					char ch, rpmi_uint32_t len)
+{
+	struct bench_shmem_counts *counts = priv;
+
+	counts->ops++;
+	counts->bytes += len;
+	return rpmi_shmem_simple_ops.fill(NULL, addr, ch, len);
+}
+
+static void *bench_shmem_direct_ptr(void *priv, rpmi_uint64_t addr,
+				    rpmi_uint32_t len)
+{
+	return rpmi_shmem_simple_ops.direct_ptr(NULL, addr, len);
+}
+
+static enum rpmi_error bench_shmem_read32(void *priv, rpmi_uint64_t addr,
+					  rpmi_uint32_t *val)
+{
+	struct bench_shmem_counts *counts = priv;
+
+	counts->ops++;
+	counts->bytes += sizeof(*val);
+	return rpmi_shmem_simple_ops.read32(NULL, addr, val);
+}
+
+static enum rpmi_error bench_shmem_write32(void *priv, rpmi_uint64_t addr,
+					   rpmi_uint32_t val)
+{
+	struct bench_shmem_counts *counts = priv;
+
+	counts->ops++;
+	counts->bytes += sizeof(val);
+	return rpmi_shmem_simple_ops.write32(NULL, addr, val);
+}
+
+static enum rpmi_error bench_shmem_readv(void *priv, rpmi_uint64_t addr,
+					 const struct rpmi_shmem_iovec *iov,
+					 rpmi_uint32_t iov_count)
+{
+	struct bench_shmem_counts *counts = priv;
+	rpmi_uint32_t i;
+
+	counts->ops++;
+	for (i = 0; i < iov_count; i++)
+		counts->bytes += iov[i].len;
+	return rpmi_shmem_simple_ops.readv(NULL, addr, iov, iov_count);
+}
+
+static enum rpmi_error bench_shmem_writev(void *priv, rpmi_uint64_t addr,
+					  const struct rpmi_shmem_iovec *iov,
+					  rpmi_uint32_t iov_count)
+{
+	struct bench_shmem_counts *counts = priv;
+	rpmi_uint32_t i;
+
+	counts->ops++;
+	for (i = 0; i < iov_count; i++)
+		counts->bytes += iov[i].len;
+	return rpmi_shmem_simple_ops.writev(NULL, addr, iov, iov_count);
+}
+
+static struct rpmi_shmem_platform_ops bench_shmem_ops = {
+	.read = bench_shmem_read,
+	.write = bench_shmem_write,
+	.fill = bench_shmem_fill,
+	.direct_ptr = bench_shmem_direct_ptr,
+	.read32 = bench_shmem_read32,
+	.write32 = bench_shmem_write32,
+	.readv = bench_shmem_readv,
+	.writev = bench_shmem_writev,
+};
+
+/* ==================== Platform operations ==================== */
+
+static enum rpmi_hart_hw_state bench_hart_get_hw_state(void *priv,
+						       rpmi_uint32_t hart_index)
+{
+	return RPMI_HART_HW_STATE_STARTED;
+}
+
+static struct rpmi_hsm_platform_ops bench_hsm_ops = {
+	.hart_get_hw_state = bench_hart_get_hw_state,
+};
+
+static const rpmi_uint64_t bench_clock_rates[] = { 100000000, 200000000 };
+
+static const struct rpmi_clock_data bench_clock_data[BENCH_CLOCK_COUNT] = {
+	{
+		.parent_id = -1,
+		.rate_count = sizeof(bench_clock_rates) / sizeof(bench_clock_rates[0]),
+		.clock_type = RPMI_CLK_TYPE_DISCRETE,
+		.name = "bench_clk0",
+		.clock_rate_array = bench_clock_rates,
+	},
+	{
+		.parent_id = 0,
+		.rate_count = sizeof(bench_clock_rates) / sizeof(bench_clock_rates[0]),
+		.clock_type = RPMI_CLK_TYPE_DISCRETE,
+		.name = "bench_clk1",
+		.clock_rate_array = bench_clock_rates,
+	},
+};
+
+static enum rpmi_error bench_clock_set_state(void *priv, rpmi_uint32_t clock_id,
+					     enum rpmi_clock_state state)
+{
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error bench_clock_get_state_and_rate(void *priv,
+						      rpmi_uint32_t clock_id,
+						      enum rpmi_clock_state *state,
+						      rpmi_uint64_t *rate)
+{
+	if (state)
+		*state = RPMI_CLK_STATE_ENABLED;
+	if (rate)
+		*rate = bench_clock_rates[0];
+	return RPMI_SUCCESS;
+}
+
+static rpmi_bool_t bench_clock_rate_change_match(void *priv,
+						 rpmi_uint32_t clock_id,
+						 rpmi_uint64_t rate)
+{
+	return true;
+}
+
+static enum rpmi_error bench_clock_set_rate(void *priv, rpmi_uint32_t clock_id,
+					    enum rpmi_clock_rate_match match,
+					    rpmi_uint64_t rate,
+					    rpmi_uint64_t *new_rate)
+{
+	*new_rate = rate;
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error bench_clock_set_rate_recalc(void *priv,
+						   rpmi_uint32_t clock_id,
+						   rpmi_uint64_t parent_rate,
+						   rpmi_uint64_t *new_rate)
+{
+	*new_rate = parent_rate;
+	return RPMI_SUCCESS;
+}
+
+static struct rpmi_clock_platform_ops bench_clock_ops = {
+	.set_state = bench_clock_set_state,
+	.get_state_and_rate = bench_clock_get_state_and_rate,
+	.rate_change_match = bench_clock_rate_change_match,
+	.set_rate = bench_clock_set_rate,
+	.set_rate_recalc = bench_clock_set_rate_recalc,
+};
+
+static const struct rpmi_cppc_regs bench_cppc_regs = {
+	.highest_perf = 100,
+	.nominal_perf = 80,
+	.lowest_nonlinear_perf = 20,
+	.lowest_perf = 10,
+};
+
+static enum rpmi_error bench_cppc_get_reg(void *priv, rpmi_uint32_t reg_id,
+					  rpmi_uint32_t hart_index,
+					  rpmi_uint64_t *val)
+{
+	*val = 0;
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error bench_cppc_set_reg(void *priv, rpmi_uint32_t reg_id,
+					  rpmi_uint32_t hart_index,
+					  rpmi_uint64_t val)
+{
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error bench_cppc_update_perf(void *priv,
+					      rpmi_uint32_t hart_index,
+					      rpmi_uint32_t desired_perf)
+{
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error bench_cppc_get_current_freq(void *priv,
+						   rpmi_uint32_t hart_index,
+						   rpmi_uint64_t *current_freq_hz)
+{
+	*current_freq_hz = bench_clock_rates[0];
+	return RPMI_SUCCESS;
+}
+
+static struct rpmi_cppc_platform_ops bench_cppc_ops = {
+	.cppc_get_reg = bench_cppc_get_reg,
+	.cppc_set_reg = bench_cppc_set_reg,
+	.cppc_update_perf = bench_cppc_update_perf,
+	.cppc_get_current_freq = bench_cppc_get_current_freq,
+};
+
+/* ==================== Scenario ==================== */
+
+static const rpmi_uint32_t bench_hart_ids[BENCH_HART_COUNT] = { 0, 1, 2, 3 };
+
+static const rpmi_uint32_t hsm_status_reqdata[] = { 0 };
+static const rpmi_uint32_t clock_rate_reqdata[] = { 1 };
+static const rpmi_uint32_t cppc_read_reqdata[] = { 0, RPMI_CPPC_NOMINAL_PERF };
+
+static void bench_scenario_cleanup_groups(struct rpmi_test_scenario *scene)
+{
+	struct bench_priv *priv = scene->priv;
+
+	if (scene->cntx) {
+		if (priv->cppc_group)
+			rpmi_context_remove_group(scene->cntx, priv->cppc_group);
+		if (priv->clock_group)
+			rpmi_context_remove_group(scene->cntx, priv->clock_group);
+		if (priv->hsm_group)
+			rpmi_context_remove_group(scene->cntx, priv->hsm_group);
+		rpmi_context_destroy(scene->cntx);
+		scene->cntx = NULL;
+	}
+	if (priv->cppc_group) {
+		rpmi_service_group_cppc_destroy(priv->cppc_group);
+		priv->cppc_group = NULL;
+	}
+	if (priv->fastchan_shmem) {
+		rpmi_shmem_destroy(priv->fastchan_shmem);
+		priv->fastchan_shmem = NULL;
+	}
+	free(priv->fastchan);
+	priv->fastchan = NULL;
+	if (priv->clock_group) {
+		rpmi_service_group_clock_destroy(priv->clock_group);
+		priv->clock_group = NULL;
+	}
+	if (priv->hsm_group) {
+		rpmi_service_group_hsm_destroy(priv->hsm_group);
+		priv->hsm_group = NULL;
+	}
+	if (priv->hsm) {
+		rpmi_hsm_destroy(priv->hsm);
+		priv->hsm = NULL;
+	}
+	if (priv->ap_xport) {
+		rpmi_transport_shmem_destroy(priv->ap_xport);
+		priv->ap_xport = NULL;
+	}
+	if (priv->ap_shmem) {
+		rpmi_shmem_destroy(priv->ap_shmem);
+		priv->ap_shmem = NULL;
+	}
+}
+
+static int bench_scenario_init(struct rpmi_test_scenario *scene)
+{
+	struct bench_priv *priv = scene->priv;
+	int rc;
+
+	/* Hide direct access so that all slot accesses are copies */
+	bench_shmem_ops.direct_ptr = priv->copy_mode ? NULL : bench_shmem_direct_ptr;
+
+	rc = test_scenario_default_init(scene);
+	if (rc)
+		return rc;
+
+	/*
+	 * The application processor side uses its own transport instance
+	 * over the same shared memory so that both sides have separate
+	 * queue state as with a real platform.
+	 */
+	priv->ap_shmem = rpmi_shmem_create("bench_ap_shmem",
+					   (unsigned long)scene->shm, scene->shm_size,
+					   &rpmi_shmem_simple_ops, NULL);
+	if (!priv->ap_shmem)
+		goto fail;
+	priv->ap_xport = rpmi_transport_shmem_create("bench_ap_transport",
+						    scene->slot_size,
+						    ((scene->shm_size * 3) / 4) / 2,
+						    ((scene->shm_size * 1) / 4) / 2,
+						    priv->ap_shmem);
+	if (!priv->ap_xport)
+		goto fail;
+
+	priv->hsm = rpmi_hsm_create(BENCH_HART_COUNT, bench_hart_ids, 0, NULL,
+				    &bench_hsm_ops, NULL);
+	if (!priv->hsm)
+		goto fail;
+	priv->hsm_group = rpmi_service_group_hsm_create(priv->hsm);
+	if (!priv->hsm_group)
+		goto fail;
+
+	priv->clock_group = rpmi_service_group_clock_create(BENCH_CLOCK_COUNT,
+							    bench_clock_data,
+							    &bench_clock_ops, NULL);
+	if (!priv->clock_group)
+		goto fail;
+
+	priv->fastchan = aligned_alloc(BENCH_FASTCHAN_SZ, BENCH_FASTCHAN_SZ);
+	if (!priv->fastchan)
+		goto fail;
+	priv->fastchan_shmem = rpmi_shmem_create("bench_fastchan",
+						 (unsigned long)priv->fastchan,
+						 BENCH_FASTCHAN_SZ,
+						 &rpmi_shmem_simple_ops, NULL);
+	if (!priv->fastchan_shmem)
+		goto fail;
+	priv->cppc_group = rpmi_service_group_cppc_create(priv->hsm, &bench_cppc_regs,
+							  RPMI_CPPC_PASSIVE_MODE,
+							  priv->fastchan_shmem,
+							  0, BENCH_FASTCHAN_SZ / 2,
+							  &bench_cppc_ops, NULL);
+	if (!priv->cppc_group)
+		goto fail;
+
+	if (rpmi_context_add_group(scene->cntx, priv->hsm_group) ||
+	    rpmi_context_add_group(scene->cntx, priv->clock_group) ||
+	    rpmi_context_add_group(scene->cntx, priv->cppc_group))
+		goto fail;
+
+	/* Clock on the first worker, HSM and CPPC on the second worker */
+	if (priv->use_workers &&
+	    (rpmi_context_set_group_worker(scene->cntx, RPMI_SRVGRP_CLOCK, 1) ||
+	     rpmi_context_set_group_worker(scene->cntx, RPMI_SRVGRP_HSM, 2) ||
+	     rpmi_context_set_group_worker(scene->cntx, RPMI_SRVGRP_CPPC, 2)))
+		goto fail;
+
+	return 0;
+
+fail:
+	printf("%s: failed to setup bench scenario\n", __func__);
+	bench_scenario_cleanup_groups(scene);
+	test_scenario_default_cleanup(scene);
+	return RPMI_ERR_FAILED;
+}
+
+static int bench_scenario_cleanup(struct rpmi_test_scenario *scene)
+{
+	bench_scenario_cleanup_groups(scene);
+	return test_scenario_default_cleanup(scene);
+}
+
+static struct rpmi_test_scenario scenario_bench = {
+	.name = "Bench",
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.shmem_ops = &bench_shmem_ops,
+	.shmem_ops_priv = &bench.counts,
+	.base.plat_info_len = PLAT_INFO_LEN,
+	.base.plat_info = PLAT_INFO,
+	.priv = &bench,
+
+	.init = bench_scenario_init,
+	.cleanup = bench_scenario_cleanup,
+
+	.num_tests = 4,
+	.tests = {
+		{
+			.name = "BASE_GET_IMPLEMENTATION_VERSION",
+			.attrs = {
+				.servicegroup_id = RPMI_SRVGRP_BASE,
+				.service_id = RPMI_BASE_SRV_GET_IMPLEMENTATION_VERSION,
+				.flags = RPMI_MSG_NORMAL_REQUEST,
+			},
+		},
+		{
+			.name = "HSM_GET_HART_STATUS",
+			.attrs = {
+				.servicegroup_id = RPMI_SRVGRP_HSM,
+				.service_id = RPMI_HSM_SRV_GET_HART_STATUS,
+				.flags = RPMI_MSG_NORMAL_REQUEST,
+				.request_data = hsm_status_reqdata,
+				.request_data_len = sizeof(hsm_status_reqdata),
+			},
+			.init_request_data = test_init_request_data_from_attrs,
+		},
+		{
+			.name = "CLOCK_GET_RATE",
+			.attrs = {
+				.servicegroup_id = RPMI_SRVGRP_CLOCK,
+				.service_id = RPMI_CLK_SRV_GET_RATE,
+				.flags = RPMI_MSG_NORMAL_REQUEST,
+				.request_data = clock_rate_reqdata,
+				.request_data_len = sizeof(clock_rate_reqdata),
+			},
+			.init_request_data = test_init_request_data_from_attrs,
+		},
+		{
+			.name = "CPPC_READ_REG",
+			.attrs = {
+				.servicegroup_id = RPMI_SRVGRP_CPPC,
+				.service_id = RPMI_CPPC_SRV_READ_REG,
+				.flags = RPMI_MSG_NORMAL_REQUEST,
+				.request_data = cppc_read_reqdata,
+				.request_data_len = sizeof(cppc_read_reqdata),
+			},
+			.init_request_data = test_init_request_data_from_attrs,
+		},
+	},
+};
+
+/* ==================== Benchmark loop ==================== */
+
+static rpmi_uint64_t bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (rpmi_uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int bench_cmp_u64(const void *a, const void *b)
+{
+	rpmi_uint64_t x = *(const rpmi_uint64_t *)a;
+	rpmi_uint64_t y = *(const rpmi_uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Processing thread standing in for the platform microcontroller */
+static void *bench_process_thread(void *arg)
+{
+	struct rpmi_test_scenario *scene = arg;
+	struct bench_priv *priv = scene->priv;
+
+	/*
+	 * Poll through the application processor view so that idle polling
+	 * is not accounted as shared memory operations of the platform side.
+	 */
+	while (!priv->stop) {
+		if (!rpmi_transport_is_empty(priv->ap_xport, RPMI_QUEUE_A2P_REQ)) {
+			rpmi_context_process_a2p_request(scene->cntx);
+		} else {
+			/* Acknowledgements of workers are posted by the dispatcher */
+			if (priv->use_workers)
+				rpmi_context_process_a2p_request(scene->cntx);
+			sched_yield();
+		}
+	}
+
+	return NULL;
+}
+
+/* Worker thread standing in for another platform microcontroller core */
+static void *bench_worker_thread(void *arg)
+{
+	struct rpmi_test_scenario *scene = &scenario_bench;
+	struct bench_priv *priv = scene->priv;
+	rpmi_uint32_t worker = (unsigned long)arg;
+
+	while (!priv->stop) {
+		if (!rpmi_context_process_worker(scene->cntx, worker))
+			sched_yield();
+	}
+
+	return NULL;
+}
+
+static rpmi_uint32_t bench_drain_acks(struct rpmi_test_scenario *scene,
+				      struct rpmi_message *resp_msg,
+				      rpmi_uint32_t received, int *failed)
+{
+	struct bench_priv *priv = scene->priv;
+	rpmi_uint64_t now;
+
+	while (!rpmi_transport_dequeue(priv->ap_xport, RPMI_QUEUE_P2A_ACK,
+				       resp_msg)) {
+		now = bench_now_ns();
+		priv->lat_ns[received++] = now - priv->start_ns[resp_msg->header.token];
+		if (resp_msg->header.datalen < sizeof(rpmi_uint32_t) ||
+		    ((rpmi_uint32_t *)resp_msg->data)[0] != RPMI_SUCCESS)
+			*failed = 1;
+	}
+
+	return received;
+}
+
+static void bench_run_test(struct rpmi_test_scenario *scene,
+			   struct rpmi_test *test, rpmi_uint32_t burst,
+			   rpmi_uint32_t iterations, int threaded)
+{
+	struct bench_priv *priv = scene->priv;
+	rpmi_uint32_t sent = 0, received = 0, prev;
+	struct rpmi_message *req_msg, *resp_msg;
+	rpmi_uint64_t t_begin, t_end;
+	unsigned long ops, bytes;
+	pthread_t thread, workers[BENCH_WORKER_COUNT];
+	unsigned long w, num_workers = 0;
+	int failed = 0;
+
+	req_msg = calloc(1, scene->slot_size);
+	resp_msg = calloc(1, scene->slot_size);
+	if (!req_msg || !resp_msg) {
+		printf("%s: failed to allocate messages\n", __func__);
+		goto done;
+	}
+
+	req_msg->header.servicegroup_id = test->attrs.servicegroup_id;
+	req_msg->header.service_id = test->attrs.service_id;
+	req_msg->header.flags = test->attrs.flags;
+	req_msg->header.datalen = 0;
+	if (test->init_request_data)
+		req_msg->header.datalen = test->init_request_data(scene, test,
+			&req_msg->data, RPMI_MSG_DATA_SIZE(scene->slot_size));
+
+	priv->stop = 0;
+	if (threaded && pthread_create(&thread, NULL, bench_process_thread, scene)) {
+		printf("%s: failed to create processing thread\n", __func__);
+		goto done;
+	}
+	for (w = 0; priv->use_workers && w < BENCH_WORKER_COUNT; w++) {
+		if (pthread_create(&workers[w], NULL, bench_worker_thread,
+				   (void *)(w + 1))) {
+			printf("%s: failed to create worker thread\n", __func__);
+			break;
+		}
+		num_workers++;
+	}
+
+	ops = priv->counts.ops;
+	bytes = priv->counts.bytes;
+	t_begin = bench_now_ns();
+	while (received < iterations) {
+		/* Keep up to burst requests outstanding */
+		while (sent < iterations && (sent - received) < burst) {
+			req_msg->header.token = scene->token_sequence++;
+			priv->start_ns[req_msg->header.token] = bench_now_ns();
+			if (rpmi_transport_enqueue(priv->ap_xport,
+						   RPMI_QUEUE_A2P_REQ, req_msg)) {
+				scene->token_sequence--;
+				break;
+			}
+			sent++;
+		}
+
+		if (!threaded)
+			rpmi_context_process_a2p_request(scene->cntx);
+
+		/* Let the processing thread run on a single CPU */
+		prev = received;
+		received = bench_drain_acks(scene, resp_msg, received, &failed);
+		if ((threaded || priv->use_workers) && prev == received)
+			sched_yield();
+	}
+	t_end = bench_now_ns();
+
+	priv->stop = 1;
+	if (threaded)
+		pthread_join(thread, NULL);
+	for (w = 0; w < num_workers; w++)
+		pthread_join(workers[w], NULL);
+	ops = priv->counts.ops - ops;
+	bytes = priv->counts.bytes - bytes;
+
+	qsort(priv->lat_ns, iterations, sizeof(*priv->lat_ns), bench_cmp_u64);
+	printf("%-32s %5u %5u %12.0f %8llu %8llu %8.2f %9.1f%s\n",
+	       test->name, scene->slot_size, burst,
+	       (double)iterations * 1000000000.0 / (double)(t_end - t_begin),
+	       (unsigned long long)priv->lat_ns[iterations / 2],
+	       (unsigned long long)priv->lat_ns[(iterations * 99ULL) / 100],
+	       (double)ops / iterations, (double)bytes / iterations,
+	       failed ? " (FAILED)" : "");
+
+done:
+	free(resp_msg);
+	free(req_msg);
+}
+
+static int bench_run_config(rpmi_uint32_t slot_size, rpmi_uint32_t burst,
+			    rpmi_uint32_t iterations, int threaded)
+{
+	struct rpmi_test_scenario *scene = &scenario_bench;
+	rpmi_uint32_t chunks;
+	int i, rc;
+
+	/*
+	 * The A2P request queue gets 3/8 of the shared memory and must hold
+	 * the burst plus the head, tail and always empty slots.
+	 */
+	chunks = (burst + 3 + 2) / 3;
+	if (chunks < LIBRPMI_TRANSPORT_SHMEM_QUEUE_MIN_SLOTS)
+		chunks = LIBRPMI_TRANSPORT_SHMEM_QUEUE_MIN_SLOTS;
+	scene->slot_size = slot_size;
+	scene->shm_size = 8 * slot_size * chunks;
+
+	rc = scene->init(scene);
+	if (rc) {
+		printf("Failed to initialize bench scenario for slot size %u\n",
+		       slot_size);
+		return rc;
+	}
+
+	for (i = 0; i < scene->num_tests; i++)
+		bench_run_test(scene, &scene->tests[i], burst, iterations, threaded);
+
+	return scene->cleanup(scene);
+}
+
+static void bench_usage(const char *prog)
+{
+	printf("Usage: %s [-i iterations] [-s slot_size]... [-b burst]... [-t] [-w] [-c] [-T trace_file]\n",
+	       prog);
+	printf("  -i  requests per service and configuration (default 100000)\n");
+#if LIBRPMI_FIXED_SLOT_SIZE
+	printf("  -s  transport slot size (only %u in this build)\n",
+	       LIBRPMI_FIXED_SLOT_SIZE);
+#else
+	printf("  -s  transport slot size (default 64, 128 and 256)\n");
+#endif
+	printf("  -b  outstanding requests per burst (default 1, 4 and 16)\n");
+	printf("  -t  produce requests against a separate processing thread\n");
+	printf("  -w  process clock and HSM/CPPC requests on two worker threads\n");
+	printf("  -c  copy mode (no direct shared memory access)\n");
+	printf("  -T  dump the trace ring to a file (needs LIBRPMI_TRACE)\n");
+}
+
+int main(int argc, char *argv[])
+{
+	rpmi_uint32_t slots[BENCH_MAX_CONFIGS] = { 64, 128, 256 };
+	rpmi_uint32_t bursts[BENCH_MAX_CONFIGS] = { 1, 4, 16 };
+	rpmi_uint32_t slot_count = 0, burst_count = 0, iterations = 100000;
+	rpmi_uint32_t s, b;
+	const char *trace_file = NULL;
+	int opt, threaded = 0, rc = 0;
+	void *trace = NULL;
+	FILE *fp;
+
+	while ((opt = getopt(argc, argv, "i:s:b:twcT:h")) != -1) {
+		switch (opt) {
+		case 'i':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			if (slot_count < BENCH_MAX_CONFIGS)
+				slots[slot_count++] = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			if (burst_count < BENCH_MAX_CONFIGS)
+				bursts[burst_count++] = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			threaded = 1;
+			break;
+		case 'w':
+			bench.use_workers = 1;
+			break;
+		case 'c':
+			bench.copy_mode = 1;
+			break;
+		case 'T':
+			trace_file = optarg;
+			break;
+		default:
+			bench_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+#if LIBRPMI_FIXED_SLOT_SIZE
+	/* Transports of other slot sizes can't be created in this build */
+	for (s = 0; s < slot_count; s++) {
+		if (slots[s] != LIBRPMI_FIXED_SLOT_SIZE) {
+			printf("Slot size %u not supported (built for slot size %u)\n",
+			       slots[s], LIBRPMI_FIXED_SLOT_SIZE);
+			return 1;
+		}
+	}
+	if (!slot_count) {
+		slots[0] = LIBRPMI_FIXED_SLOT_SIZE;
+		slot_count = 1;
+	}
+#else
+	if (!slot_count)
+		slot_count = 3;
+#endif
+	if (!burst_count)
+		burst_count = 3;
+	if (!iterations)
+		iterations = 1;
+
+	bench.start_ns = calloc(BENCH_TOKEN_COUNT, sizeof(*bench.start_ns));
+	bench.lat_ns = calloc(iterations, sizeof(*bench.lat_ns));
+	if (!bench.start_ns || !bench.lat_ns) {
+		printf("Failed to allocate latency buffers\n");
+		return 1;
+	}
+
+	if (trace_file) {
+		trace = aligned_alloc(sizeof(rpmi_uint64_t), BENCH_TRACE_SZ);
+		if (!trace || rpmi_trace_init(trace, BENCH_TRACE_SZ)) {
+			printf("Failed to initialize trace ring\n");
+			return 1;
+		}
+	}
+
+	printf("RPMI Bench (%s%s, %s, %u requests per run)\n",
+	       threaded ? "processing thread" : "single thread",
+	       bench.use_workers ? " with workers" : "",
+	       bench.copy_mode ? "copy mode" : "direct mode", iterations);
+	printf("*******************************************\n");
+	printf("%-32s %5s %5s %12s %8s %8s %8s %9s\n", "service", "slot",
+	       "burst", "msg/s", "p50(ns)", "p99(ns)", "ops/msg", "bytes/msg");
+	for (s = 0; s < slot_count && !rc; s++) {
+		for (b = 0; b < burst_count && !rc; b++)
+			rc = bench_run_config(slots[s], bursts[b] ? bursts[b] : 1,
+					      iterations, threaded);
+	}
+
+	if (trace) {
+		rpmi_trace_init(NULL, 0);
+		fp = fopen(trace_file, "wb");
+		if (!fp || fwrite(trace, BENCH_TRACE_SZ, 1, fp) != 1) {
+			printf("Failed to write trace ring to %s\n", trace_file);
+			rc = 1;
+		}
+		if (fp)
+			fclose(fp);
+		free(trace);
+	}
+
+	free(bench.lat_ns);
+	free(bench.start_ns);
+	return rc ? 1 : 0;
+}
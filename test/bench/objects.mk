@@ -0,0 +1,12 @@
+#
+# SPDX-License-Identifier: BSD-2-Clause
+#
+# Copyright (c) 2024 Ventana Micro Systems Inc.
+#
+
+ifeq ($(CONFIG_LIBRPMI_SRVGRP_HSM)$(CONFIG_LIBRPMI_SRVGRP_CLOCK)$(CONFIG_LIBRPMI_SRVGRP_CPPC),yyy)
+bench-elfs-y += bench_rpmi
+endif
+
+bench_rpmi-objs-y += test/test_common.o
+bench_rpmi-cflags-y += -pthread
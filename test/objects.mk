@@ -9,7 +9,44 @@ test-elfs-y += test_base
 test_base-objs-y += test/test_log.o
 test_base-objs-y += test/test_common.o
 
-test-elfs-y += test_sysreset
+test-elfs-$(CONFIG_LIBRPMI_SRVGRP_SYSRESET) += test_sysreset
 
 test_sysreset-objs-y += test/test_log.o
 test_sysreset-objs-y += test/test_common.o
+
+test-elfs-$(CONFIG_LIBRPMI_SRVGRP_HSM) += test_hsm
+
+test_hsm-objs-y += test/test_log.o
+test_hsm-objs-y += test/test_common.o
+
+test-elfs-$(CONFIG_LIBRPMI_SRVGRP_CPPC) += test_cppc
+
+test_cppc-objs-y += test/test_log.o
+test_cppc-objs-y += test/test_common.o
+
+test-elfs-$(CONFIG_LIBRPMI_SRVGRP_CLOCK) += test_clock
+
+test_clock-objs-y += test/test_log.o
+test_clock-objs-y += test/test_common.o
+
+test-elfs-$(CONFIG_LIBRPMI_SRVGRP_SYSMSI) += test_sysmsi
+
+test_sysmsi-objs-y += test/test_log.o
+test_sysmsi-objs-y += test/test_common.o
+
+test-elfs-y += test_trace
+
+test_trace-objs-y += test/test_log.o
+test_trace-objs-y += test/test_common.o
+
+test-elfs-y += test_transport
+
+test_transport-objs-y += test/test_log.o
+test_transport-objs-y += test/test_common.o
+test_transport-cflags-y += -pthread
+
+test-elfs-y += test_context
+
+test_context-objs-y += test/test_log.o
+test_context-objs-y += test/test_common.o
+test_context-cflags-y += -pthread
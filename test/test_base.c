@@ -6,7 +6,6 @@
 
 #include <librpmi.h>
 #include <stdio.h>
-#include <string.h>
 #include "test_common.h"
 #include "test_log.h"
 
@@ -58,6 +57,44 @@ static rpmi_uint32_t attribs_expdata_default[] = {
 	0,
 };
 
+/*
+ * The earlier tests of the scenario did seven requests of seven different
+ * base services where only ENABLE_NOTIFICATION is answered with NOTSUPP.
+ */
+#define TEST_STATS_REQUESTS	7
+
+static int test_stats_check(struct rpmi_test_scenario *scene,
+			    struct rpmi_test *test)
+{
+	struct rpmi_service_stats st;
+
+#ifdef LIBRPMI_STATS
+	if (rpmi_context_get_stats(scene->cntx, RPMI_SRVGRP_BASE, 0, &st) ||
+	    st.requests != TEST_STATS_REQUESTS || st.errors || st.notsupp != 1 ||
+	    st.latency_min > st.latency_max || st.latency_total < st.latency_max)
+		return RPMI_ERR_FAILED;
+
+	if (rpmi_context_get_stats(scene->cntx, RPMI_SRVGRP_BASE,
+				   RPMI_BASE_SRV_ENABLE_NOTIFICATION, &st) ||
+	    st.requests != 1 || st.errors || st.notsupp != 1)
+		return RPMI_ERR_FAILED;
+
+	if (rpmi_context_get_stats(scene->cntx, RPMI_SRVGRP_BASE,
+				   RPMI_BASE_SRV_PROBE_SERVICE_GROUP, &st) ||
+	    st.requests != 1 || st.errors || st.notsupp)
+		return RPMI_ERR_FAILED;
+
+	if (rpmi_context_get_stats(scene->cntx, RPMI_SRVGRP_BASE,
+				   RPMI_BASE_SRV_ID_MAX, &st) != RPMI_ERR_INVALID_PARAM)
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+#else
+	return (rpmi_context_get_stats(scene->cntx, RPMI_SRVGRP_BASE, 0, &st) ==
+		RPMI_ERR_NOTSUPP) ? RPMI_SUCCESS : RPMI_ERR_FAILED;
+#endif
+}
+
 static struct rpmi_test_scenario scenario_base_default = {
 	.name = "Base Service Group Default",
 	.shm_size = RPMI_SHM_SZ,
@@ -70,7 +107,7 @@ static struct rpmi_test_scenario scenario_base_default = {
 	.init = test_scenario_default_init,
 	.cleanup = test_scenario_default_cleanup,
 
-	.num_tests = 7,
+	.num_tests = 8,
 	.tests = {
 		{
 			.name = "RPMI_BASE_SRV_ENABLE_NOTIFICATION",
@@ -152,6 +189,10 @@ static struct rpmi_test_scenario scenario_base_default = {
 			},
 			.init_expected_data = test_init_expected_data_from_attrs,
 		},
+		{
+			.name = "RPMI_CONTEXT_GET_STATS",
+			.check = test_stats_check,
+		},
 	},
 };
 
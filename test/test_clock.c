@@ -0,0 +1,1146 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 Ventana Micro Systems Inc.
+ */
+
+#include <librpmi.h>
+#include <stdio.h>
+#include "test_common.h"
+#include "test_log.h"
+
+#define TEST_CLOCK_COUNT	2
+
+/* Clocks of the extension scenario which need more than one message */
+#define TEST_EXT_CLOCK_COUNT	12
+#define TEST_EXT_GROUP_ID	RPMI_SRVGRP_EXPERIMENTAL_START
+
+/* Entries of a clock extension response which fit in one message */
+#define TEST_EXT_MAX_CONFIGS	\
+	((RPMI_MSG_DATA_SIZE(RPMI_SLOT_SIZE) - 3 * sizeof(rpmi_uint32_t)) / sizeof(rpmi_uint32_t))
+#define TEST_EXT_MAX_RATES	\
+	((RPMI_MSG_DATA_SIZE(RPMI_SLOT_SIZE) - 3 * sizeof(rpmi_uint32_t)) / (2 * sizeof(rpmi_uint32_t)))
+
+/* Rates of a supported rates response which fit in one message */
+#define TEST_MAX_SUPP_RATES	\
+	((RPMI_MSG_DATA_SIZE(RPMI_SLOT_SIZE) - 4 * sizeof(rpmi_uint32_t)) / (2 * sizeof(rpmi_uint32_t)))
+
+#define TEST_RATE_LO(__rate)	((rpmi_uint32_t)(__rate))
+#define TEST_RATE_HI(__rate)	((rpmi_uint32_t)((rpmi_uint64_t)(__rate) >> 32))
+
+struct test_clock_priv {
+	const struct rpmi_clock_platform_ops *ops;
+	const struct rpmi_clock_data *clock_data;
+	rpmi_uint32_t clock_count;
+	struct rpmi_service_group *group;
+	struct rpmi_service_group *ext_group;
+
+	/* Hardware state and rate of each clock (sized for all scenarios) */
+	enum rpmi_clock_state state[TEST_EXT_CLOCK_COUNT];
+	rpmi_uint64_t rate[TEST_EXT_CLOCK_COUNT];
+
+	/* Clock whose state and rate can't be read (if fault is set) */
+	rpmi_bool_t fault;
+	rpmi_uint32_t fault_clock_id;
+
+	/* Error returned by set_rate_async (RPMI_SUCCESS to start the change) */
+	enum rpmi_error async_rc;
+
+	/* Rate change started by set_rate_async */
+	rpmi_bool_t async_pending;
+	rpmi_uint32_t async_clock_id;
+	rpmi_uint64_t async_rate;
+	struct rpmi_context *async_cntx;
+	rpmi_uint32_t async_handle;
+	rpmi_uint16_t async_token;
+
+	/* Platform calls which fetch or recalculate a clock rate */
+	rpmi_uint32_t rate_reads;
+	rpmi_uint32_t rate_recalcs;
+};
+
+static const rpmi_uint64_t test_root_rates[] = { 100000000, 200000000, 400000000 };
+
+/* Child clock runs at half the rate of the root clock */
+static const rpmi_uint64_t test_child_rates[] = { 50000000, 200000000, 50000000 };
+
+static const struct rpmi_clock_data test_clock_data[TEST_CLOCK_COUNT] = {
+	{
+		.parent_id = -1,
+		.rate_count = sizeof(test_root_rates) / sizeof(test_root_rates[0]),
+		.clock_type = RPMI_CLK_TYPE_DISCRETE,
+		.name = "test_root",
+		.clock_rate_array = test_root_rates,
+	},
+	{
+		.parent_id = 0,
+		.rate_count = sizeof(test_child_rates) / sizeof(test_child_rates[0]),
+		.clock_type = RPMI_CLK_TYPE_LINEAR,
+		.name = "test_child",
+		.clock_rate_array = test_child_rates,
+	},
+};
+
+/* Discrete rates which are not in ascending order */
+static const rpmi_uint64_t test_unsorted_rates[] = { 400000000, 100000000, 200000000 };
+
+static const struct rpmi_clock_data test_unsorted_clock_data[] = {
+	{
+		.parent_id = -1,
+		.rate_count = sizeof(test_unsorted_rates) / sizeof(test_unsorted_rates[0]),
+		.clock_type = RPMI_CLK_TYPE_DISCRETE,
+		.name = "test_unsorted",
+		.clock_rate_array = test_unsorted_rates,
+	},
+};
+
+/* Discrete rates which need more than one message (last one above 32 bits) */
+static const rpmi_uint64_t test_many_rates[] = {
+	25000000, 50000000, 75000000, 100000000, 125000000, 150000000,
+	200000000, 250000000, 400000000, 800000000, 1600000000, 4800000000ULL,
+};
+
+static const struct rpmi_clock_data test_rates_clock_data[] = {
+	{
+		.parent_id = -1,
+		.rate_count = sizeof(test_many_rates) / sizeof(test_many_rates[0]),
+		.clock_type = RPMI_CLK_TYPE_DISCRETE,
+		.name = "test_many",
+		.clock_rate_array = test_many_rates,
+	},
+	{
+		.parent_id = 0,
+		.rate_count = sizeof(test_child_rates) / sizeof(test_child_rates[0]),
+		.clock_type = RPMI_CLK_TYPE_LINEAR,
+		.name = "test_linear",
+		.clock_rate_array = test_child_rates,
+	},
+};
+
+static enum rpmi_error test_clock_set_state(void *priv, rpmi_uint32_t clock_id,
+					    enum rpmi_clock_state state)
+{
+	struct test_clock_priv *cpriv = priv;
+
+	cpriv->state[clock_id] = state;
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error test_clock_get_state_and_rate(void *priv,
+						     rpmi_uint32_t clock_id,
+						     enum rpmi_clock_state *state,
+						     rpmi_uint64_t *rate)
+{
+	struct test_clock_priv *cpriv = priv;
+
+	if (cpriv->fault && cpriv->fault_clock_id == clock_id)
+		return RPMI_ERR_HW_FAULT;
+
+	if (state)
+		*state = cpriv->state[clock_id];
+	if (rate) {
+		*rate = cpriv->rate[clock_id];
+		cpriv->rate_reads++;
+	}
+	return RPMI_SUCCESS;
+}
+
+static rpmi_bool_t test_clock_rate_change_match(void *priv,
+						rpmi_uint32_t clock_id,
+						rpmi_uint64_t rate)
+{
+	struct test_clock_priv *cpriv = priv;
+
+	return (cpriv->rate[clock_id] != rate) ? true : false;
+}
+
+static enum rpmi_error test_clock_set_rate(void *priv, rpmi_uint32_t clock_id,
+					   enum rpmi_clock_rate_match match,
+					   rpmi_uint64_t rate,
+					   rpmi_uint64_t *new_rate)
+{
+	struct test_clock_priv *cpriv = priv;
+
+	cpriv->rate[clock_id] = rate;
+	*new_rate = rate;
+	return RPMI_SUCCESS;
+}
+
+/* Record the rate change which the test completes later like a PLL relock */
+static enum rpmi_error test_clock_set_rate_async(void *priv,
+						 rpmi_uint32_t clock_id,
+						 enum rpmi_clock_rate_match match,
+						 rpmi_uint64_t rate,
+						 struct rpmi_context *cntx,
+						 rpmi_uint32_t handle)
+{
+	struct test_clock_priv *cpriv = priv;
+
+	if (cpriv->async_rc)
+		return cpriv->async_rc;
+
+	cpriv->async_pending = true;
+	cpriv->async_clock_id = clock_id;
+	cpriv->async_rate = rate;
+	cpriv->async_cntx = cntx;
+	cpriv->async_handle = handle;
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error test_clock_set_rate_recalc(void *priv,
+						  rpmi_uint32_t clock_id,
+						  rpmi_uint64_t parent_rate,
+						  rpmi_uint64_t *new_rate)
+{
+	struct test_clock_priv *cpriv = priv;
+
+	cpriv->rate_recalcs++;
+	cpriv->rate[clock_id] = parent_rate / 2;
+	*new_rate = cpriv->rate[clock_id];
+	return RPMI_SUCCESS;
+}
+
+static const struct rpmi_clock_platform_ops test_clock_async_ops = {
+	.set_state = test_clock_set_state,
+	.get_state_and_rate = test_clock_get_state_and_rate,
+	.rate_change_match = test_clock_rate_change_match,
+	.set_rate = test_clock_set_rate,
+	.set_rate_async = test_clock_set_rate_async,
+	.set_rate_recalc = test_clock_set_rate_recalc,
+};
+
+static struct test_clock_priv clock_priv_async = {
+	.ops = &test_clock_async_ops,
+	.clock_data = test_clock_data,
+	.clock_count = TEST_CLOCK_COUNT,
+};
+
+static const struct rpmi_clock_platform_ops test_clock_sync_ops = {
+	.set_state = test_clock_set_state,
+	.get_state_and_rate = test_clock_get_state_and_rate,
+	.rate_change_match = test_clock_rate_change_match,
+	.set_rate = test_clock_set_rate,
+	.set_rate_recalc = test_clock_set_rate_recalc,
+};
+
+static struct test_clock_priv clock_priv_cached = {
+	.ops = &test_clock_sync_ops,
+	.clock_data = test_clock_data,
+	.clock_count = TEST_CLOCK_COUNT,
+};
+
+/* Clocks of the extension scenario are setup by its init */
+static struct rpmi_clock_data test_ext_clock_data[TEST_EXT_CLOCK_COUNT];
+
+static struct test_clock_priv clock_priv_ext = {
+	.ops = &test_clock_sync_ops,
+	.clock_data = test_ext_clock_data,
+	.clock_count = TEST_EXT_CLOCK_COUNT,
+};
+
+static struct test_clock_priv clock_priv_match = {
+	.ops = &test_clock_sync_ops,
+	.clock_data = test_unsorted_clock_data,
+	.clock_count = 1,
+};
+
+static struct test_clock_priv clock_priv_rates = {
+	.ops = &test_clock_sync_ops,
+	.clock_data = test_rates_clock_data,
+	.clock_count = 2,
+};
+
+static const rpmi_uint32_t set_rate_200m_reqdata[] = {
+	0, RPMI_CLK_RATE_MATCH_PLATFORM,
+	TEST_RATE_LO(200000000), TEST_RATE_HI(200000000),
+};
+
+static const rpmi_uint32_t set_rate_400m_reqdata[] = {
+	0, RPMI_CLK_RATE_MATCH_PLATFORM,
+	TEST_RATE_LO(400000000), TEST_RATE_HI(400000000),
+};
+
+static const rpmi_uint32_t get_rate_root_reqdata[] = { 0 };
+
+static rpmi_uint32_t get_rate_200m_expdata[] = {
+	RPMI_SUCCESS, TEST_RATE_LO(200000000), TEST_RATE_HI(200000000),
+};
+
+static rpmi_uint32_t status_busy_expdata[] = { RPMI_ERR_BUSY };
+static rpmi_uint32_t status_failed_expdata[] = { RPMI_ERR_FAILED };
+
+/* Next request is acknowledged only after the rate change is completed */
+static int test_async_started_check(struct rpmi_test_scenario *scene,
+				    struct rpmi_test *test)
+{
+	struct test_clock_priv *priv = scene->priv;
+	const rpmi_uint32_t *req = test->attrs.request_data;
+	rpmi_uint32_t ack[RPMI_SLOT_SIZE / sizeof(rpmi_uint32_t)];
+
+	priv->async_token = scene->token_sequence - 1;
+
+	if (!priv->async_pending || priv->async_clock_id != req[0] ||
+	    priv->async_rate != (((rpmi_uint64_t)req[3] << 32) | req[2]) ||
+	    priv->async_cntx != scene->cntx)
+		return RPMI_ERR_FAILED;
+
+	return (rpmi_transport_dequeue(scene->xport, RPMI_QUEUE_P2A_ACK,
+				       (void *)ack) == RPMI_ERR_IO) ?
+						RPMI_SUCCESS : RPMI_ERR_FAILED;
+}
+
+/* Complete the pending rate change with the status passed as test data */
+static int test_async_complete_check(struct rpmi_test_scenario *scene,
+				     struct rpmi_test *test)
+{
+	struct test_clock_priv *priv = scene->priv;
+	enum rpmi_error status = (long)test->priv;
+	rpmi_uint32_t ack[RPMI_SLOT_SIZE / sizeof(rpmi_uint32_t)];
+	struct rpmi_message *msg = (void *)ack;
+
+	if (rpmi_service_group_clock_set_rate_complete(priv->group, 0, status,
+					priv->async_rate, priv->async_cntx,
+					priv->async_handle))
+		return RPMI_ERR_FAILED;
+	priv->async_pending = false;
+
+	/* Nothing is pending anymore */
+	if (rpmi_service_group_clock_set_rate_complete(priv->group, 0, status,
+					priv->async_rate, priv->async_cntx,
+					priv->async_handle) != RPMI_ERR_INVALID_STATE)
+		return RPMI_ERR_FAILED;
+
+	/* Acknowledgement is posted by the next request processing */
+	rpmi_context_process_a2p_request(scene->cntx);
+	if (rpmi_transport_dequeue(scene->xport, RPMI_QUEUE_P2A_ACK, msg) ||
+	    msg->header.token != priv->async_token ||
+	    msg->header.service_id != RPMI_CLK_SRV_SET_RATE ||
+	    msg->header.datalen != sizeof(rpmi_uint32_t) ||
+	    ((rpmi_uint32_t *)msg->data)[0] != (rpmi_uint32_t)status)
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static int test_async_rejected_init(struct rpmi_test_scenario *scene,
+				    struct rpmi_test *test)
+{
+	struct test_clock_priv *priv = scene->priv;
+
+	priv->async_rc = RPMI_ERR_FAILED;
+	return 0;
+}
+
+static void test_async_rejected_cleanup(struct rpmi_test_scenario *scene,
+					struct rpmi_test *test)
+{
+	struct test_clock_priv *priv = scene->priv;
+
+	priv->async_rc = RPMI_SUCCESS;
+}
+
+/*
+ * Send a request to a service group and copy the response data of up to
+ * resp_len bytes (the response length is returned if resp_datalen is set)
+ */
+static int test_clock_request(struct rpmi_test_scenario *scene,
+			      rpmi_uint16_t servicegroup_id,
+			      rpmi_uint8_t service_id,
+			      const rpmi_uint32_t *data, rpmi_uint16_t datalen,
+			      rpmi_uint32_t *resp, rpmi_uint16_t resp_len,
+			      rpmi_uint16_t *resp_datalen)
+{
+	rpmi_uint32_t buf[RPMI_SLOT_SIZE / sizeof(rpmi_uint32_t)];
+	struct rpmi_message *msg = (void *)buf;
+	rpmi_uint16_t token = scene->token_sequence++;
+	rpmi_uint32_t i;
+
+	msg->header.servicegroup_id = servicegroup_id;
+	msg->header.service_id = service_id;
+	msg->header.flags = RPMI_MSG_NORMAL_REQUEST;
+	msg->header.datalen = datalen;
+	msg->header.token = token;
+	for (i = 0; i < datalen / sizeof(rpmi_uint32_t); i++)
+		((rpmi_uint32_t *)msg->data)[i] = data[i];
+
+	if (rpmi_transport_enqueue(scene->xport, RPMI_QUEUE_A2P_REQ, msg))
+		return RPMI_ERR_FAILED;
+
+	rpmi_context_process_a2p_request(scene->cntx);
+	if (rpmi_transport_dequeue(scene->xport, RPMI_QUEUE_P2A_ACK, msg) ||
+	    msg->header.token != token || msg->header.datalen > resp_len)
+		return RPMI_ERR_FAILED;
+
+	for (i = 0; i < msg->header.datalen / sizeof(rpmi_uint32_t); i++)
+		resp[i] = ((rpmi_uint32_t *)msg->data)[i];
+	if (resp_datalen)
+		*resp_datalen = msg->header.datalen;
+
+	return RPMI_SUCCESS;
+}
+
+/* Get the rate of a clock using GET_RATE */
+static int test_clock_get_rate(struct rpmi_test_scenario *scene,
+			       rpmi_uint32_t clock_id, rpmi_uint64_t *rate)
+{
+	rpmi_uint32_t resp[3];
+
+	if (test_clock_request(scene, RPMI_SRVGRP_CLOCK, RPMI_CLK_SRV_GET_RATE,
+			       &clock_id, sizeof(clock_id), resp, sizeof(resp),
+			       NULL) ||
+	    resp[0] != RPMI_SUCCESS)
+		return RPMI_ERR_FAILED;
+
+	*rate = ((rpmi_uint64_t)resp[2] << 32) | resp[1];
+	return RPMI_SUCCESS;
+}
+
+/* Set the rate of a clock using SET_RATE and return the status */
+static int test_clock_set_rate_status(struct rpmi_test_scenario *scene,
+				      rpmi_uint32_t clock_id,
+				      enum rpmi_clock_rate_match match,
+				      rpmi_uint64_t rate, rpmi_uint32_t *status)
+{
+	rpmi_uint32_t req[4] = {
+		clock_id, match, TEST_RATE_LO(rate), TEST_RATE_HI(rate),
+	};
+
+	return test_clock_request(scene, RPMI_SRVGRP_CLOCK, RPMI_CLK_SRV_SET_RATE,
+				  req, sizeof(req), status, sizeof(*status), NULL);
+}
+
+/* Check the rates of both clocks and the platform calls needed to get them */
+static int test_cached_expect(struct rpmi_test_scenario *scene,
+			      rpmi_uint64_t root_rate, rpmi_uint64_t child_rate,
+			      rpmi_uint32_t reads, rpmi_uint32_t recalcs)
+{
+	struct test_clock_priv *priv = scene->priv;
+	rpmi_uint64_t rate[TEST_CLOCK_COUNT];
+
+	priv->rate_reads = 0;
+	priv->rate_recalcs = 0;
+
+	/* Child clock first so that it refreshes the parent if needed */
+	if (test_clock_get_rate(scene, 1, &rate[1]) ||
+	    test_clock_get_rate(scene, 0, &rate[0]))
+		return RPMI_ERR_FAILED;
+
+	if (rate[0] != root_rate || rate[1] != child_rate ||
+	    priv->rate_reads != reads || priv->rate_recalcs != recalcs)
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static int test_cached_get_rate_check(struct rpmi_test_scenario *scene,
+				      struct rpmi_test *test)
+{
+	/* Rates read when the group was created are served from the cache */
+	return test_cached_expect(scene, 100000000, 50000000, 0, 0);
+}
+
+static int test_cached_set_rate_check(struct rpmi_test_scenario *scene,
+				      struct rpmi_test *test)
+{
+	struct test_clock_priv *priv = scene->priv;
+	rpmi_uint32_t status;
+
+	/* Child rate is recalculated once after the parent rate changed */
+	priv->rate_recalcs = 0;
+	if (test_clock_set_rate_status(scene, 0, RPMI_CLK_RATE_MATCH_PLATFORM,
+				       400000000, &status) ||
+	    status != RPMI_SUCCESS || priv->rate_recalcs)
+		return RPMI_ERR_FAILED;
+
+	if (test_cached_expect(scene, 400000000, 200000000, 0, 1) ||
+	    test_cached_expect(scene, 400000000, 200000000, 0, 0))
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static int test_cached_rate_changed_check(struct rpmi_test_scenario *scene,
+					  struct rpmi_test *test)
+{
+	struct test_clock_priv *priv = scene->priv;
+
+	/* Rate changed by the platform is fetched again with its child rate */
+	priv->rate[0] = 200000000;
+	if (rpmi_service_group_clock_rate_changed(priv->group, 0) ||
+	    rpmi_service_group_clock_rate_changed(priv->group, TEST_CLOCK_COUNT) !=
+							RPMI_ERR_INVALID_PARAM)
+		return RPMI_ERR_FAILED;
+
+	if (test_cached_expect(scene, 200000000, 100000000, 1, 1) ||
+	    test_cached_expect(scene, 200000000, 100000000, 0, 0))
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+/* Rate match of a SET_RATE request and its expected result */
+struct test_match_case {
+	enum rpmi_clock_rate_match match;
+	rpmi_uint64_t rate;
+	enum rpmi_error status;
+	rpmi_uint64_t new_rate;
+};
+
+static const struct test_match_case test_match_cases[] = {
+	/* Rounding between rates */
+	{ RPMI_CLK_RATE_MATCH_ROUND_UP, 150000000, RPMI_SUCCESS, 200000000 },
+	{ RPMI_CLK_RATE_MATCH_ROUND_DOWN, 150000000, RPMI_SUCCESS, 100000000 },
+	/* Exact rates including the lowest and the highest rate */
+	{ RPMI_CLK_RATE_MATCH_ROUND_DOWN, 400000000, RPMI_SUCCESS, 400000000 },
+	{ RPMI_CLK_RATE_MATCH_ROUND_UP, 100000000, RPMI_SUCCESS, 100000000 },
+	{ RPMI_CLK_RATE_MATCH_ROUND_UP, 200000000, RPMI_SUCCESS, 200000000 },
+	/* Below the lowest rate */
+	{ RPMI_CLK_RATE_MATCH_ROUND_DOWN, 50000000, RPMI_ERR_INVALID_PARAM, 200000000 },
+	{ RPMI_CLK_RATE_MATCH_ROUND_UP, 50000000, RPMI_SUCCESS, 100000000 },
+	/* Above the highest rate */
+	{ RPMI_CLK_RATE_MATCH_ROUND_UP, 500000000, RPMI_ERR_INVALID_PARAM, 100000000 },
+	{ RPMI_CLK_RATE_MATCH_ROUND_DOWN, 500000000, RPMI_SUCCESS, 400000000 },
+	/* Rounded to the current rate */
+	{ RPMI_CLK_RATE_MATCH_ROUND_DOWN, 450000000, RPMI_ERR_ALREADY, 400000000 },
+	/* Platform decides about other rates */
+	{ RPMI_CLK_RATE_MATCH_PLATFORM, 250000000, RPMI_SUCCESS, 250000000 },
+};
+
+static int test_match_rate_check(struct rpmi_test_scenario *scene,
+				 struct rpmi_test *test)
+{
+	const struct test_match_case *c;
+	rpmi_uint32_t i, status;
+	rpmi_uint64_t rate;
+
+	for (i = 0; i < sizeof(test_match_cases) / sizeof(test_match_cases[0]); i++) {
+		c = &test_match_cases[i];
+		if (test_clock_set_rate_status(scene, 0, c->match, c->rate, &status) ||
+		    status != (rpmi_uint32_t)c->status ||
+		    test_clock_get_rate(scene, 0, &rate) || rate != c->new_rate) {
+			printf("%s: rate match case %u mismatch\n", __func__, i);
+			return RPMI_ERR_FAILED;
+		}
+	}
+
+	return RPMI_SUCCESS;
+}
+
+/* Rate of an extension scenario clock after the scenario init */
+#define TEST_EXT_RATE(__clock_id)	test_root_rates[(__clock_id) % 3]
+
+/*
+ * Get the configs or rates of all clocks page by page where each entry
+ * has the given number of words and check them with the expected values
+ */
+static int test_ext_get_all(struct rpmi_test_scenario *scene,
+			    rpmi_uint8_t service_id, rpmi_uint32_t words,
+			    rpmi_uint32_t max_entries, const rpmi_uint32_t *expected)
+{
+	rpmi_uint32_t resp[RPMI_SLOT_SIZE / sizeof(rpmi_uint32_t)];
+	rpmi_uint32_t i, clock_id = 0, pages = 0, returned, remaining;
+	rpmi_uint16_t datalen;
+
+	while (clock_id < TEST_EXT_CLOCK_COUNT) {
+		if (test_clock_request(scene, TEST_EXT_GROUP_ID, service_id,
+				       &clock_id, sizeof(clock_id), resp,
+				       sizeof(resp), &datalen) ||
+		    resp[0] != RPMI_SUCCESS)
+			return RPMI_ERR_FAILED;
+
+		returned = resp[2];
+		remaining = TEST_EXT_CLOCK_COUNT - clock_id;
+		if (returned != ((remaining < max_entries) ? remaining : max_entries) ||
+		    resp[1] != remaining - returned ||
+		    datalen != (3 + returned * words) * sizeof(rpmi_uint32_t))
+			return RPMI_ERR_FAILED;
+
+		for (i = 0; i < returned * words; i++) {
+			if (resp[3 + i] != expected[clock_id * words + i])
+				return RPMI_ERR_FAILED;
+		}
+
+		clock_id += returned;
+		pages++;
+	}
+
+	/* Clocks don't fit in one message */
+	if (pages < 2)
+		return RPMI_ERR_FAILED;
+
+	/* Start beyond the last clock */
+	if (test_clock_request(scene, TEST_EXT_GROUP_ID, service_id, &clock_id,
+			       sizeof(clock_id), resp, sizeof(resp), &datalen) ||
+	    resp[0] != (rpmi_uint32_t)RPMI_ERR_INVALID_PARAM ||
+	    datalen != sizeof(rpmi_uint32_t))
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+/* Check the configs of all clocks where the given clocks are disabled */
+static int test_ext_expect_configs(struct rpmi_test_scenario *scene,
+				   rpmi_uint32_t disabled_mask)
+{
+	rpmi_uint32_t i, configs[TEST_EXT_CLOCK_COUNT];
+
+	for (i = 0; i < TEST_EXT_CLOCK_COUNT; i++)
+		configs[i] = (disabled_mask & (1U << i)) ? 0 : 1;
+
+	return test_ext_get_all(scene, RPMI_CLK_EXT_SRV_GET_CONFIGS, 1,
+				TEST_EXT_MAX_CONFIGS, configs);
+}
+
+/* Check the rates of all clocks where one clock may have another rate */
+static int test_ext_expect_rates(struct rpmi_test_scenario *scene,
+				 rpmi_uint32_t clock_id, rpmi_uint64_t rate)
+{
+	rpmi_uint32_t i, rates[2 * TEST_EXT_CLOCK_COUNT];
+	rpmi_uint64_t r;
+
+	for (i = 0; i < TEST_EXT_CLOCK_COUNT; i++) {
+		r = (i == clock_id) ? rate : TEST_EXT_RATE(i);
+		rates[2 * i] = TEST_RATE_LO(r);
+		rates[2 * i + 1] = TEST_RATE_HI(r);
+	}
+
+	return test_ext_get_all(scene, RPMI_CLK_EXT_SRV_GET_RATES, 2,
+				TEST_EXT_MAX_RATES, rates);
+}
+
+static int test_ext_get_configs_check(struct rpmi_test_scenario *scene,
+				      struct rpmi_test *test)
+{
+	return test_ext_expect_configs(scene, 0);
+}
+
+static int test_ext_get_rates_check(struct rpmi_test_scenario *scene,
+				    struct rpmi_test *test)
+{
+	return test_ext_expect_rates(scene, TEST_EXT_CLOCK_COUNT, 0);
+}
+
+/* Pages stop before a clock which can't be read and it fails alone */
+static int test_ext_get_fault_check(struct rpmi_test_scenario *scene,
+				    struct rpmi_test *test)
+{
+	struct test_clock_priv *priv = scene->priv;
+	rpmi_uint32_t resp[RPMI_SLOT_SIZE / sizeof(rpmi_uint32_t)];
+	rpmi_uint8_t services[] = {
+		RPMI_CLK_EXT_SRV_GET_CONFIGS, RPMI_CLK_EXT_SRV_GET_RATES,
+	};
+	rpmi_uint32_t i, clock_id;
+	rpmi_uint16_t datalen;
+	int rc = RPMI_SUCCESS;
+
+	/* Rate is only read from the platform once it is dirty */
+	priv->fault = true;
+	priv->fault_clock_id = 3;
+	if (rpmi_service_group_clock_rate_changed(priv->group, 3))
+		rc = RPMI_ERR_FAILED;
+
+	for (i = 0; !rc && i < 2; i++) {
+		clock_id = 1;
+		if (test_clock_request(scene, TEST_EXT_GROUP_ID, services[i],
+				       &clock_id, sizeof(clock_id), resp,
+				       sizeof(resp), &datalen) ||
+		    resp[0] != RPMI_SUCCESS || resp[2] != 2 ||
+		    resp[1] != TEST_EXT_CLOCK_COUNT - 3)
+			rc = RPMI_ERR_FAILED;
+
+		clock_id = 3;
+		if (test_clock_request(scene, TEST_EXT_GROUP_ID, services[i],
+				       &clock_id, sizeof(clock_id), resp,
+				       sizeof(resp), &datalen) ||
+		    resp[0] != (rpmi_uint32_t)RPMI_ERR_HW_FAULT ||
+		    datalen != sizeof(rpmi_uint32_t))
+			rc = RPMI_ERR_FAILED;
+	}
+	priv->fault = false;
+
+	return rc;
+}
+
+static int test_ext_set_configs_check(struct rpmi_test_scenario *scene,
+				      struct rpmi_test *test)
+{
+	rpmi_uint32_t req[] = {
+		3,
+		1, 0,
+		TEST_EXT_CLOCK_COUNT, 0,
+		2, 0,
+	};
+	rpmi_uint32_t resp[RPMI_SLOT_SIZE / sizeof(rpmi_uint32_t)];
+	rpmi_uint16_t datalen;
+
+	/* Invalid entry does not affect the other entries */
+	if (test_clock_request(scene, TEST_EXT_GROUP_ID,
+			       RPMI_CLK_EXT_SRV_SET_CONFIGS, req, sizeof(req),
+			       resp, sizeof(resp), &datalen) ||
+	    datalen != 5 * sizeof(rpmi_uint32_t) ||
+	    resp[0] != RPMI_SUCCESS || resp[1] != 3 ||
+	    resp[2] != RPMI_SUCCESS ||
+	    resp[3] != (rpmi_uint32_t)RPMI_ERR_INVALID_PARAM ||
+	    resp[4] != RPMI_SUCCESS)
+		return RPMI_ERR_FAILED;
+
+	/* No entries or more entries than the request data */
+	req[0] = 0;
+	if (test_clock_request(scene, TEST_EXT_GROUP_ID,
+			       RPMI_CLK_EXT_SRV_SET_CONFIGS, req, 3 * sizeof(req[0]),
+			       resp, sizeof(resp), &datalen) ||
+	    resp[0] != (rpmi_uint32_t)RPMI_ERR_INVALID_PARAM)
+		return RPMI_ERR_FAILED;
+
+	req[0] = 2;
+	if (test_clock_request(scene, TEST_EXT_GROUP_ID,
+			       RPMI_CLK_EXT_SRV_SET_CONFIGS, req, 3 * sizeof(req[0]),
+			       resp, sizeof(resp), &datalen) ||
+	    resp[0] != (rpmi_uint32_t)RPMI_ERR_INVALID_PARAM)
+		return RPMI_ERR_FAILED;
+
+	return test_ext_expect_configs(scene, (1U << 1) | (1U << 2));
+}
+
+static int test_ext_set_rates_check(struct rpmi_test_scenario *scene,
+				    struct rpmi_test *test)
+{
+	/* Three entries fit in the request data of the smallest slot */
+	rpmi_uint32_t req[][13] = {
+		{
+			3,
+			6, RPMI_CLK_RATE_MATCH_ROUND_UP,
+			TEST_RATE_LO(150000000), TEST_RATE_HI(150000000),
+			TEST_EXT_CLOCK_COUNT, RPMI_CLK_RATE_MATCH_PLATFORM,
+			TEST_RATE_LO(100000000), TEST_RATE_HI(100000000),
+			5, RPMI_CLK_RATE_MATCH_MAX_IDX,
+			TEST_RATE_LO(100000000), TEST_RATE_HI(100000000),
+		},
+		{
+			3,
+			4, RPMI_CLK_RATE_MATCH_PLATFORM, 0, 0,
+			1, RPMI_CLK_RATE_MATCH_PLATFORM,
+			TEST_RATE_LO(200000000), TEST_RATE_HI(200000000),
+			7, RPMI_CLK_RATE_MATCH_ROUND_DOWN,
+			TEST_RATE_LO(50000000), TEST_RATE_HI(50000000),
+		},
+	};
+	rpmi_uint32_t status[][3] = {
+		{
+			RPMI_SUCCESS,
+			(rpmi_uint32_t)RPMI_ERR_INVALID_PARAM,
+			(rpmi_uint32_t)RPMI_ERR_INVALID_PARAM,
+		},
+		{
+			(rpmi_uint32_t)RPMI_ERR_INVALID_PARAM,
+			/* Clock 1 was disabled by SET_CONFIGS */
+			(rpmi_uint32_t)RPMI_ERR_DENIED,
+			(rpmi_uint32_t)RPMI_ERR_INVALID_PARAM,
+		},
+	};
+	rpmi_uint32_t resp[RPMI_SLOT_SIZE / sizeof(rpmi_uint32_t)];
+	rpmi_uint32_t i, j;
+	rpmi_uint16_t datalen;
+
+	for (i = 0; i < 2; i++) {
+		if (test_clock_request(scene, TEST_EXT_GROUP_ID,
+				       RPMI_CLK_EXT_SRV_SET_RATES, req[i],
+				       sizeof(req[i]), resp, sizeof(resp),
+				       &datalen) ||
+		    datalen != 5 * sizeof(rpmi_uint32_t) ||
+		    resp[0] != RPMI_SUCCESS || resp[1] != 3)
+			return RPMI_ERR_FAILED;
+
+		for (j = 0; j < 3; j++) {
+			if (resp[2 + j] != status[i][j])
+				return RPMI_ERR_FAILED;
+		}
+	}
+
+	/* Only the valid entry changed a rate */
+	return test_ext_expect_rates(scene, 6, 200000000);
+}
+
+static int test_scenario_clock_cleanup(struct rpmi_test_scenario *scene)
+{
+	struct test_clock_priv *priv = scene->priv;
+
+	if (scene->cntx) {
+		if (priv->ext_group)
+			rpmi_context_remove_group(scene->cntx, priv->ext_group);
+		if (priv->group)
+			rpmi_context_remove_group(scene->cntx, priv->group);
+		rpmi_context_destroy(scene->cntx);
+		scene->cntx = NULL;
+	}
+	if (priv->ext_group) {
+		rpmi_service_group_clock_ext_destroy(priv->ext_group);
+		priv->ext_group = NULL;
+	}
+	if (priv->group) {
+		rpmi_service_group_clock_destroy(priv->group);
+		priv->group = NULL;
+	}
+
+	return test_scenario_default_cleanup(scene);
+}
+
+static const rpmi_uint32_t supp_rates_reqdata_first[] = { 0, 0 };
+static const rpmi_uint32_t supp_rates_reqdata_next[] = { 0, TEST_MAX_SUPP_RATES };
+static const rpmi_uint32_t supp_rates_reqdata_last[] = { 0, 10 };
+static const rpmi_uint32_t supp_rates_reqdata_end[] = { 0, 12 };
+static const rpmi_uint32_t supp_rates_reqdata_past[] = { 0, 13 };
+static const rpmi_uint32_t supp_rates_reqdata_linear[] = { 1, 0 };
+
+/*
+ * Page of the supported rates of a clock starting at the requested index
+ * (linear clocks always return their max, min and step rates)
+ */
+static rpmi_uint16_t test_supp_rates_expdata(struct rpmi_test_scenario *scene,
+					     struct rpmi_test *test,
+					     void *data, rpmi_uint16_t max_data_len)
+{
+	struct test_clock_priv *priv = scene->priv;
+	const rpmi_uint32_t *req = test->attrs.request_data;
+	const struct rpmi_clock_data *clk = &priv->clock_data[req[0]];
+	rpmi_uint32_t i, start = req[1], returned;
+	rpmi_uint32_t *exp = data;
+
+	if (clk->clock_type == RPMI_CLK_TYPE_LINEAR) {
+		start = 0;
+		returned = 3;
+	} else if (start > clk->rate_count) {
+		exp[0] = (rpmi_uint32_t)RPMI_ERR_INVALID_PARAM;
+		return sizeof(*exp);
+	} else {
+		returned = clk->rate_count - start;
+		if (returned > TEST_MAX_SUPP_RATES)
+			returned = TEST_MAX_SUPP_RATES;
+	}
+
+	exp[0] = RPMI_SUCCESS;
+	exp[1] = 0;
+	exp[2] = (clk->clock_type == RPMI_CLK_TYPE_LINEAR) ?
+		 0 : clk->rate_count - (start + returned);
+	exp[3] = returned;
+	for (i = 0; i < returned; i++) {
+		exp[4 + 2 * i] = TEST_RATE_LO(clk->clock_rate_array[start + i]);
+		exp[5 + 2 * i] = TEST_RATE_HI(clk->clock_rate_array[start + i]);
+	}
+
+	return (4 + 2 * returned) * sizeof(*exp);
+}
+
+#define TEST_CLOCK_SUPP_RATES(__name, __reqdata)			\
+	{								\
+		.name = __name,						\
+		.attrs = {						\
+			.servicegroup_id = RPMI_SRVGRP_CLOCK,		\
+			.service_id = RPMI_CLK_SRV_GET_SUPPORTED_RATES,	\
+			.flags = RPMI_MSG_NORMAL_REQUEST,		\
+			.request_data = __reqdata,			\
+			.request_data_len = sizeof(__reqdata),		\
+		},							\
+		.init_request_data = test_init_request_data_from_attrs, \
+		.init_expected_data = test_supp_rates_expdata,		\
+	}
+
+static int test_scenario_clock_init(struct rpmi_test_scenario *scene)
+{
+	struct test_clock_priv *priv = scene->priv;
+	rpmi_uint32_t i;
+	int rc;
+
+	rc = test_scenario_default_init(scene);
+	if (rc)
+		return rc;
+
+	/* Root clocks run at their lowest rate and child clocks at half of it */
+	for (i = 0; i < priv->clock_count; i++) {
+		priv->state[i] = RPMI_CLK_STATE_ENABLED;
+		priv->rate[i] = (priv->clock_data[i].parent_id == -1U) ?
+				test_root_rates[0] : test_root_rates[0] / 2;
+	}
+
+	priv->group = rpmi_service_group_clock_create(priv->clock_count,
+						      priv->clock_data, priv->ops,
+						      priv);
+	if (!priv->group)
+		goto fail;
+
+	if (rpmi_context_add_group(scene->cntx, priv->group))
+		goto fail;
+
+	return 0;
+
+fail:
+	printf("%s: failed to setup clock scenario\n", __func__);
+	test_scenario_clock_cleanup(scene);
+	return RPMI_ERR_FAILED;
+}
+
+static int test_scenario_clock_ext_init(struct rpmi_test_scenario *scene)
+{
+	struct test_clock_priv *priv = scene->priv;
+	rpmi_uint32_t i;
+	int rc;
+
+	for (i = 0; i < TEST_EXT_CLOCK_COUNT; i++) {
+		test_ext_clock_data[i].parent_id = -1;
+		test_ext_clock_data[i].rate_count =
+			sizeof(test_root_rates) / sizeof(test_root_rates[0]);
+		test_ext_clock_data[i].clock_type = RPMI_CLK_TYPE_DISCRETE;
+		test_ext_clock_data[i].name = "test_ext";
+		test_ext_clock_data[i].clock_rate_array = test_root_rates;
+	}
+
+	rc = test_scenario_clock_init(scene);
+	if (rc)
+		return rc;
+
+	priv->ext_group = rpmi_service_group_clock_ext_create(priv->group,
+							      TEST_EXT_GROUP_ID);
+	if (!priv->ext_group ||
+	    rpmi_context_add_group(scene->cntx, priv->ext_group))
+		goto fail;
+
+	/* Platform changes the clock rates so that they differ */
+	for (i = 0; i < TEST_EXT_CLOCK_COUNT; i++) {
+		priv->rate[i] = TEST_EXT_RATE(i);
+		if (rpmi_service_group_clock_rate_changed(priv->group, i))
+			goto fail;
+	}
+
+	return 0;
+
+fail:
+	printf("%s: failed to setup clock extension scenario\n", __func__);
+	test_scenario_clock_cleanup(scene);
+	return RPMI_ERR_FAILED;
+}
+
+#define TEST_CLOCK_REQUEST(__name, __srv, __reqdata, __expdata)	\
+	{								\
+		.name = __name,						\
+		.attrs = {						\
+			.servicegroup_id = RPMI_SRVGRP_CLOCK,		\
+			.service_id = __srv,				\
+			.flags = RPMI_MSG_NORMAL_REQUEST,		\
+			.request_data = __reqdata,			\
+			.request_data_len = sizeof(__reqdata),		\
+			.expected_data = __expdata,			\
+			.expected_data_len = sizeof(__expdata),		\
+		},							\
+		.init_request_data = test_init_request_data_from_attrs, \
+		.init_expected_data = test_init_expected_data_from_attrs, \
+	}
+
+#define TEST_CLOCK_ASYNC_START(__name, __reqdata)			\
+	{								\
+		.name = __name,						\
+		.attrs = {						\
+			.servicegroup_id = RPMI_SRVGRP_CLOCK,		\
+			.service_id = RPMI_CLK_SRV_SET_RATE,		\
+			.flags = RPMI_MSG_NORMAL_REQUEST,		\
+			.request_data = __reqdata,			\
+			.request_data_len = sizeof(__reqdata),		\
+		},							\
+		.init_request_data = test_init_request_data_from_attrs, \
+		.run = test_run_request,				\
+		.check = test_async_started_check,			\
+	}
+
+static struct rpmi_test_scenario scenario_clock_async = {
+	.name = "Clock Asynchronous Set Rate",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = &clock_priv_async,
+
+	.init = test_scenario_clock_init,
+	.cleanup = test_scenario_clock_cleanup,
+
+	.num_tests = 9,
+	.tests = {
+		TEST_CLOCK_ASYNC_START("RPMI_CLK_SET_RATE_ASYNC_STARTED",
+				       set_rate_200m_reqdata),
+		TEST_CLOCK_REQUEST("RPMI_CLK_SET_RATE_ASYNC_BUSY",
+				   RPMI_CLK_SRV_SET_RATE,
+				   set_rate_400m_reqdata, status_busy_expdata),
+		{
+			.name = "RPMI_CLK_SET_RATE_ASYNC_COMPLETED",
+			.priv = (void *)(long)RPMI_SUCCESS,
+			.check = test_async_complete_check,
+		},
+		TEST_CLOCK_REQUEST("RPMI_CLK_SRV_GET_RATE (completed)",
+				   RPMI_CLK_SRV_GET_RATE,
+				   get_rate_root_reqdata, get_rate_200m_expdata),
+		TEST_CLOCK_ASYNC_START("RPMI_CLK_SET_RATE_ASYNC_STARTED (hw fault)",
+				       set_rate_400m_reqdata),
+		{
+			.name = "RPMI_CLK_SET_RATE_ASYNC_HW_FAULT",
+			.priv = (void *)(long)RPMI_ERR_HW_FAULT,
+			.check = test_async_complete_check,
+		},
+		TEST_CLOCK_REQUEST("RPMI_CLK_SRV_GET_RATE (hw fault)",
+				   RPMI_CLK_SRV_GET_RATE,
+				   get_rate_root_reqdata, get_rate_200m_expdata),
+		{
+			.name = "RPMI_CLK_SET_RATE_ASYNC_REJECTED",
+			.attrs = {
+				.servicegroup_id = RPMI_SRVGRP_CLOCK,
+				.service_id = RPMI_CLK_SRV_SET_RATE,
+				.flags = RPMI_MSG_NORMAL_REQUEST,
+				.request_data = set_rate_400m_reqdata,
+				.request_data_len = sizeof(set_rate_400m_reqdata),
+				.expected_data = status_failed_expdata,
+				.expected_data_len = sizeof(status_failed_expdata),
+			},
+			.init = test_async_rejected_init,
+			.init_request_data = test_init_request_data_from_attrs,
+			.init_expected_data = test_init_expected_data_from_attrs,
+			.cleanup = test_async_rejected_cleanup,
+		},
+		TEST_CLOCK_REQUEST("RPMI_CLK_SRV_GET_RATE (rejected)",
+				   RPMI_CLK_SRV_GET_RATE,
+				   get_rate_root_reqdata, get_rate_200m_expdata),
+	},
+};
+
+static struct rpmi_test_scenario scenario_clock_cached = {
+	.name = "Clock Cached Rates",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = &clock_priv_cached,
+
+	.init = test_scenario_clock_init,
+	.cleanup = test_scenario_clock_cleanup,
+
+	.num_tests = 3,
+	.tests = {
+		{
+			.name = "RPMI_CLK_CACHED_GET_RATE",
+			.check = test_cached_get_rate_check,
+		},
+		{
+			.name = "RPMI_CLK_CACHED_PARENT_SET_RATE",
+			.check = test_cached_set_rate_check,
+		},
+		{
+			.name = "RPMI_CLK_CACHED_RATE_CHANGED",
+			.check = test_cached_rate_changed_check,
+		},
+	},
+};
+
+static struct rpmi_test_scenario scenario_clock_match = {
+	.name = "Clock Rate Match",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = &clock_priv_match,
+
+	.init = test_scenario_clock_init,
+	.cleanup = test_scenario_clock_cleanup,
+
+	.num_tests = 1,
+	.tests = {
+		{
+			.name = "RPMI_CLK_SET_RATE_MATCH (unsorted rates)",
+			.check = test_match_rate_check,
+		},
+	},
+};
+
+static struct rpmi_test_scenario scenario_clock_ext = {
+	.name = "Clock Extension Service Group",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = &clock_priv_ext,
+
+	.init = test_scenario_clock_ext_init,
+	.cleanup = test_scenario_clock_cleanup,
+
+	.num_tests = 5,
+	.tests = {
+		{
+			.name = "RPMI_CLK_EXT_SRV_GET_CONFIGS (paging)",
+			.check = test_ext_get_configs_check,
+		},
+		{
+			.name = "RPMI_CLK_EXT_SRV_GET_RATES (paging)",
+			.check = test_ext_get_rates_check,
+		},
+		{
+			.name = "RPMI_CLK_EXT_SRV_GET_xyz (hw fault)",
+			.check = test_ext_get_fault_check,
+		},
+		{
+			.name = "RPMI_CLK_EXT_SRV_SET_CONFIGS (invalid entries)",
+			.check = test_ext_set_configs_check,
+		},
+		{
+			.name = "RPMI_CLK_EXT_SRV_SET_RATES (invalid entries)",
+			.check = test_ext_set_rates_check,
+		},
+	},
+};
+
+static struct rpmi_test_scenario scenario_clock_rates = {
+	.name = "Clock Supported Rates",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = &clock_priv_rates,
+
+	.init = test_scenario_clock_init,
+	.cleanup = test_scenario_clock_cleanup,
+
+	.num_tests = 6,
+	.tests = {
+		TEST_CLOCK_SUPP_RATES("RPMI_CLK_SRV_GET_SUPPORTED_RATES (first page)",
+				      supp_rates_reqdata_first),
+		TEST_CLOCK_SUPP_RATES("RPMI_CLK_SRV_GET_SUPPORTED_RATES (next page)",
+				      supp_rates_reqdata_next),
+		TEST_CLOCK_SUPP_RATES("RPMI_CLK_SRV_GET_SUPPORTED_RATES (last page)",
+				      supp_rates_reqdata_last),
+		TEST_CLOCK_SUPP_RATES("RPMI_CLK_SRV_GET_SUPPORTED_RATES (end of list)",
+				      supp_rates_reqdata_end),
+		TEST_CLOCK_SUPP_RATES("RPMI_CLK_SRV_GET_SUPPORTED_RATES (past the end)",
+				      supp_rates_reqdata_past),
+		TEST_CLOCK_SUPP_RATES("RPMI_CLK_SRV_GET_SUPPORTED_RATES (linear)",
+				      supp_rates_reqdata_linear),
+	},
+};
+
+int main(int argc, char *argv[])
+{
+	int rc;
+
+	printf("Test Clock Service Group\n");
+
+	/* Execute asynchronous set rate scenario */
+	rc = test_scenario_execute(&scenario_clock_async);
+	if (rc)
+		return rc;
+
+	/* Execute cached rates scenario */
+	rc = test_scenario_execute(&scenario_clock_cached);
+	if (rc)
+		return rc;
+
+	/* Execute rate match scenario */
+	rc = test_scenario_execute(&scenario_clock_match);
+	if (rc)
+		return rc;
+
+	/* Execute clock extension scenario */
+	rc = test_scenario_execute(&scenario_clock_ext);
+	if (rc)
+		return rc;
+
+	/* Execute supported rates scenario */
+	return test_scenario_execute(&scenario_clock_rates);
+}
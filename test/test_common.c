@@ -6,6 +6,15 @@
 
 #include "test_common.h"
 
+#ifdef LIBRPMI_ARENA_ONLY
+/* Library state of a scenario is carved out of a static arena */
+#define TEST_ARENA_SZ		(1024 * 1024)
+
+static rpmi_uint8_t test_arena_mem[TEST_ARENA_SZ]
+			__attribute__((aligned(LIBRPMI_ARENA_ALIGN)));
+static struct rpmi_arena test_arena;
+#endif
+
 /* dump buffer in hexadecimal format */
 void hexdump(char *desc, unsigned int *buf, unsigned int len)
 {
@@ -44,8 +53,8 @@ static void scenario_process(struct rpmi_test_scenario *scene)
 	}
 }
 
-static int test_run(struct rpmi_test_scenario *scene, struct rpmi_test *test,
-		    struct rpmi_message *req_msg)
+int test_run_request(struct rpmi_test_scenario *scene, struct rpmi_test *test,
+		     struct rpmi_message *req_msg)
 {
 	int rc = 0;
 
@@ -76,6 +85,11 @@ static void test_wait(struct rpmi_test_scenario *scene, struct rpmi_test *test,
 	}
 }
 
+static void test_report(struct rpmi_test *test, int failed)
+{
+	printf("%-50s \t : %s!\n", test->name, failed ? "Failed" : "Succeeded");
+}
+
 static void test_verify(struct rpmi_test *test, struct rpmi_message *msg,
 			void *exp_data, rpmi_uint16_t exp_data_len)
 {
@@ -102,7 +116,7 @@ static void test_verify(struct rpmi_test *test, struct rpmi_message *msg,
 		}
 	}
 
-	printf("%-50s \t : %s!\n", test->name, failed ? "Failed" : "Succeeded");
+	test_report(test, failed);
 }
 
 static void execute_scenario(struct rpmi_test_scenario *scene)
@@ -170,8 +184,8 @@ static void execute_scenario(struct rpmi_test_scenario *scene)
 		/* Run the test */
 		if (test->run)
 			rc = test->run(scene, test, req_msg);
-		else
-			rc = test_run(scene, test, req_msg);
+		else if (!test->check)
+			rc = test_run_request(scene, test, req_msg);
 		if (rc) {
 			printf("Failed to run test %s (error %d)\n", test->name, rc);
 			goto skip;
@@ -182,6 +196,13 @@ static void execute_scenario(struct rpmi_test_scenario *scene)
 		else
 			scenario_process(scene);
 
+		/* Check state instead of an acknowledgement */
+		if (test->check) {
+			rc = test->check(scene, test);
+			test_report(test, rc);
+			goto skip;
+		}
+
 		/* Wait for test to finish */
 		if (test->wait)
 			test->wait(scene, test, resp_msg);
@@ -223,13 +244,23 @@ int test_scenario_default_init(struct rpmi_test_scenario *scene)
 	if (!scene || scene->shm || scene->shmem || scene->xport || scene->cntx)
 		return RPMI_ERR_ALREADY;
 
+#ifdef LIBRPMI_ARENA_ONLY
+	/* Objects of the previous scenario were destroyed by its cleanup */
+	if (rpmi_arena_init(&test_arena, test_arena_mem, sizeof(test_arena_mem))) {
+		printf("%s: failed to initialize test arena\n ", __func__);
+		return RPMI_ERR_FAILED;
+	}
+	rpmi_arena_select(&test_arena);
+#endif
+
 	scene->shm = rpmi_env_zalloc(scene->shm_size);
 	if (!scene->shm)
 		return RPMI_ERR_FAILED;
 
 	scene->shmem = rpmi_shmem_create("test_shmem",
 					 (unsigned long)scene->shm, scene->shm_size,
-					 &rpmi_shmem_simple_ops, NULL);
+					 scene->shmem_ops ? scene->shmem_ops :
+					 &rpmi_shmem_simple_ops, scene->shmem_ops_priv);
 	if (!scene->shmem) {
 		printf("%s: failed to create test rpmi_shmem\n ", __func__);
 		rpmi_env_free(scene->shm);
@@ -237,10 +268,10 @@ int test_scenario_default_init(struct rpmi_test_scenario *scene)
 		return RPMI_ERR_FAILED;
 	}
 
-	scene->xport = rpmi_transport_shmem_create("test_transport", scene->slot_size,
-						   ((scene->shm_size * 3) / 4) / 2,
-						   ((scene->shm_size * 1) / 4) / 2,
-						   scene->shmem);
+	scene->xport = rpmi_transport_shmem_create_ext("test_transport", scene->slot_size,
+						       ((scene->shm_size * 3) / 4) / 2,
+						       ((scene->shm_size * 1) / 4) / 2,
+						       scene->shmem, scene->xport_flags);
 	if (!scene->xport) {
 		printf("%s: failed to create test rpmi_transport\n ", __func__);
 		rpmi_shmem_destroy(scene->shmem);
@@ -291,6 +322,10 @@ int test_scenario_default_cleanup(struct rpmi_test_scenario *scene)
 		scene->shm = NULL;
 	}
 
+#ifdef LIBRPMI_ARENA_ONLY
+	rpmi_arena_select(NULL);
+#endif
+
 	return 0;
 }
 
@@ -51,6 +51,13 @@ struct rpmi_test {
 		   struct rpmi_message *msg);
 	void (*wait)(struct rpmi_test_scenario *scene, struct rpmi_test *test,
 		    struct rpmi_message *msg);
+	/*
+	 * Check the outcome of the test by inspecting the library or platform
+	 * state instead of receiving and verifying an acknowledgement. The
+	 * check returns 0 on success. A test with check callback only sends
+	 * a request if its run callback does so.
+	 */
+	int (*check)(struct rpmi_test_scenario *scene, struct rpmi_test *test);
 	void (*cleanup)(struct rpmi_test_scenario *scene, struct rpmi_test *test);
 };
 
@@ -69,6 +76,11 @@ struct rpmi_test_scenario {
 	rpmi_uint32_t shm_size;
 	rpmi_uint32_t slot_size;
 	rpmi_uint32_t max_num_groups;
+	/* Shared memory operations (NULL means rpmi_shmem_simple_ops) */
+	const struct rpmi_shmem_platform_ops *shmem_ops;
+	void *shmem_ops_priv;
+	/* Shared memory transport flags (LIBRPMI_TRANSPORT_SHMEM_FLAG_xyz) */
+	rpmi_uint32_t xport_flags;
 	struct {
 		rpmi_uint32_t plat_info_len;
 		const char *plat_info;
@@ -91,6 +103,9 @@ rpmi_uint16_t test_init_expected_data_from_attrs(struct rpmi_test_scenario *scen
 						 struct rpmi_test *test,
 						 void *data, rpmi_uint16_t max_data_len);
 
+int test_run_request(struct rpmi_test_scenario *scene, struct rpmi_test *test,
+		     struct rpmi_message *req_msg);
+
 int test_scenario_default_init(struct rpmi_test_scenario *scene);
 int test_scenario_default_cleanup(struct rpmi_test_scenario *scene);
 
@@ -0,0 +1,1557 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 Ventana Micro Systems Inc.
+ */
+
+#include <librpmi.h>
+#include <pthread.h>
+#include <stdio.h>
+#include "test_common.h"
+#include "test_log.h"
+
+/*
+ * IDs of the experimental range which all hash to the same slot of the
+ * dispatch table of a context with at most four service groups
+ */
+#define TEST_GROUP_ID_A		0x7C00
+#define TEST_GROUP_ID_B		0x7C08
+#define TEST_GROUP_ID_C		0x7C10
+#define TEST_GROUP_ID_D		0x7C18
+
+/* Service group only accessible at S-mode */
+#define TEST_GROUP_ID_S		0x7C20
+
+/* Service groups with events processed on signal and on every call */
+#define TEST_GROUP_ID_SIGNAL	0x7C28
+#define TEST_GROUP_ID_POLL	0x7C30
+
+/*
+ * Messages held by the P2A acknowledgement queue created by
+ * test_scenario_default_init() which has the size of the A2P request
+ * queue where one slot is always kept free
+ */
+#define TEST_P2A_MAX_MSGS	((((RPMI_SHM_SZ * 3) / 4) / 2) / RPMI_SLOT_SIZE - 3)
+
+/* Requests sent while the P2A queue is full */
+#define TEST_BOUNDED_EXTRA	6
+
+/* Times the service group is added and removed by the toggle thread */
+#define TEST_TOGGLE_COUNT	256
+
+/* Service IDs of the test service group */
+enum test_service_id {
+	TEST_SRV_ECHO = 0x01,
+	TEST_SRV_DEFER = 0x02,
+	TEST_SRV_ID_MAX,
+};
+
+struct test_group {
+	/* Must be first so that the service callbacks can cast the group */
+	struct rpmi_service_group group;
+	rpmi_uint32_t num_requests;
+	rpmi_uint32_t num_events;
+	enum rpmi_error events_rc;
+};
+
+/* Set by the toggle thread once it is done */
+static volatile rpmi_bool_t test_toggle_done;
+
+static rpmi_uint32_t test_msg[RPMI_SLOT_SIZE / sizeof(rpmi_uint32_t)];
+
+/* Handles of the requests deferred by the defer service */
+static rpmi_uint32_t test_handles[LIBRPMI_CONTEXT_MAX_DEFERRED];
+static rpmi_uint32_t test_num_handles;
+
+/* Result of deferring an already deferred request */
+static enum rpmi_error test_redefer_rc;
+
+/* Context returned for the request handle by the defer service */
+static struct rpmi_context *test_defer_cntx;
+
+/* Secondary S-mode transport added to the context */
+static rpmi_uint64_t test_shm_s[RPMI_SHM_SZ / sizeof(rpmi_uint64_t)];
+static struct rpmi_shmem *test_shmem_s;
+static struct rpmi_transport *test_xport_s;
+
+static enum rpmi_error test_echo(struct rpmi_service_group *group,
+				 struct rpmi_service *service,
+				 struct rpmi_transport *trans,
+				 rpmi_uint16_t request_datalen,
+				 const rpmi_uint8_t *request_data,
+				 rpmi_uint16_t *response_datalen,
+				 rpmi_uint8_t *response_data)
+{
+	struct test_group *tgrp = (struct test_group *)group;
+	rpmi_uint32_t *resp = (void *)response_data;
+
+	tgrp->num_requests++;
+
+	*response_datalen = 2 * sizeof(*resp);
+	resp[0] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)RPMI_SUCCESS);
+	resp[1] = rpmi_to_xe32(trans->is_be, group->servicegroup_id);
+
+	return RPMI_SUCCESS;
+}
+
+/* Defer the request and respond with the status if it can't be deferred */
+static enum rpmi_error test_defer(struct rpmi_service_group *group,
+				  struct rpmi_service *service,
+				  struct rpmi_transport *trans,
+				  struct rpmi_context_request *req,
+				  rpmi_uint16_t request_datalen,
+				  const rpmi_uint8_t *request_data,
+				  rpmi_uint16_t *response_datalen,
+				  rpmi_uint8_t *response_data)
+{
+	rpmi_uint32_t *resp = (void *)response_data;
+	rpmi_uint32_t handle;
+	enum rpmi_error rc;
+
+	test_defer_cntx = rpmi_context_request_context(req);
+
+	rc = rpmi_context_defer_request(req, &handle);
+	if (!rc) {
+		test_handles[test_num_handles++] = handle;
+		test_redefer_rc = rpmi_context_defer_request(req, &handle);
+	}
+
+	*response_datalen = sizeof(*resp);
+	resp[0] = rpmi_to_xe32(trans->is_be, (rpmi_uint32_t)rc);
+
+	return RPMI_SUCCESS;
+}
+
+/* Count the calls and report the configured result */
+static enum rpmi_error test_process_events(struct rpmi_service_group *group)
+{
+	struct test_group *tgrp = (struct test_group *)group;
+
+	tgrp->num_events++;
+
+	return tgrp->events_rc;
+}
+
+static struct rpmi_service test_services[TEST_SRV_ID_MAX] = {
+	[TEST_SRV_ECHO] = {
+		.service_id = TEST_SRV_ECHO,
+		.min_a2p_request_datalen = 0,
+		.process_a2p_request = test_echo,
+	},
+	[TEST_SRV_DEFER] = {
+		.service_id = TEST_SRV_DEFER,
+		.min_a2p_request_datalen = 0,
+		.process_a2p_request_deferrable = test_defer,
+	},
+};
+
+#define TEST_GROUP(__id, __privilege_mask)				\
+	{								\
+		.group = {						\
+			.name = "test",					\
+			.servicegroup_id = __id,			\
+			.max_service_id = TEST_SRV_ID_MAX,		\
+			.servicegroup_version = RPMI_BASE_VERSION(1, 0), \
+			.privilege_level_bitmap = __privilege_mask,	\
+			.services = test_services,			\
+		},							\
+	}
+
+static struct test_group test_group_a =
+	TEST_GROUP(TEST_GROUP_ID_A, RPMI_PRIVILEGE_M_MODE_MASK);
+static struct test_group test_group_b =
+	TEST_GROUP(TEST_GROUP_ID_B, RPMI_PRIVILEGE_M_MODE_MASK);
+static struct test_group test_group_c =
+	TEST_GROUP(TEST_GROUP_ID_C, RPMI_PRIVILEGE_M_MODE_MASK);
+static struct test_group test_group_d =
+	TEST_GROUP(TEST_GROUP_ID_D, RPMI_PRIVILEGE_M_MODE_MASK);
+static struct test_group test_group_s =
+	TEST_GROUP(TEST_GROUP_ID_S, RPMI_PRIVILEGE_S_MODE_MASK);
+
+#define TEST_EVENTS_GROUP(__id, __flags)				\
+	{								\
+		.group = {						\
+			.name = "test_events",				\
+			.servicegroup_id = __id,			\
+			.max_service_id = TEST_SRV_ID_MAX,		\
+			.servicegroup_version = RPMI_BASE_VERSION(1, 0), \
+			.privilege_level_bitmap = RPMI_PRIVILEGE_M_MODE_MASK, \
+			.flags = __flags,				\
+			.services = test_services,			\
+			.process_events = test_process_events,		\
+		},							\
+	}
+
+static struct test_group test_group_signal =
+	TEST_EVENTS_GROUP(TEST_GROUP_ID_SIGNAL,
+			  LIBRPMI_SERVICE_GROUP_FLAG_EVENTS_ON_SIGNAL);
+static struct test_group test_group_poll =
+	TEST_EVENTS_GROUP(TEST_GROUP_ID_POLL, 0);
+
+static rpmi_uint32_t echo_expdata_a[] = { RPMI_SUCCESS, TEST_GROUP_ID_A };
+static rpmi_uint32_t echo_expdata_b[] = { RPMI_SUCCESS, TEST_GROUP_ID_B };
+static rpmi_uint32_t echo_expdata_c[] = { RPMI_SUCCESS, TEST_GROUP_ID_C };
+
+/* Send a request with up to one word of data over a transport */
+static int test_send_request(struct rpmi_test_scenario *scene,
+			     struct rpmi_transport *trans,
+			     rpmi_uint16_t servicegroup_id,
+			     rpmi_uint8_t service_id, rpmi_uint8_t flags,
+			     rpmi_uint16_t datalen, rpmi_uint32_t data)
+{
+	struct rpmi_message *msg = (void *)test_msg;
+
+	msg->header.servicegroup_id = servicegroup_id;
+	msg->header.service_id = service_id;
+	msg->header.flags = flags;
+	msg->header.datalen = datalen;
+	msg->header.token = scene->token_sequence++;
+	*(rpmi_uint32_t *)msg->data = data;
+
+	return rpmi_transport_enqueue(trans, RPMI_QUEUE_A2P_REQ, msg);
+}
+
+/* Send an echo request to a service group */
+static int test_send_echo(struct rpmi_test_scenario *scene,
+			  rpmi_uint16_t servicegroup_id)
+{
+	return test_send_request(scene, scene->xport, servicegroup_id,
+				 TEST_SRV_ECHO, RPMI_MSG_NORMAL_REQUEST, 0, 0);
+}
+
+/* Send a request to the defer service of a service group */
+static int test_send_defer(struct rpmi_test_scenario *scene,
+			   rpmi_uint16_t servicegroup_id)
+{
+	return test_send_request(scene, scene->xport, servicegroup_id,
+				 TEST_SRV_DEFER, RPMI_MSG_NORMAL_REQUEST, 0, 0);
+}
+
+/* Dequeue an acknowledgement and check its token and status */
+static int test_recv_status(struct rpmi_test_scenario *scene,
+			    rpmi_uint16_t token, enum rpmi_error status)
+{
+	struct rpmi_message *msg = (void *)test_msg;
+	const rpmi_uint32_t *data = (const void *)msg->data;
+
+	if (rpmi_transport_dequeue(scene->xport, RPMI_QUEUE_P2A_ACK, msg) ||
+	    msg->header.token != token ||
+	    msg->header.datalen < sizeof(rpmi_uint32_t) ||
+	    data[0] != (rpmi_uint32_t)status) {
+		printf("%s: no acknowledgement for token %u with status %d\n",
+		       __func__, token, status);
+		return RPMI_ERR_FAILED;
+	}
+
+	return RPMI_SUCCESS;
+}
+
+/* Check that no acknowledgement is pending */
+static int test_recv_none(struct rpmi_test_scenario *scene)
+{
+	struct rpmi_message *msg = (void *)test_msg;
+
+	if (rpmi_transport_dequeue(scene->xport, RPMI_QUEUE_P2A_ACK, msg) !=
+								RPMI_ERR_IO) {
+		printf("%s: unexpected acknowledgement for token %u\n",
+		       __func__, msg->header.token);
+		return RPMI_ERR_FAILED;
+	}
+
+	return RPMI_SUCCESS;
+}
+
+/* Check that an acknowledgement is the echo of a service group */
+static int test_check_echo(const struct rpmi_message *msg,
+			   rpmi_uint16_t servicegroup_id)
+{
+	const rpmi_uint32_t *data = (const void *)msg->data;
+
+	if (msg->header.servicegroup_id != servicegroup_id ||
+	    msg->header.service_id != TEST_SRV_ECHO ||
+	    msg->header.datalen != 2 * sizeof(rpmi_uint32_t) ||
+	    data[0] != RPMI_SUCCESS || data[1] != servicegroup_id) {
+		printf("%s: unexpected acknowledgement of group 0x%x\n",
+		       __func__, msg->header.servicegroup_id);
+		return RPMI_ERR_FAILED;
+	}
+
+	return RPMI_SUCCESS;
+}
+
+static int test_collision_add_check(struct rpmi_test_scenario *scene,
+				    struct rpmi_test *test)
+{
+	struct rpmi_context *cntx = scene->cntx;
+
+	if (rpmi_context_add_group(cntx, &test_group_a.group) ||
+	    rpmi_context_add_group(cntx, &test_group_b.group) ||
+	    rpmi_context_add_group(cntx, &test_group_c.group))
+		return RPMI_ERR_FAILED;
+
+	/* Groups probe past each other from the same slot */
+	if (rpmi_context_find_group(cntx, TEST_GROUP_ID_A) != &test_group_a.group ||
+	    rpmi_context_find_group(cntx, TEST_GROUP_ID_B) != &test_group_b.group ||
+	    rpmi_context_find_group(cntx, TEST_GROUP_ID_C) != &test_group_c.group ||
+	    rpmi_context_find_group(cntx, TEST_GROUP_ID_D))
+		return RPMI_ERR_FAILED;
+
+	/* Duplicate ID and a full context are rejected */
+	if (rpmi_context_add_group(cntx, &test_group_a.group) != RPMI_ERR_ALREADY ||
+	    rpmi_context_add_group(cntx, &test_group_d.group) != RPMI_ERR_IO)
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static int test_collision_remove_check(struct rpmi_test_scenario *scene,
+				       struct rpmi_test *test)
+{
+	struct rpmi_context *cntx = scene->cntx;
+
+	/* Removing the middle of the probe chain keeps the others reachable */
+	rpmi_context_remove_group(cntx, &test_group_b.group);
+
+	if (rpmi_context_find_group(cntx, TEST_GROUP_ID_A) != &test_group_a.group ||
+	    rpmi_context_find_group(cntx, TEST_GROUP_ID_B) ||
+	    rpmi_context_find_group(cntx, TEST_GROUP_ID_C) != &test_group_c.group ||
+	    test_group_b.group.num_contexts)
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static int test_collision_removed_run(struct rpmi_test_scenario *scene,
+				      struct rpmi_test *test,
+				      struct rpmi_message *msg)
+{
+	test_group_b.num_requests = 0;
+	return test_send_echo(scene, TEST_GROUP_ID_B);
+}
+
+static int test_collision_removed_check(struct rpmi_test_scenario *scene,
+					struct rpmi_test *test)
+{
+	struct rpmi_message *msg = (void *)test_msg;
+
+	/* Request of a removed group is dropped without acknowledgement */
+	if (rpmi_transport_dequeue(scene->xport, RPMI_QUEUE_P2A_ACK, msg) !=
+								RPMI_ERR_IO)
+		return RPMI_ERR_FAILED;
+
+	return test_group_b.num_requests ? RPMI_ERR_FAILED : RPMI_SUCCESS;
+}
+
+static int test_collision_readd_check(struct rpmi_test_scenario *scene,
+				      struct rpmi_test *test)
+{
+	if (rpmi_context_add_group(scene->cntx, &test_group_b.group))
+		return RPMI_ERR_FAILED;
+
+	return (rpmi_context_find_group(scene->cntx, TEST_GROUP_ID_B) ==
+		&test_group_b.group) ? RPMI_SUCCESS : RPMI_ERR_FAILED;
+}
+
+static int test_scenario_collision_cleanup(struct rpmi_test_scenario *scene)
+{
+	rpmi_context_remove_group(scene->cntx, &test_group_a.group);
+	rpmi_context_remove_group(scene->cntx, &test_group_b.group);
+	rpmi_context_remove_group(scene->cntx, &test_group_c.group);
+	return test_scenario_default_cleanup(scene);
+}
+
+/* Dequeue the echo acknowledgements of a group and check the token order */
+static rpmi_uint32_t test_drain_echo(struct rpmi_test_scenario *scene,
+				     rpmi_uint16_t servicegroup_id,
+				     rpmi_uint16_t *token)
+{
+	struct rpmi_message *msg = (void *)test_msg;
+	rpmi_uint32_t count = 0;
+
+	while (!rpmi_transport_dequeue(scene->xport, RPMI_QUEUE_P2A_ACK, msg)) {
+		if (test_check_echo(msg, servicegroup_id) ||
+		    msg->header.token != *token) {
+			printf("%s: acknowledgement %u out of order\n",
+			       __func__, count);
+			return 0;
+		}
+		(*token)++;
+		count++;
+	}
+
+	return count;
+}
+
+static int test_bounded_count_check(struct rpmi_test_scenario *scene,
+				    struct rpmi_test *test)
+{
+	rpmi_uint16_t token = scene->token_sequence;
+	rpmi_uint32_t i;
+
+	for (i = 0; i < 10; i++) {
+		if (test_send_echo(scene, TEST_GROUP_ID_A))
+			return RPMI_ERR_FAILED;
+	}
+
+	/* Processing stops after max_count requests */
+	if (rpmi_context_process_a2p_request_bounded(scene->cntx, 3, 0) != 3 ||
+	    test_drain_echo(scene, TEST_GROUP_ID_A, &token) != 3)
+		return RPMI_ERR_FAILED;
+
+	/* No limit processes the remaining requests */
+	if (rpmi_context_process_a2p_request_bounded(scene->cntx, 0, 0) != 7 ||
+	    test_drain_echo(scene, TEST_GROUP_ID_A, &token) != 7)
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static int test_bounded_parked_check(struct rpmi_test_scenario *scene,
+				     struct rpmi_test *test)
+{
+	rpmi_uint16_t token = scene->token_sequence;
+	rpmi_uint32_t i, processed;
+
+	/* Fill the P2A queue with acknowledgements */
+	for (i = 0; i < TEST_P2A_MAX_MSGS; i++) {
+		if (test_send_echo(scene, TEST_GROUP_ID_A))
+			return RPMI_ERR_FAILED;
+	}
+	if (rpmi_context_process_a2p_request_bounded(scene->cntx, 0, 0) !=
+							TEST_P2A_MAX_MSGS)
+		return RPMI_ERR_FAILED;
+
+	for (i = 0; i < TEST_BOUNDED_EXTRA; i++) {
+		if (test_send_echo(scene, TEST_GROUP_ID_A))
+			return RPMI_ERR_FAILED;
+	}
+
+	/*
+	 * Acknowledgements of the first requests are parked and the call
+	 * returns with requests left in the A2P queue instead of waiting
+	 * for the application processor to drain the P2A queue.
+	 */
+	processed = rpmi_context_process_a2p_request_bounded(scene->cntx, 0, 0);
+	if (!processed || processed >= TEST_BOUNDED_EXTRA) {
+		printf("%s: processed %u requests\n", __func__, processed);
+		return RPMI_ERR_FAILED;
+	}
+
+	/* Nothing new is processed while parked acknowledgements can't be posted */
+	if (rpmi_context_process_a2p_request_bounded(scene->cntx, 0, 0))
+		return RPMI_ERR_FAILED;
+
+	if (test_drain_echo(scene, TEST_GROUP_ID_A, &token) != TEST_P2A_MAX_MSGS)
+		return RPMI_ERR_FAILED;
+
+	/* Parked acknowledgements are posted before the remaining requests */
+	if (rpmi_context_process_a2p_request_bounded(scene->cntx, 0, 0) !=
+					TEST_BOUNDED_EXTRA - processed)
+		return RPMI_ERR_FAILED;
+
+	if (test_drain_echo(scene, TEST_GROUP_ID_A, &token) != TEST_BOUNDED_EXTRA)
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static int test_defer_complete_check(struct rpmi_test_scenario *scene,
+				     struct rpmi_test *test)
+{
+	struct rpmi_context *cntx = scene->cntx;
+	rpmi_uint16_t token = scene->token_sequence;
+	struct rpmi_message *msg = (void *)test_msg;
+	const rpmi_uint32_t *data = (const void *)msg->data;
+	rpmi_uint32_t resp[2] = { RPMI_SUCCESS, 0x1234 };
+	rpmi_uint32_t i, acked = 0;
+
+	test_num_handles = 0;
+	for (i = 0; i < 3; i++) {
+		if (test_send_defer(scene, TEST_GROUP_ID_A))
+			return RPMI_ERR_FAILED;
+	}
+	if (test_send_echo(scene, TEST_GROUP_ID_A))
+		return RPMI_ERR_FAILED;
+
+	/* Later request is acknowledged while the deferred ones are pending */
+	rpmi_context_process_a2p_request(cntx);
+	if (test_num_handles != 3 || test_defer_cntx != cntx ||
+	    test_redefer_rc != RPMI_ERR_INVALID_STATE)
+		return RPMI_ERR_FAILED;
+	if (rpmi_transport_dequeue(scene->xport, RPMI_QUEUE_P2A_ACK, msg) ||
+	    msg->header.token != (rpmi_uint16_t)(token + 3) ||
+	    test_check_echo(msg, TEST_GROUP_ID_A) || test_recv_none(scene))
+		return RPMI_ERR_FAILED;
+
+	/* Complete the last and the first request but not the middle one */
+	if (rpmi_context_complete_request(cntx, test_handles[2], sizeof(resp),
+					  (const rpmi_uint8_t *)resp) ||
+	    rpmi_context_complete_request_status(cntx, test_handles[0],
+						 RPMI_ERR_HW_FAULT))
+		return RPMI_ERR_FAILED;
+
+	/* Completed and unknown handles are rejected */
+	if (rpmi_context_complete_request_status(cntx, test_handles[2],
+				RPMI_SUCCESS) != RPMI_ERR_INVALID_STATE ||
+	    rpmi_context_complete_request_status(cntx, LIBRPMI_CONTEXT_MAX_DEFERRED,
+				RPMI_SUCCESS) != RPMI_ERR_INVALID_PARAM)
+		return RPMI_ERR_FAILED;
+
+	/* Acknowledgements carry the saved tokens and the completion data */
+	rpmi_context_process_a2p_request(cntx);
+	while (!rpmi_transport_dequeue(scene->xport, RPMI_QUEUE_P2A_ACK, msg)) {
+		if (msg->header.servicegroup_id != TEST_GROUP_ID_A ||
+		    msg->header.service_id != TEST_SRV_DEFER)
+			return RPMI_ERR_FAILED;
+		if (msg->header.token == (rpmi_uint16_t)(token + 2) &&
+		    msg->header.datalen == sizeof(resp) &&
+		    data[0] == resp[0] && data[1] == resp[1])
+			acked |= 1U << 2;
+		else if (msg->header.token == token &&
+			 msg->header.datalen == sizeof(rpmi_uint32_t) &&
+			 data[0] == (rpmi_uint32_t)RPMI_ERR_HW_FAULT)
+			acked |= 1U << 0;
+		else
+			return RPMI_ERR_FAILED;
+	}
+	if (acked != ((1U << 2) | (1U << 0)))
+		return RPMI_ERR_FAILED;
+
+	if (rpmi_context_complete_request_status(cntx, test_handles[1],
+						 RPMI_SUCCESS))
+		return RPMI_ERR_FAILED;
+
+	rpmi_context_process_a2p_request(cntx);
+	if (test_recv_status(scene, token + 1, RPMI_SUCCESS))
+		return RPMI_ERR_FAILED;
+
+	return test_recv_none(scene);
+}
+
+static int test_defer_busy_check(struct rpmi_test_scenario *scene,
+				 struct rpmi_test *test)
+{
+	struct rpmi_context *cntx = scene->cntx;
+	rpmi_uint16_t token = scene->token_sequence;
+	rpmi_uint32_t i;
+
+	test_num_handles = 0;
+	for (i = 0; i <= LIBRPMI_CONTEXT_MAX_DEFERRED; i++) {
+		if (test_send_defer(scene, TEST_GROUP_ID_A))
+			return RPMI_ERR_FAILED;
+	}
+
+	/* Request beyond the deferred limit is acknowledged right away */
+	rpmi_context_process_a2p_request(cntx);
+	if (test_num_handles != LIBRPMI_CONTEXT_MAX_DEFERRED ||
+	    test_recv_status(scene, token + LIBRPMI_CONTEXT_MAX_DEFERRED,
+			     RPMI_ERR_BUSY) ||
+	    test_recv_none(scene))
+		return RPMI_ERR_FAILED;
+
+	for (i = 0; i < LIBRPMI_CONTEXT_MAX_DEFERRED; i++) {
+		if (rpmi_context_complete_request_status(cntx, test_handles[i],
+							 RPMI_SUCCESS))
+			return RPMI_ERR_FAILED;
+	}
+
+	rpmi_context_process_a2p_request(cntx);
+	for (i = 0; i < LIBRPMI_CONTEXT_MAX_DEFERRED; i++) {
+		if (rpmi_transport_dequeue(scene->xport, RPMI_QUEUE_P2A_ACK,
+					   (void *)test_msg))
+			return RPMI_ERR_FAILED;
+	}
+
+	return test_recv_none(scene);
+}
+
+static int test_defer_posted_check(struct rpmi_test_scenario *scene,
+				   struct rpmi_test *test)
+{
+	struct rpmi_context *cntx = scene->cntx;
+
+	test_num_handles = 0;
+	if (test_send_request(scene, scene->xport, TEST_GROUP_ID_A,
+			      TEST_SRV_DEFER, RPMI_MSG_POSTED_REQUEST, 0, 0))
+		return RPMI_ERR_FAILED;
+
+	/* Completion of a posted request frees it without acknowledgement */
+	rpmi_context_process_a2p_request(cntx);
+	if (test_num_handles != 1 ||
+	    rpmi_context_complete_request_status(cntx, test_handles[0],
+						 RPMI_SUCCESS))
+		return RPMI_ERR_FAILED;
+
+	rpmi_context_process_a2p_request(cntx);
+	if (test_recv_none(scene))
+		return RPMI_ERR_FAILED;
+
+	return (rpmi_context_complete_request_status(cntx, test_handles[0],
+			RPMI_SUCCESS) == RPMI_ERR_INVALID_STATE) ?
+						RPMI_SUCCESS : RPMI_ERR_FAILED;
+}
+
+static int test_defer_worker_check(struct rpmi_test_scenario *scene,
+				   struct rpmi_test *test)
+{
+	struct rpmi_context *cntx = scene->cntx;
+	rpmi_uint16_t token = scene->token_sequence;
+	int rc;
+
+	if (rpmi_context_set_group_worker(cntx, TEST_GROUP_ID_A, 1))
+		return RPMI_ERR_FAILED;
+
+	/* Request processed by a worker is served without deferring it */
+	test_num_handles = 0;
+	rc = test_send_defer(scene, TEST_GROUP_ID_A);
+	if (!rc) {
+		rpmi_context_process_a2p_request(cntx);
+		rpmi_context_process_worker(cntx, 1);
+		rpmi_context_process_a2p_request(cntx);
+		rc = test_recv_status(scene, token, RPMI_ERR_INVALID_STATE);
+	}
+
+	if (rpmi_context_set_group_worker(cntx, TEST_GROUP_ID_A, 0) || rc ||
+	    test_num_handles)
+		return RPMI_ERR_FAILED;
+
+	return test_recv_none(scene);
+}
+
+/*
+ * Dequeue the echo acknowledgements of two groups processed by different
+ * workers and check that the tokens of each group are in order.
+ */
+static int test_worker_drain(struct rpmi_test_scenario *scene,
+			     const rpmi_uint16_t *servicegroup_id,
+			     rpmi_uint16_t *token, rpmi_uint32_t *count)
+{
+	struct rpmi_message *msg = (void *)test_msg;
+	rpmi_uint32_t i;
+
+	while (!rpmi_transport_dequeue(scene->xport, RPMI_QUEUE_P2A_ACK, msg)) {
+		for (i = 0; i < 2; i++) {
+			if (msg->header.servicegroup_id == servicegroup_id[i])
+				break;
+		}
+		if (i == 2 || test_check_echo(msg, servicegroup_id[i]) ||
+		    msg->header.token != token[i]) {
+			printf("%s: acknowledgement %u out of order\n",
+			       __func__, msg->header.token);
+			return RPMI_ERR_FAILED;
+		}
+		/* Requests of the two groups are interleaved */
+		token[i] += 3;
+		count[i]++;
+	}
+
+	return RPMI_SUCCESS;
+}
+
+static int test_worker_order_check(struct rpmi_test_scenario *scene,
+				   struct rpmi_test *test)
+{
+	static const rpmi_uint16_t ids[2] = { TEST_GROUP_ID_A, TEST_GROUP_ID_B };
+	struct rpmi_message *msg = (void *)test_msg;
+	struct rpmi_context *cntx = scene->cntx;
+	rpmi_uint16_t token = scene->token_sequence;
+	rpmi_uint16_t tokens[2] = { token, token + 1 };
+	rpmi_uint32_t i, counts[2] = { 0, 0 };
+
+	if (rpmi_context_set_group_worker(cntx, TEST_GROUP_ID_A, 1) ||
+	    rpmi_context_set_group_worker(cntx, TEST_GROUP_ID_B, 2))
+		return RPMI_ERR_FAILED;
+
+	test_group_a.num_requests = 0;
+	test_group_b.num_requests = 0;
+	for (i = 0; i < 3; i++) {
+		if (test_send_echo(scene, TEST_GROUP_ID_A) ||
+		    test_send_echo(scene, TEST_GROUP_ID_B) ||
+		    test_send_echo(scene, TEST_GROUP_ID_C))
+			return RPMI_ERR_FAILED;
+	}
+
+	/* Dispatcher serves its own group and only queues the others */
+	rpmi_context_process_a2p_request(cntx);
+	if (test_group_a.num_requests || test_group_b.num_requests)
+		return RPMI_ERR_FAILED;
+	for (i = 0; i < 3; i++) {
+		if (rpmi_transport_dequeue(scene->xport, RPMI_QUEUE_P2A_ACK, msg) ||
+		    test_check_echo(msg, TEST_GROUP_ID_C) ||
+		    msg->header.token != (rpmi_uint16_t)(token + 3 * i + 2))
+			return RPMI_ERR_FAILED;
+	}
+	if (test_recv_none(scene))
+		return RPMI_ERR_FAILED;
+
+	/* Workers finishing in any order keep the tokens of a group in order */
+	if (rpmi_context_process_worker(cntx, 2) != 3 ||
+	    rpmi_context_process_worker(cntx, 1) != 3)
+		return RPMI_ERR_FAILED;
+
+	/* Acknowledgements are only posted by the dispatcher */
+	if (test_recv_none(scene))
+		return RPMI_ERR_FAILED;
+
+	rpmi_context_process_a2p_request(cntx);
+	if (test_worker_drain(scene, ids, tokens, counts) ||
+	    counts[0] != 3 || counts[1] != 3)
+		return RPMI_ERR_FAILED;
+
+	if (rpmi_context_set_group_worker(cntx, TEST_GROUP_ID_A, 0) ||
+	    rpmi_context_set_group_worker(cntx, TEST_GROUP_ID_B, 0))
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static int test_worker_full_check(struct rpmi_test_scenario *scene,
+				  struct rpmi_test *test)
+{
+	struct rpmi_context *cntx = scene->cntx;
+	rpmi_uint16_t token = scene->token_sequence;
+	rpmi_uint32_t i;
+
+	if (rpmi_context_set_group_worker(cntx, TEST_GROUP_ID_A, 1))
+		return RPMI_ERR_FAILED;
+
+	for (i = 0; i < LIBRPMI_CONTEXT_WORKER_QUEUE_LEN + 2; i++) {
+		if (test_send_echo(scene, TEST_GROUP_ID_A))
+			return RPMI_ERR_FAILED;
+	}
+
+	/* Requests beyond a full work queue stay in the A2P queue */
+	rpmi_context_process_a2p_request(cntx);
+	if (rpmi_context_process_worker(cntx, 1) !=
+					LIBRPMI_CONTEXT_WORKER_QUEUE_LEN)
+		return RPMI_ERR_FAILED;
+
+	/* Acknowledgements are posted before the remaining requests are queued */
+	rpmi_context_process_a2p_request(cntx);
+	if (rpmi_context_process_worker(cntx, 1) != 2)
+		return RPMI_ERR_FAILED;
+
+	rpmi_context_process_a2p_request(cntx);
+	if (test_drain_echo(scene, TEST_GROUP_ID_A, &token) !=
+					LIBRPMI_CONTEXT_WORKER_QUEUE_LEN + 2)
+		return RPMI_ERR_FAILED;
+
+	return rpmi_context_set_group_worker(cntx, TEST_GROUP_ID_A, 0) ?
+		RPMI_ERR_FAILED : RPMI_SUCCESS;
+}
+
+static int test_worker_switch_check(struct rpmi_test_scenario *scene,
+				    struct rpmi_test *test)
+{
+	struct rpmi_context *cntx = scene->cntx;
+	rpmi_uint16_t token = scene->token_sequence;
+	rpmi_uint32_t i;
+
+	if (rpmi_context_set_group_worker(cntx, TEST_GROUP_ID_A, 1))
+		return RPMI_ERR_FAILED;
+
+	for (i = 0; i < 2; i++) {
+		if (test_send_echo(scene, TEST_GROUP_ID_A))
+			return RPMI_ERR_FAILED;
+	}
+	rpmi_context_process_a2p_request(cntx);
+
+	/* Requests keep going to the previous worker until it is drained */
+	if (rpmi_context_set_group_worker(cntx, TEST_GROUP_ID_A, 2))
+		return RPMI_ERR_FAILED;
+	for (i = 0; i < 2; i++) {
+		if (test_send_echo(scene, TEST_GROUP_ID_A))
+			return RPMI_ERR_FAILED;
+	}
+	rpmi_context_process_a2p_request(cntx);
+	if (rpmi_context_process_worker(cntx, 2) ||
+	    rpmi_context_process_worker(cntx, 1) != 4)
+		return RPMI_ERR_FAILED;
+
+	rpmi_context_process_a2p_request(cntx);
+	if (test_drain_echo(scene, TEST_GROUP_ID_A, &token) != 4)
+		return RPMI_ERR_FAILED;
+
+	/* New worker takes over once the previous one is acknowledged */
+	if (test_send_echo(scene, TEST_GROUP_ID_A))
+		return RPMI_ERR_FAILED;
+	rpmi_context_process_a2p_request(cntx);
+	if (rpmi_context_process_worker(cntx, 1) ||
+	    rpmi_context_process_worker(cntx, 2) != 1)
+		return RPMI_ERR_FAILED;
+
+	rpmi_context_process_a2p_request(cntx);
+	if (test_drain_echo(scene, TEST_GROUP_ID_A, &token) != 1)
+		return RPMI_ERR_FAILED;
+
+	return rpmi_context_set_group_worker(cntx, TEST_GROUP_ID_A, 0) ?
+		RPMI_ERR_FAILED : RPMI_SUCCESS;
+}
+
+/* Dequeue the echo acknowledgements of a group from a transport */
+static rpmi_uint32_t test_drain_channel(struct rpmi_transport *trans,
+					rpmi_uint16_t servicegroup_id)
+{
+	struct rpmi_message *msg = (void *)test_msg;
+	rpmi_uint32_t count = 0;
+
+	while (!rpmi_transport_dequeue(trans, RPMI_QUEUE_P2A_ACK, msg)) {
+		if (test_check_echo(msg, servicegroup_id))
+			return -1U;
+		count++;
+	}
+
+	return count;
+}
+
+/* Probe a service group over a transport and return the reported version */
+static rpmi_uint32_t test_probe_channel(struct rpmi_test_scenario *scene,
+					struct rpmi_transport *trans,
+					rpmi_uint16_t servicegroup_id)
+{
+	struct rpmi_message *msg = (void *)test_msg;
+	const rpmi_uint32_t *data = (const void *)msg->data;
+
+	if (test_send_request(scene, trans, RPMI_SRVGRP_BASE,
+			      RPMI_BASE_SRV_PROBE_SERVICE_GROUP,
+			      RPMI_MSG_NORMAL_REQUEST, sizeof(rpmi_uint32_t),
+			      servicegroup_id))
+		return -1U;
+
+	rpmi_context_process_a2p_request(scene->cntx);
+	if (rpmi_transport_dequeue(trans, RPMI_QUEUE_P2A_ACK, msg) ||
+	    data[0] != RPMI_SUCCESS)
+		return -1U;
+
+	return data[1];
+}
+
+static int test_channel_add_check(struct rpmi_test_scenario *scene,
+				  struct rpmi_test *test)
+{
+	struct rpmi_context *cntx = scene->cntx;
+
+	/* Group must be accessible from at least one channel */
+	if (rpmi_context_add_group(cntx, &test_group_s.group) != RPMI_ERR_DENIED)
+		return RPMI_ERR_FAILED;
+
+	if (rpmi_context_add_transport(cntx, test_xport_s, RPMI_PRIVILEGE_S_MODE,
+				       LIBRPMI_CONTEXT_NO_P2A_MSI) ||
+	    rpmi_context_add_transport(cntx, test_xport_s, RPMI_PRIVILEGE_S_MODE,
+				       LIBRPMI_CONTEXT_NO_P2A_MSI) != RPMI_ERR_ALREADY)
+		return RPMI_ERR_FAILED;
+
+	return rpmi_context_add_group(cntx, &test_group_s.group) ?
+						RPMI_ERR_FAILED : RPMI_SUCCESS;
+}
+
+static int test_channel_privilege_check(struct rpmi_test_scenario *scene,
+					struct rpmi_test *test)
+{
+	rpmi_uint16_t groups[] = { TEST_GROUP_ID_A, TEST_GROUP_ID_S };
+	rpmi_uint32_t i;
+
+	/* Each channel sends requests to the groups of both privilege levels */
+	for (i = 0; i < 2; i++) {
+		if (test_send_request(scene, scene->xport, groups[i],
+				      TEST_SRV_ECHO, RPMI_MSG_NORMAL_REQUEST, 0, 0) ||
+		    test_send_request(scene, test_xport_s, groups[i],
+				      TEST_SRV_ECHO, RPMI_MSG_NORMAL_REQUEST, 0, 0))
+			return RPMI_ERR_FAILED;
+	}
+
+	/* Requests to groups not accessible from a channel are dropped */
+	rpmi_context_process_a2p_request(scene->cntx);
+	if (test_drain_channel(scene->xport, TEST_GROUP_ID_A) != 1 ||
+	    test_drain_channel(test_xport_s, TEST_GROUP_ID_S) != 1)
+		return RPMI_ERR_FAILED;
+
+	/* Probe only reports the groups accessible from the channel */
+	if (test_probe_channel(scene, scene->xport, TEST_GROUP_ID_A) !=
+				test_group_a.group.servicegroup_version ||
+	    test_probe_channel(scene, scene->xport, TEST_GROUP_ID_S) ||
+	    test_probe_channel(scene, test_xport_s, TEST_GROUP_ID_A) ||
+	    test_probe_channel(scene, test_xport_s, TEST_GROUP_ID_S) !=
+				test_group_s.group.servicegroup_version)
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static int test_channel_round_robin_check(struct rpmi_test_scenario *scene,
+					  struct rpmi_test *test)
+{
+	rpmi_uint32_t i;
+
+	for (i = 0; i < 2 * LIBRPMI_CONTEXT_BATCH_COUNT; i++) {
+		if (test_send_echo(scene, TEST_GROUP_ID_A) ||
+		    test_send_request(scene, test_xport_s, TEST_GROUP_ID_S,
+				      TEST_SRV_ECHO, RPMI_MSG_NORMAL_REQUEST, 0, 0))
+			return RPMI_ERR_FAILED;
+	}
+
+	/* Busy channel gets one batch before the other channel is served */
+	if (rpmi_context_process_a2p_request_bounded(scene->cntx,
+				2 * LIBRPMI_CONTEXT_BATCH_COUNT, 0) !=
+						2 * LIBRPMI_CONTEXT_BATCH_COUNT ||
+	    test_drain_channel(scene->xport, TEST_GROUP_ID_A) !=
+						LIBRPMI_CONTEXT_BATCH_COUNT ||
+	    test_drain_channel(test_xport_s, TEST_GROUP_ID_S) !=
+						LIBRPMI_CONTEXT_BATCH_COUNT)
+		return RPMI_ERR_FAILED;
+
+	rpmi_context_process_a2p_request(scene->cntx);
+	if (test_drain_channel(scene->xport, TEST_GROUP_ID_A) !=
+						LIBRPMI_CONTEXT_BATCH_COUNT ||
+	    test_drain_channel(test_xport_s, TEST_GROUP_ID_S) !=
+						LIBRPMI_CONTEXT_BATCH_COUNT)
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static int test_channel_remove_check(struct rpmi_test_scenario *scene,
+				     struct rpmi_test *test)
+{
+	struct rpmi_context *cntx = scene->cntx;
+	struct rpmi_message *msg = (void *)test_msg;
+
+	if (rpmi_context_remove_transport(cntx, scene->xport) != RPMI_ERR_DENIED)
+		return RPMI_ERR_FAILED;
+
+	/* Channel with a deferred request can't be removed */
+	test_num_handles = 0;
+	if (test_send_request(scene, test_xport_s, TEST_GROUP_ID_S,
+			      TEST_SRV_DEFER, RPMI_MSG_NORMAL_REQUEST, 0, 0))
+		return RPMI_ERR_FAILED;
+	rpmi_context_process_a2p_request(cntx);
+	if (test_num_handles != 1 ||
+	    rpmi_context_remove_transport(cntx, test_xport_s) != RPMI_ERR_BUSY)
+		return RPMI_ERR_FAILED;
+
+	/* Channel is still served after the failed removal */
+	if (rpmi_context_complete_request_status(cntx, test_handles[0],
+						 RPMI_SUCCESS))
+		return RPMI_ERR_FAILED;
+	rpmi_context_process_a2p_request(cntx);
+	if (rpmi_transport_dequeue(test_xport_s, RPMI_QUEUE_P2A_ACK, msg) ||
+	    msg->header.token != (rpmi_uint16_t)(scene->token_sequence - 1))
+		return RPMI_ERR_FAILED;
+
+	if (rpmi_context_remove_transport(cntx, test_xport_s) ||
+	    rpmi_context_remove_transport(cntx, test_xport_s) !=
+							RPMI_ERR_INVALID_PARAM)
+		return RPMI_ERR_FAILED;
+
+	/* Requests of a removed channel stay in its queue */
+	if (test_send_request(scene, test_xport_s, TEST_GROUP_ID_S,
+			      TEST_SRV_ECHO, RPMI_MSG_NORMAL_REQUEST, 0, 0))
+		return RPMI_ERR_FAILED;
+	rpmi_context_process_a2p_request(cntx);
+	if (test_drain_channel(test_xport_s, TEST_GROUP_ID_S) ||
+	    rpmi_transport_dequeue(test_xport_s, RPMI_QUEUE_A2P_REQ, msg))
+		return RPMI_ERR_FAILED;
+
+	/* Slot of the removed channel is reused */
+	if (rpmi_context_add_transport(cntx, test_xport_s, RPMI_PRIVILEGE_S_MODE,
+				       LIBRPMI_CONTEXT_NO_P2A_MSI) ||
+	    test_send_request(scene, test_xport_s, TEST_GROUP_ID_S,
+			      TEST_SRV_ECHO, RPMI_MSG_NORMAL_REQUEST, 0, 0))
+		return RPMI_ERR_FAILED;
+	rpmi_context_process_a2p_request(cntx);
+
+	return (test_drain_channel(test_xport_s, TEST_GROUP_ID_S) == 1) ?
+						RPMI_SUCCESS : RPMI_ERR_FAILED;
+}
+
+static int test_scenario_channel_cleanup(struct rpmi_test_scenario *scene)
+{
+	if (scene->cntx) {
+		rpmi_context_remove_group(scene->cntx, &test_group_s.group);
+		if (test_xport_s)
+			rpmi_context_remove_transport(scene->cntx, test_xport_s);
+		rpmi_context_remove_group(scene->cntx, &test_group_a.group);
+	}
+	if (test_xport_s) {
+		rpmi_transport_shmem_destroy(test_xport_s);
+		test_xport_s = NULL;
+	}
+	if (test_shmem_s) {
+		rpmi_shmem_destroy(test_shmem_s);
+		test_shmem_s = NULL;
+	}
+
+	return test_scenario_default_cleanup(scene);
+}
+
+static int test_scenario_channel_init(struct rpmi_test_scenario *scene)
+{
+	int rc;
+
+	rc = test_scenario_default_init(scene);
+	if (rc)
+		return rc;
+
+	test_shmem_s = rpmi_shmem_create("test_shmem_s",
+					 (unsigned long)test_shm_s, sizeof(test_shm_s),
+					 &rpmi_shmem_simple_ops, NULL);
+	if (!test_shmem_s)
+		goto fail;
+
+	test_xport_s = rpmi_transport_shmem_create("test_transport_s",
+						   scene->slot_size,
+						   ((sizeof(test_shm_s) * 3) / 4) / 2,
+						   ((sizeof(test_shm_s) * 1) / 4) / 2,
+						   test_shmem_s);
+	if (!test_xport_s)
+		goto fail;
+
+	if (rpmi_context_add_group(scene->cntx, &test_group_a.group))
+		goto fail;
+
+	return 0;
+
+fail:
+	printf("%s: failed to setup channel scenario\n", __func__);
+	test_scenario_channel_cleanup(scene);
+	return RPMI_ERR_FAILED;
+}
+
+/* Process events and check the calls of both event groups since last time */
+static int test_events_expect(struct rpmi_test_scenario *scene,
+			      rpmi_uint32_t signal_calls)
+{
+	rpmi_uint32_t signal_events = test_group_signal.num_events;
+	rpmi_uint32_t poll_events = test_group_poll.num_events;
+
+	rpmi_context_process_all_events(scene->cntx);
+
+	if (test_group_signal.num_events - signal_events != signal_calls ||
+	    test_group_poll.num_events - poll_events != 1)
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static int test_events_initial_check(struct rpmi_test_scenario *scene,
+				     struct rpmi_test *test)
+{
+	/* Added group was signalled once for the processing before the check */
+	if (test_group_signal.num_events != 1 || test_group_poll.num_events != 1)
+		return RPMI_ERR_FAILED;
+
+	/* Polled group runs every time unlike the signalled group */
+	if (test_events_expect(scene, 0) || test_events_expect(scene, 0))
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static int test_events_signal_check(struct rpmi_test_scenario *scene,
+				    struct rpmi_test *test)
+{
+	struct rpmi_context *cntx = scene->cntx;
+
+	if (rpmi_context_signal_group(cntx, TEST_GROUP_ID_SIGNAL) ||
+	    rpmi_context_signal_group(cntx, TEST_GROUP_ID_SIGNAL))
+		return RPMI_ERR_FAILED;
+
+	/* Signals before the processing are merged into one call */
+	if (test_events_expect(scene, 1) || test_events_expect(scene, 0))
+		return RPMI_ERR_FAILED;
+
+	/* Only groups of the context with events can be signalled */
+	if (rpmi_context_signal_group(cntx, TEST_GROUP_ID_B) !=
+						RPMI_ERR_INVALID_PARAM ||
+	    rpmi_context_signal_group(cntx, TEST_GROUP_ID_A) != RPMI_ERR_NOTSUPP)
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static int test_events_error_check(struct rpmi_test_scenario *scene,
+				   struct rpmi_test *test)
+{
+	enum rpmi_error rcs[] = { RPMI_ERR_BUSY, RPMI_ERR_FAILED };
+	rpmi_uint32_t i;
+
+	for (i = 0; i < 2; i++) {
+		test_group_signal.events_rc = rcs[i];
+		if (rpmi_context_signal_group(scene->cntx, TEST_GROUP_ID_SIGNAL))
+			return RPMI_ERR_FAILED;
+
+		/* Group stays pending until its events are processed */
+		if (test_events_expect(scene, 1) || test_events_expect(scene, 1))
+			return RPMI_ERR_FAILED;
+
+		test_group_signal.events_rc = RPMI_SUCCESS;
+		if (test_events_expect(scene, 1) || test_events_expect(scene, 0))
+			return RPMI_ERR_FAILED;
+	}
+
+	return RPMI_SUCCESS;
+}
+
+static int test_events_request_check(struct rpmi_test_scenario *scene,
+				     struct rpmi_test *test)
+{
+	/* Request to the group signals it */
+	if (test_send_echo(scene, TEST_GROUP_ID_SIGNAL))
+		return RPMI_ERR_FAILED;
+	rpmi_context_process_a2p_request(scene->cntx);
+	if (test_drain_channel(scene->xport, TEST_GROUP_ID_SIGNAL) != 1)
+		return RPMI_ERR_FAILED;
+
+	if (test_events_expect(scene, 1) || test_events_expect(scene, 0))
+		return RPMI_ERR_FAILED;
+
+	/* Request to another group does not */
+	if (test_send_echo(scene, TEST_GROUP_ID_A))
+		return RPMI_ERR_FAILED;
+	rpmi_context_process_a2p_request(scene->cntx);
+	if (test_drain_channel(scene->xport, TEST_GROUP_ID_A) != 1)
+		return RPMI_ERR_FAILED;
+
+	return test_events_expect(scene, 0);
+}
+
+static int test_scenario_events_cleanup(struct rpmi_test_scenario *scene)
+{
+	rpmi_context_remove_group(scene->cntx, &test_group_poll.group);
+	rpmi_context_remove_group(scene->cntx, &test_group_signal.group);
+	rpmi_context_remove_group(scene->cntx, &test_group_a.group);
+	return test_scenario_default_cleanup(scene);
+}
+
+static int test_scenario_events_init(struct rpmi_test_scenario *scene)
+{
+	int rc;
+
+	rc = test_scenario_default_init(scene);
+	if (rc)
+		return rc;
+
+	test_group_signal.num_events = 0;
+	test_group_poll.num_events = 0;
+
+	if (rpmi_context_add_group(scene->cntx, &test_group_a.group) ||
+	    rpmi_context_add_group(scene->cntx, &test_group_signal.group) ||
+	    rpmi_context_add_group(scene->cntx, &test_group_poll.group)) {
+		printf("%s: failed to add test groups\n", __func__);
+		test_scenario_events_cleanup(scene);
+		return RPMI_ERR_FAILED;
+	}
+
+	return 0;
+}
+
+static int test_scenario_group_init(struct rpmi_test_scenario *scene)
+{
+	int rc;
+
+	rc = test_scenario_default_init(scene);
+	if (rc)
+		return rc;
+
+	rc = rpmi_context_add_group(scene->cntx, &test_group_a.group);
+	if (rc) {
+		printf("%s: failed to add test group\n", __func__);
+		test_scenario_default_cleanup(scene);
+		return rc;
+	}
+
+	return 0;
+}
+
+static int test_scenario_group_cleanup(struct rpmi_test_scenario *scene)
+{
+	rpmi_context_remove_group(scene->cntx, &test_group_a.group);
+	return test_scenario_default_cleanup(scene);
+}
+
+static int test_scenario_worker_init(struct rpmi_test_scenario *scene)
+{
+	int rc;
+
+	rc = test_scenario_default_init(scene);
+	if (rc)
+		return rc;
+
+	if (rpmi_context_add_group(scene->cntx, &test_group_a.group) ||
+	    rpmi_context_add_group(scene->cntx, &test_group_b.group) ||
+	    rpmi_context_add_group(scene->cntx, &test_group_c.group)) {
+		printf("%s: failed to add test groups\n", __func__);
+		rpmi_context_remove_group(scene->cntx, &test_group_a.group);
+		rpmi_context_remove_group(scene->cntx, &test_group_b.group);
+		test_scenario_default_cleanup(scene);
+		return RPMI_ERR_FAILED;
+	}
+
+	return 0;
+}
+
+/* Add and remove a service group while the main thread processes requests */
+static void *test_toggle_thread(void *arg)
+{
+	struct rpmi_context *cntx = arg;
+	rpmi_uint32_t i;
+
+	for (i = 0; i < TEST_TOGGLE_COUNT; i++) {
+		if (rpmi_context_add_group(cntx, &test_group_d.group))
+			break;
+		rpmi_context_remove_group(cntx, &test_group_d.group);
+	}
+
+	test_toggle_done = true;
+	return (void *)(unsigned long)(i != TEST_TOGGLE_COUNT);
+}
+
+/* Dequeue the pending acknowledgements and count them per service group */
+static int test_toggle_drain(struct rpmi_test_scenario *scene,
+			     rpmi_uint32_t *acks_a, rpmi_uint32_t *acks_d)
+{
+	struct rpmi_message *msg = (void *)test_msg;
+
+	while (!rpmi_transport_dequeue(scene->xport, RPMI_QUEUE_P2A_ACK, msg)) {
+		if (msg->header.servicegroup_id == TEST_GROUP_ID_A)
+			(*acks_a)++;
+		else
+			(*acks_d)++;
+		if (test_check_echo(msg, msg->header.servicegroup_id))
+			return RPMI_ERR_FAILED;
+	}
+
+	return RPMI_SUCCESS;
+}
+
+static int test_toggle_check(struct rpmi_test_scenario *scene,
+			     struct rpmi_test *test)
+{
+	rpmi_uint32_t sent_a = 0, acks_a = 0, acks_d = 0;
+	struct rpmi_context *cntx = scene->cntx;
+	pthread_t toggle;
+	int rc = 0;
+	void *ret;
+
+	if (rpmi_context_add_group(cntx, &test_group_a.group))
+		return RPMI_ERR_FAILED;
+	test_group_d.num_requests = 0;
+
+	test_toggle_done = false;
+	if (pthread_create(&toggle, NULL, test_toggle_thread, cntx))
+		return RPMI_ERR_FAILED;
+
+	while (!test_toggle_done && !rc) {
+		if (test_send_echo(scene, TEST_GROUP_ID_A) ||
+		    test_send_echo(scene, TEST_GROUP_ID_D)) {
+			rc = RPMI_ERR_FAILED;
+			break;
+		}
+		sent_a++;
+		rpmi_context_process_a2p_request(cntx);
+		rc = test_toggle_drain(scene, &acks_a, &acks_d);
+	}
+
+	pthread_join(toggle, &ret);
+	if (rc || ret)
+		return RPMI_ERR_FAILED;
+
+	/* Every request of the stable group is served in spite of the toggling */
+	rpmi_context_process_a2p_request(cntx);
+	if (test_toggle_drain(scene, &acks_a, &acks_d) || acks_a != sent_a) {
+		printf("%s: %u of %u requests acknowledged\n",
+		       __func__, acks_a, sent_a);
+		return RPMI_ERR_FAILED;
+	}
+
+	/* Requests of the toggled group are acknowledged iff it served them */
+	if (acks_d != test_group_d.num_requests ||
+	    test_group_d.group.num_contexts ||
+	    rpmi_context_find_group(cntx, TEST_GROUP_ID_D))
+		return RPMI_ERR_FAILED;
+
+	rpmi_context_remove_group(cntx, &test_group_a.group);
+	return RPMI_SUCCESS;
+}
+
+#define TEST_ECHO_REQUEST(__id, __expdata)				\
+	{								\
+		.name = "TEST_SRV_ECHO (" #__id ")",			\
+		.attrs = {						\
+			.servicegroup_id = __id,			\
+			.service_id = TEST_SRV_ECHO,			\
+			.flags = RPMI_MSG_NORMAL_REQUEST,		\
+			.expected_data = __expdata,			\
+			.expected_data_len = sizeof(__expdata),		\
+		},							\
+		.init_expected_data = test_init_expected_data_from_attrs, \
+	}
+
+static struct rpmi_test_scenario scenario_collision = {
+	.name = "Context Dispatch Hash Collisions",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	/* Base group and three test groups in a table of eight slots */
+	.max_num_groups = 4,
+	.priv = NULL,
+
+	.init = test_scenario_default_init,
+	.cleanup = test_scenario_collision_cleanup,
+
+	.num_tests = 10,
+	.tests = {
+		{
+			.name = "CONTEXT_COLLISION_ADD",
+			.check = test_collision_add_check,
+		},
+		TEST_ECHO_REQUEST(TEST_GROUP_ID_A, echo_expdata_a),
+		TEST_ECHO_REQUEST(TEST_GROUP_ID_B, echo_expdata_b),
+		TEST_ECHO_REQUEST(TEST_GROUP_ID_C, echo_expdata_c),
+		{
+			.name = "CONTEXT_COLLISION_REMOVE_MIDDLE",
+			.check = test_collision_remove_check,
+		},
+		TEST_ECHO_REQUEST(TEST_GROUP_ID_A, echo_expdata_a),
+		TEST_ECHO_REQUEST(TEST_GROUP_ID_C, echo_expdata_c),
+		{
+			.name = "CONTEXT_COLLISION_REMOVED_GROUP",
+			.run = test_collision_removed_run,
+			.check = test_collision_removed_check,
+		},
+		{
+			.name = "CONTEXT_COLLISION_READD",
+			.check = test_collision_readd_check,
+		},
+		TEST_ECHO_REQUEST(TEST_GROUP_ID_B, echo_expdata_b),
+	},
+};
+
+static struct rpmi_test_scenario scenario_toggle = {
+	.name = "Context Group Add/Remove While Processing",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = NULL,
+
+	.init = test_scenario_default_init,
+	.cleanup = test_scenario_default_cleanup,
+
+	.num_tests = 1,
+	.tests = {
+		{
+			.name = "CONTEXT_GROUP_ADD_REMOVE_CONCURRENT",
+			.check = test_toggle_check,
+		},
+	},
+};
+
+#define TEST_BOUNDED_TESTS						\
+	{								\
+		.name = "CONTEXT_BOUNDED_MAX_COUNT",			\
+		.check = test_bounded_count_check,			\
+	},								\
+	{								\
+		.name = "CONTEXT_BOUNDED_PARKED_ACKS",			\
+		.check = test_bounded_parked_check,			\
+	},								\
+	TEST_ECHO_REQUEST(TEST_GROUP_ID_A, echo_expdata_a)
+
+static struct rpmi_test_scenario scenario_bounded = {
+	.name = "Context Bounded Processing",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = NULL,
+
+	.init = test_scenario_group_init,
+	.cleanup = test_scenario_group_cleanup,
+
+	.num_tests = 3,
+	.tests = {
+		TEST_BOUNDED_TESTS,
+	},
+};
+
+static struct rpmi_test_scenario scenario_bounded_inplace = {
+	.name = "Context Bounded In-place Processing",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.xport_flags = LIBRPMI_TRANSPORT_SHMEM_FLAG_TRUSTED_AP,
+	.priv = NULL,
+
+	.init = test_scenario_group_init,
+	.cleanup = test_scenario_group_cleanup,
+
+	.num_tests = 3,
+	.tests = {
+		TEST_BOUNDED_TESTS,
+	},
+};
+
+static struct rpmi_test_scenario scenario_defer = {
+	.name = "Context Deferred Requests",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = NULL,
+
+	.init = test_scenario_group_init,
+	.cleanup = test_scenario_group_cleanup,
+
+	.num_tests = 5,
+	.tests = {
+		{
+			.name = "CONTEXT_DEFER_COMPLETE_OUT_OF_ORDER",
+			.check = test_defer_complete_check,
+		},
+		{
+			.name = "CONTEXT_DEFER_BUSY",
+			.check = test_defer_busy_check,
+		},
+		{
+			.name = "CONTEXT_DEFER_POSTED",
+			.check = test_defer_posted_check,
+		},
+		{
+			.name = "CONTEXT_DEFER_WORKER",
+			.check = test_defer_worker_check,
+		},
+		TEST_ECHO_REQUEST(TEST_GROUP_ID_A, echo_expdata_a),
+	},
+};
+
+static struct rpmi_test_scenario scenario_worker = {
+	.name = "Context Worker Queues",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = NULL,
+
+	.init = test_scenario_worker_init,
+	.cleanup = test_scenario_collision_cleanup,
+
+	.num_tests = 4,
+	.tests = {
+		{
+			.name = "CONTEXT_WORKER_ACK_ORDER",
+			.check = test_worker_order_check,
+		},
+		{
+			.name = "CONTEXT_WORKER_QUEUE_FULL",
+			.check = test_worker_full_check,
+		},
+		{
+			.name = "CONTEXT_WORKER_SWITCH",
+			.check = test_worker_switch_check,
+		},
+		TEST_ECHO_REQUEST(TEST_GROUP_ID_A, echo_expdata_a),
+	},
+};
+
+static struct rpmi_test_scenario scenario_channel = {
+	.name = "Context Multiple Channels",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = NULL,
+
+	.init = test_scenario_channel_init,
+	.cleanup = test_scenario_channel_cleanup,
+
+	.num_tests = 5,
+	.tests = {
+		{
+			.name = "CONTEXT_CHANNEL_ADD",
+			.check = test_channel_add_check,
+		},
+		{
+			.name = "CONTEXT_CHANNEL_PRIVILEGE",
+			.check = test_channel_privilege_check,
+		},
+		{
+			.name = "CONTEXT_CHANNEL_ROUND_ROBIN",
+			.check = test_channel_round_robin_check,
+		},
+		{
+			.name = "CONTEXT_CHANNEL_REMOVE",
+			.check = test_channel_remove_check,
+		},
+		TEST_ECHO_REQUEST(TEST_GROUP_ID_A, echo_expdata_a),
+	},
+};
+
+static struct rpmi_test_scenario scenario_events = {
+	.name = "Context Signalled Events",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = NULL,
+
+	.init = test_scenario_events_init,
+	.cleanup = test_scenario_events_cleanup,
+
+	.num_tests = 4,
+	.tests = {
+		{
+			.name = "CONTEXT_EVENTS_INITIAL",
+			.check = test_events_initial_check,
+		},
+		{
+			.name = "CONTEXT_EVENTS_SIGNAL",
+			.check = test_events_signal_check,
+		},
+		{
+			.name = "CONTEXT_EVENTS_PENDING_ON_ERROR",
+			.check = test_events_error_check,
+		},
+		{
+			.name = "CONTEXT_EVENTS_ON_REQUEST",
+			.check = test_events_request_check,
+		},
+	},
+};
+
+int main(int argc, char *argv[])
+{
+	int rc;
+
+	printf("Test RPMI Context\n");
+
+	/* Execute dispatch hash collision scenario */
+	rc = test_scenario_execute(&scenario_collision);
+	if (rc)
+		return rc;
+
+	/* Execute group add/remove while processing scenario */
+	rc = test_scenario_execute(&scenario_toggle);
+	if (rc)
+		return rc;
+
+	/* Execute bounded processing scenarios */
+	rc = test_scenario_execute(&scenario_bounded);
+	if (rc)
+		return rc;
+
+	rc = test_scenario_execute(&scenario_bounded_inplace);
+	if (rc)
+		return rc;
+
+	/* Execute deferred requests scenario */
+	rc = test_scenario_execute(&scenario_defer);
+	if (rc)
+		return rc;
+
+	/* Execute worker queues scenario */
+	rc = test_scenario_execute(&scenario_worker);
+	if (rc)
+		return rc;
+
+	/* Execute multiple channels scenario */
+	rc = test_scenario_execute(&scenario_channel);
+	if (rc)
+		return rc;
+
+	/* Execute signalled events scenario */
+	return test_scenario_execute(&scenario_events);
+}
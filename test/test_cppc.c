@@ -0,0 +1,797 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 Ventana Micro Systems Inc.
+ */
+
+#include <librpmi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_common.h"
+#include "test_log.h"
+
+#define TEST_HART_COUNT		4
+#define TEST_FASTCHAN_SZ	4096
+#define TEST_FREQ_PER_PERF	1000000ULL
+
+/* Largest stride where both subregions of all harts fill the fastchannels */
+#define TEST_MAX_STRIDE		(TEST_FASTCHAN_SZ / (2 * TEST_HART_COUNT))
+
+#define TEST_DOORBELL_ADDR	0x10001000ULL
+#define TEST_DOORBELL_SET_MASK	0x1ULL
+
+static const rpmi_uint32_t test_hart_ids[TEST_HART_COUNT] = { 0, 1, 2, 3 };
+
+struct test_cppc_priv {
+	/* Fastchannel layout and doorbell of the scenario */
+	rpmi_uint32_t stride;
+	rpmi_uint64_t feedback_offset;
+	rpmi_bool_t doorbell;
+
+	/* Frequency domains of the scenario (none when domain_count is 0) */
+	rpmi_uint32_t domain_count;
+	const rpmi_uint32_t *hart_domain;
+	enum rpmi_cppc_domain_policy policy;
+
+	struct rpmi_hsm *hsm;
+	struct rpmi_service_group *group;
+	void *fastchan;
+	struct rpmi_shmem *fastchan_shmem;
+
+	/* Desired performance passed to cppc_update_perf() per hart */
+	rpmi_uint32_t updated_perf[TEST_HART_COUNT];
+	rpmi_uint32_t update_count;
+
+	/* Desired performance passed to cppc_update_domain_perf() per domain */
+	rpmi_uint32_t domain_perf[TEST_HART_COUNT];
+	rpmi_uint32_t domain_update_count;
+};
+
+static struct test_cppc_priv cppc_priv_polled = {
+	.stride = LIBRPMI_CACHE_LINE_SIZE,
+	.feedback_offset = TEST_FASTCHAN_SZ / 2,
+};
+
+/* Subregions are adjacent and the feedback one ends with the fastchannels */
+static struct test_cppc_priv cppc_priv_doorbell = {
+	.stride = TEST_MAX_STRIDE,
+	.feedback_offset = TEST_HART_COUNT * TEST_MAX_STRIDE,
+	.doorbell = true,
+};
+
+/* Harts 0-1 and harts 2-3 share a frequency domain */
+static const rpmi_uint32_t test_hart_domain[TEST_HART_COUNT] = { 0, 0, 1, 1 };
+
+static struct test_cppc_priv cppc_priv_domain_max = {
+	.stride = LIBRPMI_CACHE_LINE_SIZE,
+	.feedback_offset = TEST_FASTCHAN_SZ / 2,
+	.domain_count = 2,
+	.hart_domain = test_hart_domain,
+	.policy = RPMI_CPPC_DOMAIN_POLICY_MAX_PERF,
+};
+
+static struct test_cppc_priv cppc_priv_domain_min = {
+	.stride = LIBRPMI_CACHE_LINE_SIZE,
+	.feedback_offset = TEST_FASTCHAN_SZ / 2,
+	.domain_count = 2,
+	.hart_domain = test_hart_domain,
+	.policy = RPMI_CPPC_DOMAIN_POLICY_MIN_PERF,
+};
+
+static enum rpmi_hart_hw_state test_hart_get_hw_state(void *priv,
+						      rpmi_uint32_t hart_index)
+{
+	return RPMI_HART_HW_STATE_STARTED;
+}
+
+static const struct rpmi_hsm_platform_ops test_hsm_ops = {
+	.hart_get_hw_state = test_hart_get_hw_state,
+};
+
+static const struct rpmi_cppc_regs test_cppc_regs = {
+	.highest_perf = 100,
+	.nominal_perf = 80,
+	.lowest_nonlinear_perf = 20,
+	.lowest_perf = 10,
+};
+
+static enum rpmi_error test_cppc_get_reg(void *priv, rpmi_uint32_t reg_id,
+					 rpmi_uint32_t hart_index,
+					 rpmi_uint64_t *val)
+{
+	*val = 0;
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error test_cppc_set_reg(void *priv, rpmi_uint32_t reg_id,
+					 rpmi_uint32_t hart_index,
+					 rpmi_uint64_t val)
+{
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error test_cppc_update_perf(void *priv,
+					     rpmi_uint32_t hart_index,
+					     rpmi_uint32_t desired_perf)
+{
+	struct test_cppc_priv *cpriv = priv;
+
+	cpriv->updated_perf[hart_index] = desired_perf;
+	cpriv->update_count++;
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error test_cppc_get_current_freq(void *priv,
+						  rpmi_uint32_t hart_index,
+						  rpmi_uint64_t *current_freq_hz)
+{
+	struct test_cppc_priv *cpriv = priv;
+
+	if (cpriv->domain_count)
+		*current_freq_hz = cpriv->domain_perf[cpriv->hart_domain[hart_index]] *
+				   TEST_FREQ_PER_PERF;
+	else
+		*current_freq_hz = cpriv->updated_perf[hart_index] * TEST_FREQ_PER_PERF;
+	return RPMI_SUCCESS;
+}
+
+static enum rpmi_error test_cppc_update_domain_perf(void *priv,
+						    rpmi_uint32_t domain_id,
+						    rpmi_uint32_t desired_perf)
+{
+	struct test_cppc_priv *cpriv = priv;
+
+	cpriv->domain_perf[domain_id] = desired_perf;
+	cpriv->domain_update_count++;
+	return RPMI_SUCCESS;
+}
+
+static const struct rpmi_cppc_platform_ops test_cppc_ops = {
+	.cppc_get_reg = test_cppc_get_reg,
+	.cppc_set_reg = test_cppc_set_reg,
+	.cppc_update_perf = test_cppc_update_perf,
+	.cppc_get_current_freq = test_cppc_get_current_freq,
+};
+
+static const struct rpmi_cppc_platform_ops test_cppc_domain_ops = {
+	.cppc_get_reg = test_cppc_get_reg,
+	.cppc_set_reg = test_cppc_set_reg,
+	.cppc_update_perf = test_cppc_update_perf,
+	.cppc_get_current_freq = test_cppc_get_current_freq,
+	.cppc_update_domain_perf = test_cppc_update_domain_perf,
+};
+
+/* Desired performance written by the application processors (0 is unchanged) */
+static const rpmi_uint32_t fastchan_perf_changed[TEST_HART_COUNT] = { 0, 30, 0, 60 };
+static const rpmi_uint32_t fastchan_perf_unchanged[TEST_HART_COUNT] = { 0, 0, 0, 0 };
+
+/* One round of fastchannel writes and event processing */
+struct test_fastchan_step {
+	/* Desired performance written before the event processing */
+	const rpmi_uint32_t *write_perf;
+	/* Desired performance expected to be passed to cppc_update_perf() */
+	const rpmi_uint32_t *updated_perf;
+	/* Signal the group like the doorbell handler of the platform */
+	rpmi_bool_t ring_doorbell;
+};
+
+static const struct test_fastchan_step fastchan_step_changed = {
+	.write_perf = fastchan_perf_changed,
+	.updated_perf = fastchan_perf_changed,
+};
+
+static const struct test_fastchan_step fastchan_step_unchanged = {
+	.write_perf = fastchan_perf_unchanged,
+	.updated_perf = fastchan_perf_unchanged,
+};
+
+static const struct test_fastchan_step fastchan_step_not_rung = {
+	.write_perf = fastchan_perf_changed,
+	.updated_perf = fastchan_perf_unchanged,
+};
+
+static const struct test_fastchan_step fastchan_step_rung = {
+	.write_perf = fastchan_perf_unchanged,
+	.updated_perf = fastchan_perf_changed,
+	.ring_doorbell = true,
+};
+
+static const struct test_fastchan_step fastchan_step_rung_unchanged = {
+	.write_perf = fastchan_perf_unchanged,
+	.updated_perf = fastchan_perf_unchanged,
+	.ring_doorbell = true,
+};
+
+static int test_fastchan_run(struct rpmi_test_scenario *scene,
+			     struct rpmi_test *test, struct rpmi_message *msg)
+{
+	struct test_cppc_priv *priv = scene->priv;
+	const struct test_fastchan_step *step = test->priv;
+	union rpmi_cppc_perf_request_fastchan *req;
+	rpmi_uint32_t i;
+
+	priv->update_count = 0;
+	for (i = 0; i < TEST_HART_COUNT; i++) {
+		priv->updated_perf[i] = 0;
+		if (!step->write_perf[i])
+			continue;
+		req = (void *)((rpmi_uint8_t *)priv->fastchan + i * priv->stride);
+		req->passive.desired_perf = rpmi_to_le32(step->write_perf[i]);
+	}
+
+	if (step->ring_doorbell)
+		return rpmi_context_signal_group(scene->cntx, RPMI_SRVGRP_CPPC);
+
+	return 0;
+}
+
+/*
+ * Only the harts whose perf request fastchannel changed since the last
+ * event processing must be updated and get a perf feedback.
+ */
+static int test_fastchan_check(struct rpmi_test_scenario *scene,
+			       struct rpmi_test *test)
+{
+	struct test_cppc_priv *priv = scene->priv;
+	const struct test_fastchan_step *step = test->priv;
+	const rpmi_uint32_t *perf = step->updated_perf;
+	struct rpmi_cppc_perf_feedback_fastchan *fb;
+	rpmi_uint32_t i, changed = 0;
+	rpmi_uint64_t freq;
+
+	for (i = 0; i < TEST_HART_COUNT; i++) {
+		if (priv->updated_perf[i] != perf[i])
+			return RPMI_ERR_FAILED;
+		if (!perf[i])
+			continue;
+		changed++;
+
+		fb = (void *)((rpmi_uint8_t *)priv->fastchan +
+			      priv->feedback_offset + i * priv->stride);
+		freq = ((rpmi_uint64_t)rpmi_to_le32(fb->cur_freq_high) << 32) |
+			rpmi_to_le32(fb->cur_freq_low);
+		if (freq != perf[i] * TEST_FREQ_PER_PERF)
+			return RPMI_ERR_FAILED;
+	}
+
+	return (priv->update_count == changed) ? RPMI_SUCCESS : RPMI_ERR_FAILED;
+}
+
+/* One round of fastchannel writes with frequency domains */
+struct test_domain_step {
+	/* Desired performance written before the event processing */
+	const rpmi_uint32_t *write_perf;
+	/* Aggregated performance expected per domain (0 is not updated) */
+	rpmi_uint32_t domain_perf[2];
+};
+
+/* Hart 2 never requests a performance level so it is ignored */
+static const rpmi_uint32_t domain_perf_all[TEST_HART_COUNT] = { 30, 50, 0, 60 };
+static const rpmi_uint32_t domain_perf_hart1[TEST_HART_COUNT] = { 0, 20, 0, 0 };
+
+static const struct test_domain_step domain_step_max_all = {
+	.write_perf = domain_perf_all,
+	.domain_perf = { 50, 60 },
+};
+
+static const struct test_domain_step domain_step_max_hart1 = {
+	.write_perf = domain_perf_hart1,
+	.domain_perf = { 30, 0 },
+};
+
+static const struct test_domain_step domain_step_min_all = {
+	.write_perf = domain_perf_all,
+	.domain_perf = { 30, 60 },
+};
+
+static const struct test_domain_step domain_step_min_hart1 = {
+	.write_perf = domain_perf_hart1,
+	.domain_perf = { 20, 0 },
+};
+
+static int test_domain_run(struct rpmi_test_scenario *scene,
+			   struct rpmi_test *test, struct rpmi_message *msg)
+{
+	struct test_cppc_priv *priv = scene->priv;
+	const struct test_domain_step *step = test->priv;
+	union rpmi_cppc_perf_request_fastchan *req;
+	rpmi_uint32_t i;
+
+	priv->update_count = 0;
+	priv->domain_update_count = 0;
+	for (i = 0; i < priv->domain_count; i++)
+		priv->domain_perf[i] = 0;
+	for (i = 0; i < TEST_HART_COUNT; i++) {
+		if (!step->write_perf[i])
+			continue;
+		req = (void *)((rpmi_uint8_t *)priv->fastchan + i * priv->stride);
+		req->passive.desired_perf = rpmi_to_le32(step->write_perf[i]);
+	}
+
+	return 0;
+}
+
+/*
+ * Each changed domain must get a single update with the aggregated
+ * performance and its frequency must be reported to all domain harts,
+ * including the ones which did not request a performance level.
+ */
+static int test_domain_check(struct rpmi_test_scenario *scene,
+			     struct rpmi_test *test)
+{
+	struct test_cppc_priv *priv = scene->priv;
+	const struct test_domain_step *step = test->priv;
+	struct rpmi_cppc_perf_feedback_fastchan *fb;
+	rpmi_uint32_t i, domain, updated = 0;
+	rpmi_uint64_t freq;
+
+	if (priv->update_count)
+		return RPMI_ERR_FAILED;
+
+	for (i = 0; i < priv->domain_count; i++) {
+		if (priv->domain_perf[i] != step->domain_perf[i])
+			return RPMI_ERR_FAILED;
+		if (step->domain_perf[i])
+			updated++;
+	}
+
+	for (i = 0; i < TEST_HART_COUNT; i++) {
+		domain = priv->hart_domain[i];
+		if (!step->domain_perf[domain])
+			continue;
+
+		fb = (void *)((rpmi_uint8_t *)priv->fastchan +
+			      priv->feedback_offset + i * priv->stride);
+		freq = ((rpmi_uint64_t)rpmi_to_le32(fb->cur_freq_high) << 32) |
+			rpmi_to_le32(fb->cur_freq_low);
+		if (freq != step->domain_perf[domain] * TEST_FREQ_PER_PERF)
+			return RPMI_ERR_FAILED;
+	}
+
+	return (priv->domain_update_count == updated) ?
+		RPMI_SUCCESS : RPMI_ERR_FAILED;
+}
+
+/* Domains are set once and must cover all harts */
+static int test_domain_set_check(struct rpmi_test_scenario *scene,
+				 struct rpmi_test *test)
+{
+	struct test_cppc_priv *priv = scene->priv;
+	static const rpmi_uint32_t bad_domain[TEST_HART_COUNT] = { 0, 0, 1, 2 };
+
+	if (rpmi_service_group_cppc_set_domains(priv->group, 2, bad_domain,
+						priv->policy) !=
+	    RPMI_ERR_INVALID_PARAM)
+		return RPMI_ERR_FAILED;
+
+	if (rpmi_service_group_cppc_set_domains(priv->group, 2, test_hart_domain,
+						RPMI_CPPC_DOMAIN_POLICY_MAX_IDX) !=
+	    RPMI_ERR_INVALID_PARAM)
+		return RPMI_ERR_FAILED;
+
+	return (rpmi_service_group_cppc_set_domains(priv->group, 2,
+						    test_hart_domain,
+						    priv->policy) ==
+		RPMI_ERR_INVALID_STATE) ? RPMI_SUCCESS : RPMI_ERR_FAILED;
+}
+
+/* Frequency domains need the cppc_update_domain_perf() platform operation */
+static int test_domain_notsupp_check(struct rpmi_test_scenario *scene,
+				     struct rpmi_test *test)
+{
+	struct test_cppc_priv *priv = scene->priv;
+
+	return (rpmi_service_group_cppc_set_domains(priv->group, 2,
+						    test_hart_domain,
+						    RPMI_CPPC_DOMAIN_POLICY_MAX_PERF) ==
+		RPMI_ERR_INVALID_STATE) ? RPMI_SUCCESS : RPMI_ERR_FAILED;
+}
+
+/* Contexts decide whether to poll a group when it is added */
+static int test_doorbell_in_context_check(struct rpmi_test_scenario *scene,
+					  struct rpmi_test *test)
+{
+	struct test_cppc_priv *priv = scene->priv;
+
+	return (rpmi_service_group_cppc_set_doorbell(priv->group,
+				RPMI_CPPC_DOORBELL_WIDTH_32BIT,
+				TEST_DOORBELL_ADDR, TEST_DOORBELL_SET_MASK, 0) ==
+		RPMI_ERR_INVALID_STATE) ? RPMI_SUCCESS : RPMI_ERR_FAILED;
+}
+
+static rpmi_uint16_t test_fastchan_region_expdata(struct rpmi_test_scenario *scene,
+						  struct rpmi_test *test,
+						  void *data, rpmi_uint16_t max_data_len)
+{
+	struct test_cppc_priv *priv = scene->priv;
+	rpmi_uint64_t base = (unsigned long)priv->fastchan;
+	rpmi_uint32_t *exp = data;
+
+	exp[0] = RPMI_SUCCESS;
+	exp[1] = RPMI_CPPC_FAST_CHANNEL_FLAGS_DB_SUPPORTED |
+		 (RPMI_CPPC_DOORBELL_WIDTH_32BIT <<
+		  RPMI_CPPC_FAST_CHANNEL_FLAGS_DB_WIDTH_POS);
+	exp[2] = (rpmi_uint32_t)base;
+	exp[3] = (rpmi_uint32_t)(base >> 32);
+	exp[4] = TEST_FASTCHAN_SZ;
+	exp[5] = 0;
+	exp[6] = (rpmi_uint32_t)TEST_DOORBELL_ADDR;
+	exp[7] = (rpmi_uint32_t)(TEST_DOORBELL_ADDR >> 32);
+	exp[8] = (rpmi_uint32_t)TEST_DOORBELL_SET_MASK;
+	exp[9] = (rpmi_uint32_t)(TEST_DOORBELL_SET_MASK >> 32);
+	exp[10] = 0;
+	exp[11] = 0;
+
+	return 12 * sizeof(*exp);
+}
+
+static const rpmi_uint32_t fastchan_offset_hart1[] = { 1 };
+static const rpmi_uint32_t fastchan_offset_hart3[] = { 3 };
+
+/* Per-hart offsets advertised to the application processors follow the stride */
+static rpmi_uint16_t test_fastchan_offset_expdata(struct rpmi_test_scenario *scene,
+						  struct rpmi_test *test,
+						  void *data, rpmi_uint16_t max_data_len)
+{
+	struct test_cppc_priv *priv = scene->priv;
+	const rpmi_uint32_t *hart_id = test->attrs.request_data;
+	rpmi_uint64_t offset;
+	rpmi_uint32_t *exp = data;
+
+	exp[0] = RPMI_SUCCESS;
+	offset = (rpmi_uint64_t)*hart_id * priv->stride;
+	exp[1] = (rpmi_uint32_t)offset;
+	exp[2] = (rpmi_uint32_t)(offset >> 32);
+	offset += priv->feedback_offset;
+	exp[3] = (rpmi_uint32_t)offset;
+	exp[4] = (rpmi_uint32_t)(offset >> 32);
+
+	return 5 * sizeof(*exp);
+}
+
+#define TEST_FASTCHAN_OFFSET(__name, __reqdata)				\
+	{								\
+		.name = __name,						\
+		.attrs = {						\
+			.servicegroup_id = RPMI_SRVGRP_CPPC,		\
+			.service_id = RPMI_CPPC_SRV_GET_FAST_CHANNEL_OFFSET, \
+			.flags = RPMI_MSG_NORMAL_REQUEST,		\
+			.request_data = __reqdata,			\
+			.request_data_len = sizeof(__reqdata),		\
+		},							\
+		.init_request_data = test_init_request_data_from_attrs,	\
+		.init_expected_data = test_fastchan_offset_expdata,	\
+	}
+
+/*
+ * Strides which are not a power of 2, smaller than an entry or which
+ * do not fit both subregions in the fastchannels must be rejected and
+ * leave the current layout untouched.
+ */
+static int test_fastchan_stride_check(struct rpmi_test_scenario *scene,
+				      struct rpmi_test *test)
+{
+	struct test_cppc_priv *priv = scene->priv;
+	static const rpmi_uint32_t bad_strides[] = {
+		RPMI_CPPC_FASTCHAN_SIZE / 2,
+		3 * RPMI_CPPC_FASTCHAN_SIZE,
+		2 * TEST_MAX_STRIDE,
+		TEST_FASTCHAN_SZ,
+	};
+	rpmi_uint32_t i;
+
+	for (i = 0; i < sizeof(bad_strides) / sizeof(bad_strides[0]); i++) {
+		if (rpmi_service_group_cppc_set_fastchan_stride(priv->group,
+								bad_strides[i]) !=
+		    RPMI_ERR_INVALID_PARAM)
+			return RPMI_ERR_FAILED;
+	}
+
+	return RPMI_SUCCESS;
+}
+
+/*
+ * Subregions which are not aligned to the stride or which overlap once
+ * padded must be rejected even if they were valid for packed entries.
+ */
+static int test_fastchan_layout_check(struct rpmi_test_scenario *scene,
+				      struct rpmi_test *test)
+{
+	struct test_cppc_priv *priv = scene->priv;
+	struct rpmi_service_group *group;
+	enum rpmi_error rc;
+
+	/* Packed entries of all harts fit before the feedback subregion */
+	group = rpmi_service_group_cppc_create(priv->hsm, &test_cppc_regs,
+					       RPMI_CPPC_PASSIVE_MODE,
+					       priv->fastchan_shmem, 0,
+					       TEST_HART_COUNT * RPMI_CPPC_FASTCHAN_SIZE,
+					       &test_cppc_ops, priv);
+	if (!group)
+		return RPMI_ERR_FAILED;
+
+	rc = rpmi_service_group_cppc_set_fastchan_stride(group,
+						LIBRPMI_CACHE_LINE_SIZE);
+	rpmi_service_group_cppc_destroy(group);
+	if (rc != RPMI_ERR_INVALID_PARAM)
+		return RPMI_ERR_FAILED;
+
+	/* Feedback subregion is not aligned to an entry */
+	group = rpmi_service_group_cppc_create(priv->hsm, &test_cppc_regs,
+					       RPMI_CPPC_PASSIVE_MODE,
+					       priv->fastchan_shmem, 0,
+					       TEST_FASTCHAN_SZ / 2 +
+					       RPMI_CPPC_FASTCHAN_SIZE / 2,
+					       &test_cppc_ops, priv);
+	if (group) {
+		rpmi_service_group_cppc_destroy(group);
+		return RPMI_ERR_FAILED;
+	}
+
+	return RPMI_SUCCESS;
+}
+
+static int test_scenario_cppc_cleanup(struct rpmi_test_scenario *scene)
+{
+	struct test_cppc_priv *priv = scene->priv;
+
+	if (scene->cntx) {
+		if (priv->group)
+			rpmi_context_remove_group(scene->cntx, priv->group);
+		rpmi_context_destroy(scene->cntx);
+		scene->cntx = NULL;
+	}
+	if (priv->group) {
+		rpmi_service_group_cppc_destroy(priv->group);
+		priv->group = NULL;
+	}
+	if (priv->fastchan_shmem) {
+		rpmi_shmem_destroy(priv->fastchan_shmem);
+		priv->fastchan_shmem = NULL;
+	}
+	free(priv->fastchan);
+	priv->fastchan = NULL;
+	if (priv->hsm) {
+		rpmi_hsm_destroy(priv->hsm);
+		priv->hsm = NULL;
+	}
+
+	return test_scenario_default_cleanup(scene);
+}
+
+static int test_scenario_cppc_init(struct rpmi_test_scenario *scene)
+{
+	struct test_cppc_priv *priv = scene->priv;
+	int rc;
+
+	rc = test_scenario_default_init(scene);
+	if (rc)
+		return rc;
+
+	priv->hsm = rpmi_hsm_create(TEST_HART_COUNT, test_hart_ids, 0, NULL,
+				    &test_hsm_ops, NULL);
+	if (!priv->hsm)
+		goto fail;
+
+	priv->fastchan = aligned_alloc(TEST_FASTCHAN_SZ, TEST_FASTCHAN_SZ);
+	if (!priv->fastchan)
+		goto fail;
+	memset(priv->fastchan, 0, TEST_FASTCHAN_SZ);
+	priv->fastchan_shmem = rpmi_shmem_create("test_fastchan",
+						 (unsigned long)priv->fastchan,
+						 TEST_FASTCHAN_SZ,
+						 &rpmi_shmem_simple_ops, NULL);
+	if (!priv->fastchan_shmem)
+		goto fail;
+
+	priv->group = rpmi_service_group_cppc_create(priv->hsm, &test_cppc_regs,
+						     RPMI_CPPC_PASSIVE_MODE,
+						     priv->fastchan_shmem,
+						     0, priv->feedback_offset,
+						     priv->domain_count ?
+						     &test_cppc_domain_ops :
+						     &test_cppc_ops, priv);
+	if (!priv->group)
+		goto fail;
+
+	/* Per-hart entries spread over cache lines as set by platforms */
+	if (rpmi_service_group_cppc_set_fastchan_stride(priv->group,
+							priv->stride))
+		goto fail;
+
+	if (priv->domain_count &&
+	    rpmi_service_group_cppc_set_domains(priv->group, priv->domain_count,
+						priv->hart_domain, priv->policy))
+		goto fail;
+
+	if (priv->doorbell &&
+	    rpmi_service_group_cppc_set_doorbell(priv->group,
+						 RPMI_CPPC_DOORBELL_WIDTH_32BIT,
+						 TEST_DOORBELL_ADDR,
+						 TEST_DOORBELL_SET_MASK, 0))
+		goto fail;
+
+	if (rpmi_context_add_group(scene->cntx, priv->group))
+		goto fail;
+
+	return 0;
+
+fail:
+	printf("%s: failed to setup CPPC scenario\n", __func__);
+	test_scenario_cppc_cleanup(scene);
+	return RPMI_ERR_FAILED;
+}
+
+static struct rpmi_test_scenario scenario_cppc_fastchan = {
+	.name = "CPPC Service Group Fastchannels",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = &cppc_priv_polled,
+
+	.init = test_scenario_cppc_init,
+	.cleanup = test_scenario_cppc_cleanup,
+
+	.num_tests = 5,
+	.tests = {
+		{
+			.name = "RPMI_CPPC_FASTCHAN_CHANGED_HARTS",
+			.priv = (void *)&fastchan_step_changed,
+			.run = test_fastchan_run,
+			.check = test_fastchan_check,
+		},
+		{
+			.name = "RPMI_CPPC_FASTCHAN_UNCHANGED_HARTS",
+			.priv = (void *)&fastchan_step_unchanged,
+			.run = test_fastchan_run,
+			.check = test_fastchan_check,
+		},
+		{
+			.name = "RPMI_CPPC_SET_DOMAINS (no domain perf update)",
+			.check = test_domain_notsupp_check,
+		},
+		TEST_FASTCHAN_OFFSET("RPMI_CPPC_SRV_GET_FAST_CHANNEL_OFFSET (hart 1)",
+				     fastchan_offset_hart1),
+		{
+			.name = "RPMI_CPPC_SET_FASTCHAN_STRIDE (overlapping layout)",
+			.check = test_fastchan_layout_check,
+		},
+	},
+};
+
+static struct rpmi_test_scenario scenario_cppc_doorbell = {
+	.name = "CPPC Service Group Fastchannel Doorbell",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = &cppc_priv_doorbell,
+
+	.init = test_scenario_cppc_init,
+	.cleanup = test_scenario_cppc_cleanup,
+
+	.num_tests = 8,
+	.tests = {
+		{
+			.name = "RPMI_CPPC_SRV_GET_FAST_CHANNEL_REGION (doorbell)",
+			.attrs = {
+				.servicegroup_id = RPMI_SRVGRP_CPPC,
+				.service_id = RPMI_CPPC_SRV_GET_FAST_CHANNEL_REGION,
+				.flags = RPMI_MSG_NORMAL_REQUEST,
+			},
+			.init_expected_data = test_fastchan_region_expdata,
+		},
+		TEST_FASTCHAN_OFFSET("RPMI_CPPC_SRV_GET_FAST_CHANNEL_OFFSET (hart 3)",
+				     fastchan_offset_hart3),
+		{
+			.name = "RPMI_CPPC_SET_FASTCHAN_STRIDE (invalid strides)",
+			.check = test_fastchan_stride_check,
+		},
+		TEST_FASTCHAN_OFFSET("RPMI_CPPC_SRV_GET_FAST_CHANNEL_OFFSET (hart 1)",
+				     fastchan_offset_hart1),
+		{
+			.name = "RPMI_CPPC_SET_DOORBELL (group in context)",
+			.check = test_doorbell_in_context_check,
+		},
+		{
+			.name = "RPMI_CPPC_FASTCHAN_DOORBELL_NOT_RUNG",
+			.priv = (void *)&fastchan_step_not_rung,
+			.run = test_fastchan_run,
+			.check = test_fastchan_check,
+		},
+		{
+			.name = "RPMI_CPPC_FASTCHAN_DOORBELL_RUNG",
+			.priv = (void *)&fastchan_step_rung,
+			.run = test_fastchan_run,
+			.check = test_fastchan_check,
+		},
+		{
+			.name = "RPMI_CPPC_FASTCHAN_DOORBELL_RUNG_UNCHANGED",
+			.priv = (void *)&fastchan_step_rung_unchanged,
+			.run = test_fastchan_run,
+			.check = test_fastchan_check,
+		},
+	},
+};
+
+static struct rpmi_test_scenario scenario_cppc_domain_max = {
+	.name = "CPPC Service Group Frequency Domains (max perf)",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = &cppc_priv_domain_max,
+
+	.init = test_scenario_cppc_init,
+	.cleanup = test_scenario_cppc_cleanup,
+
+	.num_tests = 3,
+	.tests = {
+		{
+			.name = "RPMI_CPPC_DOMAIN_ALL_HARTS (max perf)",
+			.priv = (void *)&domain_step_max_all,
+			.run = test_domain_run,
+			.check = test_domain_check,
+		},
+		{
+			.name = "RPMI_CPPC_DOMAIN_ONE_HART (max perf)",
+			.priv = (void *)&domain_step_max_hart1,
+			.run = test_domain_run,
+			.check = test_domain_check,
+		},
+		{
+			.name = "RPMI_CPPC_SET_DOMAINS (invalid and already set)",
+			.check = test_domain_set_check,
+		},
+	},
+};
+
+static struct rpmi_test_scenario scenario_cppc_domain_min = {
+	.name = "CPPC Service Group Frequency Domains (min perf)",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = &cppc_priv_domain_min,
+
+	.init = test_scenario_cppc_init,
+	.cleanup = test_scenario_cppc_cleanup,
+
+	.num_tests = 2,
+	.tests = {
+		{
+			.name = "RPMI_CPPC_DOMAIN_ALL_HARTS (min perf)",
+			.priv = (void *)&domain_step_min_all,
+			.run = test_domain_run,
+			.check = test_domain_check,
+		},
+		{
+			.name = "RPMI_CPPC_DOMAIN_ONE_HART (min perf)",
+			.priv = (void *)&domain_step_min_hart1,
+			.run = test_domain_run,
+			.check = test_domain_check,
+		},
+	},
+};
+
+int main(int argc, char *argv[])
+{
+	int rc;
+
+	printf("Test CPPC Service Group\n");
+
+	/* Execute polled fastchannel scenario */
+	rc = test_scenario_execute(&scenario_cppc_fastchan);
+	if (rc)
+		return rc;
+
+	/* Execute fastchannel doorbell scenario */
+	rc = test_scenario_execute(&scenario_cppc_doorbell);
+	if (rc)
+		return rc;
+
+	/* Execute frequency domain scenarios */
+	rc = test_scenario_execute(&scenario_cppc_domain_max);
+	if (rc)
+		return rc;
+
+	return test_scenario_execute(&scenario_cppc_domain_min);
+}
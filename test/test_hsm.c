@@ -0,0 +1,939 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 Ventana Micro Systems Inc.
+ */
+
+#include <librpmi.h>
+#include <stdio.h>
+#include "test_common.h"
+#include "test_log.h"
+
+#define TEST_CLUSTER_HART_COUNT	3
+#define TEST_HART_COUNT		(2 * TEST_CLUSTER_HART_COUNT)
+
+/* Sparse and unsorted hart IDs of two clusters */
+static const rpmi_uint32_t cluster0_hart_ids[TEST_CLUSTER_HART_COUNT] = { 7, 2, 100 };
+static const rpmi_uint32_t cluster1_hart_ids[TEST_CLUSTER_HART_COUNT] = { 64, 3, 31 };
+
+/* Hart IDs of the non-leaf HSM instance indexed by hart index */
+static const rpmi_uint32_t test_hart_ids[TEST_HART_COUNT] = { 7, 2, 100, 64, 3, 31 };
+
+/* Hart IDs which are not managed by the HSM instance */
+static const rpmi_uint32_t test_missing_hart_ids[] = { 0, 5, 63, 101, 0xfffffffe };
+
+/* Clusters of the paginated list scenario which need more than one message */
+#define TEST_LIST_CLUSTER_HART_COUNT	7
+#define TEST_LIST_HART_COUNT		(2 * TEST_LIST_CLUSTER_HART_COUNT)
+#define TEST_LIST_SUSPEND_TYPE_COUNT	13
+
+/* Entries of a hart list or suspend type list response which fit in one message */
+#define TEST_LIST_MAX_ENTRIES	\
+	((RPMI_MSG_DATA_SIZE(RPMI_SLOT_SIZE) - 3 * sizeof(rpmi_uint32_t)) / sizeof(rpmi_uint32_t))
+
+/* Platform state of the harts of a cluster */
+struct test_hsm_cluster {
+	enum rpmi_hart_hw_state hw_state[TEST_CLUSTER_HART_COUNT];
+	rpmi_uint32_t hw_state_reads;
+	rpmi_uint32_t finalized;
+
+	/* Harts whose single hart prepare reports a HW fault */
+	rpmi_uint32_t prepare_fault_mask;
+	rpmi_uint32_t prepare_calls;
+
+	/* Result and arguments of the multi hart prepare */
+	enum rpmi_error multi_rc;
+	rpmi_uint32_t multi_calls;
+	rpmi_uint32_t multi_mask;
+};
+
+/* Hart IDs and suspend types shared by the clusters of a scenario */
+struct test_hsm_layout {
+	rpmi_uint32_t cluster_hart_count;
+	const rpmi_uint32_t *cluster_hart_ids[2];
+	rpmi_uint32_t suspend_type_count;
+	const struct rpmi_hsm_suspend_type *suspend_types;
+};
+
+struct test_hsm_priv {
+	/* Clusters of the scenario (NULL for the default clusters) */
+	const struct test_hsm_layout *layout;
+
+	/* Platform operations and their private data of each cluster */
+	const struct rpmi_hsm_platform_ops *ops;
+	struct test_hsm_cluster *ops_priv[2];
+
+	struct rpmi_hsm *clusters[2];
+	struct rpmi_hsm *hsm;
+	struct rpmi_service_group *group;
+};
+
+static enum rpmi_hart_hw_state test_hart_get_hw_state(void *priv,
+						      rpmi_uint32_t hart_index)
+{
+	return RPMI_HART_HW_STATE_STARTED;
+}
+
+static const struct rpmi_hsm_platform_ops test_hsm_ops = {
+	.hart_get_hw_state = test_hart_get_hw_state,
+};
+
+static struct test_hsm_priv hsm_priv = {
+	.ops = &test_hsm_ops,
+};
+
+static enum rpmi_hart_hw_state test_cluster_get_hw_state(void *priv,
+							 rpmi_uint32_t hart_index)
+{
+	struct test_hsm_cluster *cluster = priv;
+
+	cluster->hw_state_reads++;
+	return cluster->hw_state[hart_index];
+}
+
+static enum rpmi_error test_cluster_prepare(struct test_hsm_cluster *cluster,
+					    rpmi_uint32_t hart_index)
+{
+	cluster->prepare_calls++;
+
+	return (cluster->prepare_fault_mask & (1U << hart_index)) ?
+					RPMI_ERR_HW_FAULT : RPMI_SUCCESS;
+}
+
+static enum rpmi_error test_cluster_start_prepare(void *priv,
+						  rpmi_uint32_t hart_index,
+						  rpmi_uint64_t start_addr)
+{
+	return test_cluster_prepare(priv, hart_index);
+}
+
+static void test_cluster_start_finalize(void *priv, rpmi_uint32_t hart_index,
+					rpmi_uint64_t start_addr)
+{
+	struct test_hsm_cluster *cluster = priv;
+
+	cluster->finalized++;
+}
+
+static enum rpmi_error test_cluster_stop_prepare(void *priv,
+						 rpmi_uint32_t hart_index)
+{
+	return test_cluster_prepare(priv, hart_index);
+}
+
+static void test_cluster_stop_finalize(void *priv, rpmi_uint32_t hart_index)
+{
+	struct test_hsm_cluster *cluster = priv;
+
+	cluster->finalized++;
+}
+
+static const struct rpmi_hsm_platform_ops test_cluster_ops = {
+	.hart_get_hw_state = test_cluster_get_hw_state,
+	.hart_start_prepare = test_cluster_start_prepare,
+	.hart_start_finalize = test_cluster_start_finalize,
+	.hart_stop_prepare = test_cluster_stop_prepare,
+	.hart_stop_finalize = test_cluster_stop_finalize,
+};
+
+static enum rpmi_error test_cluster_prepare_multi(void *priv,
+						  rpmi_uint32_t base_index,
+						  rpmi_uint32_t hart_mask)
+{
+	struct test_hsm_cluster *cluster = priv;
+
+	cluster->multi_calls++;
+	cluster->multi_mask = hart_mask;
+	return cluster->multi_rc;
+}
+
+static enum rpmi_error test_cluster_start_prepare_multi(void *priv,
+							rpmi_uint32_t base_index,
+							rpmi_uint32_t hart_mask,
+							rpmi_uint64_t start_addr)
+{
+	return test_cluster_prepare_multi(priv, base_index, hart_mask);
+}
+
+static const struct rpmi_hsm_platform_ops test_cluster_multi_ops = {
+	.hart_get_hw_state = test_cluster_get_hw_state,
+	.hart_start_prepare = test_cluster_start_prepare,
+	.hart_start_finalize = test_cluster_start_finalize,
+	.hart_stop_prepare = test_cluster_stop_prepare,
+	.hart_stop_finalize = test_cluster_stop_finalize,
+	.hart_start_prepare_multi = test_cluster_start_prepare_multi,
+	.hart_stop_prepare_multi = test_cluster_prepare_multi,
+};
+
+/* Hart 7 is stopped and hart 31 is suspended initially */
+static struct test_hsm_cluster test_clusters[2] = {
+	{
+		.hw_state = {
+			RPMI_HART_HW_STATE_STOPPED,
+			RPMI_HART_HW_STATE_STARTED,
+			RPMI_HART_HW_STATE_STARTED,
+		},
+	},
+	{
+		.hw_state = {
+			RPMI_HART_HW_STATE_STARTED,
+			RPMI_HART_HW_STATE_STARTED,
+			RPMI_HART_HW_STATE_SUSPENDED,
+		},
+	},
+};
+
+static struct test_hsm_priv hsm_pending_priv = {
+	.ops = &test_cluster_ops,
+	.ops_priv = { &test_clusters[0], &test_clusters[1] },
+};
+
+/*
+ * All harts are stopped initially and the second cluster falls back to
+ * single hart prepare where hart 31 reports a HW fault
+ */
+static struct test_hsm_cluster test_bulk_clusters[2] = {
+	{
+		.multi_rc = RPMI_SUCCESS,
+	},
+	{
+		.prepare_fault_mask = 1U << 2,
+		.multi_rc = RPMI_ERR_NOTSUPP,
+	},
+};
+
+static struct test_hsm_priv hsm_bulk_priv = {
+	.ops = &test_cluster_multi_ops,
+	.ops_priv = { &test_bulk_clusters[0], &test_bulk_clusters[1] },
+};
+
+static const rpmi_uint32_t list_cluster0_hart_ids[TEST_LIST_CLUSTER_HART_COUNT] = {
+	40, 1, 22, 9, 13, 70, 5,
+};
+static const rpmi_uint32_t list_cluster1_hart_ids[TEST_LIST_CLUSTER_HART_COUNT] = {
+	8, 81, 33, 2, 64, 17, 6,
+};
+
+#define TEST_SUSPEND_TYPE(__type)	{ .type = (__type) }
+
+static const struct rpmi_hsm_suspend_type
+list_suspend_types[TEST_LIST_SUSPEND_TYPE_COUNT] = {
+	TEST_SUSPEND_TYPE(0x00000000), TEST_SUSPEND_TYPE(0x00000001),
+	TEST_SUSPEND_TYPE(0x00000002), TEST_SUSPEND_TYPE(0x00000010),
+	TEST_SUSPEND_TYPE(0x00000011), TEST_SUSPEND_TYPE(0x00000012),
+	TEST_SUSPEND_TYPE(0x80000000), TEST_SUSPEND_TYPE(0x80000001),
+	TEST_SUSPEND_TYPE(0x80000002), TEST_SUSPEND_TYPE(0x80000010),
+	TEST_SUSPEND_TYPE(0x80000011), TEST_SUSPEND_TYPE(0x80000012),
+	TEST_SUSPEND_TYPE(0x8fffffff),
+};
+
+static const struct test_hsm_layout hsm_list_layout = {
+	.cluster_hart_count = TEST_LIST_CLUSTER_HART_COUNT,
+	.cluster_hart_ids = { list_cluster0_hart_ids, list_cluster1_hart_ids },
+	.suspend_type_count = TEST_LIST_SUSPEND_TYPE_COUNT,
+	.suspend_types = list_suspend_types,
+};
+
+static struct test_hsm_priv hsm_list_priv = {
+	.layout = &hsm_list_layout,
+	.ops = &test_hsm_ops,
+};
+
+static rpmi_uint32_t hart_status_reqdata_present[] = {
+	100,
+};
+
+static rpmi_uint32_t hart_status_reqdata_last[] = {
+	31,
+};
+
+static rpmi_uint32_t hart_status_expdata_started[] = {
+	RPMI_SUCCESS,
+	RPMI_HSM_HART_STATE_STARTED,
+};
+
+static rpmi_uint32_t hart_status_reqdata_missing[] = {
+	5,
+};
+
+static rpmi_uint32_t hart_status_expdata_missing[] = {
+	RPMI_ERR_INVALID_PARAM,
+	0,
+};
+
+static int test_lookup_check(struct rpmi_test_scenario *scene,
+			     struct rpmi_test *test)
+{
+	struct test_hsm_priv *priv = scene->priv;
+	rpmi_uint32_t i;
+
+	if (rpmi_hsm_hart_count(priv->hsm) != TEST_HART_COUNT)
+		return RPMI_ERR_FAILED;
+
+	for (i = 0; i < TEST_HART_COUNT; i++) {
+		if (rpmi_hsm_hart_id2index(priv->hsm, test_hart_ids[i]) != i ||
+		    rpmi_hsm_hart_index2id(priv->hsm, i) != test_hart_ids[i])
+			return RPMI_ERR_FAILED;
+	}
+
+	for (i = 0; i < sizeof(test_missing_hart_ids) / sizeof(rpmi_uint32_t); i++) {
+		if (rpmi_hsm_hart_id2index(priv->hsm, test_missing_hart_ids[i]) !=
+						LIBRPMI_HSM_INVALID_HART_INDEX)
+			return RPMI_ERR_FAILED;
+	}
+
+	if (rpmi_hsm_hart_index2id(priv->hsm, TEST_HART_COUNT) !=
+						LIBRPMI_HSM_INVALID_HART_ID)
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+/* Duplicate hart IDs within and across clusters */
+static const rpmi_uint32_t dup_cluster0_hart_ids[] = { 9, 5, 9, 1 };
+static const rpmi_uint32_t dup_cluster1_hart_ids[] = { 5, 12 };
+
+/* Lowest hart index of each duplicated hart ID wins as with a linear search */
+static int test_lookup_duplicate_check(struct rpmi_test_scenario *scene,
+				       struct rpmi_test *test)
+{
+	struct rpmi_hsm *clusters[2], *hsm = NULL;
+	int rc = RPMI_ERR_FAILED;
+
+	clusters[0] = rpmi_hsm_create(sizeof(dup_cluster0_hart_ids) / sizeof(rpmi_uint32_t),
+				      dup_cluster0_hart_ids, 0, NULL,
+				      &test_hsm_ops, NULL);
+	clusters[1] = rpmi_hsm_create(sizeof(dup_cluster1_hart_ids) / sizeof(rpmi_uint32_t),
+				      dup_cluster1_hart_ids, 0, NULL,
+				      &test_hsm_ops, NULL);
+	if (!clusters[0] || !clusters[1])
+		goto done;
+
+	if (rpmi_hsm_hart_id2index(clusters[0], 9) != 0 ||
+	    rpmi_hsm_hart_id2index(clusters[0], 5) != 1 ||
+	    rpmi_hsm_hart_id2index(clusters[0], 1) != 3 ||
+	    rpmi_hsm_hart_index2id(clusters[0], 2) != 9)
+		goto done;
+
+	hsm = rpmi_hsm_nonleaf_create(2, clusters);
+	if (!hsm)
+		goto done;
+
+	if (rpmi_hsm_hart_count(hsm) != 6 ||
+	    rpmi_hsm_hart_id2index(hsm, 9) != 0 ||
+	    rpmi_hsm_hart_id2index(hsm, 5) != 1 ||
+	    rpmi_hsm_hart_id2index(hsm, 1) != 3 ||
+	    rpmi_hsm_hart_id2index(hsm, 12) != 5 ||
+	    rpmi_hsm_hart_index2id(hsm, 4) != 5)
+		goto done;
+
+	rc = RPMI_SUCCESS;
+
+done:
+	if (hsm)
+		rpmi_hsm_destroy(hsm);
+	if (clusters[1])
+		rpmi_hsm_destroy(clusters[1]);
+	if (clusters[0])
+		rpmi_hsm_destroy(clusters[0]);
+	return rc;
+}
+
+/* Synchronize with HW state and return the HW state reads of each cluster */
+static void test_pending_process(struct test_hsm_priv *priv,
+				 rpmi_uint32_t *reads)
+{
+	rpmi_uint32_t i;
+
+	for (i = 0; i < 2; i++)
+		priv->ops_priv[i]->hw_state_reads = 0;
+
+	rpmi_hsm_process_state_changes(priv->hsm);
+
+	for (i = 0; i < 2; i++)
+		reads[i] = priv->ops_priv[i]->hw_state_reads;
+}
+
+static int test_pending_initial_check(struct rpmi_test_scenario *scene,
+				      struct rpmi_test *test)
+{
+	struct test_hsm_priv *priv = scene->priv;
+	rpmi_uint32_t reads[2];
+
+	/* Initial state of each hart was derived from the HW state */
+	if (rpmi_hsm_get_hart_state(priv->hsm, 7) != RPMI_HSM_HART_STATE_STOPPED ||
+	    rpmi_hsm_get_hart_state(priv->hsm, 2) != RPMI_HSM_HART_STATE_STARTED ||
+	    rpmi_hsm_get_hart_state(priv->hsm, 31) != RPMI_HSM_HART_STATE_SUSPENDED)
+		return RPMI_ERR_FAILED;
+
+	/* Only the suspended hart waits for a HW state change */
+	if (rpmi_hsm_state_changes_pending(priv->clusters[0]) ||
+	    !rpmi_hsm_state_changes_pending(priv->clusters[1]))
+		return RPMI_ERR_FAILED;
+
+	test_pending_process(priv, reads);
+	if (reads[0] || reads[1] != 1)
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static int test_pending_notify_check(struct rpmi_test_scenario *scene,
+				     struct rpmi_test *test)
+{
+	struct test_hsm_priv *priv = scene->priv;
+	rpmi_uint32_t reads[2];
+
+	/* Notified steady hart is checked once */
+	if (rpmi_hsm_notify_hw_state_change(priv->hsm, 1) ||
+	    !rpmi_hsm_state_changes_pending(priv->clusters[0]))
+		return RPMI_ERR_FAILED;
+
+	test_pending_process(priv, reads);
+	if (reads[0] != 1 || rpmi_hsm_state_changes_pending(priv->clusters[0]))
+		return RPMI_ERR_FAILED;
+
+	test_pending_process(priv, reads);
+	if (reads[0])
+		return RPMI_ERR_FAILED;
+
+	if (rpmi_hsm_notify_hw_state_change(priv->hsm, TEST_HART_COUNT) !=
+							RPMI_ERR_INVALID_PARAM)
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static int test_pending_start_check(struct rpmi_test_scenario *scene,
+				    struct rpmi_test *test)
+{
+	struct test_hsm_priv *priv = scene->priv;
+	struct test_hsm_cluster *cluster = priv->ops_priv[0];
+	rpmi_uint32_t reads[2];
+
+	cluster->finalized = 0;
+	if (rpmi_hsm_hart_start(priv->hsm, 7, 0x80000000) ||
+	    rpmi_hsm_get_hart_state(priv->hsm, 7) != RPMI_HSM_HART_STATE_START_PENDING)
+		return RPMI_ERR_FAILED;
+
+	/* Hart is checked until the HW state changes */
+	test_pending_process(priv, reads);
+	if (reads[0] != 1 || !rpmi_hsm_state_changes_pending(priv->clusters[0]))
+		return RPMI_ERR_FAILED;
+
+	cluster->hw_state[0] = RPMI_HART_HW_STATE_STARTED;
+	test_pending_process(priv, reads);
+	if (reads[0] != 1 || cluster->finalized != 1 ||
+	    rpmi_hsm_get_hart_state(priv->hsm, 7) != RPMI_HSM_HART_STATE_STARTED ||
+	    rpmi_hsm_state_changes_pending(priv->clusters[0]))
+		return RPMI_ERR_FAILED;
+
+	test_pending_process(priv, reads);
+	if (reads[0])
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static int test_pending_stop_check(struct rpmi_test_scenario *scene,
+				   struct rpmi_test *test)
+{
+	struct test_hsm_priv *priv = scene->priv;
+	struct test_hsm_cluster *cluster = priv->ops_priv[1];
+	rpmi_uint32_t reads[2];
+
+	/* Suspended hart resumes once the HW state changes */
+	cluster->hw_state[2] = RPMI_HART_HW_STATE_STARTED;
+	test_pending_process(priv, reads);
+	if (reads[1] != 1 ||
+	    rpmi_hsm_get_hart_state(priv->hsm, 31) != RPMI_HSM_HART_STATE_STARTED ||
+	    rpmi_hsm_state_changes_pending(priv->hsm))
+		return RPMI_ERR_FAILED;
+
+	cluster->finalized = 0;
+	if (rpmi_hsm_hart_stop(priv->hsm, 64) ||
+	    rpmi_hsm_get_hart_state(priv->hsm, 64) != RPMI_HSM_HART_STATE_STOP_PENDING ||
+	    !rpmi_hsm_state_changes_pending(priv->hsm))
+		return RPMI_ERR_FAILED;
+
+	cluster->hw_state[0] = RPMI_HART_HW_STATE_STOPPED;
+	test_pending_process(priv, reads);
+	if (reads[1] != 1 || cluster->finalized != 1 ||
+	    rpmi_hsm_get_hart_state(priv->hsm, 64) != RPMI_HSM_HART_STATE_STOPPED ||
+	    rpmi_hsm_state_changes_pending(priv->hsm))
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+/* Check the state of the harts of a mask (hart indexes 0 to 31 only) */
+static int test_bulk_expect(struct test_hsm_priv *priv, rpmi_uint32_t mask,
+			    enum rpmi_hsm_hart_state state)
+{
+	rpmi_uint32_t snapshot;
+
+	if (rpmi_hsm_harts_state_snapshot(priv->hsm, 0, TEST_HART_COUNT,
+					  state, &snapshot) ||
+	    snapshot != mask)
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+/* Set the HW state of harts of a mask and synchronize with it */
+static void test_bulk_set_hw_state(struct test_hsm_priv *priv,
+				   rpmi_uint32_t mask,
+				   enum rpmi_hart_hw_state hw_state)
+{
+	rpmi_uint32_t i;
+
+	for (i = 0; i < TEST_HART_COUNT; i++) {
+		if (mask & (1U << i))
+			priv->ops_priv[i / TEST_CLUSTER_HART_COUNT]->hw_state[
+					i % TEST_CLUSTER_HART_COUNT] = hw_state;
+	}
+
+	rpmi_hsm_process_state_changes(priv->hsm);
+}
+
+static void test_bulk_reset_calls(struct test_hsm_priv *priv)
+{
+	rpmi_uint32_t i;
+
+	for (i = 0; i < 2; i++) {
+		priv->ops_priv[i]->prepare_calls = 0;
+		priv->ops_priv[i]->multi_calls = 0;
+		priv->ops_priv[i]->multi_mask = 0;
+	}
+}
+
+static int test_bulk_snapshot_check(struct rpmi_test_scenario *scene,
+				    struct rpmi_test *test)
+{
+	struct test_hsm_priv *priv = scene->priv;
+	rpmi_uint32_t snapshot;
+
+	if (test_bulk_expect(priv, 0x3f, RPMI_HSM_HART_STATE_STOPPED) ||
+	    test_bulk_expect(priv, 0, RPMI_HSM_HART_STATE_STARTED))
+		return RPMI_ERR_FAILED;
+
+	/* Bit N of the snapshot is the hart (start_index + N) */
+	if (rpmi_hsm_harts_state_snapshot(priv->hsm, 4, 2,
+					  RPMI_HSM_HART_STATE_STOPPED, &snapshot) ||
+	    snapshot != 0x3)
+		return RPMI_ERR_FAILED;
+
+	if (rpmi_hsm_harts_state_snapshot(priv->hsm, TEST_HART_COUNT, 0,
+					  RPMI_HSM_HART_STATE_STOPPED, &snapshot) ||
+	    snapshot)
+		return RPMI_ERR_FAILED;
+
+	if (rpmi_hsm_harts_state_snapshot(priv->hsm, 5, 2,
+					  RPMI_HSM_HART_STATE_STOPPED, &snapshot) !=
+							RPMI_ERR_INVALID_PARAM ||
+	    rpmi_hsm_harts_state_snapshot(priv->hsm, 0, 33,
+					  RPMI_HSM_HART_STATE_STOPPED, &snapshot) !=
+							RPMI_ERR_INVALID_PARAM)
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static int test_bulk_start_check(struct rpmi_test_scenario *scene,
+				 struct rpmi_test *test)
+{
+	struct test_hsm_priv *priv = scene->priv;
+	struct test_hsm_cluster *c0 = priv->ops_priv[0], *c1 = priv->ops_priv[1];
+	rpmi_uint32_t mask = 0x2d, fail_mask = 0;
+
+	test_bulk_reset_calls(priv);
+	if (rpmi_hsm_harts_start_mask(priv->hsm, &mask, 0x80000000,
+				      &fail_mask) != RPMI_ERR_HW_FAULT)
+		return RPMI_ERR_FAILED;
+
+	/*
+	 * First cluster is prepared with one call and the second cluster
+	 * falls back to single hart prepare where the fault of its last
+	 * hart maps to hart index 5
+	 */
+	if (c0->multi_calls != 1 || c0->multi_mask != 0x5 || c0->prepare_calls ||
+	    c1->multi_calls != 1 || c1->multi_mask != 0x5 || c1->prepare_calls != 2 ||
+	    fail_mask != 0x20)
+		return RPMI_ERR_FAILED;
+
+	if (test_bulk_expect(priv, 0x0d, RPMI_HSM_HART_STATE_START_PENDING) ||
+	    test_bulk_expect(priv, 0x32, RPMI_HSM_HART_STATE_STOPPED))
+		return RPMI_ERR_FAILED;
+
+	test_bulk_set_hw_state(priv, 0x0d, RPMI_HART_HW_STATE_STARTED);
+	return test_bulk_expect(priv, 0x0d, RPMI_HSM_HART_STATE_STARTED);
+}
+
+static int test_bulk_start_already_check(struct rpmi_test_scenario *scene,
+					 struct rpmi_test *test)
+{
+	struct test_hsm_priv *priv = scene->priv;
+	rpmi_uint32_t mask = 0x3, fail_mask = 0;
+
+	/* Started hart is reported without affecting the other harts */
+	test_bulk_reset_calls(priv);
+	if (rpmi_hsm_harts_start_mask(priv->hsm, &mask, 0x80000000,
+				      &fail_mask) != RPMI_ERR_ALREADY ||
+	    fail_mask != 0x1 || priv->ops_priv[0]->multi_mask != 0x2)
+		return RPMI_ERR_FAILED;
+
+	test_bulk_set_hw_state(priv, 0x2, RPMI_HART_HW_STATE_STARTED);
+	return test_bulk_expect(priv, 0x0f, RPMI_HSM_HART_STATE_STARTED);
+}
+
+static int test_bulk_stop_check(struct rpmi_test_scenario *scene,
+				struct rpmi_test *test)
+{
+	struct test_hsm_priv *priv = scene->priv;
+	rpmi_uint32_t mask = 0x7, fail_mask = 0;
+
+	/* Failed multi hart prepare leaves all harts of the call as is */
+	test_bulk_reset_calls(priv);
+	priv->ops_priv[0]->multi_rc = RPMI_ERR_HW_FAULT;
+	if (rpmi_hsm_harts_stop_mask(priv->hsm, &mask, &fail_mask) !=
+							RPMI_ERR_HW_FAULT ||
+	    fail_mask != 0x7 || priv->ops_priv[0]->prepare_calls ||
+	    test_bulk_expect(priv, 0x0f, RPMI_HSM_HART_STATE_STARTED))
+		return RPMI_ERR_FAILED;
+
+	/* Stopped harts are reported without affecting the other harts */
+	priv->ops_priv[0]->multi_rc = RPMI_SUCCESS;
+	mask = 0x3f;
+	if (rpmi_hsm_harts_stop_mask(priv->hsm, &mask, &fail_mask) !=
+							RPMI_ERR_ALREADY ||
+	    fail_mask != 0x30 ||
+	    test_bulk_expect(priv, 0x0f, RPMI_HSM_HART_STATE_STOP_PENDING))
+		return RPMI_ERR_FAILED;
+
+	test_bulk_set_hw_state(priv, 0x0f, RPMI_HART_HW_STATE_STOPPED);
+	return test_bulk_expect(priv, 0x3f, RPMI_HSM_HART_STATE_STOPPED);
+}
+
+static const rpmi_uint32_t list_reqdata_first[] = { 0 };
+static const rpmi_uint32_t list_reqdata_middle[] = { 5 };
+static const rpmi_uint32_t list_reqdata_next[] = { TEST_LIST_MAX_ENTRIES };
+static const rpmi_uint32_t list_reqdata_hart_end[] = { TEST_LIST_HART_COUNT };
+static const rpmi_uint32_t list_reqdata_hart_past[] = { TEST_LIST_HART_COUNT + 1 };
+static const rpmi_uint32_t list_reqdata_type_last[] = { TEST_LIST_SUSPEND_TYPE_COUNT - 1 };
+static const rpmi_uint32_t list_reqdata_type_past[] = { TEST_LIST_SUSPEND_TYPE_COUNT + 1 };
+
+/*
+ * Page of the hart list or suspend type list starting at the requested
+ * index where the hart IDs are ordered by hart index across the clusters
+ */
+static rpmi_uint16_t test_list_expdata(struct rpmi_test_scenario *scene,
+				       struct rpmi_test *test,
+				       void *data, rpmi_uint16_t max_data_len)
+{
+	const struct test_hsm_layout *layout = ((struct test_hsm_priv *)scene->priv)->layout;
+	rpmi_uint32_t start = *(const rpmi_uint32_t *)test->attrs.request_data;
+	rpmi_uint32_t i, count, returned, n = layout->cluster_hart_count;
+	rpmi_uint32_t *exp = data;
+
+	if (test->attrs.service_id == RPMI_HSM_SRV_GET_HART_LIST)
+		count = 2 * n;
+	else
+		count = layout->suspend_type_count;
+
+	if (start > count) {
+		exp[0] = (rpmi_uint32_t)RPMI_ERR_INVALID_PARAM;
+		exp[1] = count;
+		exp[2] = 0;
+		return 3 * sizeof(*exp);
+	}
+
+	returned = count - start;
+	if (returned > TEST_LIST_MAX_ENTRIES)
+		returned = TEST_LIST_MAX_ENTRIES;
+
+	exp[0] = RPMI_SUCCESS;
+	exp[1] = count - (start + returned);
+	exp[2] = returned;
+	for (i = start; i < start + returned; i++) {
+		if (test->attrs.service_id != RPMI_HSM_SRV_GET_HART_LIST)
+			exp[3 + i - start] = layout->suspend_types[i].type;
+		else if (i < n)
+			exp[3 + i - start] = layout->cluster_hart_ids[0][i];
+		else
+			exp[3 + i - start] = layout->cluster_hart_ids[1][i - n];
+	}
+
+	return (3 + returned) * sizeof(*exp);
+}
+
+#define TEST_HSM_LIST(__name, __srv, __reqdata)				\
+	{								\
+		.name = __name,						\
+		.attrs = {						\
+			.servicegroup_id = RPMI_SRVGRP_HSM,		\
+			.service_id = __srv,				\
+			.flags = RPMI_MSG_NORMAL_REQUEST,		\
+			.request_data = __reqdata,			\
+			.request_data_len = sizeof(__reqdata),		\
+		},							\
+		.init_request_data = test_init_request_data_from_attrs,	\
+		.init_expected_data = test_list_expdata,		\
+	}
+
+static int test_scenario_hsm_cleanup(struct rpmi_test_scenario *scene)
+{
+	struct test_hsm_priv *priv = scene->priv;
+	int i;
+
+	if (scene->cntx) {
+		if (priv->group)
+			rpmi_context_remove_group(scene->cntx, priv->group);
+		rpmi_context_destroy(scene->cntx);
+		scene->cntx = NULL;
+	}
+	if (priv->group) {
+		rpmi_service_group_hsm_destroy(priv->group);
+		priv->group = NULL;
+	}
+	if (priv->hsm) {
+		rpmi_hsm_destroy(priv->hsm);
+		priv->hsm = NULL;
+	}
+	for (i = 0; i < 2; i++) {
+		if (priv->clusters[i]) {
+			rpmi_hsm_destroy(priv->clusters[i]);
+			priv->clusters[i] = NULL;
+		}
+	}
+
+	return test_scenario_default_cleanup(scene);
+}
+
+static int test_scenario_hsm_init(struct rpmi_test_scenario *scene)
+{
+	static const struct test_hsm_layout default_layout = {
+		.cluster_hart_count = TEST_CLUSTER_HART_COUNT,
+		.cluster_hart_ids = { cluster0_hart_ids, cluster1_hart_ids },
+	};
+	struct test_hsm_priv *priv = scene->priv;
+	const struct test_hsm_layout *layout;
+	int rc, i;
+
+	rc = test_scenario_default_init(scene);
+	if (rc)
+		return rc;
+
+	layout = priv->layout ? priv->layout : &default_layout;
+	for (i = 0; i < 2; i++) {
+		priv->clusters[i] = rpmi_hsm_create(layout->cluster_hart_count,
+						    layout->cluster_hart_ids[i],
+						    layout->suspend_type_count,
+						    layout->suspend_types,
+						    priv->ops, priv->ops_priv[i]);
+		if (!priv->clusters[i])
+			goto fail;
+	}
+
+	priv->hsm = rpmi_hsm_nonleaf_create(2, priv->clusters);
+	if (!priv->hsm)
+		goto fail;
+
+	priv->group = rpmi_service_group_hsm_create(priv->hsm);
+	if (!priv->group)
+		goto fail;
+
+	if (rpmi_context_add_group(scene->cntx, priv->group))
+		goto fail;
+
+	return 0;
+
+fail:
+	printf("%s: failed to setup HSM scenario\n", __func__);
+	test_scenario_hsm_cleanup(scene);
+	return RPMI_ERR_FAILED;
+}
+
+static struct rpmi_test_scenario scenario_hsm_sparse = {
+	.name = "HSM Service Group Sparse Hart IDs",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = &hsm_priv,
+
+	.init = test_scenario_hsm_init,
+	.cleanup = test_scenario_hsm_cleanup,
+
+	.num_tests = 5,
+	.tests = {
+		{
+			.name = "RPMI_HSM_HART_ID_TO_INDEX",
+			.check = test_lookup_check,
+		},
+		{
+			.name = "RPMI_HSM_HART_ID_TO_INDEX (duplicate hart IDs)",
+			.check = test_lookup_duplicate_check,
+		},
+		{
+			.name = "RPMI_HSM_SRV_GET_HART_STATUS",
+			.attrs = {
+				.servicegroup_id = RPMI_SRVGRP_HSM,
+				.service_id = RPMI_HSM_SRV_GET_HART_STATUS,
+				.flags = RPMI_MSG_NORMAL_REQUEST,
+				.request_data = hart_status_reqdata_present,
+				.request_data_len = sizeof(hart_status_reqdata_present),
+				.expected_data = hart_status_expdata_started,
+				.expected_data_len = sizeof(hart_status_expdata_started),
+			},
+			.init_request_data = test_init_request_data_from_attrs,
+			.init_expected_data = test_init_expected_data_from_attrs,
+		},
+		{
+			.name = "RPMI_HSM_SRV_GET_HART_STATUS (last child hart)",
+			.attrs = {
+				.servicegroup_id = RPMI_SRVGRP_HSM,
+				.service_id = RPMI_HSM_SRV_GET_HART_STATUS,
+				.flags = RPMI_MSG_NORMAL_REQUEST,
+				.request_data = hart_status_reqdata_last,
+				.request_data_len = sizeof(hart_status_reqdata_last),
+				.expected_data = hart_status_expdata_started,
+				.expected_data_len = sizeof(hart_status_expdata_started),
+			},
+			.init_request_data = test_init_request_data_from_attrs,
+			.init_expected_data = test_init_expected_data_from_attrs,
+		},
+		{
+			.name = "RPMI_HSM_SRV_GET_HART_STATUS (missing hart)",
+			.attrs = {
+				.servicegroup_id = RPMI_SRVGRP_HSM,
+				.service_id = RPMI_HSM_SRV_GET_HART_STATUS,
+				.flags = RPMI_MSG_NORMAL_REQUEST,
+				.request_data = hart_status_reqdata_missing,
+				.request_data_len = sizeof(hart_status_reqdata_missing),
+				.expected_data = hart_status_expdata_missing,
+				.expected_data_len = sizeof(hart_status_expdata_missing),
+			},
+			.init_request_data = test_init_request_data_from_attrs,
+			.init_expected_data = test_init_expected_data_from_attrs,
+		},
+	},
+};
+
+static struct rpmi_test_scenario scenario_hsm_pending = {
+	.name = "HSM Service Group Pending Harts",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = &hsm_pending_priv,
+
+	.init = test_scenario_hsm_init,
+	.cleanup = test_scenario_hsm_cleanup,
+
+	.num_tests = 4,
+	.tests = {
+		{
+			.name = "RPMI_HSM_PENDING_INITIAL",
+			.check = test_pending_initial_check,
+		},
+		{
+			.name = "RPMI_HSM_PENDING_NOTIFY",
+			.check = test_pending_notify_check,
+		},
+		{
+			.name = "RPMI_HSM_PENDING_START",
+			.check = test_pending_start_check,
+		},
+		{
+			.name = "RPMI_HSM_PENDING_RESUME_AND_STOP",
+			.check = test_pending_stop_check,
+		},
+	},
+};
+
+static struct rpmi_test_scenario scenario_hsm_bulk = {
+	.name = "HSM Service Group Bulk Operations",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = &hsm_bulk_priv,
+
+	.init = test_scenario_hsm_init,
+	.cleanup = test_scenario_hsm_cleanup,
+
+	.num_tests = 4,
+	.tests = {
+		{
+			.name = "RPMI_HSM_HARTS_STATE_SNAPSHOT",
+			.check = test_bulk_snapshot_check,
+		},
+		{
+			.name = "RPMI_HSM_HARTS_START_MASK",
+			.check = test_bulk_start_check,
+		},
+		{
+			.name = "RPMI_HSM_HARTS_START_MASK (already started)",
+			.check = test_bulk_start_already_check,
+		},
+		{
+			.name = "RPMI_HSM_HARTS_STOP_MASK",
+			.check = test_bulk_stop_check,
+		},
+	},
+};
+
+static struct rpmi_test_scenario scenario_hsm_list = {
+	.name = "HSM Service Group Paginated Lists",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = &hsm_list_priv,
+
+	.init = test_scenario_hsm_init,
+	.cleanup = test_scenario_hsm_cleanup,
+
+	.num_tests = 9,
+	.tests = {
+		TEST_HSM_LIST("RPMI_HSM_SRV_GET_HART_LIST (first page)",
+			      RPMI_HSM_SRV_GET_HART_LIST, list_reqdata_first),
+		TEST_HSM_LIST("RPMI_HSM_SRV_GET_HART_LIST (next page)",
+			      RPMI_HSM_SRV_GET_HART_LIST, list_reqdata_next),
+		TEST_HSM_LIST("RPMI_HSM_SRV_GET_HART_LIST (across clusters)",
+			      RPMI_HSM_SRV_GET_HART_LIST, list_reqdata_middle),
+		TEST_HSM_LIST("RPMI_HSM_SRV_GET_HART_LIST (end of list)",
+			      RPMI_HSM_SRV_GET_HART_LIST, list_reqdata_hart_end),
+		TEST_HSM_LIST("RPMI_HSM_SRV_GET_HART_LIST (past the end)",
+			      RPMI_HSM_SRV_GET_HART_LIST, list_reqdata_hart_past),
+		TEST_HSM_LIST("RPMI_HSM_SRV_GET_SUSPEND_TYPES (first page)",
+			      RPMI_HSM_SRV_GET_SUSPEND_TYPES, list_reqdata_first),
+		TEST_HSM_LIST("RPMI_HSM_SRV_GET_SUSPEND_TYPES (next page)",
+			      RPMI_HSM_SRV_GET_SUSPEND_TYPES, list_reqdata_next),
+		TEST_HSM_LIST("RPMI_HSM_SRV_GET_SUSPEND_TYPES (last type)",
+			      RPMI_HSM_SRV_GET_SUSPEND_TYPES, list_reqdata_type_last),
+		TEST_HSM_LIST("RPMI_HSM_SRV_GET_SUSPEND_TYPES (past the end)",
+			      RPMI_HSM_SRV_GET_SUSPEND_TYPES, list_reqdata_type_past),
+	},
+};
+
+int main(int argc, char *argv[])
+{
+	int rc;
+
+	printf("Test HSM Service Group\n");
+
+	/* Execute sparse hart ID scenario */
+	rc = test_scenario_execute(&scenario_hsm_sparse);
+	if (rc)
+		return rc;
+
+	/* Execute pending harts scenario */
+	rc = test_scenario_execute(&scenario_hsm_pending);
+	if (rc)
+		return rc;
+
+	/* Execute bulk operations scenario */
+	rc = test_scenario_execute(&scenario_hsm_bulk);
+	if (rc)
+		return rc;
+
+	/* Execute paginated lists scenario */
+	return test_scenario_execute(&scenario_hsm_list);
+}
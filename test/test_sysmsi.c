@@ -0,0 +1,253 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 Ventana Micro Systems Inc.
+ */
+
+#include <librpmi.h>
+#include <stdio.h>
+#include "test_common.h"
+#include "test_log.h"
+
+#define TEST_MSI_COUNT		2
+
+/* MSI data written to the target of each system MSI */
+static const rpmi_uint32_t test_msi_data[TEST_MSI_COUNT] = { 0x11, 0x22 };
+
+struct test_sysmsi_priv {
+	struct rpmi_service_group *group;
+
+	/* MSI target memory written by rpmi_env_writel() */
+	volatile rpmi_uint32_t msi_mem[TEST_MSI_COUNT];
+};
+
+static struct test_sysmsi_priv sysmsi_priv;
+
+static rpmi_bool_t test_validate_msi_addr(void *priv, rpmi_uint64_t msi_addr)
+{
+	return true;
+}
+
+static const struct rpmi_sysmsi_platform_ops test_sysmsi_ops = {
+	.validate_msi_addr = test_validate_msi_addr,
+};
+
+static rpmi_uint16_t test_set_target_reqdata(struct rpmi_test_scenario *scene,
+					     struct rpmi_test *test,
+					     void *data, rpmi_uint16_t max_data_len)
+{
+	struct test_sysmsi_priv *priv = scene->priv;
+	rpmi_uint32_t msi_index = (unsigned long)test->priv;
+	rpmi_uint64_t addr = (unsigned long)&priv->msi_mem[msi_index];
+	rpmi_uint32_t *req = data;
+
+	req[0] = msi_index;
+	req[1] = (rpmi_uint32_t)addr;
+	req[2] = (rpmi_uint32_t)(addr >> 32);
+	req[3] = test_msi_data[msi_index];
+
+	return 4 * sizeof(*req);
+}
+
+static rpmi_uint32_t set_state_reqdata_msi0[] = {
+	0,
+	RPMI_SYSMSI_MSI_STATE_ENABLE,
+};
+
+static rpmi_uint32_t set_state_reqdata_msi1[] = {
+	1,
+	RPMI_SYSMSI_MSI_STATE_ENABLE,
+};
+
+static rpmi_uint32_t status_expdata_success[] = {
+	RPMI_SUCCESS,
+};
+
+/* MSI data delivered to MSI 1 by enabling it */
+static rpmi_uint32_t delivered_msi1;
+
+/* Inject the disabled MSI 1 and then the enabled MSI 0 */
+static int test_inject_run(struct rpmi_test_scenario *scene,
+			   struct rpmi_test *test, struct rpmi_message *msg)
+{
+	struct test_sysmsi_priv *priv = scene->priv;
+
+	priv->msi_mem[0] = 0;
+	priv->msi_mem[1] = 0;
+	if (rpmi_service_group_sysmsi_inject(priv->group, 1) ||
+	    rpmi_service_group_sysmsi_inject(priv->group, 0))
+		return RPMI_ERR_FAILED;
+
+	return 0;
+}
+
+/* Only the enabled MSI is delivered and the disabled one stays pending */
+static int test_inject_check(struct rpmi_test_scenario *scene,
+			     struct rpmi_test *test)
+{
+	struct test_sysmsi_priv *priv = scene->priv;
+	int rc = RPMI_SUCCESS;
+
+	if (priv->msi_mem[0] != test_msi_data[0] || priv->msi_mem[1])
+		rc = RPMI_ERR_FAILED;
+	priv->msi_mem[0] = 0;
+
+	return rc;
+}
+
+/* Take the MSI delivered by enabling MSI 1 before processing again */
+static int test_pending_run(struct rpmi_test_scenario *scene,
+			    struct rpmi_test *test, struct rpmi_message *msg)
+{
+	struct test_sysmsi_priv *priv = scene->priv;
+
+	delivered_msi1 = priv->msi_mem[1];
+	priv->msi_mem[1] = 0;
+
+	return 0;
+}
+
+/* Pending MSI delivered once on enable and never again */
+static int test_pending_check(struct rpmi_test_scenario *scene,
+			      struct rpmi_test *test)
+{
+	struct test_sysmsi_priv *priv = scene->priv;
+
+	if (delivered_msi1 != test_msi_data[1] ||
+	    priv->msi_mem[0] || priv->msi_mem[1])
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static int test_scenario_sysmsi_cleanup(struct rpmi_test_scenario *scene)
+{
+	struct test_sysmsi_priv *priv = scene->priv;
+
+	if (scene->cntx) {
+		if (priv->group)
+			rpmi_context_remove_group(scene->cntx, priv->group);
+		rpmi_context_destroy(scene->cntx);
+		scene->cntx = NULL;
+	}
+	if (priv->group) {
+		rpmi_service_group_sysmsi_destroy(priv->group);
+		priv->group = NULL;
+	}
+
+	return test_scenario_default_cleanup(scene);
+}
+
+static int test_scenario_sysmsi_init(struct rpmi_test_scenario *scene)
+{
+	struct test_sysmsi_priv *priv = scene->priv;
+	int rc;
+
+	rc = test_scenario_default_init(scene);
+	if (rc)
+		return rc;
+
+	/* No P2A doorbell system MSI */
+	priv->group = rpmi_service_group_sysmsi_create(TEST_MSI_COUNT,
+						       TEST_MSI_COUNT,
+						       &test_sysmsi_ops, NULL);
+	if (!priv->group)
+		goto fail;
+
+	if (rpmi_context_add_group(scene->cntx, priv->group))
+		goto fail;
+
+	return 0;
+
+fail:
+	printf("%s: failed to setup system MSI scenario\n", __func__);
+	test_scenario_sysmsi_cleanup(scene);
+	return RPMI_ERR_FAILED;
+}
+
+static struct rpmi_test_scenario scenario_sysmsi_pending = {
+	.name = "System MSI Service Group Pending MSIs",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = &sysmsi_priv,
+
+	.init = test_scenario_sysmsi_init,
+	.cleanup = test_scenario_sysmsi_cleanup,
+
+	.num_tests = 6,
+	.tests = {
+		{
+			.name = "RPMI_SYSMSI_SRV_SET_MSI_TARGET (MSI 0)",
+			.attrs = {
+				.servicegroup_id = RPMI_SRVGRP_SYSTEM_MSI,
+				.service_id = RPMI_SYSMSI_SRV_SET_MSI_TARGET,
+				.flags = RPMI_MSG_NORMAL_REQUEST,
+				.expected_data = status_expdata_success,
+				.expected_data_len = sizeof(status_expdata_success),
+			},
+			.priv = (void *)0UL,
+			.init_request_data = test_set_target_reqdata,
+			.init_expected_data = test_init_expected_data_from_attrs,
+		},
+		{
+			.name = "RPMI_SYSMSI_SRV_SET_MSI_TARGET (MSI 1)",
+			.attrs = {
+				.servicegroup_id = RPMI_SRVGRP_SYSTEM_MSI,
+				.service_id = RPMI_SYSMSI_SRV_SET_MSI_TARGET,
+				.flags = RPMI_MSG_NORMAL_REQUEST,
+				.expected_data = status_expdata_success,
+				.expected_data_len = sizeof(status_expdata_success),
+			},
+			.priv = (void *)1UL,
+			.init_request_data = test_set_target_reqdata,
+			.init_expected_data = test_init_expected_data_from_attrs,
+		},
+		{
+			.name = "RPMI_SYSMSI_SRV_SET_MSI_STATE (enable MSI 0)",
+			.attrs = {
+				.servicegroup_id = RPMI_SRVGRP_SYSTEM_MSI,
+				.service_id = RPMI_SYSMSI_SRV_SET_MSI_STATE,
+				.flags = RPMI_MSG_NORMAL_REQUEST,
+				.request_data = set_state_reqdata_msi0,
+				.request_data_len = sizeof(set_state_reqdata_msi0),
+				.expected_data = status_expdata_success,
+				.expected_data_len = sizeof(status_expdata_success),
+			},
+			.init_request_data = test_init_request_data_from_attrs,
+			.init_expected_data = test_init_expected_data_from_attrs,
+		},
+		{
+			.name = "RPMI_SYSMSI_INJECT (MSI 1 disabled)",
+			.run = test_inject_run,
+			.check = test_inject_check,
+		},
+		{
+			.name = "RPMI_SYSMSI_SRV_SET_MSI_STATE (enable MSI 1)",
+			.attrs = {
+				.servicegroup_id = RPMI_SRVGRP_SYSTEM_MSI,
+				.service_id = RPMI_SYSMSI_SRV_SET_MSI_STATE,
+				.flags = RPMI_MSG_NORMAL_REQUEST,
+				.request_data = set_state_reqdata_msi1,
+				.request_data_len = sizeof(set_state_reqdata_msi1),
+				.expected_data = status_expdata_success,
+				.expected_data_len = sizeof(status_expdata_success),
+			},
+			.init_request_data = test_init_request_data_from_attrs,
+			.init_expected_data = test_init_expected_data_from_attrs,
+		},
+		{
+			.name = "RPMI_SYSMSI_PENDING_DELIVERED_ONCE",
+			.run = test_pending_run,
+			.check = test_pending_check,
+		},
+	},
+};
+
+int main(int argc, char *argv[])
+{
+	printf("Test System MSI Service Group\n");
+
+	/* Execute pending MSI scenario */
+	return test_scenario_execute(&scenario_sysmsi_pending);
+}
@@ -0,0 +1,148 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 Ventana Micro Systems Inc.
+ */
+
+#include <librpmi.h>
+#include <stdio.h>
+#include "test_common.h"
+#include "test_log.h"
+
+/* Small ring so that a few requests wrap it */
+#define TEST_TRACE_EVENTS	8
+#define TEST_TRACE_SZ		(sizeof(struct rpmi_trace_ring) + \
+				 TEST_TRACE_EVENTS * sizeof(struct rpmi_trace_event))
+
+static rpmi_uint64_t trace_mem[TEST_TRACE_SZ / sizeof(rpmi_uint64_t)];
+
+static rpmi_uint32_t impl_ver_expdata_default[] = {
+	RPMI_SUCCESS,
+	RPMI_BASE_VERSION(LIBRPMI_IMPL_VERSION_MAJOR, LIBRPMI_IMPL_VERSION_MINOR),
+};
+
+#ifdef LIBRPMI_TRACE
+/*
+ * Walk the ring from the oldest to the most recent event like the trace
+ * decoder does and check that the events are in sequence order.
+ */
+static int test_trace_check_ring(void)
+{
+	const struct rpmi_trace_ring *ring = (void *)trace_mem;
+	const struct rpmi_trace_event *ev;
+	rpmi_uint32_t seq, head, num, dispatching = 0;
+	rpmi_uint64_t prev_ts = 0;
+
+	head = ring->head;
+	num = ring->num_events;
+	if (ring->magic != RPMI_TRACE_RING_MAGIC || num != TEST_TRACE_EVENTS)
+		return RPMI_ERR_FAILED;
+
+	/* Ring must have wrapped at least once */
+	if (head <= num)
+		return RPMI_ERR_FAILED;
+
+	for (seq = head - num; seq != head; seq++) {
+		ev = &ring->events[seq & (num - 1)];
+		if (ev->seq != seq + 1 || ev->timestamp < prev_ts ||
+		    ev->type == RPMI_TRACE_EVENT_NONE ||
+		    ev->type >= RPMI_TRACE_EVENT_MAX)
+			return RPMI_ERR_FAILED;
+		prev_ts = ev->timestamp;
+
+		/* Dispatch of a request must end after it started */
+		if (ev->type == RPMI_TRACE_EVENT_DISPATCH_START) {
+			if (dispatching)
+				return RPMI_ERR_FAILED;
+			dispatching = 1;
+		} else if (ev->type == RPMI_TRACE_EVENT_DISPATCH_END) {
+			if (!dispatching && seq != head - num)
+				return RPMI_ERR_FAILED;
+			dispatching = 0;
+		}
+	}
+
+	return RPMI_SUCCESS;
+}
+#endif
+
+static int test_trace_check(struct rpmi_test_scenario *scene,
+			    struct rpmi_test *test)
+{
+#ifdef LIBRPMI_TRACE
+	return test_trace_check_ring();
+#else
+	/* Nothing is recorded without LIBRPMI_TRACE */
+	return (rpmi_trace_init(trace_mem, sizeof(trace_mem)) ==
+		RPMI_ERR_NOTSUPP) ? RPMI_SUCCESS : RPMI_ERR_FAILED;
+#endif
+}
+
+static int test_scenario_trace_init(struct rpmi_test_scenario *scene)
+{
+	int rc;
+
+	rc = test_scenario_default_init(scene);
+	if (rc)
+		return rc;
+
+#ifdef LIBRPMI_TRACE
+	if (rpmi_trace_init(trace_mem, sizeof(trace_mem))) {
+		printf("%s: failed to initialize trace ring\n", __func__);
+		test_scenario_default_cleanup(scene);
+		return RPMI_ERR_FAILED;
+	}
+#endif
+
+	return 0;
+}
+
+static int test_scenario_trace_cleanup(struct rpmi_test_scenario *scene)
+{
+	rpmi_trace_init(NULL, 0);
+	return test_scenario_default_cleanup(scene);
+}
+
+#define TEST_TRACE_REQUEST						\
+	{								\
+		.name = "RPMI_BASE_SRV_GET_IMPLEMENTATION_VERSION",	\
+		.attrs = {						\
+			.servicegroup_id = RPMI_SRVGRP_BASE,		\
+			.service_id = RPMI_BASE_SRV_GET_IMPLEMENTATION_VERSION, \
+			.flags = RPMI_MSG_NORMAL_REQUEST,		\
+			.expected_data = impl_ver_expdata_default,	\
+			.expected_data_len = sizeof(impl_ver_expdata_default), \
+		},							\
+		.init_expected_data = test_init_expected_data_from_attrs, \
+	}
+
+static struct rpmi_test_scenario scenario_trace_wrap = {
+	.name = "Trace Ring Wrap",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = NULL,
+
+	.init = test_scenario_trace_init,
+	.cleanup = test_scenario_trace_cleanup,
+
+	.num_tests = 5,
+	.tests = {
+		TEST_TRACE_REQUEST,
+		TEST_TRACE_REQUEST,
+		TEST_TRACE_REQUEST,
+		TEST_TRACE_REQUEST,
+		{
+			.name = "RPMI_TRACE_RING_WRAP_ORDER",
+			.check = test_trace_check,
+		},
+	},
+};
+
+int main(int argc, char *argv[])
+{
+	printf("Test Trace Ring\n");
+
+	/* Execute trace ring wrap scenario */
+	return test_scenario_execute(&scenario_trace_wrap);
+}
@@ -0,0 +1,600 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 Ventana Micro Systems Inc.
+ */
+
+#include <librpmi.h>
+#include <pthread.h>
+#include <stdio.h>
+#include "test_common.h"
+#include "test_log.h"
+
+/* Data slots of the A2P request queue created by test_scenario_default_init() */
+#define TEST_A2P_DATA_SLOTS	((((RPMI_SHM_SZ * 3) / 4) / 2) / RPMI_SLOT_SIZE - 2)
+
+/* One slot is always kept free so a full queue holds one less message */
+#define TEST_A2P_MAX_MSGS	(TEST_A2P_DATA_SLOTS - 1)
+
+/* Batch larger than the queue so that it is only partially enqueued */
+#define TEST_BATCH_MAX		(TEST_A2P_DATA_SLOTS + 4)
+
+/* Messages passed between the producer thread and the consumer */
+#define TEST_SPSC_MSGS		4096
+
+static rpmi_uint8_t test_batch[TEST_BATCH_MAX * RPMI_SLOT_SIZE];
+
+/* Set by the consumer to stop the producer thread upon failure */
+static volatile rpmi_bool_t test_spsc_stop;
+
+static rpmi_uint32_t impl_ver_expdata_default[] = {
+	RPMI_SUCCESS,
+	RPMI_BASE_VERSION(LIBRPMI_IMPL_VERSION_MAJOR, LIBRPMI_IMPL_VERSION_MINOR),
+};
+
+/* Fill a batch of messages where each message carries its sequence number */
+static void test_batch_fill(struct rpmi_transport *trans, rpmi_uint32_t count,
+			    rpmi_uint32_t seq)
+{
+	struct rpmi_message *msg;
+	rpmi_uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		msg = rpmi_transport_batch_msg(trans, (void *)test_batch, i);
+		msg->header.servicegroup_id = RPMI_SRVGRP_BASE;
+		msg->header.service_id = RPMI_BASE_SRV_GET_IMPLEMENTATION_VERSION;
+		msg->header.flags = RPMI_MSG_NORMAL_REQUEST;
+		msg->header.datalen = sizeof(rpmi_uint32_t);
+		msg->header.token = (rpmi_uint16_t)(seq + i);
+		*(rpmi_uint32_t *)msg->data = seq + i;
+	}
+}
+
+/* Check that a batch of messages is in sequence starting from seq */
+static int test_batch_verify(struct rpmi_transport *trans, rpmi_uint32_t count,
+			     rpmi_uint32_t seq)
+{
+	struct rpmi_message *msg;
+	rpmi_uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		msg = rpmi_transport_batch_msg(trans, (void *)test_batch, i);
+		if (msg->header.token != (rpmi_uint16_t)(seq + i) ||
+		    msg->header.datalen != sizeof(rpmi_uint32_t) ||
+		    *(rpmi_uint32_t *)msg->data != seq + i) {
+			printf("%s: message %u out of sequence\n", __func__, i);
+			return RPMI_ERR_FAILED;
+		}
+	}
+
+	return RPMI_SUCCESS;
+}
+
+/* Enqueue and dequeue a batch and check that all messages pass in order */
+static int test_batch_transfer(struct rpmi_transport *trans,
+			       rpmi_uint32_t count, rpmi_uint32_t expected,
+			       rpmi_uint32_t seq)
+{
+	rpmi_uint32_t out_count;
+	int rc;
+
+	test_batch_fill(trans, count, seq);
+	rc = rpmi_transport_enqueue_batch(trans, RPMI_QUEUE_A2P_REQ,
+					  (void *)test_batch, count, &out_count);
+	if (rc || out_count != expected) {
+		printf("%s: enqueued %u of %u messages (rc %d)\n",
+		       __func__, out_count, count, rc);
+		return RPMI_ERR_FAILED;
+	}
+
+	rpmi_env_memset(test_batch, 0, sizeof(test_batch));
+	rc = rpmi_transport_dequeue_batch(trans, RPMI_QUEUE_A2P_REQ,
+					  (void *)test_batch, count, &out_count);
+	if (rc || out_count != expected) {
+		printf("%s: dequeued %u of %u messages (rc %d)\n",
+		       __func__, out_count, expected, rc);
+		return RPMI_ERR_FAILED;
+	}
+
+	return test_batch_verify(trans, expected, seq);
+}
+
+static int test_batch_wrap_check(struct rpmi_test_scenario *scene,
+				 struct rpmi_test *test)
+{
+	rpmi_uint32_t before_wrap = 6, out_count;
+	int rc;
+
+	/* Move head and tail close to the end of the queue */
+	rc = test_batch_transfer(scene->xport, TEST_A2P_DATA_SLOTS - before_wrap,
+				 TEST_A2P_DATA_SLOTS - before_wrap, 0);
+	if (rc)
+		return rc;
+
+	/* Batch is copied in two chunks, before and after the wrap point */
+	rc = test_batch_transfer(scene->xport, before_wrap + 8,
+				 before_wrap + 8, 100);
+	if (rc)
+		return rc;
+
+	/* Batch larger than the queue stops when the queue is full */
+	rc = test_batch_transfer(scene->xport, TEST_BATCH_MAX,
+				 TEST_A2P_MAX_MSGS, 200);
+	if (rc)
+		return rc;
+
+	/* Queue is empty again */
+	rc = rpmi_transport_dequeue_batch(scene->xport, RPMI_QUEUE_A2P_REQ,
+					  (void *)test_batch, TEST_BATCH_MAX,
+					  &out_count);
+	return (rc == RPMI_ERR_IO && !out_count) ? RPMI_SUCCESS : RPMI_ERR_FAILED;
+}
+
+static int test_batch_full_check(struct rpmi_test_scenario *scene,
+				 struct rpmi_test *test)
+{
+	rpmi_uint32_t out_count;
+	int rc;
+
+	/* Fill the queue past its data slots */
+	test_batch_fill(scene->xport, TEST_BATCH_MAX, 300);
+	rc = rpmi_transport_enqueue_batch(scene->xport, RPMI_QUEUE_A2P_REQ,
+					  (void *)test_batch, TEST_BATCH_MAX,
+					  &out_count);
+	if (rc || out_count != TEST_A2P_MAX_MSGS)
+		return RPMI_ERR_FAILED;
+
+	/* Nothing more fits into a full queue */
+	rc = rpmi_transport_enqueue_batch(scene->xport, RPMI_QUEUE_A2P_REQ,
+					  (void *)test_batch, 1, &out_count);
+	if (rc != RPMI_ERR_IO || out_count)
+		return RPMI_ERR_FAILED;
+
+	/* Dequeue in two batches where the second one crosses the wrap */
+	rc = rpmi_transport_dequeue_batch(scene->xport, RPMI_QUEUE_A2P_REQ,
+					  (void *)test_batch, 10, &out_count);
+	if (rc || out_count != 10 || test_batch_verify(scene->xport, 10, 300))
+		return RPMI_ERR_FAILED;
+
+	rc = rpmi_transport_dequeue_batch(scene->xport, RPMI_QUEUE_A2P_REQ,
+					  (void *)test_batch, TEST_BATCH_MAX,
+					  &out_count);
+	if (rc || out_count != TEST_A2P_MAX_MSGS - 10)
+		return RPMI_ERR_FAILED;
+
+	return test_batch_verify(scene->xport, TEST_A2P_MAX_MSGS - 10, 310);
+}
+
+static struct rpmi_test_scenario scenario_transport_batch = {
+	.name = "Transport Batch Enqueue/Dequeue",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = NULL,
+
+	.init = test_scenario_default_init,
+	.cleanup = test_scenario_default_cleanup,
+
+	.num_tests = 2,
+	.tests = {
+		{
+			.name = "TRANSPORT_BATCH_WRAP",
+			.check = test_batch_wrap_check,
+		},
+		{
+			.name = "TRANSPORT_BATCH_FULL",
+			.check = test_batch_full_check,
+		},
+	},
+};
+
+static int test_spsc_lock_check(struct rpmi_test_scenario *scene,
+				struct rpmi_test *test)
+{
+	/* No transport lock is allocated in SPSC mode */
+	return (scene->xport->lock) ? RPMI_ERR_FAILED : RPMI_SUCCESS;
+}
+
+/* Producer side of the A2P request queue running on its own thread */
+static void *test_spsc_producer(void *arg)
+{
+	struct rpmi_transport *trans = arg;
+	rpmi_uint8_t buf[RPMI_SLOT_SIZE];
+	struct rpmi_message *msg = (void *)buf;
+	rpmi_uint32_t seq = 0;
+	int rc;
+
+	msg->header.servicegroup_id = RPMI_SRVGRP_BASE;
+	msg->header.service_id = RPMI_BASE_SRV_GET_IMPLEMENTATION_VERSION;
+	msg->header.flags = RPMI_MSG_NORMAL_REQUEST;
+	msg->header.datalen = sizeof(rpmi_uint32_t);
+	while (seq < TEST_SPSC_MSGS && !test_spsc_stop) {
+		msg->header.token = (rpmi_uint16_t)seq;
+		*(rpmi_uint32_t *)msg->data = seq;
+		rc = rpmi_transport_enqueue(trans, RPMI_QUEUE_A2P_REQ, msg);
+		if (rc == RPMI_ERR_IO)
+			continue;
+		if (rc)
+			return (void *)1UL;
+		seq++;
+	}
+
+	return NULL;
+}
+
+static int test_spsc_concurrent_check(struct rpmi_test_scenario *scene,
+				      struct rpmi_test *test)
+{
+	rpmi_uint8_t buf[RPMI_SLOT_SIZE];
+	struct rpmi_message *msg = (void *)buf;
+	rpmi_uint32_t seq = 0;
+	pthread_t producer;
+	void *ret;
+	int rc;
+
+	if (pthread_create(&producer, NULL, test_spsc_producer, scene->xport))
+		return RPMI_ERR_FAILED;
+
+	/* Consume concurrently and check that nothing is lost or reordered */
+	while (seq < TEST_SPSC_MSGS) {
+		rc = rpmi_transport_dequeue(scene->xport, RPMI_QUEUE_A2P_REQ, msg);
+		if (rc == RPMI_ERR_IO)
+			continue;
+		if (rc || msg->header.token != (rpmi_uint16_t)seq ||
+		    *(rpmi_uint32_t *)msg->data != seq) {
+			printf("%s: message %u out of sequence (rc %d)\n",
+			       __func__, seq, rc);
+			test_spsc_stop = true;
+			break;
+		}
+		seq++;
+	}
+
+	pthread_join(producer, &ret);
+	return (seq == TEST_SPSC_MSGS && !ret) ? RPMI_SUCCESS : RPMI_ERR_FAILED;
+}
+
+#define TEST_IMPL_VERSION_REQUEST					\
+	{								\
+		.name = "RPMI_BASE_SRV_GET_IMPLEMENTATION_VERSION",	\
+		.attrs = {						\
+			.servicegroup_id = RPMI_SRVGRP_BASE,		\
+			.service_id = RPMI_BASE_SRV_GET_IMPLEMENTATION_VERSION, \
+			.flags = RPMI_MSG_NORMAL_REQUEST,		\
+			.expected_data = impl_ver_expdata_default,	\
+			.expected_data_len = sizeof(impl_ver_expdata_default), \
+		},							\
+		.init_expected_data = test_init_expected_data_from_attrs, \
+	}
+
+static struct rpmi_test_scenario scenario_transport_spsc = {
+	.name = "Transport SPSC Mode",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.xport_flags = LIBRPMI_TRANSPORT_SHMEM_FLAG_SPSC,
+	.priv = NULL,
+
+	.init = test_scenario_default_init,
+	.cleanup = test_scenario_default_cleanup,
+
+	.num_tests = 4,
+	.tests = {
+		{
+			.name = "TRANSPORT_SPSC_NO_LOCK",
+			.check = test_spsc_lock_check,
+		},
+		{
+			.name = "TRANSPORT_SPSC_CONCURRENT",
+			.check = test_spsc_concurrent_check,
+		},
+		TEST_IMPL_VERSION_REQUEST,
+		TEST_IMPL_VERSION_REQUEST,
+	},
+};
+
+/* Number of head/tail index reads from the shared memory */
+static rpmi_uint32_t test_index_reads;
+
+/* rpmi_shmem_simple_ops with index reads counted */
+static struct rpmi_shmem_platform_ops test_counting_ops;
+
+static enum rpmi_error test_counting_read32(void *priv, rpmi_uint64_t addr,
+					    rpmi_uint32_t *val)
+{
+	test_index_reads++;
+	return rpmi_shmem_simple_ops.read32(priv, addr, val);
+}
+
+static int test_scenario_counting_init(struct rpmi_test_scenario *scene)
+{
+	test_counting_ops = rpmi_shmem_simple_ops;
+	test_counting_ops.read32 = test_counting_read32;
+
+	return test_scenario_default_init(scene);
+}
+
+/* Enqueue single messages until count messages are enqueued or queue is full */
+static rpmi_uint32_t test_enqueue_msgs(struct rpmi_transport *trans,
+				       rpmi_uint32_t count)
+{
+	rpmi_uint32_t i;
+
+	test_batch_fill(trans, 1, 0);
+	for (i = 0; i < count; i++) {
+		if (rpmi_transport_enqueue(trans, RPMI_QUEUE_A2P_REQ,
+					   (void *)test_batch))
+			break;
+	}
+
+	return i;
+}
+
+/* Dequeue single messages until count messages are dequeued or queue is empty */
+static rpmi_uint32_t test_dequeue_msgs(struct rpmi_transport *trans,
+				       rpmi_uint32_t count)
+{
+	rpmi_uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		if (rpmi_transport_dequeue(trans, RPMI_QUEUE_A2P_REQ,
+					   (void *)test_batch))
+			break;
+	}
+
+	return i;
+}
+
+static int test_consumer_refetch_check(struct rpmi_test_scenario *scene,
+				       struct rpmi_test *test)
+{
+	test_index_reads = 0;
+
+	/* Cached view is empty so the tail is re-fetched */
+	if (test_dequeue_msgs(scene->xport, 1) || test_index_reads != 1)
+		return RPMI_ERR_FAILED;
+
+	/* Producer trusts its cached head while there are free slots */
+	if (test_enqueue_msgs(scene->xport, 3) != 3 || test_index_reads != 1)
+		return RPMI_ERR_FAILED;
+
+	/* Only the first dequeue re-fetches the tail */
+	if (test_dequeue_msgs(scene->xport, 3) != 3 || test_index_reads != 2)
+		return RPMI_ERR_FAILED;
+
+	/* Empty again so the tail is re-fetched once more */
+	if (test_dequeue_msgs(scene->xport, 1) || test_index_reads != 3)
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static int test_producer_refetch_check(struct rpmi_test_scenario *scene,
+				       struct rpmi_test *test)
+{
+	rpmi_uint32_t out_count;
+
+	test_index_reads = 0;
+
+	/*
+	 * Cached head is still at zero while the consumer has moved it to
+	 * three so the cached view says full three messages too early.
+	 */
+	if (test_enqueue_msgs(scene->xport, TEST_A2P_MAX_MSGS - 3) !=
+	    TEST_A2P_MAX_MSGS - 3 || test_index_reads)
+		return RPMI_ERR_FAILED;
+
+	/* Cached view is full so the head is re-fetched */
+	if (test_enqueue_msgs(scene->xport, 1) != 1 || test_index_reads != 1)
+		return RPMI_ERR_FAILED;
+
+	/* Remaining free slots are known without a re-fetch */
+	if (test_enqueue_msgs(scene->xport, 2) != 2 || test_index_reads != 1)
+		return RPMI_ERR_FAILED;
+
+	/* Queue is really full */
+	if (test_enqueue_msgs(scene->xport, 1) || test_index_reads != 2)
+		return RPMI_ERR_FAILED;
+
+	/* Consumer re-fetches once for the whole batch */
+	if (rpmi_transport_dequeue_batch(scene->xport, RPMI_QUEUE_A2P_REQ,
+					 (void *)test_batch, TEST_BATCH_MAX,
+					 &out_count) ||
+	    out_count != TEST_A2P_MAX_MSGS || test_index_reads != 3)
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static struct rpmi_test_scenario scenario_transport_refetch = {
+	.name = "Transport Shadow Index Refetch",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.shmem_ops = &test_counting_ops,
+	.priv = NULL,
+
+	.init = test_scenario_counting_init,
+	.cleanup = test_scenario_default_cleanup,
+
+	.num_tests = 2,
+	.tests = {
+		{
+			.name = "TRANSPORT_CONSUMER_REFETCH",
+			.check = test_consumer_refetch_check,
+		},
+		{
+			.name = "TRANSPORT_PRODUCER_REFETCH",
+			.check = test_producer_refetch_check,
+		},
+	},
+};
+
+/* Publish single messages in-place until count messages or queue is full */
+static rpmi_uint32_t test_publish_msgs(struct rpmi_transport *trans,
+				       rpmi_uint32_t count, rpmi_uint32_t seq)
+{
+	struct rpmi_message_header hdr;
+	struct rpmi_message *msg;
+	rpmi_uint32_t i;
+
+	hdr.servicegroup_id = RPMI_SRVGRP_BASE;
+	hdr.service_id = RPMI_BASE_SRV_GET_IMPLEMENTATION_VERSION;
+	hdr.flags = RPMI_MSG_NORMAL_REQUEST;
+	hdr.datalen = sizeof(rpmi_uint32_t);
+	for (i = 0; i < count; i++) {
+		if (rpmi_transport_reserve_slot(trans, RPMI_QUEUE_A2P_REQ, &msg))
+			break;
+		hdr.token = (rpmi_uint16_t)(seq + i);
+		rpmi_transport_convert_header(trans, &msg->header, &hdr);
+		*(rpmi_uint32_t *)msg->data = rpmi_to_xe32(trans->is_be, seq + i);
+		if (rpmi_transport_publish_slot(trans, RPMI_QUEUE_A2P_REQ))
+			break;
+	}
+
+	return i;
+}
+
+/* Consume single messages in-place and check that they are in sequence */
+static rpmi_uint32_t test_commit_msgs(struct rpmi_transport *trans,
+				      rpmi_uint32_t count, rpmi_uint32_t seq)
+{
+	struct rpmi_message_header hdr;
+	struct rpmi_message *msg;
+	rpmi_uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		if (rpmi_transport_peek_slot(trans, RPMI_QUEUE_A2P_REQ, &msg))
+			break;
+		rpmi_transport_convert_header(trans, &hdr, &msg->header);
+		if (hdr.token != (rpmi_uint16_t)(seq + i) ||
+		    rpmi_to_xe32(trans->is_be, *(rpmi_uint32_t *)msg->data) != seq + i)
+			break;
+		if (rpmi_transport_commit_slot(trans, RPMI_QUEUE_A2P_REQ))
+			break;
+	}
+
+	return i;
+}
+
+static int test_inplace_check(struct rpmi_test_scenario *scene,
+			      struct rpmi_test *test)
+{
+	if (!rpmi_transport_has_peek_slot(scene->xport) ||
+	    !rpmi_transport_has_reserve_slot(scene->xport))
+		return RPMI_ERR_FAILED;
+
+	/* Messages published in-place are seen in-place by the consumer */
+	if (test_publish_msgs(scene->xport, 3, 0) != 3 ||
+	    test_commit_msgs(scene->xport, 3, 0) != 3)
+		return RPMI_ERR_FAILED;
+
+	/* Reserve fails once the queue is full and peek once it is empty */
+	if (test_publish_msgs(scene->xport, TEST_BATCH_MAX, 100) != TEST_A2P_MAX_MSGS ||
+	    test_commit_msgs(scene->xport, TEST_BATCH_MAX, 100) != TEST_A2P_MAX_MSGS)
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static int test_copy_fallback_check(struct rpmi_test_scenario *scene,
+				    struct rpmi_test *test)
+{
+	struct rpmi_message *msg;
+
+	/* Requests of an untrusted AP are never accessed in-place */
+	if (rpmi_transport_has_peek_slot(scene->xport) ||
+	    rpmi_transport_peek_slot(scene->xport, RPMI_QUEUE_A2P_REQ, &msg) !=
+	    RPMI_ERR_NOTSUPP)
+		return RPMI_ERR_FAILED;
+
+	/* Acknowledgements can still be written in-place */
+	if (!rpmi_transport_has_reserve_slot(scene->xport))
+		return RPMI_ERR_FAILED;
+
+	/*
+	 * Messages published in-place are copied out by the consumer and
+	 * the last one copied is left in the buffer.
+	 */
+	if (test_publish_msgs(scene->xport, 3, 0) != 3)
+		return RPMI_ERR_FAILED;
+	rpmi_env_memset(test_batch, 0, sizeof(test_batch));
+	if (test_dequeue_msgs(scene->xport, 3) != 3 ||
+	    test_batch_verify(scene->xport, 1, 2))
+		return RPMI_ERR_FAILED;
+
+	return RPMI_SUCCESS;
+}
+
+static struct rpmi_test_scenario scenario_transport_trusted = {
+	.name = "Transport Trusted AP In-place Access",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.xport_flags = LIBRPMI_TRANSPORT_SHMEM_FLAG_TRUSTED_AP,
+	.priv = NULL,
+
+	.init = test_scenario_default_init,
+	.cleanup = test_scenario_default_cleanup,
+
+	.num_tests = 3,
+	.tests = {
+		{
+			.name = "TRANSPORT_INPLACE_RESERVE_PEEK",
+			.check = test_inplace_check,
+		},
+		TEST_IMPL_VERSION_REQUEST,
+		TEST_IMPL_VERSION_REQUEST,
+	},
+};
+
+static struct rpmi_test_scenario scenario_transport_untrusted = {
+	.name = "Transport Untrusted AP Copy Fallback",
+	.shm_size = RPMI_SHM_SZ,
+	.slot_size = RPMI_SLOT_SIZE,
+	.max_num_groups = RPMI_SRVGRP_ID_MAX_COUNT,
+	.priv = NULL,
+
+	.init = test_scenario_default_init,
+	.cleanup = test_scenario_default_cleanup,
+
+	.num_tests = 3,
+	.tests = {
+		{
+			.name = "TRANSPORT_COPY_FALLBACK",
+			.check = test_copy_fallback_check,
+		},
+		TEST_IMPL_VERSION_REQUEST,
+		TEST_IMPL_VERSION_REQUEST,
+	},
+};
+
+int main(int argc, char *argv[])
+{
+	int rc;
+
+	printf("Test Shared Memory Transport\n");
+
+	/* Execute batch enqueue/dequeue scenario */
+	rc = test_scenario_execute(&scenario_transport_batch);
+	if (rc)
+		return rc;
+
+	/* Execute SPSC mode scenario */
+	rc = test_scenario_execute(&scenario_transport_spsc);
+	if (rc)
+		return rc;
+
+	/* Execute shadow index refetch scenario */
+	rc = test_scenario_execute(&scenario_transport_refetch);
+	if (rc)
+		return rc;
+
+	/* Execute in-place access scenario */
+	rc = test_scenario_execute(&scenario_transport_trusted);
+	if (rc)
+		return rc;
+
+	/* Execute copy fallback scenario */
+	return test_scenario_execute(&scenario_transport_untrusted);
+}
@@ -0,0 +1,245 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 Ventana Micro Systems Inc.
+ */
+
+/*
+ * Host-side decoder of a RPMI trace ring (see rpmi_trace_init()) dumped as
+ * raw binary, for example the memory of the shared memory region holding
+ * the ring. The ring header is searched at 8 byte aligned offsets so the
+ * dump does not need to start with the ring. Events which were torn or not
+ * yet written when the dump was taken are skipped.
+ */
+
+#include <librpmi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char *decode_event_names[RPMI_TRACE_EVENT_MAX] = {
+	[RPMI_TRACE_EVENT_NONE] = "none",
+	[RPMI_TRACE_EVENT_DEQUEUE] = "dequeue",
+	[RPMI_TRACE_EVENT_DISPATCH_START] = "dispatch-start",
+	[RPMI_TRACE_EVENT_DISPATCH_END] = "dispatch-end",
+	[RPMI_TRACE_EVENT_ACK_ENQUEUE] = "ack-enqueue",
+	[RPMI_TRACE_EVENT_QUEUE_FULL] = "queue-full",
+	[RPMI_TRACE_EVENT_MSI_INJECT] = "msi-inject",
+	[RPMI_TRACE_EVENT_HSM_STATE] = "hsm-state",
+};
+
+static const char *decode_queue_names[RPMI_QUEUE_MAX] = {
+	[RPMI_QUEUE_A2P_REQ] = "a2p-req",
+	[RPMI_QUEUE_P2A_ACK] = "p2a-ack",
+	[RPMI_QUEUE_P2A_REQ] = "p2a-req",
+	[RPMI_QUEUE_A2P_ACK] = "a2p-ack",
+};
+
+static const char *decode_hart_state_names[] = {
+	[RPMI_HSM_HART_STATE_STARTED] = "started",
+	[RPMI_HSM_HART_STATE_STOPPED] = "stopped",
+	[RPMI_HSM_HART_STATE_START_PENDING] = "start-pending",
+	[RPMI_HSM_HART_STATE_STOP_PENDING] = "stop-pending",
+	[RPMI_HSM_HART_STATE_SUSPENDED] = "suspended",
+	[RPMI_HSM_HART_STATE_SUSPEND_PENDING] = "suspend-pending",
+	[RPMI_HSM_HART_STATE_RESUME_PENDING] = "resume-pending",
+};
+
+#define decode_name(names, idx)						\
+	(((idx) < sizeof(names) / sizeof((names)[0]) && (names)[idx]) ?	\
+	 (names)[idx] : "unknown")
+
+static int decode_swap;
+
+static rpmi_uint16_t decode16(rpmi_uint16_t v)
+{
+	return decode_swap ? __builtin_bswap16(v) : v;
+}
+
+static rpmi_uint32_t decode32(rpmi_uint32_t v)
+{
+	return decode_swap ? __builtin_bswap32(v) : v;
+}
+
+static rpmi_uint64_t decode64(rpmi_uint64_t v)
+{
+	return decode_swap ? __builtin_bswap64(v) : v;
+}
+
+static void decode_event(const struct rpmi_trace_event *ev, rpmi_uint32_t seq,
+			 rpmi_uint64_t delta)
+{
+	rpmi_uint16_t arg1 = decode16(ev->arg1);
+	rpmi_uint32_t arg2 = decode32(ev->arg2);
+
+	printf("%10u %20llu %+12lld %-15s ", seq,
+	       (unsigned long long)decode64(ev->timestamp), (long long)delta,
+	       decode_name(decode_event_names, ev->type));
+
+	switch (ev->type) {
+	case RPMI_TRACE_EVENT_DEQUEUE:
+	case RPMI_TRACE_EVENT_ACK_ENQUEUE:
+		printf("queue=%s count=%u\n",
+		       decode_name(decode_queue_names, ev->arg0), arg1);
+		break;
+	case RPMI_TRACE_EVENT_QUEUE_FULL:
+		printf("queue=%s pending=%u\n",
+		       decode_name(decode_queue_names, ev->arg0), arg1);
+		break;
+	case RPMI_TRACE_EVENT_DISPATCH_START:
+		printf("group=0x%x service=0x%x token=0x%x\n",
+		       arg1, ev->arg0, arg2 & 0xffff);
+		break;
+	case RPMI_TRACE_EVENT_DISPATCH_END:
+		printf("group=0x%x service=0x%x token=0x%x rc=%d\n",
+		       arg1, ev->arg0, arg2 & 0xffff,
+		       (rpmi_int16_t)(arg2 >> 16));
+		break;
+	case RPMI_TRACE_EVENT_MSI_INJECT:
+		printf("msi=%u\n", arg2);
+		break;
+	case RPMI_TRACE_EVENT_HSM_STATE:
+		printf("hart=0x%x %s -> %s\n", arg2,
+		       arg1 == 0xffff ? "initial" :
+		       decode_name(decode_hart_state_names, arg1),
+		       decode_name(decode_hart_state_names, ev->arg0));
+		break;
+	default:
+		printf("arg0=0x%x arg1=0x%x arg2=0x%x\n", ev->arg0, arg1, arg2);
+		break;
+	}
+}
+
+static const struct rpmi_trace_ring *decode_find_ring(const rpmi_uint8_t *buf,
+						      size_t size)
+{
+	const struct rpmi_trace_ring *ring;
+	size_t off;
+
+	for (off = 0; off + sizeof(*ring) <= size; off += sizeof(rpmi_uint64_t)) {
+		ring = (const struct rpmi_trace_ring *)(buf + off);
+		if (ring->magic == RPMI_TRACE_RING_MAGIC)
+			decode_swap = 0;
+		else if (ring->magic == __builtin_bswap32(RPMI_TRACE_RING_MAGIC))
+			decode_swap = 1;
+		else
+			continue;
+
+		if (decode16(ring->version) != RPMI_TRACE_RING_VERSION ||
+		    decode16(ring->event_size) != sizeof(ring->events[0]))
+			continue;
+		if (off + sizeof(*ring) + (size_t)decode32(ring->num_events) *
+				sizeof(ring->events[0]) > size)
+			continue;
+
+		printf("Trace ring at offset 0x%lx (%s endian, %u events)\n",
+		       (unsigned long)off, decode_swap ? "foreign" : "native",
+		       decode32(ring->num_events));
+		return ring;
+	}
+
+	return NULL;
+}
+
+static void decode_usage(const char *prog)
+{
+	printf("Usage: %s [-n last_events] <dump_file>\n", prog);
+	printf("  -n  only decode the most recent events\n");
+}
+
+int main(int argc, char *argv[])
+{
+	const struct rpmi_trace_event *ev;
+	const struct rpmi_trace_ring *ring;
+	struct rpmi_trace_event event;
+	rpmi_uint32_t head, num, seq, last = 0, skipped = 0;
+	rpmi_uint64_t prev_ts = 0, ts;
+	rpmi_bool_t first = true;
+	rpmi_uint8_t *buf = NULL;
+	size_t size = 0, count;
+	int opt, rc = 1;
+	FILE *fp;
+
+	while ((opt = getopt(argc, argv, "n:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			last = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			decode_usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if (optind != argc - 1) {
+		decode_usage(argv[0]);
+		return 1;
+	}
+
+	fp = fopen(argv[optind], "rb");
+	if (!fp) {
+		printf("Failed to open %s\n", argv[optind]);
+		return 1;
+	}
+
+	/* Read the complete dump with 8 byte aligned buffer */
+	do {
+		buf = realloc(buf, size + 65536);
+		if (!buf) {
+			printf("Failed to allocate dump buffer\n");
+			goto done;
+		}
+		count = fread(buf + size, 1, 65536, fp);
+		size += count;
+	} while (count == 65536);
+
+	ring = decode_find_ring(buf, size);
+	if (!ring) {
+		printf("No trace ring found in %s\n", argv[optind]);
+		goto done;
+	}
+
+	head = decode32(ring->head);
+	num = decode32(ring->num_events);
+	if (num & (num - 1)) {
+		printf("Invalid number of events %u\n", num);
+		goto done;
+	}
+	if (head < num)
+		num = head;
+	if (last && last < num)
+		num = last;
+
+	printf("%10s %20s %12s %-15s %s\n", "seq", "timestamp", "delta",
+	       "event", "details");
+	for (seq = head - num; seq != head; seq++) {
+		ev = &ring->events[seq & (decode32(ring->num_events) - 1)];
+		if (decode32(*(volatile const rpmi_uint32_t *)&ev->seq) != seq + 1) {
+			skipped++;
+			continue;
+		}
+
+		/* Event rewritten while being copied has a different sequence */
+		rpmi_env_fence_acquire();
+		memcpy(&event, ev, sizeof(event));
+		rpmi_env_fence_acquire();
+		if (decode32(*(volatile const rpmi_uint32_t *)&ev->seq) != seq + 1 ||
+		    decode32(event.seq) != seq + 1) {
+			skipped++;
+			continue;
+		}
+
+		ts = decode64(event.timestamp);
+		decode_event(&event, seq, first ? 0 : ts - prev_ts);
+		prev_ts = ts;
+		first = false;
+	}
+	if (skipped)
+		printf("Skipped %u torn or unwritten events\n", skipped);
+	rc = 0;
+
+done:
+	free(buf);
+	fclose(fp);
+	return rc;
+}